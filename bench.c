@@ -0,0 +1,253 @@
+#define _POSIX_C_SOURCE 200809L
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <time.h>
+#endif
+
+#include "byte_struct.h"
+
+#define BENCH_DEFAULT_RECORDS (1 << 16)
+#define BENCH_ARRAY_COUNT 16
+#define BENCH_REPETITIONS 5
+#define BENCH_PARSE_ITERATIONS 100000
+
+static double bench_now_ns(void) {
+#ifdef _WIN32
+    LARGE_INTEGER freq, counter;
+    QueryPerformanceFrequency(&freq);
+    QueryPerformanceCounter(&counter);
+    return (double)counter.QuadPart * 1e9 / (double)freq.QuadPart;
+#else
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (double)ts.tv_sec * 1e9 + (double)ts.tv_nsec;
+#endif
+}
+
+typedef struct {
+    byte_struct_type_t type;
+    char format;
+    const char *name;
+} bench_type_t;
+
+static const bench_type_t bench_types[] = {
+    {BYTE_STRUCT_TYPE_CHAR, 'c', "char"},
+    {BYTE_STRUCT_TYPE_INT8, 'b', "int8"},
+    {BYTE_STRUCT_TYPE_UINT8, 'B', "uint8"},
+    {BYTE_STRUCT_TYPE_INT16, 'h', "int16"},
+    {BYTE_STRUCT_TYPE_UINT16, 'H', "uint16"},
+    {BYTE_STRUCT_TYPE_INT32, 'i', "int32"},
+    {BYTE_STRUCT_TYPE_UINT32, 'I', "uint32"},
+    {BYTE_STRUCT_TYPE_INT64, 'l', "int64"},
+    {BYTE_STRUCT_TYPE_UINT64, 'L', "uint64"},
+    {BYTE_STRUCT_TYPE_FLOAT, 'f', "float"},
+    {BYTE_STRUCT_TYPE_DOUBLE, 'd', "double"},
+    {BYTE_STRUCT_TYPE_HALF, 'e', "half"},
+    {BYTE_STRUCT_TYPE_BFLOAT16, 'E', "bfloat16"},
+    {BYTE_STRUCT_TYPE_PTR, 'p', "ptr"},
+    {BYTE_STRUCT_TYPE_RELPTR, 'r', "relptr"}
+};
+
+#define BENCH_NUM_TYPES (sizeof(bench_types) / sizeof(bench_types[0]))
+
+static const struct {
+    byte_order_t byte_order;
+    const char *name;
+} bench_byte_orders[] = {
+    {BYTE_STRUCT_BIG_ENDIAN, "BIG_ENDIAN"},
+    {BYTE_STRUCT_LITTLE_ENDIAN, "LITTLE_ENDIAN"},
+    {BYTE_STRUCT_NATIVE_ENDIAN, "NATIVE_ENDIAN"},
+    {BYTE_STRUCT_SORTABLE, "SORTABLE"}
+};
+
+#define BENCH_NUM_BYTE_ORDERS (sizeof(bench_byte_orders) / sizeof(bench_byte_orders[0]))
+
+// Formats resembling real keys and records
+static const char *bench_parse_formats[] = {
+    "l",
+    "IlL",
+    "bI[4]f",
+    "HHIlc[16]d",
+    "c[32]lllIIIddf[8]p"
+};
+
+#define BENCH_NUM_PARSE_FORMATS (sizeof(bench_parse_formats) / sizeof(bench_parse_formats[0]))
+
+static volatile uint64_t bench_sink;
+
+static bool bench_pack_one(byte_struct_t *s, uint8_t *data, byte_struct_type_t type, size_t count, uint8_t *values) {
+    if (count > 1) {
+        return byte_struct_pack(s, data, (void *)values);
+    }
+    switch (type) {
+        case BYTE_STRUCT_TYPE_CHAR:
+            return byte_struct_pack(s, data, (char)values[0]);
+        case BYTE_STRUCT_TYPE_INT8:
+            return byte_struct_pack(s, data, *(int8_t *)values);
+        case BYTE_STRUCT_TYPE_UINT8:
+            return byte_struct_pack(s, data, *(uint8_t *)values);
+        case BYTE_STRUCT_TYPE_INT16:
+            return byte_struct_pack(s, data, *(int16_t *)values);
+        case BYTE_STRUCT_TYPE_UINT16:
+            return byte_struct_pack(s, data, *(uint16_t *)values);
+        case BYTE_STRUCT_TYPE_INT32:
+            return byte_struct_pack(s, data, *(int32_t *)values);
+        case BYTE_STRUCT_TYPE_UINT32:
+            return byte_struct_pack(s, data, *(uint32_t *)values);
+        case BYTE_STRUCT_TYPE_INT64:
+            return byte_struct_pack(s, data, *(int64_t *)values);
+        case BYTE_STRUCT_TYPE_UINT64:
+            return byte_struct_pack(s, data, *(uint64_t *)values);
+        case BYTE_STRUCT_TYPE_FLOAT:
+        case BYTE_STRUCT_TYPE_HALF:
+        case BYTE_STRUCT_TYPE_BFLOAT16:
+            return byte_struct_pack(s, data, (double)*(float *)values);
+        case BYTE_STRUCT_TYPE_DOUBLE:
+            return byte_struct_pack(s, data, *(double *)values);
+        case BYTE_STRUCT_TYPE_PTR:
+        case BYTE_STRUCT_TYPE_RELPTR:
+            return byte_struct_pack(s, data, *(void **)values);
+        default:
+            return false;
+    }
+}
+
+typedef enum {
+    BENCH_OP_PACK,
+    BENCH_OP_UNPACK,
+    BENCH_OP_PACK_BATCH,
+    BENCH_OP_UNPACK_BATCH
+} bench_op_t;
+
+static const char *bench_op_names[] = {"pack", "unpack", "pack_batch", "unpack_batch"};
+
+// Best of BENCH_REPETITIONS runs, in nanoseconds
+static double bench_run(bench_op_t op, byte_struct_t *s, uint8_t *data, uint8_t *values, size_t n) {
+    type_offset_t type_offset = s->type_offsets[0];
+    // Values in their C representation, e.g. floats for half fields
+    size_t value_size = type_offset.native_size * type_offset.count;
+    double best = -1.0;
+    for (size_t rep = 0; rep < BENCH_REPETITIONS; rep++) {
+        double start = bench_now_ns();
+        switch (op) {
+            case BENCH_OP_PACK:
+                for (size_t i = 0; i < n; i++) {
+                    bench_pack_one(s, data + i * s->total_size, type_offset.type, type_offset.count, values + i * value_size);
+                }
+                break;
+            case BENCH_OP_UNPACK:
+                for (size_t i = 0; i < n; i++) {
+                    byte_struct_unpack(s, data + i * s->total_size, s->total_size, (void *)(values + i * value_size));
+                }
+                break;
+            case BENCH_OP_PACK_BATCH:
+                byte_struct_pack_batch(s, data, n, (void *[]){values});
+                break;
+            case BENCH_OP_UNPACK_BATCH:
+                byte_struct_unpack_batch(s, data, n, (void *[]){values});
+                break;
+        }
+        double elapsed = bench_now_ns() - start;
+        bench_sink += data[(rep * 31) % (n * s->total_size)] + values[(rep * 17) % (n * value_size)];
+        if (best < 0.0 || elapsed < best) best = elapsed;
+    }
+    return best;
+}
+
+static void bench_print_result(bool *first, const char *op, const char *type, size_t count, const char *byte_order, size_t record_size, size_t n, double ns) {
+    double ns_per_record = ns / (double)n;
+    double gb_per_s = ns > 0.0 ? (double)(record_size * n) / ns : 0.0;
+    printf("%s\n    {\"op\": \"%s\", \"type\": \"%s\", \"count\": %zu, \"byte_order\": \"%s\", \"record_size\": %zu, \"ns_per_record\": %.3f, \"gb_per_s\": %.3f}",
+           *first ? "" : ",", op, type, count, byte_order, record_size, ns_per_record, gb_per_s);
+    *first = false;
+}
+
+int main(int argc, char **argv) {
+    size_t n = BENCH_DEFAULT_RECORDS;
+    if (argc > 1) {
+        n = (size_t)strtoull(argv[1], NULL, 10);
+        if (n == 0) {
+            fprintf(stderr, "usage: %s [records]\n", argv[0]);
+            return 1;
+        }
+    }
+
+    size_t max_record_size = sizeof(uint64_t) * BENCH_ARRAY_COUNT;
+    uint8_t *data = malloc(n * max_record_size);
+    uint8_t *values = malloc(n * max_record_size);
+    uint8_t *baseline = malloc(n * max_record_size);
+    if (data == NULL || values == NULL || baseline == NULL) {
+        fprintf(stderr, "out of memory\n");
+        return 1;
+    }
+    // Pointers are packed but never dereferenced, so any bit pattern will do
+    for (size_t i = 0; i < n * max_record_size; i++) {
+        values[i] = (uint8_t)(i * 2654435761u >> 13);
+    }
+
+    printf("{\n  \"version\": \"%s\",\n  \"records\": %zu,\n  \"repetitions\": %d,\n  \"results\": [", BYTE_STRUCT_VERSION, n, BENCH_REPETITIONS);
+
+    bool first = true;
+    size_t counts[] = {1, BENCH_ARRAY_COUNT};
+    for (size_t c = 0; c < sizeof(counts) / sizeof(counts[0]); c++) {
+        size_t count = counts[c];
+        for (size_t t = 0; t < BENCH_NUM_TYPES; t++) {
+            char format[16];
+            if (count == 1) {
+                snprintf(format, sizeof(format), "%c", bench_types[t].format);
+            } else {
+                snprintf(format, sizeof(format), "%c[%zu]", bench_types[t].format, count);
+            }
+            size_t record_size = 0;
+            for (size_t o = 0; o < BENCH_NUM_BYTE_ORDERS; o++) {
+                byte_struct_t *s = byte_struct_new_len_options(format, strlen(format), bench_byte_orders[o].byte_order);
+                if (s == NULL) {
+                    fprintf(stderr, "failed to parse %s\n", format);
+                    return 1;
+                }
+                record_size = s->total_size;
+                for (bench_op_t op = BENCH_OP_PACK; op <= BENCH_OP_UNPACK_BATCH; op++) {
+                    double ns = bench_run(op, s, data, values, n);
+                    bench_print_result(&first, bench_op_names[op], bench_types[t].name, count, bench_byte_orders[o].name, record_size, n, ns);
+                }
+                byte_struct_destroy(s);
+            }
+
+            double best = -1.0;
+            for (size_t rep = 0; rep < BENCH_REPETITIONS; rep++) {
+                double start = bench_now_ns();
+                memcpy(baseline, values, n * record_size);
+                double elapsed = bench_now_ns() - start;
+                bench_sink += baseline[(rep * 31) % (n * record_size)];
+                if (best < 0.0 || elapsed < best) best = elapsed;
+            }
+            bench_print_result(&first, "memcpy", bench_types[t].name, count, "NONE", record_size, n, best);
+        }
+    }
+    printf("\n  ],\n  \"parse\": [");
+
+    for (size_t f = 0; f < BENCH_NUM_PARSE_FORMATS; f++) {
+        const char *format = bench_parse_formats[f];
+        double start = bench_now_ns();
+        for (size_t i = 0; i < BENCH_PARSE_ITERATIONS; i++) {
+            byte_struct_t *s = byte_struct_new(format);
+            bench_sink += s->total_size;
+            byte_struct_destroy(s);
+        }
+        double elapsed = bench_now_ns() - start;
+        printf("%s\n    {\"format\": \"%s\", \"ns_per_call\": %.3f}", f == 0 ? "" : ",", format, elapsed / BENCH_PARSE_ITERATIONS);
+    }
+    printf("\n  ]\n}\n");
+
+    free(data);
+    free(values);
+    free(baseline);
+    return 0;
+}
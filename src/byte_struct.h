@@ -7,6 +7,9 @@
 #include <string.h>
 
 #include "lex_order/lex_order.h"
+#include "byte_struct_half.h"
+
+#define BYTE_STRUCT_VERSION "0.1.0"
 
 static const char BYTE_STRUCT_FORMAT_CHAR = 'c';
 static const char BYTE_STRUCT_FORMAT_INT8 = 'b';
@@ -19,7 +22,26 @@ static const char BYTE_STRUCT_FORMAT_INT64 = 'l';
 static const char BYTE_STRUCT_FORMAT_UINT64 = 'L';
 static const char BYTE_STRUCT_FORMAT_FLOAT = 'f';
 static const char BYTE_STRUCT_FORMAT_DOUBLE = 'd';
+// 16-bit floats, packed from and unpacked to float
+static const char BYTE_STRUCT_FORMAT_HALF = 'e';
+static const char BYTE_STRUCT_FORMAT_BFLOAT16 = 'E';
 static const char BYTE_STRUCT_FORMAT_PTR = 'p';
+// Pointer stored as an int64 distance from the field itself, see byte_struct_relptr.h
+static const char BYTE_STRUCT_FORMAT_RELPTR = 'r';
+
+// Prefix modifier, e.g. "I-l" sorts the int64 field descending under BYTE_STRUCT_SORTABLE
+static const char BYTE_STRUCT_FORMAT_DESCENDING = '-';
+/*
+Prefix modifiers for nullable fields, e.g. "i?d" or "i!-l". The field gets a
+one-byte null marker in front of its value; nulls sort before ('?') or after
+('!') every value under BYTE_STRUCT_SORTABLE, whatever the field's direction.
+*/
+static const char BYTE_STRUCT_FORMAT_NULLABLE = '?';
+static const char BYTE_STRUCT_FORMAT_NULLABLE_LAST = '!';
+
+// Groups of fields that can be repeated, e.g. "i(Hf)[8]"
+static const char BYTE_STRUCT_FORMAT_GROUP_START = '(';
+static const char BYTE_STRUCT_FORMAT_GROUP_END = ')';
 
 typedef enum {
     BYTE_STRUCT_TYPE_CHAR,
@@ -33,9 +55,16 @@ typedef enum {
     BYTE_STRUCT_TYPE_UINT64,
     BYTE_STRUCT_TYPE_FLOAT,
     BYTE_STRUCT_TYPE_DOUBLE,
-    BYTE_STRUCT_TYPE_PTR
+    BYTE_STRUCT_TYPE_PTR,
+    // Later additions go at the end so stored type numbers keep their meaning
+    BYTE_STRUCT_TYPE_RELPTR,
+    BYTE_STRUCT_TYPE_GROUP,
+    BYTE_STRUCT_TYPE_HALF,
+    BYTE_STRUCT_TYPE_BFLOAT16
 } byte_struct_type_t;
 
+#define BYTE_STRUCT_NUM_TYPES (BYTE_STRUCT_TYPE_BFLOAT16 + 1)
+
 typedef enum {
     BYTE_STRUCT_BIG_ENDIAN,
     BYTE_STRUCT_LITTLE_ENDIAN,
@@ -43,19 +72,59 @@ typedef enum {
     BYTE_STRUCT_SORTABLE
 } byte_order_t;
 
+#define BYTE_STRUCT_NUM_BYTE_ORDERS (BYTE_STRUCT_SORTABLE + 1)
+
+// Field flags set by format modifiers
+#define BYTE_STRUCT_FIELD_DESCENDING (1 << 0)
+#define BYTE_STRUCT_FIELD_NULLABLE (1 << 1)
+#define BYTE_STRUCT_FIELD_NULLS_LAST (1 << 2)
+
+/*
+offset is from the start of the record for top-level fields and from the start
+of the enclosing group element for group members. size is the packed size of
+one element (a group's stride), native_size/native_offset describe the same
+field in the natural C struct layout used for values passed to pack/unpack.
+null_offset (nullable fields only) is the marker byte, relative like offset,
+directly in front of the value; one marker covers every element of an array.
+*/
 typedef struct type_offset {
     size_t offset;
     size_t count;
     byte_struct_type_t type;
+    uint32_t flags;
+    size_t size;
+    size_t null_offset;
+    size_t native_offset;
+    size_t native_size;
+    // groups only, members are type_offsets[first_child..first_child + num_children)
+    size_t first_child;
+    size_t num_children;
 } type_offset_t;
 
+/*
+type_offsets[0..num_fields) are the top-level fields, group members follow
+up to num_type_offsets.
+*/
 typedef struct byte_struct {
     byte_order_t byte_order;
     size_t num_fields;
+    size_t num_type_offsets;
     size_t total_size;
+#ifdef BYTE_STRUCT_STATS
+    struct byte_struct_latency *latency;
+#endif
     type_offset_t type_offsets[];
 } byte_struct_t;
 
+#ifdef BYTE_STRUCT_STATS
+#include "byte_struct_stats.h"
+#else
+#define BYTE_STRUCT_STATS_ADD(counter, n) ((void)0)
+#define BYTE_STRUCT_STATS_RECORDS(op, s, n) ((void)0)
+#define BYTE_STRUCT_STATS_SAMPLE_START(start)
+#define BYTE_STRUCT_STATS_SAMPLE_END(s, op, start) ((void)0)
+#endif
+
 static bool byte_struct_type_and_size(char c, byte_struct_type_t *type, size_t *size) {
     if (c == BYTE_STRUCT_FORMAT_CHAR) {
         *size = sizeof(char);
@@ -90,9 +159,18 @@ static bool byte_struct_type_and_size(char c, byte_struct_type_t *type, size_t *
     } else if (c == BYTE_STRUCT_FORMAT_DOUBLE) {
         *size = sizeof(double);
         *type = BYTE_STRUCT_TYPE_DOUBLE;
+    } else if (c == BYTE_STRUCT_FORMAT_HALF) {
+        *size = sizeof(uint16_t);
+        *type = BYTE_STRUCT_TYPE_HALF;
+    } else if (c == BYTE_STRUCT_FORMAT_BFLOAT16) {
+        *size = sizeof(uint16_t);
+        *type = BYTE_STRUCT_TYPE_BFLOAT16;
     } else if (c == BYTE_STRUCT_FORMAT_PTR) {
         *size = sizeof(void *);
         *type = BYTE_STRUCT_TYPE_PTR;
+    } else if (c == BYTE_STRUCT_FORMAT_RELPTR) {
+        *size = sizeof(int64_t);
+        *type = BYTE_STRUCT_TYPE_RELPTR;
     } else {
         return false;
     }
@@ -100,124 +178,308 @@ static bool byte_struct_type_and_size(char c, byte_struct_type_t *type, size_t *
     return true;
 }
 
-static byte_struct_t *byte_struct_new_len_options(const char *format, size_t len, byte_order_t byte_order) {
-    if (format == NULL || len == 0) return NULL;
+/*
+Validates one sequence of items, up to the end of the format or (if nested)
+the matching ')'. num_items counts the items at this level, num_total every
+item including the members of nested groups.
+*/
+static bool byte_struct_parse_count(const char *format, size_t len, size_t *pos, bool nested, size_t *num_items, size_t *num_total) {
+    size_t i = *pos;
+    bool prev_was_item = false;
+    bool pending_descending = false;
+    bool pending_nullable = false;
 
-    size_t num_fields = 0;
-    size_t i = 0, j = 0;
-
-    bool prev_was_type = false;
-
-    for (i = 0; i < len; i++) {
-        if (format[i] == '[') {
-            if (!prev_was_type) {
-                return NULL;
-            }
-            j = i + 1;
+    while (i < len) {
+        char c = format[i];
+        bool pending_modifier = pending_descending || pending_nullable;
+        if (c == BYTE_STRUCT_FORMAT_DESCENDING) {
+            if (pending_descending) return false;
+            pending_descending = true;
+            prev_was_item = false;
+            i++;
+        } else if (c == BYTE_STRUCT_FORMAT_NULLABLE || c == BYTE_STRUCT_FORMAT_NULLABLE_LAST) {
+            if (pending_nullable) return false;
+            pending_nullable = true;
+            prev_was_item = false;
+            i++;
+        } else if (c == '[') {
+            if (!prev_was_item) return false;
+            size_t j = i + 1;
             while (j < len && format[j] != ']') {
                 if (format[j] < '0' || format[j] > '9') {
-                    return NULL;
+                    return false;
                 }
                 j++;
             }
             if (j < i + 2 || j == len) {
-                return NULL;
+                return false;
             }
-            i = j;
-            prev_was_type = false;
+            i = j + 1;
+            prev_was_item = false;
+        } else if (c == BYTE_STRUCT_FORMAT_GROUP_START) {
+            // modifiers apply to individual members, not whole groups
+            if (pending_modifier) return false;
+            size_t group_items = 0;
+            i++;
+            if (!byte_struct_parse_count(format, len, &i, true, &group_items, num_total)) return false;
+            if (group_items == 0) return false;
+            (*num_items)++;
+            (*num_total)++;
+            prev_was_item = true;
+        } else if (c == BYTE_STRUCT_FORMAT_GROUP_END) {
+            if (!nested || pending_modifier) return false;
+            *pos = i + 1;
+            return true;
         } else {
-            char c = format[i];
-            if ((c == BYTE_STRUCT_FORMAT_CHAR) ||
-                (c == BYTE_STRUCT_FORMAT_INT8) ||
-                (c == BYTE_STRUCT_FORMAT_UINT8) ||
-                (c == BYTE_STRUCT_FORMAT_INT16) ||
-                (c == BYTE_STRUCT_FORMAT_UINT16) ||
-                (c == BYTE_STRUCT_FORMAT_INT32) ||
-                (c == BYTE_STRUCT_FORMAT_UINT32) ||
-                (c == BYTE_STRUCT_FORMAT_INT64) ||
-                (c == BYTE_STRUCT_FORMAT_UINT64) ||
-                (c == BYTE_STRUCT_FORMAT_FLOAT) ||
-                (c == BYTE_STRUCT_FORMAT_DOUBLE) ||
-                (c == BYTE_STRUCT_FORMAT_PTR)) {
-                    num_fields++;
-            } else {
-                return NULL;
-            }
-            prev_was_type = true;
+            byte_struct_type_t type;
+            size_t type_size;
+            if (!byte_struct_type_and_size(c, &type, &type_size)) return false;
+            // a descending offset would be decoded away from its own address
+            if (pending_descending && type == BYTE_STRUCT_TYPE_RELPTR) return false;
+            (*num_items)++;
+            (*num_total)++;
+            pending_descending = false;
+            pending_nullable = false;
+            prev_was_item = true;
+            i++;
         }
     }
+    // unclosed group or dangling modifier
+    if (nested || pending_descending || pending_nullable) return false;
+    *pos = i;
+    return true;
+}
 
-    byte_struct_t *s = malloc(sizeof(byte_struct_t) + num_fields * sizeof(type_offset_t));
-    if (s == NULL) return NULL;
-    s->num_fields = num_fields;
-    s->byte_order = byte_order;
-    size_t total_size = 0;
-    size_t prev_size = 0;
+static bool byte_struct_align_up(size_t *value, size_t align) {
+    size_t remainder = *value % align;
+    if (remainder == 0) return true;
+    if (SIZE_MAX - *value < align - remainder) return false;
+    *value += align - remainder;
+    return true;
+}
 
-    size_t current_field = 0;
+/*
+Lays out one (already validated) sequence of items into type_offsets[first...].
+Members of a group get the next free slots after all top-level fields, so
+type_offsets[0..num_fields) are always the top-level fields in order.
 
-    size_t current_size = 0;
+Alongside the packed layout this computes the natural C struct layout of each
+group, which is how group values are passed to pack/unpack.
+*/
+static bool byte_struct_parse_layout(const char *format, size_t len, size_t *pos, byte_struct_t *s, size_t first, size_t *next_free, size_t *size, size_t *native_size, size_t *native_align) {
     const size_t max_array_div_10 = SIZE_MAX / 10;
     const size_t max_array_mod_10 = SIZE_MAX % 10;
 
-    i = 0;
-    char format_type = '\0';
-    byte_struct_type_t type;
-
-    size_t count = 1;
+    size_t i = *pos;
+    size_t current = first;
+    size_t total_size = 0;
+    size_t total_native_size = 0;
+    size_t max_align = 1;
+    uint32_t flags = 0;
 
     while (i < len) {
-        if (format[i] == '[') {
+        char c = format[i];
+        if (c == BYTE_STRUCT_FORMAT_DESCENDING) {
+            flags |= BYTE_STRUCT_FIELD_DESCENDING;
+            i++;
+            continue;
+        } else if (c == BYTE_STRUCT_FORMAT_NULLABLE || c == BYTE_STRUCT_FORMAT_NULLABLE_LAST) {
+            flags |= BYTE_STRUCT_FIELD_NULLABLE;
+            if (c == BYTE_STRUCT_FORMAT_NULLABLE_LAST) flags |= BYTE_STRUCT_FIELD_NULLS_LAST;
+            i++;
+            continue;
+        } else if (c == BYTE_STRUCT_FORMAT_GROUP_END) {
+            i++;
+            break;
+        }
+
+        type_offset_t *type_offset = &s->type_offsets[current++];
+        size_t item_size = 0;
+        size_t item_native_size = 0;
+        size_t item_align = 1;
+
+        if (c == BYTE_STRUCT_FORMAT_GROUP_START) {
+            size_t j = i + 1;
+            size_t num_children = 0, ignored = 0;
+            byte_struct_parse_count(format, len, &j, true, &num_children, &ignored);
+            size_t first_child = *next_free;
+            *next_free += num_children;
+            i++;
+            if (!byte_struct_parse_layout(format, len, &i, s, first_child, next_free, &item_size, &item_native_size, &item_align)) {
+                return false;
+            }
+            *type_offset = (type_offset_t){.type = BYTE_STRUCT_TYPE_GROUP, .first_child = first_child, .num_children = num_children};
+        } else {
+            byte_struct_type_t type;
+            byte_struct_type_and_size(c, &type, &item_size);
+            item_native_size = item_size;
+            if (type == BYTE_STRUCT_TYPE_HALF || type == BYTE_STRUCT_TYPE_BFLOAT16) {
+                item_native_size = sizeof(float);
+            } else if (type == BYTE_STRUCT_TYPE_RELPTR) {
+                item_native_size = sizeof(void *);
+            }
+            item_align = item_native_size;
+            *type_offset = (type_offset_t){.type = type, .flags = flags};
+            flags = 0;
+            i++;
+        }
+
+        size_t count = 1;
+        if (i < len && format[i] == '[') {
             count = 0;
             size_t j = i + 1;
             while (j < len && format[j] != ']') {
                 uint8_t digit = format[j] - '0';
                 if (count > max_array_div_10 || (count == max_array_div_10 && digit > max_array_mod_10)) {
-                    free(s);
-                    return NULL;
+                    return false;
                 }
                 count = (count * 10) + (size_t)digit;
                 j++;
             }
-
-            if ((SIZE_MAX - total_size) / prev_size < (count - 1)) {
-                free(s);
-                return NULL;
-            }
-            // We validated above that the [ is not the first character.
-            // Use count - 1 since we already accounted for the first element
-            total_size += (prev_size * (count - 1));
-            if (j == len) {
-                // closing brace at the end of the format string
-                s->type_offsets[current_field++] = (type_offset_t){.offset = total_size, .type = type, .count = count};
-            // we know the current_field is at least 1 from validation above
-            } else {
-                s->type_offsets[current_field - 1].count = count;
-            }
+            if (count == 0) return false;
             i = j + 1;
-        } else {
-            format_type = format[i];
-            size_t type_size = 0;
-            if (!byte_struct_type_and_size(format_type, &type, &type_size)) {
-                free(s);
-                return NULL;
-            }
-            if (SIZE_MAX - total_size < type_size) {
-                free(s);
-                return NULL;
-            }
-            type_offset_t type_offset = {.offset = total_size, .type = type, .count = 1};
-            s->type_offsets[current_field++] = type_offset;
-            i++;
-            count = 1;
-            prev_size = type_size;
-            total_size += type_size;
         }
+
+        if (type_offset->flags & BYTE_STRUCT_FIELD_NULLABLE) {
+            if (total_size == SIZE_MAX) return false;
+            type_offset->null_offset = total_size++;
+        }
+        if (item_size > 0 && (SIZE_MAX - total_size) / item_size < count) {
+            return false;
+        }
+        type_offset->offset = total_size;
+        type_offset->count = count;
+        type_offset->size = item_size;
+        type_offset->native_size = item_native_size;
+        total_size += item_size * count;
+
+        if (!byte_struct_align_up(&total_native_size, item_align)) return false;
+        if (item_native_size > 0 && (SIZE_MAX - total_native_size) / item_native_size < count) {
+            return false;
+        }
+        type_offset->native_offset = total_native_size;
+        total_native_size += item_native_size * count;
+        if (item_align > max_align) max_align = item_align;
     }
-    s->total_size = total_size;
+
+    if (!byte_struct_align_up(&total_native_size, max_align)) return false;
+    *pos = i;
+    *size = total_size;
+    *native_size = total_native_size;
+    *native_align = max_align;
+    return true;
+}
+
+static byte_struct_t *byte_struct_parse(const char *format, size_t len, byte_order_t byte_order) {
+    if (format == NULL || len == 0) return NULL;
+
+    size_t num_fields = 0;
+    size_t num_type_offsets = 0;
+    size_t pos = 0;
+    if (!byte_struct_parse_count(format, len, &pos, false, &num_fields, &num_type_offsets)) {
+        return NULL;
+    }
+
+    byte_struct_t *s = malloc(sizeof(byte_struct_t) + num_type_offsets * sizeof(type_offset_t));
+    if (s == NULL) return NULL;
+    s->num_fields = num_fields;
+    s->num_type_offsets = num_type_offsets;
+    s->byte_order = byte_order;
+
+    pos = 0;
+    size_t next_free = num_fields;
+    size_t native_size = 0, native_align = 0;
+    if (!byte_struct_parse_layout(format, len, &pos, s, 0, &next_free, &s->total_size, &native_size, &native_align)) {
+        free(s);
+        return NULL;
+    }
+    return s;
+}
+
+static byte_struct_t *byte_struct_new_len_options(const char *format, size_t len, byte_order_t byte_order) {
+    BYTE_STRUCT_STATS_ADD(parse_calls, 1);
+    byte_struct_t *s = byte_struct_parse(format, len, byte_order);
+    if (s == NULL) {
+        BYTE_STRUCT_STATS_ADD(parse_failures, 1);
+        return NULL;
+    }
+#ifdef BYTE_STRUCT_STATS
+    s->latency = calloc(1, sizeof(byte_struct_latency_t));
+#endif
     return s;
 }
 
+// Encoded size of the first num_fields top-level fields, the whole record if num_fields >= s->num_fields
+size_t byte_struct_prefix_size(byte_struct_t *s, size_t num_fields) {
+    if (s == NULL) return 0;
+    if (num_fields >= s->num_fields) return s->total_size;
+    type_offset_t *next = &s->type_offsets[num_fields];
+    return (next->flags & BYTE_STRUCT_FIELD_NULLABLE) ? next->null_offset : next->offset;
+}
+
+/*
+Resolves a path to a field inside nested groups. The path alternates field
+index and element index: {field}, {field, element}, {field, element, member},
+{field, element, member, element}, ... On success out describes the addressed
+field with offset relative to the start of the record, so it can be passed to
+the batch column helpers or read directly. A path ending on an element index
+addresses that single element.
+*/
+bool byte_struct_field_path(byte_struct_t *s, size_t *path, size_t path_len, type_offset_t *out) {
+    if (s == NULL || path == NULL || path_len == 0 || out == NULL) return false;
+    if (path[0] >= s->num_fields) return false;
+
+    type_offset_t field = s->type_offsets[path[0]];
+    size_t base = 0;
+    for (size_t i = 1; i < path_len; i++) {
+        if (i % 2 == 1) {
+            if (path[i] >= field.count) return false;
+            field.offset += path[i] * field.size;
+            field.count = 1;
+        } else {
+            if (field.type != BYTE_STRUCT_TYPE_GROUP || path[i] >= field.num_children) return false;
+            base += field.offset;
+            field = s->type_offsets[field.first_child + path[i]];
+        }
+    }
+    *out = field;
+    out->offset += base;
+    out->null_offset += base;
+    return true;
+}
+
+/*
+Descending fields store the complement of the sortable encoding, so memcmp
+order is reversed for that field only. Other byte orders ignore the flag.
+*/
+static inline bool byte_struct_field_descending(byte_struct_t *s, type_offset_t *type_offset) {
+    return (type_offset->flags & BYTE_STRUCT_FIELD_DESCENDING) && s->byte_order == BYTE_STRUCT_SORTABLE;
+}
+
+static inline bool byte_struct_field_nullable(type_offset_t *type_offset) {
+    return (type_offset->flags & BYTE_STRUCT_FIELD_NULLABLE) != 0;
+}
+
+/*
+The null marker is 0 for nulls and 1 for values, or the other way round for
+nulls last. It is the same in every byte order and never complemented, so
+convert and transcode copy it as is and descending fields keep their null order.
+*/
+static inline uint8_t byte_struct_null_marker(type_offset_t *type_offset, bool is_null) {
+    bool nulls_last = (type_offset->flags & BYTE_STRUCT_FIELD_NULLS_LAST) != 0;
+    return is_null == nulls_last ? 1 : 0;
+}
+
+static void byte_struct_complement(uint8_t *data, size_t n) {
+    for (size_t i = 0; i < n; i++) {
+        data[i] = (uint8_t)~data[i];
+    }
+}
+
+static void byte_struct_pack_field(byte_struct_t *s, type_offset_t *type_offset, uint8_t *data, void *values);
+static void byte_struct_unpack_field(byte_struct_t *s, type_offset_t *type_offset, uint8_t *data, void *values);
+static void byte_struct_pack_null(byte_struct_t *s, type_offset_t *type_offset, uint8_t *data);
+static void byte_struct_skip_pack_arg(type_offset_t *type_offset, va_list *args);
 
 static void byte_struct_pack_int8(byte_struct_t *s, uint8_t *data, int8_t value) {
     if (s->byte_order == BYTE_STRUCT_SORTABLE) {
@@ -394,6 +656,62 @@ static void byte_struct_pack_float_array(byte_struct_t *s, uint8_t *data, float
     }
 }
 
+#define BYTE_STRUCT_HALF_CHUNK 64
+
+/*
+16-bit float bit patterns in any byte order. The sortable encoding is the one
+lex_ordered_write_float uses, at 16 bits: flip the sign bit of positives and
+every bit of negatives, then big-endian.
+*/
+static void byte_struct_write_float16_bits(byte_struct_t *s, uint8_t *data, uint16_t *bits, size_t n) {
+    if (s->byte_order == BYTE_STRUCT_SORTABLE) {
+        for (size_t i = 0; i < n; i++) {
+            uint16_t u = bits[i];
+            u = (u & 0x8000) ? (uint16_t)~u : (uint16_t)(u | 0x8000);
+            write_uint16_big_endian(data + i * sizeof(uint16_t), u);
+        }
+    } else if (s->byte_order == BYTE_STRUCT_BIG_ENDIAN) {
+        for (size_t i = 0; i < n; i++) {
+            write_uint16_big_endian(data + i * sizeof(uint16_t), bits[i]);
+        }
+    } else if (s->byte_order == BYTE_STRUCT_LITTLE_ENDIAN) {
+        for (size_t i = 0; i < n; i++) {
+            write_uint16_little_endian(data + i * sizeof(uint16_t), bits[i]);
+        }
+    } else {
+        memcpy(data, bits, n * sizeof(uint16_t));
+    }
+}
+
+static void byte_struct_pack_float16_array(byte_struct_t *s, uint8_t *data, float *values, size_t n, bool bfloat16) {
+    uint16_t bits[BYTE_STRUCT_HALF_CHUNK];
+    for (size_t i = 0; i < n; i += BYTE_STRUCT_HALF_CHUNK) {
+        size_t m = n - i < BYTE_STRUCT_HALF_CHUNK ? n - i : BYTE_STRUCT_HALF_CHUNK;
+        if (bfloat16) {
+            byte_struct_float_to_bfloat16_array(values + i, bits, m);
+        } else {
+            byte_struct_float_to_half_array(values + i, bits, m);
+        }
+        byte_struct_write_float16_bits(s, data + i * sizeof(uint16_t), bits, m);
+    }
+}
+
+static void byte_struct_pack_half(byte_struct_t *s, uint8_t *data, float value) {
+    byte_struct_pack_float16_array(s, data, &value, 1, false);
+}
+
+static void byte_struct_pack_half_array(byte_struct_t *s, uint8_t *data, float *values, size_t n) {
+    byte_struct_pack_float16_array(s, data, values, n, false);
+}
+
+static void byte_struct_pack_bfloat16(byte_struct_t *s, uint8_t *data, float value) {
+    byte_struct_pack_float16_array(s, data, &value, 1, true);
+}
+
+static void byte_struct_pack_bfloat16_array(byte_struct_t *s, uint8_t *data, float *values, size_t n) {
+    byte_struct_pack_float16_array(s, data, values, n, true);
+}
+
 static void byte_struct_pack_int64(byte_struct_t *s, uint8_t *data, int64_t value) {
     if (s->byte_order == BYTE_STRUCT_SORTABLE) {
         lex_ordered_write_int64(data, value);
@@ -478,13 +796,13 @@ static void byte_struct_unpack_ptr(byte_struct_t *s, uint8_t *data, void **value
         memcpy(value, data, sizeof(void *));
     }
 }
-static void byte_struct_unpack_ptr_array(byte_struct_t *s, uint8_t *data, void ***values, size_t n) {
+static void byte_struct_unpack_ptr_array(byte_struct_t *s, uint8_t *data, void **values, size_t n) {
     if (s->byte_order == BYTE_STRUCT_SORTABLE) {
         for (size_t i = 0; i < n; i++) {
-            (*values)[i] = (void *)(uintptr_t)lex_ordered_read_uint64(data + i * sizeof(void *));
+            values[i] = (void *)(uintptr_t)lex_ordered_read_uint64(data + i * sizeof(void *));
         }
     } else {
-        memcpy(values, data, n * sizeof(void **));
+        memcpy(values, data, n * sizeof(void *));
     }
 }
 #elif UINTPTR_MAX == 0xFFFFFFFF
@@ -511,19 +829,50 @@ static void byte_struct_unpack_ptr(byte_struct_t *s, uint8_t *data, void **value
         memcpy(value, data, sizeof(void *));
     }
 }
-static void byte_struct_unpack_ptr_array(byte_struct_t *s, uint8_t *data, void ***values, size_t n) {
+static void byte_struct_unpack_ptr_array(byte_struct_t *s, uint8_t *data, void **values, size_t n) {
     if (s->byte_order == BYTE_STRUCT_SORTABLE) {
         for (size_t i = 0; i < n; i++) {
-            (*values)[i] = (void *)(uintptr_t)lex_ordered_read_uint32(data + i * sizeof(void *));
+            values[i] = (void *)(uintptr_t)lex_ordered_read_uint32(data + i * sizeof(void *));
         }
     } else {
-        memcpy(values, data, n * sizeof(void **));
+        memcpy(values, data, n * sizeof(void *));
     }
 }
 #else
 #error "Unsupported pointer size"
 #endif
 
+/*
+Self-relative pointers store target - field address as an int64 in the struct's
+byte order, with INT64_MIN for NULL so that 0 can point at the field itself
+(e.g. the sentinel of an empty circular list). A pool of records linked this
+way can be written out and mapped back at any address without fixing pointers
+up. The arithmetic wraps at pointer width so offsets are the same on 32 and
+64-bit builds, where no real distance reaches INT64_MIN.
+*/
+#define BYTE_STRUCT_RELPTR_NULL_OFFSET INT64_MIN
+
+static inline int64_t byte_struct_relptr_offset(uint8_t *field, void *target) {
+    if (target == NULL) return BYTE_STRUCT_RELPTR_NULL_OFFSET;
+    return (int64_t)(intptr_t)((uintptr_t)target - (uintptr_t)field);
+}
+
+static inline void *byte_struct_relptr_target(uint8_t *field, int64_t offset) {
+    if (offset == BYTE_STRUCT_RELPTR_NULL_OFFSET) return NULL;
+    return (void *)((uintptr_t)field + (uintptr_t)(intptr_t)offset);
+}
+
+static void byte_struct_pack_relptr(byte_struct_t *s, uint8_t *data, void *value) {
+    byte_struct_pack_int64(s, data, byte_struct_relptr_offset(data, value));
+}
+
+static void byte_struct_pack_relptr_array(byte_struct_t *s, uint8_t *data, void **values, size_t n) {
+    for (size_t i = 0; i < n; i++) {
+        uint8_t *field = data + i * sizeof(int64_t);
+        byte_struct_pack_int64(s, field, byte_struct_relptr_offset(field, values[i]));
+    }
+}
+
 static void byte_struct_pack_double(byte_struct_t *s, uint8_t *data, double value) {
     if (s->byte_order == BYTE_STRUCT_SORTABLE) {
         lex_ordered_write_double(data, value);
@@ -542,13 +891,32 @@ static void byte_struct_pack_double_array(byte_struct_t *s, uint8_t *data, doubl
     }
 }
 
+// Nullable fields take a bool presence flag before their value, which isn't read when the flag is false
 bool byte_struct_pack(byte_struct_t *s, uint8_t *data, ...) {
-    if (s == NULL || s->num_fields == 0) return false;
-    if (data == NULL) return false;
+    BYTE_STRUCT_STATS_ADD(pack_calls, 1);
+    if (s == NULL || s->num_fields == 0) {
+        BYTE_STRUCT_STATS_ADD(null_schema_failures, 1);
+        return false;
+    }
+    if (data == NULL) {
+        BYTE_STRUCT_STATS_ADD(null_data_failures, 1);
+        return false;
+    }
+    BYTE_STRUCT_STATS_SAMPLE_START(sample_start);
     va_list args;
     va_start(args, data);
     for (size_t i = 0; i < s->num_fields; i++) {
         type_offset_t type_offset = s->type_offsets[i];
+        BYTE_STRUCT_STATS_ADD(pack_fields_by_type[type_offset.type], 1);
+        if (byte_struct_field_nullable(&type_offset)) {
+            bool present = (bool)va_arg(args, int);
+            if (!present) {
+                byte_struct_skip_pack_arg(&type_offset, &args);
+                byte_struct_pack_null(s, &type_offset, data);
+                continue;
+            }
+            data[type_offset.null_offset] = byte_struct_null_marker(&type_offset, false);
+        }
         switch (type_offset.type) {
             case BYTE_STRUCT_TYPE_CHAR:
                 if (type_offset.count == 1) {
@@ -649,6 +1017,24 @@ bool byte_struct_pack(byte_struct_t *s, uint8_t *data, ...) {
                     byte_struct_pack_double_array(s, data + type_offset.offset, value, type_offset.count);
                 }
                 break;
+            case BYTE_STRUCT_TYPE_HALF:
+                if (type_offset.count == 1) {
+                    float value = (float)va_arg(args, double);
+                    byte_struct_pack_half(s, data + type_offset.offset, value);
+                } else {
+                    float *value = va_arg(args, float *);
+                    byte_struct_pack_half_array(s, data + type_offset.offset, value, type_offset.count);
+                }
+                break;
+            case BYTE_STRUCT_TYPE_BFLOAT16:
+                if (type_offset.count == 1) {
+                    float value = (float)va_arg(args, double);
+                    byte_struct_pack_bfloat16(s, data + type_offset.offset, value);
+                } else {
+                    float *value = va_arg(args, float *);
+                    byte_struct_pack_bfloat16_array(s, data + type_offset.offset, value, type_offset.count);
+                }
+                break;
             case BYTE_STRUCT_TYPE_PTR:
                 if (type_offset.count == 1) {
                     void *value = va_arg(args, void *);
@@ -658,9 +1044,29 @@ bool byte_struct_pack(byte_struct_t *s, uint8_t *data, ...) {
                     byte_struct_pack_ptr_array(s, data + type_offset.offset, value, type_offset.count);
                 }
                 break;
+            case BYTE_STRUCT_TYPE_RELPTR:
+                if (type_offset.count == 1) {
+                    void *value = va_arg(args, void *);
+                    byte_struct_pack_relptr(s, data + type_offset.offset, value);
+                } else {
+                    void **value = va_arg(args, void **);
+                    byte_struct_pack_relptr_array(s, data + type_offset.offset, value, type_offset.count);
+                }
+                break;
+            case BYTE_STRUCT_TYPE_GROUP: {
+                // array of C structs laid out like the group
+                void *value = va_arg(args, void *);
+                byte_struct_pack_field(s, &type_offset, data, value);
+                break;
+            }
+        }
+        if (byte_struct_field_descending(s, &type_offset)) {
+            byte_struct_complement(data + type_offset.offset, type_offset.count * type_offset.size);
         }
     }
     va_end(args);
+    BYTE_STRUCT_STATS_RECORDS(pack, s, 1);
+    BYTE_STRUCT_STATS_SAMPLE_END(s, true, sample_start);
     return true;
 }
 
@@ -851,6 +1257,21 @@ static void byte_struct_unpack_int64_array(byte_struct_t *s, uint8_t *data, int6
     }
 }
 
+static void byte_struct_unpack_relptr(byte_struct_t *s, uint8_t *data, void **value) {
+    int64_t offset;
+    byte_struct_unpack_int64(s, data, &offset);
+    *value = byte_struct_relptr_target(data, offset);
+}
+
+static void byte_struct_unpack_relptr_array(byte_struct_t *s, uint8_t *data, void **values, size_t n) {
+    for (size_t i = 0; i < n; i++) {
+        uint8_t *field = data + i * sizeof(int64_t);
+        int64_t offset;
+        byte_struct_unpack_int64(s, field, &offset);
+        values[i] = byte_struct_relptr_target(field, offset);
+    }
+}
+
 static void byte_struct_unpack_uint64(byte_struct_t *s, uint8_t *data, uint64_t *value) {
     if (s->byte_order == BYTE_STRUCT_SORTABLE) {
         *value = lex_ordered_read_uint64(data);
@@ -900,6 +1321,54 @@ static void byte_struct_unpack_float_array(byte_struct_t *s, uint8_t *data, floa
     }
 }
 
+static void byte_struct_read_float16_bits(byte_struct_t *s, uint8_t *data, uint16_t *bits, size_t n) {
+    if (s->byte_order == BYTE_STRUCT_SORTABLE) {
+        for (size_t i = 0; i < n; i++) {
+            uint16_t u = read_uint16_big_endian(data + i * sizeof(uint16_t));
+            bits[i] = (u & 0x8000) ? (uint16_t)(u & 0x7fff) : (uint16_t)~u;
+        }
+    } else if (s->byte_order == BYTE_STRUCT_BIG_ENDIAN) {
+        for (size_t i = 0; i < n; i++) {
+            bits[i] = read_uint16_big_endian(data + i * sizeof(uint16_t));
+        }
+    } else if (s->byte_order == BYTE_STRUCT_LITTLE_ENDIAN) {
+        for (size_t i = 0; i < n; i++) {
+            bits[i] = read_uint16_little_endian(data + i * sizeof(uint16_t));
+        }
+    } else {
+        memcpy(bits, data, n * sizeof(uint16_t));
+    }
+}
+
+static void byte_struct_unpack_float16_array(byte_struct_t *s, uint8_t *data, float *values, size_t n, bool bfloat16) {
+    uint16_t bits[BYTE_STRUCT_HALF_CHUNK];
+    for (size_t i = 0; i < n; i += BYTE_STRUCT_HALF_CHUNK) {
+        size_t m = n - i < BYTE_STRUCT_HALF_CHUNK ? n - i : BYTE_STRUCT_HALF_CHUNK;
+        byte_struct_read_float16_bits(s, data + i * sizeof(uint16_t), bits, m);
+        if (bfloat16) {
+            byte_struct_bfloat16_to_float_array(bits, values + i, m);
+        } else {
+            byte_struct_half_to_float_array(bits, values + i, m);
+        }
+    }
+}
+
+static void byte_struct_unpack_half(byte_struct_t *s, uint8_t *data, float *value) {
+    byte_struct_unpack_float16_array(s, data, value, 1, false);
+}
+
+static void byte_struct_unpack_half_array(byte_struct_t *s, uint8_t *data, float *values, size_t n) {
+    byte_struct_unpack_float16_array(s, data, values, n, false);
+}
+
+static void byte_struct_unpack_bfloat16(byte_struct_t *s, uint8_t *data, float *value) {
+    byte_struct_unpack_float16_array(s, data, value, 1, true);
+}
+
+static void byte_struct_unpack_bfloat16_array(byte_struct_t *s, uint8_t *data, float *values, size_t n) {
+    byte_struct_unpack_float16_array(s, data, values, n, true);
+}
+
 static void byte_struct_unpack_double(byte_struct_t *s, uint8_t *data, double *value) {
     if (s->byte_order == BYTE_STRUCT_SORTABLE) {
         *value = lex_ordered_read_double(data);
@@ -918,17 +1387,42 @@ static void byte_struct_unpack_double_array(byte_struct_t *s, uint8_t *data, dou
     }
 }
 
+// Nullable fields take a bool * (may be NULL) for the presence flag before their value pointer
 bool byte_struct_unpack(byte_struct_t *s, uint8_t *data, size_t data_len, ...) {
-    if (s == NULL || data == NULL || data_len < s->total_size || s->num_fields == 0) return false;
+    BYTE_STRUCT_STATS_ADD(unpack_calls, 1);
+    if (s == NULL || s->num_fields == 0) {
+        BYTE_STRUCT_STATS_ADD(null_schema_failures, 1);
+        return false;
+    }
+    if (data == NULL) {
+        BYTE_STRUCT_STATS_ADD(null_data_failures, 1);
+        return false;
+    }
+    if (data_len < s->total_size) {
+        BYTE_STRUCT_STATS_ADD(short_data_failures, 1);
+        return false;
+    }
+    BYTE_STRUCT_STATS_SAMPLE_START(sample_start);
     va_list args;
     va_start(args, data_len);
     for (size_t i = 0; i < s->num_fields; i++) {
         type_offset_t type_offset = s->type_offsets[i];
+        BYTE_STRUCT_STATS_ADD(unpack_fields_by_type[type_offset.type], 1);
+        if (byte_struct_field_nullable(&type_offset)) {
+            // nulls unpack as zero
+            bool *present = va_arg(args, bool *);
+            if (present != NULL) *present = data[type_offset.null_offset] != byte_struct_null_marker(&type_offset, true);
+        }
+        if (byte_struct_field_descending(s, &type_offset)) {
+            void *value = va_arg(args, void *);
+            byte_struct_unpack_field(s, &type_offset, data, value);
+            continue;
+        }
         switch(type_offset.type) {
             case BYTE_STRUCT_TYPE_CHAR:
                 if (type_offset.count == 1) {
-                    char value = va_arg(args, int);
-                    memcpy(&value, data + type_offset.offset, sizeof(char));
+                    char *value = va_arg(args, char *);
+                    memcpy(value, data + type_offset.offset, sizeof(char));
                 } else {
                     char *value = va_arg(args, char *);
                     memcpy(value, data + type_offset.offset, type_offset.count * sizeof(char));
@@ -1024,19 +1518,696 @@ bool byte_struct_unpack(byte_struct_t *s, uint8_t *data, size_t data_len, ...) {
                     byte_struct_unpack_double_array(s, data + type_offset.offset, value, type_offset.count);
                 }
                 break;
+            case BYTE_STRUCT_TYPE_HALF:
+                if (type_offset.count == 1) {
+                    float *value = va_arg(args, float *);
+                    byte_struct_unpack_half(s, data + type_offset.offset, value);
+                } else {
+                    float *value = va_arg(args, float *);
+                    byte_struct_unpack_half_array(s, data + type_offset.offset, value, type_offset.count);
+                }
+                break;
+            case BYTE_STRUCT_TYPE_BFLOAT16:
+                if (type_offset.count == 1) {
+                    float *value = va_arg(args, float *);
+                    byte_struct_unpack_bfloat16(s, data + type_offset.offset, value);
+                } else {
+                    float *value = va_arg(args, float *);
+                    byte_struct_unpack_bfloat16_array(s, data + type_offset.offset, value, type_offset.count);
+                }
+                break;
             case BYTE_STRUCT_TYPE_PTR:
                 if (type_offset.count == 1) {
                     void **value = va_arg(args, void **);
                     byte_struct_unpack_ptr(s, data + type_offset.offset, value);
                 } else {
-                    void ***value = va_arg(args, void ***);
+                    void **value = va_arg(args, void **);
                     byte_struct_unpack_ptr_array(s, data + type_offset.offset, value, type_offset.count);
                 }
                 break;
+            case BYTE_STRUCT_TYPE_RELPTR:
+                if (type_offset.count == 1) {
+                    void **value = va_arg(args, void **);
+                    byte_struct_unpack_relptr(s, data + type_offset.offset, value);
+                } else {
+                    void **value = va_arg(args, void **);
+                    byte_struct_unpack_relptr_array(s, data + type_offset.offset, value, type_offset.count);
+                }
+                break;
+            case BYTE_STRUCT_TYPE_GROUP: {
+                void *value = va_arg(args, void *);
+                byte_struct_unpack_field(s, &type_offset, data, value);
+                break;
+            }
         }
     }
 
     va_end(args);
+    BYTE_STRUCT_STATS_RECORDS(unpack, s, 1);
+    BYTE_STRUCT_STATS_SAMPLE_END(s, false, sample_start);
+    return true;
+}
+
+
+#define BYTE_STRUCT_CONVERT_SCRATCH_SIZE 512
+
+// Packing a value into a nullable field also marks it present
+static void byte_struct_pack_field(byte_struct_t *s, type_offset_t *type_offset, uint8_t *data, void *values) {
+    uint8_t *field = data + type_offset->offset;
+    size_t n = type_offset->count;
+    if (byte_struct_field_nullable(type_offset)) {
+        data[type_offset->null_offset] = byte_struct_null_marker(type_offset, false);
+    }
+    switch (type_offset->type) {
+        case BYTE_STRUCT_TYPE_CHAR:
+            memcpy(field, values, n * sizeof(char));
+            break;
+        case BYTE_STRUCT_TYPE_INT8:
+            byte_struct_pack_int8_array(s, field, (int8_t *)values, n);
+            break;
+        case BYTE_STRUCT_TYPE_UINT8:
+            byte_struct_pack_uint8_array(s, field, (uint8_t *)values, n);
+            break;
+        case BYTE_STRUCT_TYPE_INT16:
+            byte_struct_pack_int16_array(s, field, (int16_t *)values, n);
+            break;
+        case BYTE_STRUCT_TYPE_UINT16:
+            byte_struct_pack_uint16_array(s, field, (uint16_t *)values, n);
+            break;
+        case BYTE_STRUCT_TYPE_INT32:
+            byte_struct_pack_int32_array(s, field, (int32_t *)values, n);
+            break;
+        case BYTE_STRUCT_TYPE_UINT32:
+            byte_struct_pack_uint32_array(s, field, (uint32_t *)values, n);
+            break;
+        case BYTE_STRUCT_TYPE_INT64:
+            byte_struct_pack_int64_array(s, field, (int64_t *)values, n);
+            break;
+        case BYTE_STRUCT_TYPE_UINT64:
+            byte_struct_pack_uint64_array(s, field, (uint64_t *)values, n);
+            break;
+        case BYTE_STRUCT_TYPE_FLOAT:
+            byte_struct_pack_float_array(s, field, (float *)values, n);
+            break;
+        case BYTE_STRUCT_TYPE_DOUBLE:
+            byte_struct_pack_double_array(s, field, (double *)values, n);
+            break;
+        case BYTE_STRUCT_TYPE_HALF:
+            byte_struct_pack_half_array(s, field, (float *)values, n);
+            break;
+        case BYTE_STRUCT_TYPE_BFLOAT16:
+            byte_struct_pack_bfloat16_array(s, field, (float *)values, n);
+            break;
+        case BYTE_STRUCT_TYPE_PTR:
+            byte_struct_pack_ptr_array(s, field, (void **)values, n);
+            break;
+        case BYTE_STRUCT_TYPE_RELPTR:
+            byte_struct_pack_relptr_array(s, field, (void **)values, n);
+            break;
+        case BYTE_STRUCT_TYPE_GROUP:
+            for (size_t e = 0; e < n; e++) {
+                uint8_t *element = field + e * type_offset->size;
+                uint8_t *element_values = (uint8_t *)values + e * type_offset->native_size;
+                for (size_t c = 0; c < type_offset->num_children; c++) {
+                    type_offset_t *child = &s->type_offsets[type_offset->first_child + c];
+                    byte_struct_pack_field(s, child, element, element_values + child->native_offset);
+                }
+            }
+            break;
+    }
+    if (byte_struct_field_descending(s, type_offset)) {
+        byte_struct_complement(field, n * type_offset->size);
+    }
+}
+
+static void byte_struct_unpack_field(byte_struct_t *s, type_offset_t *type_offset, uint8_t *data, void *values) {
+    uint8_t *field = data + type_offset->offset;
+    size_t n = type_offset->count;
+    if (byte_struct_field_descending(s, type_offset)) {
+        // Undo the complement in a scratch copy so data is never written
+        uint8_t scratch[BYTE_STRUCT_CONVERT_SCRATCH_SIZE];
+        size_t type_size = type_offset->size;
+        size_t chunk_max = BYTE_STRUCT_CONVERT_SCRATCH_SIZE / type_size;
+        for (size_t j = 0; j < n; j += chunk_max) {
+            type_offset_t chunk = *type_offset;
+            chunk.offset = 0;
+            chunk.count = n - j < chunk_max ? n - j : chunk_max;
+            chunk.flags &= ~(uint32_t)BYTE_STRUCT_FIELD_DESCENDING;
+            memcpy(scratch, field + j * type_size, chunk.count * type_size);
+            byte_struct_complement(scratch, chunk.count * type_size);
+            byte_struct_unpack_field(s, &chunk, scratch, (uint8_t *)values + j * type_offset->native_size);
+        }
+        return;
+    }
+    switch (type_offset->type) {
+        case BYTE_STRUCT_TYPE_CHAR:
+            memcpy(values, field, n * sizeof(char));
+            break;
+        case BYTE_STRUCT_TYPE_INT8:
+            byte_struct_unpack_int8_array(s, field, (int8_t *)values, n);
+            break;
+        case BYTE_STRUCT_TYPE_UINT8:
+            byte_struct_unpack_uint8_array(s, field, (uint8_t *)values, n);
+            break;
+        case BYTE_STRUCT_TYPE_INT16:
+            byte_struct_unpack_int16_array(s, field, (int16_t *)values, n);
+            break;
+        case BYTE_STRUCT_TYPE_UINT16:
+            byte_struct_unpack_uint16_array(s, field, (uint16_t *)values, n);
+            break;
+        case BYTE_STRUCT_TYPE_INT32:
+            byte_struct_unpack_int32_array(s, field, (int32_t *)values, n);
+            break;
+        case BYTE_STRUCT_TYPE_UINT32:
+            byte_struct_unpack_uint32_array(s, field, (uint32_t *)values, n);
+            break;
+        case BYTE_STRUCT_TYPE_INT64:
+            byte_struct_unpack_int64_array(s, field, (int64_t *)values, n);
+            break;
+        case BYTE_STRUCT_TYPE_UINT64:
+            byte_struct_unpack_uint64_array(s, field, (uint64_t *)values, n);
+            break;
+        case BYTE_STRUCT_TYPE_FLOAT:
+            byte_struct_unpack_float_array(s, field, (float *)values, n);
+            break;
+        case BYTE_STRUCT_TYPE_DOUBLE:
+            byte_struct_unpack_double_array(s, field, (double *)values, n);
+            break;
+        case BYTE_STRUCT_TYPE_HALF:
+            byte_struct_unpack_half_array(s, field, (float *)values, n);
+            break;
+        case BYTE_STRUCT_TYPE_BFLOAT16:
+            byte_struct_unpack_bfloat16_array(s, field, (float *)values, n);
+            break;
+        case BYTE_STRUCT_TYPE_PTR:
+            byte_struct_unpack_ptr_array(s, field, (void **)values, n);
+            break;
+        case BYTE_STRUCT_TYPE_RELPTR:
+            byte_struct_unpack_relptr_array(s, field, (void **)values, n);
+            break;
+        case BYTE_STRUCT_TYPE_GROUP:
+            for (size_t e = 0; e < n; e++) {
+                uint8_t *element = field + e * type_offset->size;
+                uint8_t *element_values = (uint8_t *)values + e * type_offset->native_size;
+                for (size_t c = 0; c < type_offset->num_children; c++) {
+                    type_offset_t *child = &s->type_offsets[type_offset->first_child + c];
+                    byte_struct_unpack_field(s, child, element, element_values + child->native_offset);
+                }
+            }
+            break;
+    }
+}
+
+/*
+A null stores the encoding of zero as its value, so all nulls of a field are
+the same bytes (and sort together, ordered by the fields after them) and a null
+converts to another byte order like any value.
+*/
+static void byte_struct_pack_null(byte_struct_t *s, type_offset_t *type_offset, uint8_t *data) {
+    uint64_t zeros[BYTE_STRUCT_CONVERT_SCRATCH_SIZE / sizeof(uint64_t)] = {0};
+    size_t chunk_max = BYTE_STRUCT_CONVERT_SCRATCH_SIZE / type_offset->native_size;
+    for (size_t j = 0; j < type_offset->count; j += chunk_max) {
+        type_offset_t chunk = *type_offset;
+        chunk.offset = type_offset->offset + j * type_offset->size;
+        chunk.count = type_offset->count - j < chunk_max ? type_offset->count - j : chunk_max;
+        byte_struct_pack_field(s, &chunk, data, zeros);
+    }
+    data[type_offset->null_offset] = byte_struct_null_marker(type_offset, true);
+}
+
+// Consumes the value argument pack would read for a field that is packed as null
+static void byte_struct_skip_pack_arg(type_offset_t *type_offset, va_list *args) {
+    if (type_offset->count > 1) {
+        (void)va_arg(*args, void *);
+        return;
+    }
+    switch (type_offset->type) {
+        case BYTE_STRUCT_TYPE_INT64:
+            (void)va_arg(*args, int64_t);
+            break;
+        case BYTE_STRUCT_TYPE_UINT64:
+            (void)va_arg(*args, uint64_t);
+            break;
+        case BYTE_STRUCT_TYPE_FLOAT:
+        case BYTE_STRUCT_TYPE_DOUBLE:
+        case BYTE_STRUCT_TYPE_HALF:
+        case BYTE_STRUCT_TYPE_BFLOAT16:
+            (void)va_arg(*args, double);
+            break;
+        case BYTE_STRUCT_TYPE_PTR:
+        case BYTE_STRUCT_TYPE_RELPTR:
+        case BYTE_STRUCT_TYPE_GROUP:
+            (void)va_arg(*args, void *);
+            break;
+        default:
+            (void)va_arg(*args, int);
+            break;
+    }
+}
+
+/*
+Null checks read only the marker byte, so scans can filter or count nulls
+without decoding values. field is s->type_offsets[i] or the result of
+byte_struct_field_path. Fields that aren't nullable are never null.
+*/
+bool byte_struct_is_null(byte_struct_t *s, uint8_t *record, type_offset_t *field) {
+    if (s == NULL || record == NULL || field == NULL || !byte_struct_field_nullable(field)) return false;
+    return record[field->null_offset] == byte_struct_null_marker(field, true);
+}
+
+// Sets a nullable field to null, packing a value into it makes it present again
+bool byte_struct_set_null(byte_struct_t *s, uint8_t *record, type_offset_t *field) {
+    if (s == NULL || record == NULL || field == NULL || !byte_struct_field_nullable(field)) return false;
+    byte_struct_pack_null(s, field, record);
+    return true;
+}
+
+/*
+Sets bit r (LSB first) of bitmap, (n + 7) / 8 bytes, for each null of field in
+n consecutive records and returns the number of nulls.
+*/
+size_t byte_struct_null_bitmap(byte_struct_t *s, uint8_t *data, size_t n, type_offset_t *field, uint8_t *bitmap) {
+    if (s == NULL || data == NULL || field == NULL || bitmap == NULL) return 0;
+    size_t num_bytes = (n + 7) / 8;
+    if (!byte_struct_field_nullable(field)) {
+        memset(bitmap, 0, num_bytes);
+        return 0;
+    }
+    uint8_t null_marker = byte_struct_null_marker(field, true);
+    uint8_t *marker = data + field->null_offset;
+    size_t size = s->total_size;
+    size_t nulls = 0;
+    for (size_t b = 0; b < num_bytes; b++) {
+        size_t end = n - b * 8 < 8 ? n - b * 8 : 8;
+        uint8_t bits = 0;
+        for (size_t k = 0; k < end; k++) {
+            bool is_null = marker[(b * 8 + k) * size] == null_marker;
+            bits |= (uint8_t)(is_null << k);
+            nulls += is_null;
+        }
+        bitmap[b] = bits;
+    }
+    return nulls;
+}
+
+/*
+Batch pack/unpack use a columnar layout for the unpacked side: columns[i] points
+to an array holding field i for every record, i.e. records * count values of the
+field's C type, so records can be packed/unpacked without varargs.
+*/
+static void byte_struct_pack_batch_range(byte_struct_t *s, uint8_t *data, size_t start, size_t end, void **columns) {
+    for (size_t i = 0; i < s->num_fields; i++) {
+        type_offset_t *type_offset = &s->type_offsets[i];
+        BYTE_STRUCT_STATS_ADD(pack_fields_by_type[type_offset->type], end - start);
+        size_t value_size = type_offset->native_size * type_offset->count;
+        uint8_t *values = (uint8_t *)columns[i];
+        for (size_t r = start; r < end; r++) {
+            byte_struct_pack_field(s, type_offset, data + r * s->total_size, values + r * value_size);
+        }
+    }
+    BYTE_STRUCT_STATS_RECORDS(pack, s, end - start);
+}
+
+static void byte_struct_unpack_batch_range(byte_struct_t *s, uint8_t *data, size_t start, size_t end, void **columns) {
+    for (size_t i = 0; i < s->num_fields; i++) {
+        type_offset_t *type_offset = &s->type_offsets[i];
+        BYTE_STRUCT_STATS_ADD(unpack_fields_by_type[type_offset->type], end - start);
+        size_t value_size = type_offset->native_size * type_offset->count;
+        uint8_t *values = (uint8_t *)columns[i];
+        for (size_t r = start; r < end; r++) {
+            byte_struct_unpack_field(s, type_offset, data + r * s->total_size, values + r * value_size);
+        }
+    }
+    BYTE_STRUCT_STATS_RECORDS(unpack, s, end - start);
+}
+
+static bool byte_struct_batch_valid(byte_struct_t *s, uint8_t *data, void **columns) {
+    if (s == NULL || s->num_fields == 0) {
+        BYTE_STRUCT_STATS_ADD(null_schema_failures, 1);
+        return false;
+    }
+    if (data == NULL || columns == NULL) {
+        BYTE_STRUCT_STATS_ADD(null_data_failures, 1);
+        return false;
+    }
+    for (size_t i = 0; i < s->num_fields; i++) {
+        if (columns[i] == NULL) return false;
+    }
+    return true;
+}
+
+bool byte_struct_pack_batch(byte_struct_t *s, uint8_t *data, size_t n, void **columns) {
+    BYTE_STRUCT_STATS_ADD(pack_calls, 1);
+    if (!byte_struct_batch_valid(s, data, columns)) return false;
+    byte_struct_pack_batch_range(s, data, 0, n, columns);
+    return true;
+}
+
+bool byte_struct_unpack_batch(byte_struct_t *s, uint8_t *data, size_t n, void **columns) {
+    BYTE_STRUCT_STATS_ADD(unpack_calls, 1);
+    if (!byte_struct_batch_valid(s, data, columns)) return false;
+    byte_struct_unpack_batch_range(s, data, 0, n, columns);
+    return true;
+}
+
+/*
+Re-encodes records packed with s->byte_order into byte_order. Elements go through
+a small scratch buffer so src and dst may be the same buffer. Self-relative
+pointers convert as their stored offsets, so a converted pool stays linked to
+itself wherever dst is.
+*/
+static void byte_struct_convert_field(byte_struct_t *s, type_offset_t *type_offset, uint8_t *src, byte_struct_t *dst_struct, uint8_t *dst, uint64_t *scratch) {
+    if (type_offset->type == BYTE_STRUCT_TYPE_GROUP) {
+        for (size_t e = 0; e < type_offset->count; e++) {
+            size_t element_offset = type_offset->offset + e * type_offset->size;
+            for (size_t c = 0; c < type_offset->num_children; c++) {
+                type_offset_t *child = &s->type_offsets[type_offset->first_child + c];
+                byte_struct_convert_field(s, child, src + element_offset, dst_struct, dst + element_offset, scratch);
+            }
+        }
+        return;
+    }
+    type_offset_t field = *type_offset;
+    if (field.type == BYTE_STRUCT_TYPE_RELPTR) {
+        field.type = BYTE_STRUCT_TYPE_INT64;
+        field.native_size = sizeof(int64_t);
+    }
+    size_t type_size = field.size;
+    size_t chunk_max = BYTE_STRUCT_CONVERT_SCRATCH_SIZE / field.native_size;
+    size_t count = field.count;
+    for (size_t j = 0; j < count; j += chunk_max) {
+        type_offset_t chunk = field;
+        chunk.offset = type_offset->offset + j * type_size;
+        chunk.count = count - j < chunk_max ? count - j : chunk_max;
+        byte_struct_unpack_field(s, &chunk, src, scratch);
+        byte_struct_pack_field(dst_struct, &chunk, dst, scratch);
+    }
+    if (byte_struct_field_nullable(type_offset)) {
+        dst[type_offset->null_offset] = src[type_offset->null_offset];
+    }
+}
+
+static void byte_struct_convert_range(byte_struct_t *s, uint8_t *src, size_t start, size_t end, byte_order_t byte_order, uint8_t *dst) {
+    byte_struct_t dst_struct = {.byte_order = byte_order};
+    uint64_t scratch[BYTE_STRUCT_CONVERT_SCRATCH_SIZE / sizeof(uint64_t)];
+
+    for (size_t r = start; r < end; r++) {
+        uint8_t *src_record = src + r * s->total_size;
+        uint8_t *dst_record = dst + r * s->total_size;
+        for (size_t i = 0; i < s->num_fields; i++) {
+            byte_struct_convert_field(s, &s->type_offsets[i], src_record, &dst_struct, dst_record, scratch);
+        }
+    }
+}
+
+bool byte_struct_convert(byte_struct_t *s, uint8_t *src, size_t n, byte_order_t byte_order, uint8_t *dst) {
+    if (s == NULL || s->num_fields == 0) return false;
+    if (src == NULL || dst == NULL) return false;
+    if (s->byte_order == byte_order) {
+        if (src != dst) memmove(dst, src, n * s->total_size);
+        return true;
+    }
+    byte_struct_convert_range(s, src, 0, n, byte_order, dst);
+    return true;
+}
+
+#define BYTE_STRUCT_SORT_INSERTION_THRESHOLD 16
+
+/*
+Records compare as raw bytes (memcmp), which is the key order for
+BYTE_STRUCT_SORTABLE and an arbitrary but consistent order otherwise.
+*/
+static void byte_struct_merge_records(uint8_t *a, size_t na, uint8_t *b, size_t nb, uint8_t *out, size_t size) {
+    while (na > 0 && nb > 0) {
+        if (memcmp(b, a, size) < 0) {
+            memcpy(out, b, size);
+            b += size;
+            nb--;
+        } else {
+            memcpy(out, a, size);
+            a += size;
+            na--;
+        }
+        out += size;
+    }
+    if (na > 0) memcpy(out, a, na * size);
+    if (nb > 0) memcpy(out, b, nb * size);
+}
+
+static void byte_struct_insertion_sort_records(uint8_t *data, size_t n, size_t size, uint8_t *tmp) {
+    for (size_t i = 1; i < n; i++) {
+        size_t j = i;
+        if (memcmp(data + (j - 1) * size, data + j * size, size) <= 0) continue;
+        memcpy(tmp, data + i * size, size);
+        while (j > 0 && memcmp(data + (j - 1) * size, tmp, size) > 0) {
+            j--;
+        }
+        memmove(data + (j + 1) * size, data + j * size, (i - j) * size);
+        memcpy(data + j * size, tmp, size);
+    }
+}
+
+// Stable bottom-up merge sort, tmp must hold n records
+static void byte_struct_sort_records(uint8_t *data, size_t n, size_t size, uint8_t *tmp) {
+    for (size_t i = 0; i < n; i += BYTE_STRUCT_SORT_INSERTION_THRESHOLD) {
+        size_t m = n - i < BYTE_STRUCT_SORT_INSERTION_THRESHOLD ? n - i : BYTE_STRUCT_SORT_INSERTION_THRESHOLD;
+        byte_struct_insertion_sort_records(data + i * size, m, size, tmp);
+    }
+
+    uint8_t *src = data;
+    uint8_t *dst = tmp;
+    for (size_t width = BYTE_STRUCT_SORT_INSERTION_THRESHOLD; width < n; width *= 2) {
+        for (size_t i = 0; i < n; i += 2 * width) {
+            size_t na = n - i < width ? n - i : width;
+            size_t nb = n - i - na < width ? n - i - na : width;
+            byte_struct_merge_records(src + i * size, na, src + (i + na) * size, nb, dst + i * size, size);
+        }
+        uint8_t *swap = src;
+        src = dst;
+        dst = swap;
+    }
+    if (src != data) memcpy(data, src, n * size);
+}
+
+/*
+Abbreviated keys for sorting wide records: the first 8 key bytes read
+big-endian as an integer, so comparing two of them agrees with memcmp on those
+bytes. Sorting (key, index) pairs moves 16 bytes per record instead of the
+record and mostly compares without touching the records at all. Pairs are
+sorted by LSD radix on the key, skipping digits where every key agrees, and
+only runs of equal keys go on to the following key bytes. The result is a
+stable order, applied to the records with byte_struct_permute.
+*/
+
+#define BYTE_STRUCT_SORT_ABBREVIATED_KEY_SIZE sizeof(uint64_t)
+// byte_struct_sort switches to abbreviated keys for records at least this wide
+#define BYTE_STRUCT_SORT_ABBREVIATED_MIN_SIZE 64
+// Runs of equal abbreviated keys longer than this are radix sorted again on the next 8 bytes
+#define BYTE_STRUCT_SORT_ABBREVIATED_RADIX_MIN 256
+
+typedef struct byte_struct_sort_key {
+    uint64_t key;
+    size_t index;
+} byte_struct_sort_key_t;
+
+static inline uint64_t byte_struct_abbreviate(uint8_t *record, size_t key_len) {
+    if (key_len >= BYTE_STRUCT_SORT_ABBREVIATED_KEY_SIZE) return read_uint64_big_endian(record);
+    // Shorter keys are padded with zeros, which is the whole key so there are no ties to break
+    uint64_t key = 0;
+    for (size_t j = 0; j < BYTE_STRUCT_SORT_ABBREVIATED_KEY_SIZE; j++) {
+        key = key << 8 | (j < key_len ? record[j] : 0);
+    }
+    return key;
+}
+
+static inline int byte_struct_sort_key_compare_tail(uint8_t *data, size_t size, size_t offset, size_t key_len, byte_struct_sort_key_t *a, byte_struct_sort_key_t *b) {
+    return memcmp(data + a->index * size + offset, data + b->index * size + offset, key_len - offset);
+}
+
+// Stable sort of a short run of equal abbreviated keys on the key bytes from offset, tmp holds n pairs
+static void byte_struct_sort_key_ties(uint8_t *data, size_t size, size_t offset, size_t key_len, byte_struct_sort_key_t *keys, size_t n, byte_struct_sort_key_t *tmp) {
+    for (size_t start = 0; start < n; start += BYTE_STRUCT_SORT_INSERTION_THRESHOLD) {
+        size_t end = n - start < BYTE_STRUCT_SORT_INSERTION_THRESHOLD ? n : start + BYTE_STRUCT_SORT_INSERTION_THRESHOLD;
+        for (size_t i = start + 1; i < end; i++) {
+            byte_struct_sort_key_t key = keys[i];
+            size_t j = i;
+            while (j > start && byte_struct_sort_key_compare_tail(data, size, offset, key_len, &keys[j - 1], &key) > 0) {
+                keys[j] = keys[j - 1];
+                j--;
+            }
+            keys[j] = key;
+        }
+    }
+    byte_struct_sort_key_t *src = keys;
+    byte_struct_sort_key_t *dst = tmp;
+    for (size_t width = BYTE_STRUCT_SORT_INSERTION_THRESHOLD; width < n; width *= 2) {
+        for (size_t i = 0; i < n; i += 2 * width) {
+            size_t a = i, a_end = n - i < width ? n : i + width;
+            size_t b = a_end, b_end = n - a_end < width ? n : a_end + width;
+            size_t out = i;
+            while (a < a_end && b < b_end) {
+                dst[out++] = byte_struct_sort_key_compare_tail(data, size, offset, key_len, &src[b], &src[a]) < 0 ? src[b++] : src[a++];
+            }
+            while (a < a_end) dst[out++] = src[a++];
+            while (b < b_end) dst[out++] = src[b++];
+        }
+        byte_struct_sort_key_t *swap = src;
+        src = dst;
+        dst = swap;
+    }
+    if (src != keys) memcpy(keys, src, n * sizeof(byte_struct_sort_key_t));
+}
+
+/*
+Sorts the n records named by keys (in input order) on key bytes [offset,
+key_len) through the abbreviated key at offset, tmp holds n more pairs. LSD
+radix is stable, so equal keys stay in input order. Long runs of equal
+abbreviated keys, e.g. from a common prefix, are sorted the same way on the
+next 8 bytes, short ones with memcmp. counts holds a histogram per key byte,
+shared by the levels since each is done with it before going down.
+*/
+static void byte_struct_sort_keys(uint8_t *data, size_t size, size_t offset, size_t key_len, byte_struct_sort_key_t *keys, size_t n, byte_struct_sort_key_t *tmp, size_t *counts) {
+    memset(counts, 0, BYTE_STRUCT_SORT_ABBREVIATED_KEY_SIZE * 256 * sizeof(size_t));
+    for (size_t i = 0; i < n; i++) {
+        uint64_t key = byte_struct_abbreviate(data + keys[i].index * size + offset, key_len - offset);
+        keys[i].key = key;
+        for (size_t d = 0; d < BYTE_STRUCT_SORT_ABBREVIATED_KEY_SIZE; d++) {
+            counts[d * 256 + ((key >> (8 * d)) & 0xff)]++;
+        }
+    }
+
+    byte_struct_sort_key_t *src = keys;
+    byte_struct_sort_key_t *dst = tmp;
+    for (size_t d = 0; d < BYTE_STRUCT_SORT_ABBREVIATED_KEY_SIZE; d++) {
+        size_t *count = counts + d * 256;
+        // Every key has the same digit here, the pass would be a copy
+        if (count[(src[0].key >> (8 * d)) & 0xff] == n) continue;
+        size_t position = 0;
+        for (size_t v = 0; v < 256; v++) {
+            size_t c = count[v];
+            count[v] = position;
+            position += c;
+        }
+        for (size_t i = 0; i < n; i++) {
+            dst[count[(src[i].key >> (8 * d)) & 0xff]++] = src[i];
+        }
+        byte_struct_sort_key_t *swap = src;
+        src = dst;
+        dst = swap;
+    }
+    if (src != keys) memcpy(keys, src, n * sizeof(byte_struct_sort_key_t));
+
+    offset += BYTE_STRUCT_SORT_ABBREVIATED_KEY_SIZE;
+    if (key_len <= offset) return;
+    for (size_t start = 0; start < n;) {
+        size_t end = start + 1;
+        while (end < n && keys[end].key == keys[start].key) end++;
+        if (end - start > BYTE_STRUCT_SORT_ABBREVIATED_RADIX_MIN) {
+            byte_struct_sort_keys(data, size, offset, key_len, keys + start, end - start, tmp, counts);
+        } else if (end - start > 1) {
+            byte_struct_sort_key_ties(data, size, offset, key_len, keys + start, end - start, tmp);
+        }
+        start = end;
+    }
+}
+
+/*
+Stable sort order of n records by their first prefix_fields fields compared
+with memcmp, without moving the records: permutation[i] is the index of the
+record that sorts to position i.
+*/
+bool byte_struct_sort_permutation(byte_struct_t *s, uint8_t *data, size_t n, size_t prefix_fields, size_t *permutation) {
+    if (s == NULL || s->total_size == 0 || data == NULL || permutation == NULL) return false;
+    if (prefix_fields == 0 || prefix_fields > s->num_fields) return false;
+    if (n == 0) return true;
+    if (n > SIZE_MAX / (2 * sizeof(byte_struct_sort_key_t))) return false;
+    byte_struct_sort_key_t *keys = malloc(2 * n * sizeof(byte_struct_sort_key_t));
+    size_t *counts = malloc(BYTE_STRUCT_SORT_ABBREVIATED_KEY_SIZE * 256 * sizeof(size_t));
+    if (keys == NULL || counts == NULL) {
+        free(keys);
+        free(counts);
+        return false;
+    }
+    for (size_t i = 0; i < n; i++) {
+        keys[i].index = i;
+    }
+    byte_struct_sort_keys(data, s->total_size, 0, byte_struct_prefix_size(s, prefix_fields), keys, n, keys + n, counts);
+    for (size_t i = 0; i < n; i++) {
+        permutation[i] = keys[i].index;
+    }
+    free(counts);
+    free(keys);
+    return true;
+}
+
+/*
+Reorders records so record i is the one at permutation[i] before, in one pass:
+gathered into out, or with out NULL in place, following the permutation's
+cycles so each record moves once. Returns false without touching the records if
+permutation isn't a permutation of 0..n-1.
+*/
+bool byte_struct_permute(byte_struct_t *s, uint8_t *data, size_t n, size_t *permutation, uint8_t *out) {
+    if (s == NULL || s->total_size == 0 || data == NULL || permutation == NULL) return false;
+    if (n == 0) return true;
+    size_t size = s->total_size;
+    uint8_t *placed = calloc(n / 8 + 1, 1);
+    uint8_t *tmp = malloc(size);
+    if (placed == NULL || tmp == NULL) {
+        free(placed);
+        free(tmp);
+        return false;
+    }
+    bool valid = true;
+    for (size_t i = 0; i < n && valid; i++) {
+        size_t k = permutation[i];
+        valid = k < n && !(placed[k / 8] & (1 << (k % 8)));
+        if (valid) placed[k / 8] |= (uint8_t)(1 << (k % 8));
+    }
+    if (valid && out != NULL) {
+        for (size_t i = 0; i < n; i++) {
+            memcpy(out + i * size, data + permutation[i] * size, size);
+        }
+    } else if (valid) {
+        memset(placed, 0, n / 8 + 1);
+        for (size_t i = 0; i < n; i++) {
+            if (placed[i / 8] & (1 << (i % 8))) continue;
+            placed[i / 8] |= (uint8_t)(1 << (i % 8));
+            if (permutation[i] == i) continue;
+            memcpy(tmp, data + i * size, size);
+            size_t j = i;
+            while (permutation[j] != i) {
+                size_t k = permutation[j];
+                memcpy(data + j * size, data + k * size, size);
+                placed[k / 8] |= (uint8_t)(1 << (k % 8));
+                j = k;
+            }
+            memcpy(data + j * size, tmp, size);
+        }
+    }
+    free(tmp);
+    free(placed);
+    return valid;
+}
+
+/*
+Wide records sort through abbreviated keys and a permutation, narrow ones with
+a merge sort on the records themselves, where moving a record costs about the
+same as moving a (key, index) pair.
+*/
+bool byte_struct_sort(byte_struct_t *s, uint8_t *data, size_t n) {
+    if (s == NULL || s->total_size == 0 || data == NULL) return false;
+    if (n < 2) return true;
+    if (s->total_size >= BYTE_STRUCT_SORT_ABBREVIATED_MIN_SIZE && s->num_fields > 0) {
+        size_t *permutation = malloc(n * sizeof(size_t));
+        if (permutation == NULL) return false;
+        bool sorted = byte_struct_sort_permutation(s, data, n, s->num_fields, permutation) && byte_struct_permute(s, data, n, permutation, NULL);
+        free(permutation);
+        return sorted;
+    }
+    uint8_t *tmp = malloc(n * s->total_size);
+    if (tmp == NULL) return false;
+    byte_struct_sort_records(data, n, s->total_size, tmp);
+    free(tmp);
     return true;
 }
 
@@ -1047,6 +2218,9 @@ static byte_struct_t *byte_struct_new(const char *format) {
 
 void byte_struct_destroy(byte_struct_t *s) {
     if (s == NULL) return;
+#ifdef BYTE_STRUCT_STATS
+    free(s->latency);
+#endif
     free(s);
 }
 
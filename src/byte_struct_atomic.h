@@ -0,0 +1,89 @@
+#ifndef BYTE_STRUCT_ATOMIC_H
+#define BYTE_STRUCT_ATOMIC_H
+
+#include <stdint.h>
+#include <stdbool.h>
+
+/*
+Minimal 64-bit atomics plus spin and prefetch hints. The thread pool claims work
+with fetch_add, the stats counters and ring buffer use the loads, stores and
+CAS, the ring buffer spins with cpu_relax, and the bloom filter and search
+tree prefetch. Values are plain uint64_t so the same layout can live in shared
+memory.
+*/
+
+#define BYTE_STRUCT_CACHE_LINE_SIZE 64
+
+#if defined(_MSC_VER) && !defined(__clang__)
+#include <intrin.h>
+
+static inline uint64_t byte_struct_atomic_load(volatile uint64_t *p) {
+    return (uint64_t)_InterlockedOr64((volatile __int64 *)p, 0);
+}
+
+static inline uint64_t byte_struct_atomic_load_relaxed(volatile uint64_t *p) {
+    return *p;
+}
+
+static inline void byte_struct_atomic_store(volatile uint64_t *p, uint64_t value) {
+    _InterlockedExchange64((volatile __int64 *)p, (__int64)value);
+}
+
+static inline uint64_t byte_struct_atomic_fetch_add(volatile uint64_t *p, uint64_t value) {
+    return (uint64_t)_InterlockedExchangeAdd64((volatile __int64 *)p, (__int64)value);
+}
+
+static inline bool byte_struct_atomic_cas(volatile uint64_t *p, uint64_t *expected, uint64_t desired) {
+    uint64_t prev = (uint64_t)_InterlockedCompareExchange64((volatile __int64 *)p, (__int64)desired, (__int64)*expected);
+    if (prev == *expected) return true;
+    *expected = prev;
+    return false;
+}
+
+static inline void byte_struct_cpu_relax(void) {
+#if defined(_M_X64) || defined(_M_IX86)
+    _mm_pause();
+#else
+    __yield();
+#endif
+}
+
+#define byte_struct_prefetch(p) ((void)(p))
+
+#elif defined(__GNUC__) || defined(__clang__)
+
+static inline uint64_t byte_struct_atomic_load(volatile uint64_t *p) {
+    return __atomic_load_n(p, __ATOMIC_ACQUIRE);
+}
+
+static inline uint64_t byte_struct_atomic_load_relaxed(volatile uint64_t *p) {
+    return __atomic_load_n(p, __ATOMIC_RELAXED);
+}
+
+static inline void byte_struct_atomic_store(volatile uint64_t *p, uint64_t value) {
+    __atomic_store_n(p, value, __ATOMIC_RELEASE);
+}
+
+static inline uint64_t byte_struct_atomic_fetch_add(volatile uint64_t *p, uint64_t value) {
+    return __atomic_fetch_add(p, value, __ATOMIC_ACQ_REL);
+}
+
+static inline bool byte_struct_atomic_cas(volatile uint64_t *p, uint64_t *expected, uint64_t desired) {
+    return __atomic_compare_exchange_n(p, expected, desired, false, __ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE);
+}
+
+static inline void byte_struct_cpu_relax(void) {
+#if defined(__x86_64__) || defined(__i386__)
+    __builtin_ia32_pause();
+#elif defined(__aarch64__)
+    __asm__ __volatile__("yield");
+#endif
+}
+
+#define byte_struct_prefetch(p) __builtin_prefetch((p))
+
+#else
+#error "Unsupported compiler for byte_struct atomics"
+#endif
+
+#endif
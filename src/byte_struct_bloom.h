@@ -0,0 +1,239 @@
+#ifndef BYTE_STRUCT_BLOOM_H
+#define BYTE_STRUCT_BLOOM_H
+
+#include <stdint.h>
+#include <stdlib.h>
+#include <stdbool.h>
+#include <string.h>
+
+#include "byte_struct.h"
+#include "byte_struct_atomic.h"
+#include "byte_struct_hash.h"
+
+/*
+Split block Bloom filter over packed keys. Each key touches one 32-byte block
+(half a cache line) and sets one bit in each of its 8 32-bit words, the bit
+chosen by multiplying the low hash bits by a per-word odd salt. The 8 lanes are
+independent, so the probe loop compiles to a few vector instructions.
+
+Keys are hashed over their encoded bytes, either the whole record or the first
+k fields (type_offsets[k].offset bytes). A prefix filter answers "might any key
+starting with these k fields be present", so probes pack just those fields.
+For the byte comparisons to mean anything, build and probe with the same
+schema and byte order.
+*/
+
+#define BYTE_STRUCT_BLOOM_WORDS_PER_BLOCK 8
+#define BYTE_STRUCT_BLOOM_BLOCK_BITS (BYTE_STRUCT_BLOOM_WORDS_PER_BLOCK * 32)
+#define BYTE_STRUCT_BLOOM_DEFAULT_BITS_PER_KEY 10
+#define BYTE_STRUCT_BLOOM_SEED 0x62797465626c6f6full
+
+#define BYTE_STRUCT_BLOOM_MAGIC 0x46425342u  // "BSBF" little-endian
+#define BYTE_STRUCT_BLOOM_LAYOUT_VERSION 1
+// magic, version, then num_blocks, key_len, record_size, seed
+#define BYTE_STRUCT_BLOOM_HEADER_SIZE (2 * sizeof(uint32_t) + 4 * sizeof(uint64_t))
+
+typedef struct byte_struct_bloom_block {
+    uint32_t words[BYTE_STRUCT_BLOOM_WORDS_PER_BLOCK];
+} byte_struct_bloom_block_t;
+
+typedef struct byte_struct_bloom {
+    // bytes hashed per key
+    size_t key_len;
+    // stride of record buffers passed to the batch functions
+    size_t record_size;
+    uint64_t seed;
+    size_t num_blocks;
+    byte_struct_bloom_block_t *blocks;
+} byte_struct_bloom_t;
+
+static const uint32_t byte_struct_bloom_salt[BYTE_STRUCT_BLOOM_WORDS_PER_BLOCK] = {
+    0x47b6137bu, 0x44974d91u, 0x8824ad5bu, 0xa2b7289du,
+    0x705495c7u, 0x2df1424bu, 0x9efc4947u, 0x5c6bfb31u
+};
+
+static byte_struct_bloom_t *byte_struct_bloom_alloc(size_t num_blocks, size_t key_len, size_t record_size, uint64_t seed) {
+    if (num_blocks == 0 || num_blocks > UINT32_MAX || key_len == 0 || key_len > record_size) return NULL;
+    byte_struct_bloom_t *bloom = malloc(sizeof(byte_struct_bloom_t));
+    if (bloom == NULL) return NULL;
+    bloom->blocks = calloc(num_blocks, sizeof(byte_struct_bloom_block_t));
+    if (bloom->blocks == NULL) {
+        free(bloom);
+        return NULL;
+    }
+    bloom->key_len = key_len;
+    bloom->record_size = record_size;
+    bloom->seed = seed;
+    bloom->num_blocks = num_blocks;
+    return bloom;
+}
+
+/*
+Filter for about num_keys keys at bits_per_key (0 for the default of 10,
+roughly a 1% false positive rate). prefix_fields is the number of leading
+fields hashed, s->num_fields for the whole key.
+*/
+byte_struct_bloom_t *byte_struct_bloom_new(byte_struct_t *s, size_t prefix_fields, size_t num_keys, size_t bits_per_key) {
+    if (s == NULL || prefix_fields == 0 || prefix_fields > s->num_fields) return NULL;
+    if (bits_per_key == 0) bits_per_key = BYTE_STRUCT_BLOOM_DEFAULT_BITS_PER_KEY;
+    if (num_keys == 0) num_keys = 1;
+    if (num_keys > SIZE_MAX / bits_per_key) return NULL;
+    size_t num_blocks = (num_keys * bits_per_key + BYTE_STRUCT_BLOOM_BLOCK_BITS - 1) / BYTE_STRUCT_BLOOM_BLOCK_BITS;
+    size_t key_len = byte_struct_prefix_size(s, prefix_fields);
+    return byte_struct_bloom_alloc(num_blocks, key_len, s->total_size, BYTE_STRUCT_BLOOM_SEED);
+}
+
+static inline uint64_t byte_struct_bloom_hash(byte_struct_bloom_t *bloom, const uint8_t *key) {
+    return byte_struct_hash_bytes(key, bloom->key_len, bloom->seed);
+}
+
+// High hash bits pick the block (multiply-shift instead of modulo), low bits the lanes
+static inline byte_struct_bloom_block_t *byte_struct_bloom_block(byte_struct_bloom_t *bloom, uint64_t hash) {
+    return &bloom->blocks[((hash >> 32) * (uint64_t)bloom->num_blocks) >> 32];
+}
+
+static inline void byte_struct_bloom_masks(uint64_t hash, uint32_t *masks) {
+    uint32_t lo = (uint32_t)hash;
+    for (size_t i = 0; i < BYTE_STRUCT_BLOOM_WORDS_PER_BLOCK; i++) {
+        masks[i] = (uint32_t)1 << ((lo * byte_struct_bloom_salt[i]) >> 27);
+    }
+}
+
+static inline void byte_struct_bloom_insert_hash(byte_struct_bloom_t *bloom, uint64_t hash) {
+    byte_struct_bloom_block_t *block = byte_struct_bloom_block(bloom, hash);
+    uint32_t masks[BYTE_STRUCT_BLOOM_WORDS_PER_BLOCK];
+    byte_struct_bloom_masks(hash, masks);
+    for (size_t i = 0; i < BYTE_STRUCT_BLOOM_WORDS_PER_BLOCK; i++) {
+        block->words[i] |= masks[i];
+    }
+}
+
+static inline bool byte_struct_bloom_check_hash(byte_struct_bloom_t *bloom, uint64_t hash) {
+    byte_struct_bloom_block_t *block = byte_struct_bloom_block(bloom, hash);
+    uint32_t masks[BYTE_STRUCT_BLOOM_WORDS_PER_BLOCK];
+    byte_struct_bloom_masks(hash, masks);
+    uint32_t missing = 0;
+    for (size_t i = 0; i < BYTE_STRUCT_BLOOM_WORDS_PER_BLOCK; i++) {
+        missing |= masks[i] & ~block->words[i];
+    }
+    return missing == 0;
+}
+
+// key is a packed record, or at least its first key_len bytes
+void byte_struct_bloom_add(byte_struct_bloom_t *bloom, uint8_t *key) {
+    if (bloom == NULL || key == NULL) return;
+    byte_struct_bloom_insert_hash(bloom, byte_struct_bloom_hash(bloom, key));
+}
+
+#define BYTE_STRUCT_BLOOM_BATCH 16
+
+// Adds n records of record_size bytes each, hashing a batch ahead of the inserts
+void byte_struct_bloom_add_batch(byte_struct_bloom_t *bloom, uint8_t *data, size_t n) {
+    if (bloom == NULL || data == NULL) return;
+    uint64_t hashes[BYTE_STRUCT_BLOOM_BATCH];
+    for (size_t r = 0; r < n; r += BYTE_STRUCT_BLOOM_BATCH) {
+        size_t m = n - r < BYTE_STRUCT_BLOOM_BATCH ? n - r : BYTE_STRUCT_BLOOM_BATCH;
+        for (size_t j = 0; j < m; j++) {
+            hashes[j] = byte_struct_bloom_hash(bloom, data + (r + j) * bloom->record_size);
+            byte_struct_prefetch(byte_struct_bloom_block(bloom, hashes[j]));
+        }
+        for (size_t j = 0; j < m; j++) {
+            byte_struct_bloom_insert_hash(bloom, hashes[j]);
+        }
+    }
+}
+
+// false means key is definitely absent
+bool byte_struct_bloom_may_contain(byte_struct_bloom_t *bloom, uint8_t *key) {
+    if (bloom == NULL || key == NULL) return false;
+    return byte_struct_bloom_check_hash(bloom, byte_struct_bloom_hash(bloom, key));
+}
+
+/*
+Probes n keys spaced record_size bytes apart, writing one result per key.
+Block loads for a batch are prefetched before any of them is tested, so the
+cache misses overlap. Returns the number of possible hits.
+*/
+size_t byte_struct_bloom_may_contain_batch(byte_struct_bloom_t *bloom, uint8_t *keys, size_t n, bool *results) {
+    if (bloom == NULL || keys == NULL || results == NULL) return 0;
+    uint64_t hashes[BYTE_STRUCT_BLOOM_BATCH];
+    size_t hits = 0;
+    for (size_t r = 0; r < n; r += BYTE_STRUCT_BLOOM_BATCH) {
+        size_t m = n - r < BYTE_STRUCT_BLOOM_BATCH ? n - r : BYTE_STRUCT_BLOOM_BATCH;
+        for (size_t j = 0; j < m; j++) {
+            hashes[j] = byte_struct_bloom_hash(bloom, keys + (r + j) * bloom->record_size);
+            byte_struct_prefetch(byte_struct_bloom_block(bloom, hashes[j]));
+        }
+        for (size_t j = 0; j < m; j++) {
+            results[r + j] = byte_struct_bloom_check_hash(bloom, hashes[j]);
+            hits += results[r + j];
+        }
+    }
+    return hits;
+}
+
+// Combines filters built with the same parameters, e.g. one per build thread
+bool byte_struct_bloom_merge(byte_struct_bloom_t *dst, byte_struct_bloom_t *src) {
+    if (dst == NULL || src == NULL) return false;
+    if (dst->num_blocks != src->num_blocks || dst->key_len != src->key_len || dst->seed != src->seed) return false;
+    uint32_t *dst_words = (uint32_t *)dst->blocks;
+    uint32_t *src_words = (uint32_t *)src->blocks;
+    for (size_t i = 0; i < dst->num_blocks * BYTE_STRUCT_BLOOM_WORDS_PER_BLOCK; i++) {
+        dst_words[i] |= src_words[i];
+    }
+    return true;
+}
+
+size_t byte_struct_bloom_serialized_size(byte_struct_bloom_t *bloom) {
+    if (bloom == NULL) return 0;
+    return BYTE_STRUCT_BLOOM_HEADER_SIZE + bloom->num_blocks * sizeof(byte_struct_bloom_block_t);
+}
+
+/*
+Writes the filter to out (byte_struct_bloom_serialized_size bytes), all
+integers little-endian so the bytes are portable across hosts.
+*/
+bool byte_struct_bloom_serialize(byte_struct_bloom_t *bloom, uint8_t *out) {
+    if (bloom == NULL || out == NULL) return false;
+    write_uint32_little_endian(out, BYTE_STRUCT_BLOOM_MAGIC);
+    write_uint32_little_endian(out + 4, BYTE_STRUCT_BLOOM_LAYOUT_VERSION);
+    write_uint64_little_endian(out + 8, (uint64_t)bloom->num_blocks);
+    write_uint64_little_endian(out + 16, (uint64_t)bloom->key_len);
+    write_uint64_little_endian(out + 24, (uint64_t)bloom->record_size);
+    write_uint64_little_endian(out + 32, bloom->seed);
+    uint8_t *words = out + BYTE_STRUCT_BLOOM_HEADER_SIZE;
+    uint32_t *src_words = (uint32_t *)bloom->blocks;
+    for (size_t i = 0; i < bloom->num_blocks * BYTE_STRUCT_BLOOM_WORDS_PER_BLOCK; i++) {
+        write_uint32_little_endian(words + i * sizeof(uint32_t), src_words[i]);
+    }
+    return true;
+}
+
+byte_struct_bloom_t *byte_struct_bloom_deserialize(uint8_t *data, size_t len) {
+    if (data == NULL || len < BYTE_STRUCT_BLOOM_HEADER_SIZE) return NULL;
+    if (read_uint32_little_endian(data) != BYTE_STRUCT_BLOOM_MAGIC) return NULL;
+    if (read_uint32_little_endian(data + 4) != BYTE_STRUCT_BLOOM_LAYOUT_VERSION) return NULL;
+    uint64_t num_blocks = read_uint64_little_endian(data + 8);
+    uint64_t key_len = read_uint64_little_endian(data + 16);
+    uint64_t record_size = read_uint64_little_endian(data + 24);
+    uint64_t seed = read_uint64_little_endian(data + 32);
+    if (num_blocks > (len - BYTE_STRUCT_BLOOM_HEADER_SIZE) / sizeof(byte_struct_bloom_block_t)) return NULL;
+    if (key_len > SIZE_MAX || record_size > SIZE_MAX) return NULL;
+
+    byte_struct_bloom_t *bloom = byte_struct_bloom_alloc((size_t)num_blocks, (size_t)key_len, (size_t)record_size, seed);
+    if (bloom == NULL) return NULL;
+    uint8_t *words = data + BYTE_STRUCT_BLOOM_HEADER_SIZE;
+    uint32_t *dst_words = (uint32_t *)bloom->blocks;
+    for (size_t i = 0; i < bloom->num_blocks * BYTE_STRUCT_BLOOM_WORDS_PER_BLOCK; i++) {
+        dst_words[i] = read_uint32_little_endian(words + i * sizeof(uint32_t));
+    }
+    return bloom;
+}
+
+void byte_struct_bloom_destroy(byte_struct_bloom_t *bloom) {
+    if (bloom == NULL) return;
+    free(bloom->blocks);
+    free(bloom);
+}
+
+#endif
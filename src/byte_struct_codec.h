@@ -0,0 +1,669 @@
+#ifndef BYTE_STRUCT_CODEC_H
+#define BYTE_STRUCT_CODEC_H
+
+#include <stdint.h>
+#include <stdlib.h>
+#include <stdbool.h>
+#include <string.h>
+
+#include "byte_struct.h"
+
+/*
+Block compression for buffers of packed records, self-contained (no external
+library) and fast to decode, for cold storage and network transfer.
+
+Records of one schema compress poorly as they are because each record repeats
+its field layout. Three stages use the schema to fix that:
+
+1. Integer fields (every element of integer arrays and groups) are turned into
+   small numbers per block, either zigzag deltas from the previous record
+   (counters, timestamps, sorted keys) or offsets from the block minimum (frame
+   of reference, for values in a narrow range), whichever has the smaller
+   maximum. Other fields are left as they are.
+2. The records are transposed into byte planes, plane b holding byte b of every
+   record. The high bytes of small integers, float exponents, padding and
+   constant fields become long runs.
+3. A byte-oriented LZ77 stage in the style of LZ4 (4-bit literal and match
+   lengths with 255-byte extensions, 16-bit offsets) compresses the planes.
+   Runs are overlapping matches at distance 1, decoded by doubling copies.
+   Blocks that don't shrink are stored with the planes uncompressed.
+
+Blocks are independent. A few thousand to a few hundred thousand records per
+block works well: the planes need enough records to form runs, and each
+block's scratch buffers are the size of its input. The encoded block records
+the record size and integer column count and decoding checks them against the
+schema, but a block has to be decoded with the schema it was encoded with, in
+any byte order, on any host.
+*/
+
+#define BYTE_STRUCT_CODEC_MAGIC 0x42435342u  // "BSCB" little-endian
+#define BYTE_STRUCT_CODEC_LAYOUT_VERSION 1
+// magic, version, then num_records, record_size, then num_columns, stage
+#define BYTE_STRUCT_CODEC_HEADER_SIZE (2 * sizeof(uint32_t) + 2 * sizeof(uint64_t) + 2 * sizeof(uint32_t))
+// per integer column: mode, then the frame of reference base
+#define BYTE_STRUCT_CODEC_COLUMN_SIZE (1 + sizeof(uint64_t))
+
+#define BYTE_STRUCT_CODEC_STORED 0
+#define BYTE_STRUCT_CODEC_LZ 1
+
+#define BYTE_STRUCT_CODEC_DELTA 0
+#define BYTE_STRUCT_CODEC_FRAME_OF_REFERENCE 1
+
+#define BYTE_STRUCT_CODEC_HASH_BITS 16
+#define BYTE_STRUCT_CODEC_MIN_MATCH 4
+#define BYTE_STRUCT_CODEC_MAX_OFFSET 65535
+// Records per tile when moving between records and planes, keeps both sides in cache
+#define BYTE_STRUCT_CODEC_TILE_RECORDS 256
+
+typedef struct byte_struct_codec_column {
+    size_t offset;
+    size_t width;
+    uint8_t mode;
+    uint64_t base;
+    // running value while decoding deltas
+    uint64_t prev;
+} byte_struct_codec_column_t;
+
+// Collects (or just counts, columns == NULL) the integer columns of fields at base
+static size_t byte_struct_codec_columns(byte_struct_t *s, type_offset_t *fields, size_t num_fields, size_t base, byte_struct_codec_column_t *columns, size_t num_columns) {
+    for (size_t f = 0; f < num_fields; f++) {
+        type_offset_t *field = &fields[f];
+        for (size_t e = 0; e < field->count; e++) {
+            size_t offset = base + field->offset + e * field->size;
+            switch (field->type) {
+                case BYTE_STRUCT_TYPE_GROUP:
+                    num_columns = byte_struct_codec_columns(s, &s->type_offsets[field->first_child], field->num_children, offset, columns, num_columns);
+                    break;
+                case BYTE_STRUCT_TYPE_INT8:
+                case BYTE_STRUCT_TYPE_UINT8:
+                case BYTE_STRUCT_TYPE_INT16:
+                case BYTE_STRUCT_TYPE_UINT16:
+                case BYTE_STRUCT_TYPE_INT32:
+                case BYTE_STRUCT_TYPE_UINT32:
+                case BYTE_STRUCT_TYPE_INT64:
+                case BYTE_STRUCT_TYPE_UINT64:
+                case BYTE_STRUCT_TYPE_RELPTR:
+                    if (columns != NULL) {
+                        columns[num_columns] = (byte_struct_codec_column_t){.offset = offset, .width = field->size};
+                    }
+                    num_columns++;
+                    break;
+                default:
+                    break;
+            }
+        }
+    }
+    return num_columns;
+}
+
+// True if the schema's integers are stored in the opposite byte order to the host's
+static bool byte_struct_codec_swapped(byte_struct_t *s) {
+    const uint16_t probe = 1;
+    bool host_big = *(const uint8_t *)&probe == 0;
+    if (s->byte_order == BYTE_STRUCT_NATIVE_ENDIAN) return false;
+    return (s->byte_order != BYTE_STRUCT_LITTLE_ENDIAN) != host_big;
+}
+
+// Written so compilers turn them into single byte swap instructions
+static inline uint16_t byte_struct_codec_swap16(uint16_t value) {
+    return (uint16_t)((value << 8) | (value >> 8));
+}
+
+static inline uint32_t byte_struct_codec_swap32(uint32_t value) {
+    value = ((value & 0x00ff00ffu) << 8) | ((value >> 8) & 0x00ff00ffu);
+    return (value << 16) | (value >> 16);
+}
+
+static inline uint64_t byte_struct_codec_swap64(uint64_t value) {
+    value = ((value & 0x00ff00ff00ff00ffull) << 8) | ((value >> 8) & 0x00ff00ff00ff00ffull);
+    value = ((value & 0x0000ffff0000ffffull) << 16) | ((value >> 16) & 0x0000ffff0000ffffull);
+    return (value << 32) | (value >> 32);
+}
+
+static inline uint64_t byte_struct_codec_read(const uint8_t *data, size_t width, bool swap) {
+    if (width == sizeof(uint8_t)) return data[0];
+    if (width == sizeof(uint16_t)) {
+        uint16_t value;
+        memcpy(&value, data, sizeof(uint16_t));
+        return swap ? byte_struct_codec_swap16(value) : value;
+    }
+    if (width == sizeof(uint32_t)) {
+        uint32_t value;
+        memcpy(&value, data, sizeof(uint32_t));
+        return swap ? byte_struct_codec_swap32(value) : value;
+    }
+    uint64_t value;
+    memcpy(&value, data, sizeof(uint64_t));
+    return swap ? byte_struct_codec_swap64(value) : value;
+}
+
+static inline void byte_struct_codec_write(uint8_t *data, size_t width, bool swap, uint64_t value) {
+    if (width == sizeof(uint8_t)) {
+        data[0] = (uint8_t)value;
+    } else if (width == sizeof(uint16_t)) {
+        uint16_t narrow = swap ? byte_struct_codec_swap16((uint16_t)value) : (uint16_t)value;
+        memcpy(data, &narrow, sizeof(uint16_t));
+    } else if (width == sizeof(uint32_t)) {
+        uint32_t narrow = swap ? byte_struct_codec_swap32((uint32_t)value) : (uint32_t)value;
+        memcpy(data, &narrow, sizeof(uint32_t));
+    } else {
+        if (swap) value = byte_struct_codec_swap64(value);
+        memcpy(data, &value, sizeof(uint64_t));
+    }
+}
+
+static inline uint64_t byte_struct_codec_mask(size_t width) {
+    return width == sizeof(uint64_t) ? UINT64_MAX : ((uint64_t)1 << (8 * width)) - 1;
+}
+
+// Zigzag within width bytes so small negative deltas have zero high bytes too
+static inline uint64_t byte_struct_codec_zigzag(uint64_t delta, size_t width, uint64_t mask) {
+    uint64_t sign = (delta >> (8 * width - 1)) & 1;
+    return ((delta << 1) & mask) ^ (sign ? mask : 0);
+}
+
+static inline uint64_t byte_struct_codec_unzigzag(uint64_t zigzag, uint64_t mask) {
+    return (zigzag >> 1) ^ ((0 - (zigzag & 1)) & mask);
+}
+
+// Byte j of value goes to plane j, planes are n bytes apart. Unrolled by hand for constant widths
+static inline void byte_struct_codec_scatter(uint8_t *plane, size_t n, size_t width, uint64_t value) {
+    switch (width) {
+        case 8:
+            plane[7 * n] = (uint8_t)(value >> 56);
+            plane[6 * n] = (uint8_t)(value >> 48);
+            plane[5 * n] = (uint8_t)(value >> 40);
+            plane[4 * n] = (uint8_t)(value >> 32);
+            // fall through
+        case 4:
+            plane[3 * n] = (uint8_t)(value >> 24);
+            plane[2 * n] = (uint8_t)(value >> 16);
+            // fall through
+        case 2:
+            plane[n] = (uint8_t)(value >> 8);
+            // fall through
+        default:
+            plane[0] = (uint8_t)value;
+    }
+}
+
+static inline uint64_t byte_struct_codec_gather(const uint8_t *plane, size_t n, size_t width) {
+    uint64_t value = 0;
+    switch (width) {
+        case 8:
+            value |= (uint64_t)plane[7 * n] << 56 | (uint64_t)plane[6 * n] << 48 | (uint64_t)plane[5 * n] << 40 | (uint64_t)plane[4 * n] << 32;
+            // fall through
+        case 4:
+            value |= (uint64_t)plane[3 * n] << 24 | (uint64_t)plane[2 * n] << 16;
+            // fall through
+        case 2:
+            value |= (uint64_t)plane[n] << 8;
+            // fall through
+        default:
+            value |= plane[0];
+    }
+    return value;
+}
+
+/*
+One tile of one integer column to or from its planes. Called through the
+dispatch functions below with constant width and byte order, so each
+combination compiles to its own straight-line loop.
+*/
+static inline void byte_struct_codec_encode_fixed(byte_struct_codec_column_t *column, const uint8_t *tile, size_t record_size, size_t count, uint8_t *plane, size_t n, size_t width, bool swap) {
+    const uint8_t *field = tile + column->offset;
+    if (column->mode == BYTE_STRUCT_CODEC_FRAME_OF_REFERENCE) {
+        uint64_t base = column->base;
+        for (size_t i = 0; i < count; i++) {
+            uint64_t value = byte_struct_codec_read(field + i * record_size, width, swap);
+            byte_struct_codec_scatter(plane + i, n, width, value - base);
+        }
+    } else {
+        uint64_t mask = byte_struct_codec_mask(width);
+        uint64_t prev = column->prev;
+        for (size_t i = 0; i < count; i++) {
+            uint64_t value = byte_struct_codec_read(field + i * record_size, width, swap);
+            byte_struct_codec_scatter(plane + i, n, width, byte_struct_codec_zigzag((value - prev) & mask, width, mask));
+            prev = value;
+        }
+        column->prev = prev;
+    }
+}
+
+static inline void byte_struct_codec_decode_fixed(byte_struct_codec_column_t *column, uint8_t *tile, size_t record_size, size_t count, const uint8_t *plane, size_t n, size_t width, bool swap) {
+    uint8_t *field = tile + column->offset;
+    uint64_t mask = byte_struct_codec_mask(width);
+    if (column->mode == BYTE_STRUCT_CODEC_FRAME_OF_REFERENCE) {
+        uint64_t base = column->base;
+        for (size_t i = 0; i < count; i++) {
+            uint64_t value = (byte_struct_codec_gather(plane + i, n, width) + base) & mask;
+            byte_struct_codec_write(field + i * record_size, width, swap, value);
+        }
+    } else {
+        uint64_t prev = column->prev;
+        for (size_t i = 0; i < count; i++) {
+            prev = (prev + byte_struct_codec_unzigzag(byte_struct_codec_gather(plane + i, n, width), mask)) & mask;
+            byte_struct_codec_write(field + i * record_size, width, swap, prev);
+        }
+        column->prev = prev;
+    }
+}
+
+static void byte_struct_codec_encode_column(byte_struct_codec_column_t *column, const uint8_t *tile, size_t record_size, size_t count, uint8_t *plane, size_t n, bool swap) {
+    switch (column->width) {
+        case 1: byte_struct_codec_encode_fixed(column, tile, record_size, count, plane, n, 1, false); break;
+        case 2: swap ? byte_struct_codec_encode_fixed(column, tile, record_size, count, plane, n, 2, true) : byte_struct_codec_encode_fixed(column, tile, record_size, count, plane, n, 2, false); break;
+        case 4: swap ? byte_struct_codec_encode_fixed(column, tile, record_size, count, plane, n, 4, true) : byte_struct_codec_encode_fixed(column, tile, record_size, count, plane, n, 4, false); break;
+        default: swap ? byte_struct_codec_encode_fixed(column, tile, record_size, count, plane, n, 8, true) : byte_struct_codec_encode_fixed(column, tile, record_size, count, plane, n, 8, false); break;
+    }
+}
+
+static void byte_struct_codec_decode_column(byte_struct_codec_column_t *column, uint8_t *tile, size_t record_size, size_t count, const uint8_t *plane, size_t n, bool swap) {
+    switch (column->width) {
+        case 1: byte_struct_codec_decode_fixed(column, tile, record_size, count, plane, n, 1, false); break;
+        case 2: swap ? byte_struct_codec_decode_fixed(column, tile, record_size, count, plane, n, 2, true) : byte_struct_codec_decode_fixed(column, tile, record_size, count, plane, n, 2, false); break;
+        case 4: swap ? byte_struct_codec_decode_fixed(column, tile, record_size, count, plane, n, 4, true) : byte_struct_codec_decode_fixed(column, tile, record_size, count, plane, n, 4, false); break;
+        default: swap ? byte_struct_codec_decode_fixed(column, tile, record_size, count, plane, n, 8, true) : byte_struct_codec_decode_fixed(column, tile, record_size, count, plane, n, 8, false); break;
+    }
+}
+
+static void byte_struct_codec_choose_mode(byte_struct_codec_column_t *column, const uint8_t *data, size_t n, size_t record_size, bool swap) {
+    uint64_t mask = byte_struct_codec_mask(column->width);
+    uint64_t min = mask, max = 0, max_zigzag = 0, prev = 0;
+    for (size_t i = 0; i < n; i++) {
+        uint64_t value = byte_struct_codec_read(data + i * record_size + column->offset, column->width, swap);
+        if (value < min) min = value;
+        if (value > max) max = value;
+        // the first record's delta is from 0 like the decoder's, which doesn't count
+        if (i > 0) {
+            uint64_t zigzag = byte_struct_codec_zigzag((value - prev) & mask, column->width, mask);
+            if (zigzag > max_zigzag) max_zigzag = zigzag;
+        }
+        prev = value;
+    }
+    if (max - min <= max_zigzag) {
+        column->mode = BYTE_STRUCT_CODEC_FRAME_OF_REFERENCE;
+        column->base = min;
+    } else {
+        column->mode = BYTE_STRUCT_CODEC_DELTA;
+        column->base = 0;
+    }
+    column->prev = 0;
+}
+
+/*
+Both directions work on tiles of records so the records and the stretch of
+each plane they map to stay in cache. plain lists the byte offsets outside the
+integer columns, which are only transposed, eight planes at a time where eight
+of them are adjacent.
+*/
+static void byte_struct_codec_to_planes(const uint8_t *data, size_t n, size_t record_size, bool swap, byte_struct_codec_column_t *columns, size_t num_columns, const size_t *plain, size_t num_plain, uint8_t *planes) {
+    const uint16_t probe = 1;
+    bool host_big = *(const uint8_t *)&probe == 0;
+    for (size_t start = 0; start < n; start += BYTE_STRUCT_CODEC_TILE_RECORDS) {
+        size_t count = n - start < BYTE_STRUCT_CODEC_TILE_RECORDS ? n - start : BYTE_STRUCT_CODEC_TILE_RECORDS;
+        const uint8_t *tile = data + start * record_size;
+        size_t p = 0;
+        while (p < num_plain) {
+            size_t b = plain[p];
+            uint8_t *plane = planes + b * n + start;
+            if (p + 8 <= num_plain && plain[p + 7] == b + 7) {
+                for (size_t i = 0; i < count; i++) {
+                    byte_struct_codec_scatter(plane + i, n, 8, byte_struct_codec_read(tile + i * record_size + b, 8, host_big));
+                }
+                p += 8;
+            } else {
+                for (size_t i = 0; i < count; i++) {
+                    plane[i] = tile[i * record_size + b];
+                }
+                p++;
+            }
+        }
+        for (size_t c = 0; c < num_columns; c++) {
+            byte_struct_codec_encode_column(&columns[c], tile, record_size, count, planes + columns[c].offset * n + start, n, swap);
+        }
+    }
+}
+
+static void byte_struct_codec_from_planes(const uint8_t *planes, size_t n, size_t record_size, bool swap, byte_struct_codec_column_t *columns, size_t num_columns, const size_t *plain, size_t num_plain, uint8_t *data) {
+    const uint16_t probe = 1;
+    bool host_big = *(const uint8_t *)&probe == 0;
+    for (size_t start = 0; start < n; start += BYTE_STRUCT_CODEC_TILE_RECORDS) {
+        size_t count = n - start < BYTE_STRUCT_CODEC_TILE_RECORDS ? n - start : BYTE_STRUCT_CODEC_TILE_RECORDS;
+        uint8_t *tile = data + start * record_size;
+        size_t p = 0;
+        while (p < num_plain) {
+            size_t b = plain[p];
+            const uint8_t *plane = planes + b * n + start;
+            if (p + 8 <= num_plain && plain[p + 7] == b + 7) {
+                for (size_t i = 0; i < count; i++) {
+                    byte_struct_codec_write(tile + i * record_size + b, 8, host_big, byte_struct_codec_gather(plane + i, n, 8));
+                }
+                p += 8;
+            } else {
+                for (size_t i = 0; i < count; i++) {
+                    tile[i * record_size + b] = plane[i];
+                }
+                p++;
+            }
+        }
+        for (size_t c = 0; c < num_columns; c++) {
+            byte_struct_codec_decode_column(&columns[c], tile, record_size, count, planes + columns[c].offset * n + start, n, swap);
+        }
+    }
+}
+
+static inline uint32_t byte_struct_codec_read32(const uint8_t *p) {
+    uint32_t value;
+    memcpy(&value, p, sizeof(uint32_t));
+    return value;
+}
+
+static inline uint32_t byte_struct_codec_hash(uint32_t sequence) {
+    return (sequence * 2654435761u) >> (32 - BYTE_STRUCT_CODEC_HASH_BITS);
+}
+
+static uint8_t *byte_struct_codec_write_length(uint8_t *op, size_t length) {
+    for (; length >= 255; length -= 255) {
+        *op++ = 255;
+    }
+    *op++ = (uint8_t)length;
+    return op;
+}
+
+// Upper bound on the bytes one sequence (token, literals, offset, lengths) takes
+static inline size_t byte_struct_codec_sequence_bound(size_t literals, size_t match) {
+    return 1 + literals / 255 + 1 + literals + 2 + match / 255 + 1;
+}
+
+// match == 0 for the final literals-only sequence
+static uint8_t *byte_struct_codec_write_sequence(uint8_t *op, const uint8_t *literals, size_t num_literals, size_t offset, size_t match) {
+    uint8_t *token = op++;
+    size_t match_code = match == 0 ? 0 : match - BYTE_STRUCT_CODEC_MIN_MATCH;
+    *token = (uint8_t)(((num_literals < 15 ? num_literals : 15) << 4) | (match_code < 15 ? match_code : 15));
+    if (num_literals >= 15) op = byte_struct_codec_write_length(op, num_literals - 15);
+    memcpy(op, literals, num_literals);
+    op += num_literals;
+    if (match == 0) return op;
+    *op++ = (uint8_t)offset;
+    *op++ = (uint8_t)(offset >> 8);
+    if (match_code >= 15) op = byte_struct_codec_write_length(op, match_code - 15);
+    return op;
+}
+
+/*
+Greedy LZ77 over len bytes with a single-entry hash table of 4-byte sequences.
+Returns the compressed size, or 0 if it doesn't fit in capacity.
+*/
+static size_t byte_struct_codec_lz_compress(const uint8_t *in, size_t len, uint8_t *out, size_t capacity, uint32_t *table) {
+    memset(table, 0, ((size_t)1 << BYTE_STRUCT_CODEC_HASH_BITS) * sizeof(uint32_t));
+    uint8_t *op = out;
+    uint8_t *oend = out + capacity;
+    size_t anchor = 0;
+    size_t p = 0;
+    size_t misses = 0;
+    while (len >= BYTE_STRUCT_CODEC_MIN_MATCH && p <= len - BYTE_STRUCT_CODEC_MIN_MATCH) {
+        uint32_t sequence = byte_struct_codec_read32(in + p);
+        uint32_t h = byte_struct_codec_hash(sequence);
+        size_t candidate = table[h];
+        table[h] = (uint32_t)p;
+        if (candidate >= p || p - candidate > BYTE_STRUCT_CODEC_MAX_OFFSET || byte_struct_codec_read32(in + candidate) != sequence) {
+            // Step faster through data that doesn't match
+            p += 1 + (misses++ >> 6);
+            continue;
+        }
+        while (p > anchor && candidate > 0 && in[p - 1] == in[candidate - 1]) {
+            p--;
+            candidate--;
+        }
+        size_t match = BYTE_STRUCT_CODEC_MIN_MATCH;
+        while (p + match + sizeof(uint64_t) <= len) {
+            uint64_t a, b;
+            memcpy(&a, in + p + match, sizeof(uint64_t));
+            memcpy(&b, in + candidate + match, sizeof(uint64_t));
+            if (a != b) break;
+            match += sizeof(uint64_t);
+        }
+        while (p + match < len && in[p + match] == in[candidate + match]) match++;
+
+        if (byte_struct_codec_sequence_bound(p - anchor, match) > (size_t)(oend - op)) return 0;
+        op = byte_struct_codec_write_sequence(op, in + anchor, p - anchor, p - candidate, match);
+        p += match;
+        anchor = p;
+        misses = 0;
+        if (p <= len - BYTE_STRUCT_CODEC_MIN_MATCH) {
+            table[byte_struct_codec_hash(byte_struct_codec_read32(in + p - 2))] = (uint32_t)(p - 2);
+        }
+    }
+    if (byte_struct_codec_sequence_bound(len - anchor, 0) > (size_t)(oend - op)) return 0;
+    op = byte_struct_codec_write_sequence(op, in + anchor, len - anchor, 0, 0);
+    return (size_t)(op - out);
+}
+
+static bool byte_struct_codec_read_length(const uint8_t **ip, const uint8_t *iend, size_t *length) {
+    uint8_t byte;
+    do {
+        if (*ip >= iend) return false;
+        byte = *(*ip)++;
+        if (*length > SIZE_MAX - byte) return false;
+        *length += byte;
+    } while (byte == 255);
+    return true;
+}
+
+/*
+Decodes exactly len bytes into out. Every length and offset is checked, so
+corrupt or hostile input fails instead of reading or writing out of bounds.
+*/
+static bool byte_struct_codec_lz_decompress(const uint8_t *in, size_t in_len, uint8_t *out, size_t len) {
+    const uint8_t *ip = in;
+    const uint8_t *iend = in + in_len;
+    uint8_t *op = out;
+    uint8_t *oend = out + len;
+    while (ip < iend) {
+        uint8_t token = *ip++;
+        size_t literals = token >> 4;
+        if (literals == 15 && !byte_struct_codec_read_length(&ip, iend, &literals)) return false;
+        if (literals > (size_t)(iend - ip) || literals > (size_t)(oend - op)) return false;
+        if (literals <= 16 && iend - ip >= 16 && oend - op >= 16) {
+            // Short literals: a fixed-size copy, the excess is overwritten later
+            memcpy(op, ip, 16);
+        } else {
+            memcpy(op, ip, literals);
+        }
+        op += literals;
+        ip += literals;
+        if (ip == iend) break;
+
+        if (iend - ip < 2) return false;
+        size_t offset = (size_t)ip[0] | ((size_t)ip[1] << 8);
+        ip += 2;
+        if (offset == 0 || offset > (size_t)(op - out)) return false;
+        size_t match = token & 15;
+        if (match == 15 && !byte_struct_codec_read_length(&ip, iend, &match)) return false;
+        match += BYTE_STRUCT_CODEC_MIN_MATCH;
+        if (match > (size_t)(oend - op)) return false;
+
+        const uint8_t *source = op - offset;
+        if (offset >= 16 && match <= 32 && oend - op >= 32) {
+            memcpy(op, source, 16);
+            memcpy(op + 16, source + 16, 16);
+        } else if (offset >= match) {
+            memcpy(op, source, match);
+        } else {
+            // Overlapping: each copy doubles the repeated span
+            uint8_t *copy = op;
+            size_t remaining = match;
+            while (remaining > 0) {
+                size_t chunk = (size_t)(copy - source) < remaining ? (size_t)(copy - source) : remaining;
+                memcpy(copy, source, chunk);
+                copy += chunk;
+                remaining -= chunk;
+            }
+        }
+        op += match;
+    }
+    return op == oend;
+}
+
+// Byte offsets outside the integer columns, copied to planes untransformed
+static size_t byte_struct_codec_plain_bytes(size_t record_size, byte_struct_codec_column_t *columns, size_t num_columns, size_t *plain) {
+    memset(plain, 0, record_size * sizeof(size_t));
+    for (size_t c = 0; c < num_columns; c++) {
+        for (size_t j = 0; j < columns[c].width; j++) {
+            plain[columns[c].offset + j] = 1;
+        }
+    }
+    // Compacting in place, the write index never passes the read index
+    size_t num_plain = 0;
+    for (size_t b = 0; b < record_size; b++) {
+        if (plain[b] == 0) plain[num_plain++] = b;
+    }
+    return num_plain;
+}
+
+static size_t byte_struct_codec_header_size(size_t num_columns) {
+    return BYTE_STRUCT_CODEC_HEADER_SIZE + num_columns * BYTE_STRUCT_CODEC_COLUMN_SIZE;
+}
+
+// Largest encoded size of n records of s, for sizing the output of byte_struct_compress
+size_t byte_struct_compress_bound(byte_struct_t *s, size_t n) {
+    if (s == NULL || s->total_size == 0) return 0;
+    size_t header_size = byte_struct_codec_header_size(byte_struct_codec_columns(s, s->type_offsets, s->num_fields, 0, NULL, 0));
+    if (n > (SIZE_MAX - header_size) / s->total_size) return 0;
+    return header_size + n * s->total_size;
+}
+
+static size_t byte_struct_codec_encode(byte_struct_t *s, uint8_t *data, size_t n, uint8_t *out, size_t capacity, byte_struct_codec_column_t *columns, size_t num_columns, size_t *plain, uint8_t *planes, uint32_t *table) {
+    size_t record_size = s->total_size;
+    size_t header_size = byte_struct_codec_header_size(num_columns);
+    size_t len = n * record_size;
+    byte_struct_codec_columns(s, s->type_offsets, s->num_fields, 0, columns, 0);
+    size_t num_plain = byte_struct_codec_plain_bytes(record_size, columns, num_columns, plain);
+
+    bool swap = byte_struct_codec_swapped(s);
+    for (size_t c = 0; c < num_columns; c++) {
+        byte_struct_codec_choose_mode(&columns[c], data, n, record_size, swap);
+    }
+    byte_struct_codec_to_planes(data, n, record_size, swap, columns, num_columns, plain, num_plain, planes);
+
+    uint32_t stage = BYTE_STRUCT_CODEC_LZ;
+    size_t payload = 0;
+    // Table positions are 32-bit, larger blocks are stored
+    if (len <= UINT32_MAX) {
+        size_t room = capacity - header_size < len ? capacity - header_size : len;
+        payload = byte_struct_codec_lz_compress(planes, len, out + header_size, room, table);
+    }
+    if (payload == 0 || payload >= len) {
+        if (capacity - header_size < len) return 0;
+        stage = BYTE_STRUCT_CODEC_STORED;
+        memcpy(out + header_size, planes, len);
+        payload = len;
+    }
+
+    write_uint32_little_endian(out, BYTE_STRUCT_CODEC_MAGIC);
+    write_uint32_little_endian(out + 4, BYTE_STRUCT_CODEC_LAYOUT_VERSION);
+    write_uint64_little_endian(out + 8, (uint64_t)n);
+    write_uint64_little_endian(out + 16, (uint64_t)record_size);
+    write_uint32_little_endian(out + 24, (uint32_t)num_columns);
+    write_uint32_little_endian(out + 28, stage);
+    for (size_t c = 0; c < num_columns; c++) {
+        uint8_t *column = out + BYTE_STRUCT_CODEC_HEADER_SIZE + c * BYTE_STRUCT_CODEC_COLUMN_SIZE;
+        column[0] = columns[c].mode;
+        write_uint64_little_endian(column + 1, columns[c].base);
+    }
+    return header_size + payload;
+}
+
+/*
+Compresses n records of s into out, returns the encoded size, or 0 if capacity
+is too small (byte_struct_compress_bound is always enough) or allocation fails.
+*/
+size_t byte_struct_compress(byte_struct_t *s, uint8_t *data, size_t n, uint8_t *out, size_t capacity) {
+    if (s == NULL || (data == NULL && n > 0) || out == NULL) return 0;
+    if (byte_struct_compress_bound(s, n) == 0) return 0;
+    size_t num_columns = byte_struct_codec_columns(s, s->type_offsets, s->num_fields, 0, NULL, 0);
+    if (capacity < byte_struct_codec_header_size(num_columns)) return 0;
+
+    byte_struct_codec_column_t *columns = malloc((num_columns + 1) * sizeof(byte_struct_codec_column_t));
+    size_t *plain = malloc(s->total_size * sizeof(size_t));
+    uint8_t *planes = malloc(n * s->total_size + 1);
+    uint32_t *table = malloc(((size_t)1 << BYTE_STRUCT_CODEC_HASH_BITS) * sizeof(uint32_t));
+    size_t encoded = 0;
+    if (columns != NULL && plain != NULL && planes != NULL && table != NULL) {
+        encoded = byte_struct_codec_encode(s, data, n, out, capacity, columns, num_columns, plain, planes, table);
+    }
+    free(table);
+    free(planes);
+    free(plain);
+    free(columns);
+    return encoded;
+}
+
+// Number of records in an encoded block, so the caller can size the output
+bool byte_struct_compressed_records(uint8_t *in, size_t len, size_t *n) {
+    if (in == NULL || n == NULL || len < BYTE_STRUCT_CODEC_HEADER_SIZE) return false;
+    if (read_uint32_little_endian(in) != BYTE_STRUCT_CODEC_MAGIC) return false;
+    if (read_uint32_little_endian(in + 4) != BYTE_STRUCT_CODEC_LAYOUT_VERSION) return false;
+    uint64_t num_records = read_uint64_little_endian(in + 8);
+    if (num_records > SIZE_MAX) return false;
+    *n = (size_t)num_records;
+    return true;
+}
+
+static bool byte_struct_codec_decode(byte_struct_t *s, uint8_t *in, size_t len, size_t n, uint32_t stage, uint8_t *data, byte_struct_codec_column_t *columns, size_t num_columns, size_t *plain, uint8_t *planes) {
+    size_t record_size = s->total_size;
+    size_t header_size = byte_struct_codec_header_size(num_columns);
+    byte_struct_codec_columns(s, s->type_offsets, s->num_fields, 0, columns, 0);
+    for (size_t c = 0; c < num_columns; c++) {
+        uint8_t *column = in + BYTE_STRUCT_CODEC_HEADER_SIZE + c * BYTE_STRUCT_CODEC_COLUMN_SIZE;
+        if (column[0] != BYTE_STRUCT_CODEC_DELTA && column[0] != BYTE_STRUCT_CODEC_FRAME_OF_REFERENCE) return false;
+        columns[c].mode = column[0];
+        columns[c].base = read_uint64_little_endian(column + 1);
+        columns[c].prev = 0;
+    }
+    size_t num_plain = byte_struct_codec_plain_bytes(record_size, columns, num_columns, plain);
+
+    const uint8_t *source = in + header_size;
+    if (stage == BYTE_STRUCT_CODEC_LZ) {
+        if (!byte_struct_codec_lz_decompress(in + header_size, len - header_size, planes, n * record_size)) return false;
+        source = planes;
+    }
+    byte_struct_codec_from_planes(source, n, record_size, byte_struct_codec_swapped(s), columns, num_columns, plain, num_plain, data);
+    return true;
+}
+
+/*
+Decodes a block produced by byte_struct_compress with the same schema into
+data, which has room for capacity records. The number of records is stored in
+*n. Returns false on a schema mismatch, too small a buffer or corrupt input.
+*/
+bool byte_struct_decompress(byte_struct_t *s, uint8_t *in, size_t len, uint8_t *data, size_t capacity, size_t *n) {
+    if (s == NULL || n == NULL) return false;
+    size_t num_records;
+    if (!byte_struct_compressed_records(in, len, &num_records)) return false;
+    if (read_uint64_little_endian(in + 16) != s->total_size || num_records > capacity) return false;
+    if (num_records > 0 && data == NULL) return false;
+    size_t num_columns = byte_struct_codec_columns(s, s->type_offsets, s->num_fields, 0, NULL, 0);
+    if (read_uint32_little_endian(in + 24) != num_columns) return false;
+    uint32_t stage = read_uint32_little_endian(in + 28);
+    size_t header_size = byte_struct_codec_header_size(num_columns);
+    if (len < header_size || (stage != BYTE_STRUCT_CODEC_STORED && stage != BYTE_STRUCT_CODEC_LZ)) return false;
+    if (stage == BYTE_STRUCT_CODEC_STORED && len - header_size != num_records * s->total_size) return false;
+
+    byte_struct_codec_column_t *columns = malloc((num_columns + 1) * sizeof(byte_struct_codec_column_t));
+    size_t *plain = malloc(s->total_size * sizeof(size_t));
+    // Stored planes are transposed straight from the input
+    uint8_t *planes = stage == BYTE_STRUCT_CODEC_LZ ? malloc(num_records * s->total_size + 1) : NULL;
+    bool ok = false;
+    if (columns != NULL && plain != NULL && (stage == BYTE_STRUCT_CODEC_STORED || planes != NULL)) {
+        ok = byte_struct_codec_decode(s, in, len, num_records, stage, data, columns, num_columns, plain, planes);
+    }
+    if (ok) *n = num_records;
+    free(planes);
+    free(plain);
+    free(columns);
+    return ok;
+}
+
+#endif
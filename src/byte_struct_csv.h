@@ -0,0 +1,767 @@
+#ifndef BYTE_STRUCT_CSV_H
+#define BYTE_STRUCT_CSV_H
+
+#include <stdint.h>
+#include <stdlib.h>
+#include <stdbool.h>
+#include <string.h>
+#include <stdio.h>
+#include <locale.h>
+
+#include "byte_struct.h"
+#include "byte_struct_parallel.h"
+
+/*
+Bulk load of delimited text (CSV, TSV) into packed records and the reverse dump.
+
+Each field takes its values from consecutive text columns, one per element,
+except char arrays which take one column holding the string (zero padded, an
+error if longer than the array). Half floats parse as float. Pointer and group
+fields can't be loaded. A nullable field is null when all its columns are empty
+(blank for numbers) and unquoted, so "" is an empty string but not a null.
+
+Parsing runs over chunks of about BYTE_STRUCT_CSV_CHUNK_BYTES split on line
+boundaries: a first parallel pass counts records per chunk, a prefix sum gives
+each chunk its first output record, and a second parallel pass parses straight
+into the output, which can be a mapped file. Quoted fields ("a,b", "say ""hi""")
+are supported but must not span lines, or the split could land inside one.
+
+Integers are parsed by hand with range checks against the field type. Floats are
+decimal ([+-] digits [. digits] [e [+-] digits], digits on at least one side of
+the point) or inf, infinity and nan in any case. Those with at most 19
+significant digits and a decimal exponent within +-22 are computed exactly from
+the digits (the common case for exported data); others go through strtod with
+the decimal point swapped for the locale's, read once per parse since
+localeconv isn't thread-safe.
+*/
+
+#define BYTE_STRUCT_CSV_CHUNK_BYTES (1024 * 1024)
+#define BYTE_STRUCT_CSV_MAX_NUMBER_LEN 64
+
+typedef struct byte_struct_csv_options {
+    // ',' when 0
+    char delimiter;
+    // the first line holds column names and is skipped
+    bool header;
+    // column_map[i] is the 0-based text column of field i's first element, NULL for fields in order
+    size_t *column_map;
+} byte_struct_csv_options_t;
+
+typedef struct byte_struct_csv_error {
+    // 1-based line and column, 0 when the error isn't about a single field
+    size_t line;
+    size_t column;
+    const char *message;
+} byte_struct_csv_error_t;
+
+typedef struct byte_struct_csv_chunk {
+    size_t start;
+    size_t end;
+    size_t lines;
+    size_t records;
+    // set by the prefix sum after counting
+    size_t first_line;
+    size_t first_record;
+    bool failed;
+    byte_struct_csv_error_t error;
+} byte_struct_csv_chunk_t;
+
+typedef struct byte_struct_csv_token {
+    const char *start;
+    size_t len;
+    bool quoted;
+} byte_struct_csv_token_t;
+
+typedef struct byte_struct_csv_parser {
+    byte_struct_t *s;
+    const char *text;
+    char delimiter;
+    // first text column of each field, and columns a line needs
+    size_t *field_columns;
+    size_t num_columns;
+    // largest char array, for unescaping quoted strings
+    size_t max_string;
+    // the locale's, for strtod
+    char decimal_point;
+    byte_struct_csv_chunk_t *chunks;
+    uint8_t *out;
+} byte_struct_csv_parser_t;
+
+typedef union byte_struct_csv_value {
+    int8_t i8;
+    uint8_t u8;
+    int16_t i16;
+    uint16_t u16;
+    int32_t i32;
+    uint32_t u32;
+    int64_t i64;
+    uint64_t u64;
+    float f;
+    double d;
+    char c;
+} byte_struct_csv_value_t;
+
+static const double byte_struct_csv_powers_of_10[] = {
+    1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9, 1e10, 1e11,
+    1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22
+};
+
+static inline bool byte_struct_csv_is_space(char c) {
+    return c == ' ' || c == '\t';
+}
+
+static void byte_struct_csv_trim(byte_struct_csv_token_t *token) {
+    while (token->len > 0 && byte_struct_csv_is_space(token->start[0])) {
+        token->start++;
+        token->len--;
+    }
+    while (token->len > 0 && byte_struct_csv_is_space(token->start[token->len - 1])) {
+        token->len--;
+    }
+}
+
+// Magnitude of a decimal integer, false on anything but digits or overflow
+static bool byte_struct_csv_parse_digits(const char *p, size_t len, uint64_t *value) {
+    if (len == 0) return false;
+    uint64_t v = 0;
+    for (size_t i = 0; i < len; i++) {
+        unsigned digit = (unsigned)(p[i] - '0');
+        if (digit > 9) return false;
+        if (v > (UINT64_MAX - digit) / 10) return false;
+        v = v * 10 + digit;
+    }
+    *value = v;
+    return true;
+}
+
+static const char *byte_struct_csv_parse_int(byte_struct_csv_token_t *token, bool is_signed, int64_t min, uint64_t max, byte_struct_csv_value_t *value) {
+    const char *p = token->start;
+    size_t len = token->len;
+    bool negative = false;
+    if (len > 0 && (p[0] == '-' || p[0] == '+')) {
+        negative = p[0] == '-';
+        p++;
+        len--;
+    }
+    uint64_t magnitude;
+    if (!byte_struct_csv_parse_digits(p, len, &magnitude)) return "invalid integer";
+    if (negative) {
+        if (!is_signed && magnitude != 0) return "integer out of range";
+        if (magnitude > (uint64_t)(-(min + 1)) + 1) return "integer out of range";
+        value->i64 = magnitude == (uint64_t)INT64_MAX + 1 ? INT64_MIN : -(int64_t)magnitude;
+    } else {
+        if (magnitude > max) return "integer out of range";
+        if (is_signed) {
+            value->i64 = (int64_t)magnitude;
+        } else {
+            value->u64 = magnitude;
+        }
+    }
+    return NULL;
+}
+
+// Case-insensitive match of the whole of [p, p + len) with a lowercase word
+static bool byte_struct_csv_is_word(const char *p, size_t len, const char *word) {
+    if (len != strlen(word)) return false;
+    for (size_t i = 0; i < len; i++) {
+        if ((p[i] | 0x20) != word[i]) return false;
+    }
+    return true;
+}
+
+// The float grammar, everything else strtod would take (hex, nan(...)) is rejected
+static bool byte_struct_csv_is_number(const char *p, size_t len) {
+    size_t i = 0;
+    if (i < len && (p[i] == '-' || p[i] == '+')) i++;
+    if (byte_struct_csv_is_word(p + i, len - i, "inf") || byte_struct_csv_is_word(p + i, len - i, "infinity") || byte_struct_csv_is_word(p + i, len - i, "nan")) {
+        return true;
+    }
+    size_t digits = 0;
+    for (; i < len && p[i] >= '0' && p[i] <= '9'; i++) digits++;
+    if (i < len && p[i] == '.') {
+        for (i++; i < len && p[i] >= '0' && p[i] <= '9'; i++) digits++;
+    }
+    if (digits == 0) return false;
+    if (i < len && (p[i] == 'e' || p[i] == 'E')) {
+        i++;
+        if (i < len && (p[i] == '-' || p[i] == '+')) i++;
+        size_t exponent_digits = 0;
+        for (; i < len && p[i] >= '0' && p[i] <= '9'; i++) exponent_digits++;
+        if (exponent_digits == 0) return false;
+    }
+    return i == len;
+}
+
+static bool byte_struct_csv_parse_double_slow(const char *p, size_t len, char point, double *value) {
+    char stack_buf[BYTE_STRUCT_CSV_MAX_NUMBER_LEN];
+    // any length the grammar allows, e.g. long runs of digits
+    char *buf = len < sizeof(stack_buf) ? stack_buf : malloc(len + 1);
+    if (buf == NULL) return false;
+    for (size_t i = 0; i < len; i++) {
+        buf[i] = p[i] == '.' ? point : p[i];
+    }
+    buf[len] = '\0';
+    char *end;
+    *value = strtod(buf, &end);
+    bool ok = end == buf + len;
+    if (buf != stack_buf) free(buf);
+    return ok;
+}
+
+static const char *byte_struct_csv_parse_double(byte_struct_csv_token_t *token, char point, double *value) {
+    const char *p = token->start;
+    size_t len = token->len;
+    if (!byte_struct_csv_is_number(p, len)) return "invalid number";
+    size_t i = 0;
+    bool negative = false;
+    if (i < len && (p[i] == '-' || p[i] == '+')) {
+        negative = p[i] == '-';
+        i++;
+    }
+    uint64_t mantissa = 0;
+    int digits = 0, exponent = 0;
+    bool any_digits = false, fast = true;
+    for (; i < len && p[i] >= '0' && p[i] <= '9'; i++) {
+        any_digits = true;
+        if (mantissa == 0 && p[i] == '0') continue;
+        if (digits == 19) {
+            fast = false;
+            break;
+        }
+        mantissa = mantissa * 10 + (uint64_t)(p[i] - '0');
+        digits++;
+    }
+    if (fast && i < len && p[i] == '.') {
+        for (i++; i < len && p[i] >= '0' && p[i] <= '9'; i++) {
+            any_digits = true;
+            if (mantissa == 0 && p[i] == '0') {
+                exponent--;
+                continue;
+            }
+            if (digits == 19) {
+                fast = false;
+                break;
+            }
+            mantissa = mantissa * 10 + (uint64_t)(p[i] - '0');
+            digits++;
+            exponent--;
+        }
+    }
+    if (fast && any_digits && i < len && (p[i] == 'e' || p[i] == 'E')) {
+        size_t j = i + 1;
+        bool exp_negative = false;
+        if (j < len && (p[j] == '-' || p[j] == '+')) {
+            exp_negative = p[j] == '-';
+            j++;
+        }
+        uint64_t e;
+        // the digits are checked, but huge exponents are left to strtod
+        if (byte_struct_csv_parse_digits(p + j, len - j, &e) && e <= 9999) {
+            exponent += exp_negative ? -(int)e : (int)e;
+            i = len;
+        } else {
+            fast = false;
+        }
+    }
+    if (fast && any_digits && i == len && mantissa <= (1ull << 53) && exponent >= -22 && exponent <= 22) {
+        // Both operands are exact, so the one rounding gives the correctly rounded result
+        double d = (double)mantissa;
+        d = exponent < 0 ? d / byte_struct_csv_powers_of_10[-exponent] : d * byte_struct_csv_powers_of_10[exponent];
+        *value = negative ? -d : d;
+        return NULL;
+    }
+    // Long mantissas, large exponents, inf and nan
+    if (!byte_struct_csv_parse_double_slow(token->start, token->len, point, value)) return "invalid number";
+    return NULL;
+}
+
+// Copies a char array token, undoing "" escapes in quoted strings
+static const char *byte_struct_csv_parse_string(byte_struct_csv_token_t *token, char *out, size_t size) {
+    size_t n = 0;
+    for (size_t i = 0; i < token->len; i++) {
+        if (n == size) return "string too long";
+        out[n++] = token->start[i];
+        if (token->quoted && token->start[i] == '"') i++;
+    }
+    memset(out + n, 0, size - n);
+    return NULL;
+}
+
+static const char *byte_struct_csv_parse_element(byte_struct_type_t type, byte_struct_csv_token_t *token, char point, byte_struct_csv_value_t *value) {
+    const char *message = NULL;
+    byte_struct_csv_value_t v = {0};
+    double d = 0.0;
+    if (type != BYTE_STRUCT_TYPE_CHAR && token->len == 0) return "empty field";
+    switch (type) {
+        case BYTE_STRUCT_TYPE_CHAR:
+            // dump quotes delimiters, quotes and newlines
+            if (token->quoted) return byte_struct_csv_parse_string(token, &value->c, 1) == NULL ? NULL : "expected a single character";
+            if (token->len > 1) return "expected a single character";
+            value->c = token->len == 1 ? token->start[0] : '\0';
+            return NULL;
+        case BYTE_STRUCT_TYPE_INT8:
+            message = byte_struct_csv_parse_int(token, true, INT8_MIN, INT8_MAX, &v);
+            value->i8 = (int8_t)v.i64;
+            break;
+        case BYTE_STRUCT_TYPE_UINT8:
+            message = byte_struct_csv_parse_int(token, false, 0, UINT8_MAX, &v);
+            value->u8 = (uint8_t)v.u64;
+            break;
+        case BYTE_STRUCT_TYPE_INT16:
+            message = byte_struct_csv_parse_int(token, true, INT16_MIN, INT16_MAX, &v);
+            value->i16 = (int16_t)v.i64;
+            break;
+        case BYTE_STRUCT_TYPE_UINT16:
+            message = byte_struct_csv_parse_int(token, false, 0, UINT16_MAX, &v);
+            value->u16 = (uint16_t)v.u64;
+            break;
+        case BYTE_STRUCT_TYPE_INT32:
+            message = byte_struct_csv_parse_int(token, true, INT32_MIN, INT32_MAX, &v);
+            value->i32 = (int32_t)v.i64;
+            break;
+        case BYTE_STRUCT_TYPE_UINT32:
+            message = byte_struct_csv_parse_int(token, false, 0, UINT32_MAX, &v);
+            value->u32 = (uint32_t)v.u64;
+            break;
+        case BYTE_STRUCT_TYPE_INT64:
+            message = byte_struct_csv_parse_int(token, true, INT64_MIN, INT64_MAX, &v);
+            value->i64 = v.i64;
+            break;
+        case BYTE_STRUCT_TYPE_UINT64:
+            message = byte_struct_csv_parse_int(token, false, 0, UINT64_MAX, &v);
+            value->u64 = v.u64;
+            break;
+        case BYTE_STRUCT_TYPE_FLOAT:
+        case BYTE_STRUCT_TYPE_HALF:
+        case BYTE_STRUCT_TYPE_BFLOAT16:
+            message = byte_struct_csv_parse_double(token, point, &d);
+            value->f = (float)d;
+            break;
+        case BYTE_STRUCT_TYPE_DOUBLE:
+            message = byte_struct_csv_parse_double(token, point, &d);
+            value->d = d;
+            break;
+        default:
+            return "unsupported field type";
+    }
+    return message;
+}
+
+/*
+Splits one line into its first parser->num_columns columns. Returns the number
+found, or sets *message on a malformed quoted field.
+*/
+static size_t byte_struct_csv_tokenize(byte_struct_csv_parser_t *parser, const char *p, const char *end, byte_struct_csv_token_t *tokens, const char **message) {
+    size_t n = 0;
+    while (n < parser->num_columns) {
+        byte_struct_csv_token_t *token = &tokens[n];
+        if (p < end && *p == '"') {
+            const char *q = p + 1;
+            while (true) {
+                q = memchr(q, '"', (size_t)(end - q));
+                if (q == NULL) {
+                    *message = "unterminated quoted field";
+                    return n;
+                }
+                if (q + 1 < end && q[1] == '"') {
+                    q += 2;
+                } else {
+                    break;
+                }
+            }
+            *token = (byte_struct_csv_token_t){.start = p + 1, .len = (size_t)(q - p - 1), .quoted = true};
+            p = q + 1;
+            if (p < end && *p != parser->delimiter) {
+                *message = "unexpected character after quoted field";
+                return n;
+            }
+        } else {
+            const char *q = memchr(p, parser->delimiter, (size_t)(end - p));
+            if (q == NULL) q = end;
+            *token = (byte_struct_csv_token_t){.start = p, .len = (size_t)(q - p), .quoted = false};
+            p = q;
+        }
+        n++;
+        if (p == end) break;
+        p++;
+    }
+    return n;
+}
+
+static bool byte_struct_csv_is_null(byte_struct_type_t type, byte_struct_csv_token_t *tokens, size_t columns) {
+    for (size_t j = 0; j < columns; j++) {
+        byte_struct_csv_token_t token = tokens[j];
+        if (type != BYTE_STRUCT_TYPE_CHAR) byte_struct_csv_trim(&token);
+        if (token.quoted || token.len > 0) return false;
+    }
+    return true;
+}
+
+static bool byte_struct_csv_parse_line(byte_struct_csv_parser_t *parser, const char *p, const char *end, uint8_t *record, byte_struct_csv_token_t *tokens, char *string, byte_struct_csv_error_t *error) {
+    byte_struct_t *s = parser->s;
+    const char *message = NULL;
+    size_t found = byte_struct_csv_tokenize(parser, p, end, tokens, &message);
+    if (message != NULL) {
+        error->column = found + 1;
+        error->message = message;
+        return false;
+    }
+    for (size_t i = 0; i < s->num_fields; i++) {
+        type_offset_t *field = &s->type_offsets[i];
+        size_t column = parser->field_columns[i];
+        bool is_string = field->type == BYTE_STRUCT_TYPE_CHAR && field->count > 1;
+        size_t columns = is_string ? 1 : field->count;
+        if (column + columns > found) {
+            error->column = found + 1;
+            error->message = "missing column";
+            return false;
+        }
+        if (byte_struct_field_nullable(field) && byte_struct_csv_is_null(field->type, &tokens[column], columns)) {
+            byte_struct_set_null(s, record, field);
+            continue;
+        }
+        if (is_string) {
+            message = byte_struct_csv_parse_string(&tokens[column], string, field->count);
+            if (message == NULL) byte_struct_pack_field(s, field, record, string);
+        } else {
+            type_offset_t element = *field;
+            element.count = 1;
+            for (size_t j = 0; j < field->count && message == NULL; j++) {
+                byte_struct_csv_token_t token = tokens[column + j];
+                if (field->type != BYTE_STRUCT_TYPE_CHAR) byte_struct_csv_trim(&token);
+                byte_struct_csv_value_t value;
+                message = byte_struct_csv_parse_element(field->type, &token, parser->decimal_point, &value);
+                if (message == NULL) {
+                    element.offset = field->offset + j * field->size;
+                    byte_struct_pack_field(s, &element, record, &value);
+                } else {
+                    column += j;
+                }
+            }
+        }
+        if (message != NULL) {
+            error->column = column + 1;
+            error->message = message;
+            return false;
+        }
+    }
+    return true;
+}
+
+// Next line of [p, end) as [p, *line_end), without the \r of \r\n
+static const char *byte_struct_csv_next_line(const char *p, const char *end, const char **line_end) {
+    const char *newline = memchr(p, '\n', (size_t)(end - p));
+    const char *next = newline == NULL ? end : newline + 1;
+    const char *e = newline == NULL ? end : newline;
+    if (e > p && e[-1] == '\r') e--;
+    *line_end = e;
+    return next;
+}
+
+// Pass 1: lines and non-empty lines (records) per chunk
+static void byte_struct_csv_count_fn(void *arg, size_t start, size_t end) {
+    byte_struct_csv_parser_t *parser = arg;
+    for (size_t c = start; c < end; c++) {
+        byte_struct_csv_chunk_t *chunk = &parser->chunks[c];
+        const char *p = parser->text + chunk->start;
+        const char *chunk_end = parser->text + chunk->end;
+        while (p < chunk_end) {
+            const char *line_end;
+            const char *next = byte_struct_csv_next_line(p, chunk_end, &line_end);
+            chunk->lines++;
+            if (line_end > p) chunk->records++;
+            p = next;
+        }
+    }
+}
+
+// Pass 2: parse every record of the chunk into its slot of the output
+static void byte_struct_csv_parse_fn(void *arg, size_t start, size_t end) {
+    byte_struct_csv_parser_t *parser = arg;
+    byte_struct_csv_token_t *tokens = malloc(parser->num_columns * sizeof(byte_struct_csv_token_t));
+    char *string = malloc(parser->max_string + 1);
+    for (size_t c = start; c < end; c++) {
+        byte_struct_csv_chunk_t *chunk = &parser->chunks[c];
+        if (tokens == NULL || string == NULL) {
+            chunk->failed = true;
+            chunk->error = (byte_struct_csv_error_t){.message = "out of memory"};
+            continue;
+        }
+        const char *p = parser->text + chunk->start;
+        const char *chunk_end = parser->text + chunk->end;
+        size_t line = chunk->first_line;
+        uint8_t *record = parser->out + chunk->first_record * parser->s->total_size;
+        while (p < chunk_end) {
+            const char *line_end;
+            const char *next = byte_struct_csv_next_line(p, chunk_end, &line_end);
+            line++;
+            if (line_end > p) {
+                if (!byte_struct_csv_parse_line(parser, p, line_end, record, tokens, string, &chunk->error)) {
+                    chunk->failed = true;
+                    chunk->error.line = line;
+                    break;
+                }
+                record += parser->s->total_size;
+            }
+            p = next;
+        }
+    }
+    free(tokens);
+    free(string);
+}
+
+/*
+Parses text[0, len) into records of s. Empty lines are skipped. With out NULL
+only counts: *num_records is set to the number of records the text holds, so
+the caller can size out (or a file to map) and call again. Otherwise records
+are written to out, which has room for capacity records, and *num_records is
+the number of records in the text.
+
+On a parse error returns false with the first error (by line) in *error, if
+error isn't NULL. Records before it are valid. A NULL pool parses on the calling
+thread.
+*/
+bool byte_struct_csv_parse(byte_struct_thread_pool_t *pool, byte_struct_t *s, const char *text, size_t len, byte_struct_csv_options_t *options, uint8_t *out, size_t capacity, size_t *num_records, byte_struct_csv_error_t *error) {
+    byte_struct_csv_error_t ignored;
+    if (error == NULL) error = &ignored;
+    *error = (byte_struct_csv_error_t){0};
+    if (s == NULL || s->num_fields == 0 || (text == NULL && len > 0) || num_records == NULL) {
+        error->message = "invalid arguments";
+        return false;
+    }
+    byte_struct_csv_options_t defaults = {0};
+    if (options == NULL) options = &defaults;
+
+    byte_struct_csv_parser_t parser = {
+        .s = s,
+        .text = text,
+        .delimiter = options->delimiter != 0 ? options->delimiter : ',',
+        .decimal_point = localeconv()->decimal_point[0],
+    };
+    parser.field_columns = malloc(s->num_fields * sizeof(size_t));
+    if (parser.field_columns == NULL) {
+        error->message = "out of memory";
+        return false;
+    }
+    size_t next_column = 0;
+    for (size_t i = 0; i < s->num_fields; i++) {
+        type_offset_t *field = &s->type_offsets[i];
+        if (field->type == BYTE_STRUCT_TYPE_GROUP || field->type == BYTE_STRUCT_TYPE_PTR || field->type == BYTE_STRUCT_TYPE_RELPTR) {
+            free(parser.field_columns);
+            error->message = "unsupported field type";
+            return false;
+        }
+        bool is_string = field->type == BYTE_STRUCT_TYPE_CHAR && field->count > 1;
+        size_t columns = is_string ? 1 : field->count;
+        parser.field_columns[i] = options->column_map != NULL ? options->column_map[i] : next_column;
+        next_column = parser.field_columns[i] + columns;
+        if (next_column > parser.num_columns) parser.num_columns = next_column;
+        if (is_string && field->count > parser.max_string) parser.max_string = field->count;
+    }
+
+    // Header line, then chunks split after newlines
+    size_t body = 0;
+    size_t header_lines = 0;
+    if (options->header && len > 0) {
+        const char *line_end;
+        body = (size_t)(byte_struct_csv_next_line(text, text + len, &line_end) - text);
+        header_lines = 1;
+    }
+    size_t num_chunks = (len - body) / BYTE_STRUCT_CSV_CHUNK_BYTES + 1;
+    parser.chunks = calloc(num_chunks, sizeof(byte_struct_csv_chunk_t));
+    if (parser.chunks == NULL) {
+        free(parser.field_columns);
+        error->message = "out of memory";
+        return false;
+    }
+    size_t prev_end = body;
+    for (size_t c = 0; c < num_chunks; c++) {
+        size_t end = c + 1 == num_chunks ? len : body + (len - body) / num_chunks * (c + 1);
+        if (end < prev_end) end = prev_end;
+        if (end < len) {
+            const char *newline = memchr(text + end, '\n', len - end);
+            end = newline == NULL ? len : (size_t)(newline - text) + 1;
+        }
+        parser.chunks[c].start = prev_end;
+        parser.chunks[c].end = end;
+        prev_end = end;
+    }
+
+    byte_struct_thread_pool_for(pool, num_chunks, 1, byte_struct_csv_count_fn, &parser);
+    size_t lines = header_lines, records = 0;
+    for (size_t c = 0; c < num_chunks; c++) {
+        parser.chunks[c].first_line = lines;
+        parser.chunks[c].first_record = records;
+        lines += parser.chunks[c].lines;
+        records += parser.chunks[c].records;
+    }
+    *num_records = records;
+
+    bool ok = true;
+    if (out != NULL) {
+        if (records > capacity) {
+            error->message = "output too small";
+            ok = false;
+        } else {
+            parser.out = out;
+            byte_struct_thread_pool_for(pool, num_chunks, 1, byte_struct_csv_parse_fn, &parser);
+            for (size_t c = 0; c < num_chunks; c++) {
+                if (parser.chunks[c].failed) {
+                    *error = parser.chunks[c].error;
+                    ok = false;
+                    break;
+                }
+            }
+        }
+    }
+    free(parser.chunks);
+    free(parser.field_columns);
+    return ok;
+}
+
+// Appends to a bounded buffer, counting everything that didn't fit
+typedef struct byte_struct_csv_writer {
+    char *out;
+    size_t capacity;
+    size_t len;
+    // the locale's, read once per dump like the parser's
+    char decimal_point;
+} byte_struct_csv_writer_t;
+
+static void byte_struct_csv_write(byte_struct_csv_writer_t *w, const char *p, size_t n) {
+    if (w->len < w->capacity) {
+        size_t room = w->capacity - w->len;
+        memcpy(w->out + w->len, p, n < room ? n : room);
+    }
+    w->len += n;
+}
+
+static void byte_struct_csv_write_uint(byte_struct_csv_writer_t *w, uint64_t v, bool negative) {
+    char buf[21];
+    size_t i = sizeof(buf);
+    do {
+        buf[--i] = (char)('0' + v % 10);
+        v /= 10;
+    } while (v != 0);
+    if (negative) buf[--i] = '-';
+    byte_struct_csv_write(w, buf + i, sizeof(buf) - i);
+}
+
+static void byte_struct_csv_write_int(byte_struct_csv_writer_t *w, int64_t v) {
+    uint64_t magnitude = v < 0 ? (uint64_t)0 - (uint64_t)v : (uint64_t)v;
+    byte_struct_csv_write_uint(w, magnitude, v < 0);
+}
+
+// Enough digits to read back the same value, with '.' whatever the locale
+static void byte_struct_csv_write_double(byte_struct_csv_writer_t *w, double v, int precision) {
+    char buf[BYTE_STRUCT_CSV_MAX_NUMBER_LEN];
+    int n = snprintf(buf, sizeof(buf), "%.*g", precision, v);
+    if (n < 0) return;
+    for (int i = 0; i < n; i++) {
+        if (buf[i] == w->decimal_point) buf[i] = '.';
+    }
+    byte_struct_csv_write(w, buf, (size_t)n);
+}
+
+static void byte_struct_csv_write_string(byte_struct_csv_writer_t *w, const char *p, size_t size, char delimiter) {
+    size_t len = 0;
+    bool quote = false;
+    while (len < size && p[len] != '\0') {
+        char c = p[len++];
+        if (c == delimiter || c == '"' || c == '\n' || c == '\r') quote = true;
+    }
+    if (!quote) {
+        byte_struct_csv_write(w, p, len);
+        return;
+    }
+    byte_struct_csv_write(w, "\"", 1);
+    for (size_t i = 0; i < len; i++) {
+        if (p[i] == '"') byte_struct_csv_write(w, "\"", 1);
+        byte_struct_csv_write(w, p + i, 1);
+    }
+    byte_struct_csv_write(w, "\"", 1);
+}
+
+static void byte_struct_csv_write_element(byte_struct_csv_writer_t *w, byte_struct_type_t type, byte_struct_csv_value_t *value, char delimiter) {
+    switch (type) {
+        case BYTE_STRUCT_TYPE_CHAR: byte_struct_csv_write_string(w, &value->c, 1, delimiter); break;
+        case BYTE_STRUCT_TYPE_INT8: byte_struct_csv_write_int(w, value->i8); break;
+        case BYTE_STRUCT_TYPE_UINT8: byte_struct_csv_write_uint(w, value->u8, false); break;
+        case BYTE_STRUCT_TYPE_INT16: byte_struct_csv_write_int(w, value->i16); break;
+        case BYTE_STRUCT_TYPE_UINT16: byte_struct_csv_write_uint(w, value->u16, false); break;
+        case BYTE_STRUCT_TYPE_INT32: byte_struct_csv_write_int(w, value->i32); break;
+        case BYTE_STRUCT_TYPE_UINT32: byte_struct_csv_write_uint(w, value->u32, false); break;
+        case BYTE_STRUCT_TYPE_INT64: byte_struct_csv_write_int(w, value->i64); break;
+        case BYTE_STRUCT_TYPE_UINT64: byte_struct_csv_write_uint(w, value->u64, false); break;
+        case BYTE_STRUCT_TYPE_FLOAT: byte_struct_csv_write_double(w, value->f, 9); break;
+        case BYTE_STRUCT_TYPE_HALF: byte_struct_csv_write_double(w, value->f, 5); break;
+        case BYTE_STRUCT_TYPE_BFLOAT16: byte_struct_csv_write_double(w, value->f, 4); break;
+        case BYTE_STRUCT_TYPE_DOUBLE: byte_struct_csv_write_double(w, value->d, 17); break;
+        default: break;
+    }
+}
+
+/*
+Writes n records of s as delimited text, one line per record, in the layout
+byte_struct_csv_parse reads back (options->column_map is ignored). Like
+snprintf, returns the length of the full text and writes at most capacity bytes
+of it, so a call with capacity 0 sizes the buffer. Returns 0 for fields that
+can't be dumped.
+*/
+size_t byte_struct_csv_dump(byte_struct_t *s, uint8_t *data, size_t n, byte_struct_csv_options_t *options, char *out, size_t capacity) {
+    if (s == NULL || s->num_fields == 0 || (data == NULL && n > 0)) return 0;
+    char delimiter = options != NULL && options->delimiter != 0 ? options->delimiter : ',';
+    size_t max_string = 0;
+    for (size_t i = 0; i < s->num_fields; i++) {
+        type_offset_t *field = &s->type_offsets[i];
+        if (field->type == BYTE_STRUCT_TYPE_GROUP || field->type == BYTE_STRUCT_TYPE_PTR || field->type == BYTE_STRUCT_TYPE_RELPTR) return 0;
+        if (field->type == BYTE_STRUCT_TYPE_CHAR && field->count > max_string) max_string = field->count;
+    }
+    char *string = malloc(max_string + 1);
+    if (string == NULL) return 0;
+
+    byte_struct_csv_writer_t w = {
+        .out = out,
+        .capacity = out == NULL ? 0 : capacity,
+        .decimal_point = localeconv()->decimal_point[0]
+    };
+    for (size_t r = 0; r < n; r++) {
+        uint8_t *record = data + r * s->total_size;
+        for (size_t i = 0; i < s->num_fields; i++) {
+            type_offset_t *field = &s->type_offsets[i];
+            if (i > 0) byte_struct_csv_write(&w, &delimiter, 1);
+            bool nullable = byte_struct_field_nullable(field);
+            bool is_null = byte_struct_is_null(s, record, field);
+            if (field->type == BYTE_STRUCT_TYPE_CHAR && field->count > 1) {
+                if (is_null) continue;
+                byte_struct_unpack_field(s, field, record, string);
+                // quoted so it doesn't read back as null
+                if (nullable && string[0] == '\0') {
+                    byte_struct_csv_write(&w, "\"\"", 2);
+                } else {
+                    byte_struct_csv_write_string(&w, string, field->count, delimiter);
+                }
+                continue;
+            }
+            type_offset_t element = *field;
+            element.count = 1;
+            for (size_t j = 0; j < field->count; j++) {
+                if (j > 0) byte_struct_csv_write(&w, &delimiter, 1);
+                if (is_null) continue;
+                byte_struct_csv_value_t value;
+                element.offset = field->offset + j * field->size;
+                byte_struct_unpack_field(s, &element, record, &value);
+                if (nullable && field->type == BYTE_STRUCT_TYPE_CHAR && value.c == '\0') {
+                    byte_struct_csv_write(&w, "\"\"", 2);
+                } else {
+                    byte_struct_csv_write_element(&w, field->type, &value, delimiter);
+                }
+            }
+        }
+        byte_struct_csv_write(&w, "\n", 1);
+    }
+    free(string);
+    return w.len;
+}
+
+#endif
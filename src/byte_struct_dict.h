@@ -0,0 +1,367 @@
+#ifndef BYTE_STRUCT_DICT_H
+#define BYTE_STRUCT_DICT_H
+
+#include <stdint.h>
+#include <stdlib.h>
+#include <stdbool.h>
+#include <string.h>
+
+#include "byte_struct.h"
+#include "byte_struct_hash.h"
+
+/*
+Dictionary encoding for low-cardinality strings (country, device, status...).
+Instead of a c[N] field padded to N bytes in every record, records hold a 'B',
+'H' or 'I' code and a shared byte_struct_dict_t maps codes to strings, so
+records shrink and equality predicates become integer comparisons on the code.
+
+Strings are width-byte slots, zero padded like c[N] values. The dictionary
+grows as strings are encoded and numbers them in the order they are first seen.
+byte_struct_dict_sort renumbers them in string order, after which codes compare
+like the strings they stand for (so BYTE_STRUCT_SORTABLE records sort by the
+strings) until a new string is added. It returns the old -> new mapping so
+records already encoded can be rewritten with byte_struct_dict_remap.
+
+Encoding is a hash lookup (open addressing on byte_struct_hash_bytes, after a
+check against the previous string since such columns tend to come in runs),
+decoding is a gather from the contiguous array of strings.
+*/
+
+#define BYTE_STRUCT_DICT_MIN_TABLE_SIZE 16
+#define BYTE_STRUCT_DICT_SEED 0x5d1c7e0a3b9f2461ull
+// Codes go through a stack buffer this many at a time when packing records
+#define BYTE_STRUCT_DICT_CHUNK 256
+
+typedef struct byte_struct_dict {
+    size_t width;
+    size_t code_size;
+    // number of distinct codes of code_size bytes
+    size_t max_size;
+    size_t size;
+    size_t capacity;
+    // string i (width bytes) has code i
+    uint8_t *values;
+    // 0 for empty slots, code + 1 otherwise
+    uint32_t *table;
+    size_t table_mask;
+    bool ordered;
+} byte_struct_dict_t;
+
+// Dictionary of strings up to width bytes with codes of code_size (1, 2 or 4) bytes
+byte_struct_dict_t *byte_struct_dict_new(size_t width, size_t code_size) {
+    if (width == 0 || (code_size != 1 && code_size != 2 && code_size != 4)) return NULL;
+    byte_struct_dict_t *dict = calloc(1, sizeof(byte_struct_dict_t));
+    if (dict == NULL) return NULL;
+    dict->width = width;
+    dict->code_size = code_size;
+    // code + 1 has to fit a table slot
+    dict->max_size = code_size == 4 ? UINT32_MAX : (size_t)1 << (8 * code_size);
+    dict->table = calloc(BYTE_STRUCT_DICT_MIN_TABLE_SIZE, sizeof(uint32_t));
+    if (dict->table == NULL) {
+        free(dict);
+        return NULL;
+    }
+    dict->table_mask = BYTE_STRUCT_DICT_MIN_TABLE_SIZE - 1;
+    // the empty dictionary is trivially in order
+    dict->ordered = true;
+    return dict;
+}
+
+void byte_struct_dict_destroy(byte_struct_dict_t *dict) {
+    if (dict == NULL) return;
+    free(dict->values);
+    free(dict->table);
+    free(dict);
+}
+
+size_t byte_struct_dict_size(byte_struct_dict_t *dict) {
+    return dict == NULL ? 0 : dict->size;
+}
+
+// True while codes are in string order
+bool byte_struct_dict_ordered(byte_struct_dict_t *dict) {
+    return dict != NULL && dict->ordered;
+}
+
+static inline uint8_t *byte_struct_dict_value(byte_struct_dict_t *dict, size_t code) {
+    return dict->values + code * dict->width;
+}
+
+static inline size_t byte_struct_dict_hash(byte_struct_dict_t *dict, const uint8_t *string) {
+    return (size_t)byte_struct_hash_bytes(string, dict->width, BYTE_STRUCT_DICT_SEED);
+}
+
+// Slot holding string, or the empty slot where it would go
+static uint32_t *byte_struct_dict_slot(byte_struct_dict_t *dict, const uint8_t *string) {
+    size_t i = byte_struct_dict_hash(dict, string) & dict->table_mask;
+    while (true) {
+        uint32_t *slot = &dict->table[i];
+        if (*slot == 0 || memcmp(byte_struct_dict_value(dict, *slot - 1), string, dict->width) == 0) return slot;
+        i = (i + 1) & dict->table_mask;
+    }
+}
+
+// Rebuilds the table for the current codes, at least twice as many slots as strings
+static bool byte_struct_dict_rehash(byte_struct_dict_t *dict, size_t table_size) {
+    uint32_t *table = calloc(table_size, sizeof(uint32_t));
+    if (table == NULL) return false;
+    free(dict->table);
+    dict->table = table;
+    dict->table_mask = table_size - 1;
+    for (size_t code = 0; code < dict->size; code++) {
+        *byte_struct_dict_slot(dict, byte_struct_dict_value(dict, code)) = (uint32_t)code + 1;
+    }
+    return true;
+}
+
+// Adds string (not in the dictionary yet) under the next code
+static bool byte_struct_dict_add(byte_struct_dict_t *dict, const uint8_t *string, uint32_t *code) {
+    if (dict->size == dict->max_size) return false;
+    if (dict->size == dict->capacity) {
+        size_t capacity = dict->capacity == 0 ? BYTE_STRUCT_DICT_MIN_TABLE_SIZE : dict->capacity * 2;
+        if (capacity > dict->max_size) capacity = dict->max_size;
+        if (capacity > SIZE_MAX / dict->width) return false;
+        uint8_t *values = realloc(dict->values, capacity * dict->width);
+        if (values == NULL) return false;
+        dict->values = values;
+        dict->capacity = capacity;
+    }
+    if ((dict->size + 1) * 2 > dict->table_mask + 1) {
+        if (!byte_struct_dict_rehash(dict, (dict->table_mask + 1) * 2)) return false;
+    }
+    memcpy(byte_struct_dict_value(dict, dict->size), string, dict->width);
+    *code = (uint32_t)dict->size;
+    *byte_struct_dict_slot(dict, string) = *code + 1;
+    dict->size++;
+    if (dict->ordered && dict->size > 1) {
+        dict->ordered = memcmp(byte_struct_dict_value(dict, dict->size - 2), string, dict->width) < 0;
+    }
+    return true;
+}
+
+static bool byte_struct_dict_encode_one(byte_struct_dict_t *dict, const uint8_t *string, bool insert, uint32_t *code) {
+    uint32_t slot = *byte_struct_dict_slot(dict, string);
+    if (slot != 0) {
+        *code = slot - 1;
+        return true;
+    }
+    return insert && byte_struct_dict_add(dict, string, code);
+}
+
+/*
+Codes for n strings of width bytes each. With insert, strings not in the
+dictionary are added, otherwise they fail the call. Returns false on the first
+string that can't be encoded (also a full dictionary or failed allocation),
+codes before it are filled in.
+*/
+bool byte_struct_dict_encode(byte_struct_dict_t *dict, const char *strings, size_t n, uint32_t *codes, bool insert) {
+    if (dict == NULL || (n > 0 && (strings == NULL || codes == NULL))) return false;
+    const uint8_t *p = (const uint8_t *)strings;
+    size_t width = dict->width;
+    for (size_t i = 0; i < n; i++) {
+        const uint8_t *string = p + i * width;
+        if (i > 0 && memcmp(string, string - width, width) == 0) {
+            codes[i] = codes[i - 1];
+            continue;
+        }
+        if (!byte_struct_dict_encode_one(dict, string, insert, &codes[i])) return false;
+    }
+    return true;
+}
+
+// Strings for n codes, false (with the strings before it written) on an unknown code
+bool byte_struct_dict_decode(byte_struct_dict_t *dict, const uint32_t *codes, size_t n, char *strings) {
+    if (dict == NULL || (n > 0 && (strings == NULL || codes == NULL))) return false;
+    size_t width = dict->width;
+    for (size_t i = 0; i < n; i++) {
+        if (codes[i] >= dict->size) return false;
+        memcpy(strings + i * width, byte_struct_dict_value(dict, codes[i]), width);
+    }
+    return true;
+}
+
+// Pads a C string to a width-byte slot, false if it doesn't fit
+static bool byte_struct_dict_pad(byte_struct_dict_t *dict, const char *string, uint8_t *padded) {
+    size_t len = 0;
+    while (string[len] != '\0') {
+        if (len == dict->width) return false;
+        len++;
+    }
+    memcpy(padded, string, len);
+    memset(padded + len, 0, dict->width - len);
+    return true;
+}
+
+/*
+Code of a C string without adding it, e.g. to turn an equality predicate into
+a code comparison. False if the string isn't in the dictionary.
+*/
+bool byte_struct_dict_find(byte_struct_dict_t *dict, const char *string, uint32_t *code) {
+    if (dict == NULL || string == NULL || code == NULL) return false;
+    uint8_t *padded = malloc(dict->width);
+    if (padded == NULL) return false;
+    bool found = byte_struct_dict_pad(dict, string, padded) && byte_struct_dict_encode_one(dict, padded, false, code);
+    free(padded);
+    return found;
+}
+
+/*
+For ordered dictionaries, the first code whose string is >= string (size if
+there is none), so range predicates on the strings become code ranges. False if
+the dictionary isn't ordered.
+*/
+bool byte_struct_dict_lower_bound(byte_struct_dict_t *dict, const char *string, uint32_t *code) {
+    if (dict == NULL || string == NULL || code == NULL || !dict->ordered) return false;
+    uint8_t *padded = malloc(dict->width);
+    if (padded == NULL) return false;
+    // Strings longer than width sort after their width-byte prefix, so search for the prefix and step past it
+    size_t len = strlen(string);
+    bool truncated = len > dict->width;
+    memcpy(padded, string, truncated ? dict->width : len);
+    if (!truncated) memset(padded + len, 0, dict->width - len);
+    size_t lo = 0, hi = dict->size;
+    while (lo < hi) {
+        size_t mid = lo + (hi - lo) / 2;
+        int cmp = memcmp(byte_struct_dict_value(dict, mid), padded, dict->width);
+        if (cmp < 0 || (truncated && cmp == 0)) {
+            lo = mid + 1;
+        } else {
+            hi = mid;
+        }
+    }
+    free(padded);
+    *code = (uint32_t)lo;
+    return true;
+}
+
+/*
+Renumbers the codes in string order. remap (room for byte_struct_dict_size
+entries, may be NULL) gets the new code of each old one for byte_struct_dict_remap.
+*/
+bool byte_struct_dict_sort(byte_struct_dict_t *dict, uint32_t *remap) {
+    if (dict == NULL) return false;
+    size_t n = dict->size;
+    size_t width = dict->width;
+    // Sort (string, old code) records, strings are distinct so the code never decides
+    size_t size = width + sizeof(uint32_t);
+    uint8_t *records = malloc(2 * n * size + 1);
+    if (records == NULL) return false;
+    for (size_t code = 0; code < n; code++) {
+        memcpy(records + code * size, byte_struct_dict_value(dict, code), width);
+        memcpy(records + code * size + width, &(uint32_t){(uint32_t)code}, sizeof(uint32_t));
+    }
+    byte_struct_sort_records(records, n, size, records + n * size);
+    for (size_t code = 0; code < n; code++) {
+        uint32_t old_code;
+        memcpy(&old_code, records + code * size + width, sizeof(uint32_t));
+        memcpy(byte_struct_dict_value(dict, code), records + code * size, width);
+        if (remap != NULL) remap[old_code] = (uint32_t)code;
+    }
+    free(records);
+    dict->ordered = true;
+    return byte_struct_dict_rehash(dict, dict->table_mask + 1);
+}
+
+// Codes are stored in unsigned integer fields wide enough for every code of dict
+static bool byte_struct_dict_field_valid(byte_struct_dict_t *dict, byte_struct_t *s, uint8_t *data, size_t n, type_offset_t *field) {
+    if (dict == NULL || s == NULL || field == NULL || (data == NULL && n > 0)) return false;
+    if (field->type != BYTE_STRUCT_TYPE_UINT8 && field->type != BYTE_STRUCT_TYPE_UINT16 && field->type != BYTE_STRUCT_TYPE_UINT32) return false;
+    return field->size >= dict->code_size;
+}
+
+static void byte_struct_dict_pack_code(byte_struct_t *s, type_offset_t *element, uint8_t *record, uint32_t code) {
+    switch (element->type) {
+        case BYTE_STRUCT_TYPE_UINT8:
+            byte_struct_pack_field(s, element, record, &(uint8_t){(uint8_t)code});
+            break;
+        case BYTE_STRUCT_TYPE_UINT16:
+            byte_struct_pack_field(s, element, record, &(uint16_t){(uint16_t)code});
+            break;
+        default:
+            byte_struct_pack_field(s, element, record, &code);
+            break;
+    }
+}
+
+static uint32_t byte_struct_dict_unpack_code(byte_struct_t *s, type_offset_t *element, uint8_t *record) {
+    switch (element->type) {
+        case BYTE_STRUCT_TYPE_UINT8: {
+            uint8_t code = 0;
+            byte_struct_unpack_field(s, element, record, &code);
+            return code;
+        }
+        case BYTE_STRUCT_TYPE_UINT16: {
+            uint16_t code = 0;
+            byte_struct_unpack_field(s, element, record, &code);
+            return code;
+        }
+        default: {
+            uint32_t code = 0;
+            byte_struct_unpack_field(s, element, record, &code);
+            return code;
+        }
+    }
+}
+
+/*
+Encodes strings into the code field of n records of s, field->count strings of
+dict->width bytes per record (a columnar c[N] array). field is
+s->type_offsets[i] or the result of byte_struct_field_path.
+*/
+bool byte_struct_dict_pack(byte_struct_dict_t *dict, byte_struct_t *s, uint8_t *data, size_t n, type_offset_t *field, const char *strings, bool insert) {
+    if (!byte_struct_dict_field_valid(dict, s, data, n, field) || (strings == NULL && n > 0)) return false;
+    uint32_t codes[BYTE_STRUCT_DICT_CHUNK];
+    size_t count = field->count;
+    type_offset_t element = *field;
+    element.count = 1;
+    size_t total = n * count;
+    for (size_t start = 0; start < total; start += BYTE_STRUCT_DICT_CHUNK) {
+        size_t m = total - start < BYTE_STRUCT_DICT_CHUNK ? total - start : BYTE_STRUCT_DICT_CHUNK;
+        if (!byte_struct_dict_encode(dict, strings + start * dict->width, m, codes, insert)) return false;
+        for (size_t k = 0; k < m; k++) {
+            size_t r = (start + k) / count, j = (start + k) % count;
+            element.offset = field->offset + j * field->size;
+            byte_struct_dict_pack_code(s, &element, data + r * s->total_size, codes[k]);
+        }
+    }
+    return true;
+}
+
+// Decodes the code field of n records into field->count strings per record
+bool byte_struct_dict_unpack(byte_struct_dict_t *dict, byte_struct_t *s, uint8_t *data, size_t n, type_offset_t *field, char *strings) {
+    if (!byte_struct_dict_field_valid(dict, s, data, n, field) || (strings == NULL && n > 0)) return false;
+    uint32_t codes[BYTE_STRUCT_DICT_CHUNK];
+    size_t count = field->count;
+    type_offset_t element = *field;
+    element.count = 1;
+    size_t total = n * count;
+    for (size_t start = 0; start < total; start += BYTE_STRUCT_DICT_CHUNK) {
+        size_t m = total - start < BYTE_STRUCT_DICT_CHUNK ? total - start : BYTE_STRUCT_DICT_CHUNK;
+        for (size_t k = 0; k < m; k++) {
+            size_t r = (start + k) / count, j = (start + k) % count;
+            element.offset = field->offset + j * field->size;
+            codes[k] = byte_struct_dict_unpack_code(s, &element, data + r * s->total_size);
+        }
+        if (!byte_struct_dict_decode(dict, codes, m, strings + start * dict->width)) return false;
+    }
+    return true;
+}
+
+// Rewrites the codes of n records through remap from byte_struct_dict_sort
+bool byte_struct_dict_remap(byte_struct_dict_t *dict, byte_struct_t *s, uint8_t *data, size_t n, type_offset_t *field, const uint32_t *remap) {
+    if (!byte_struct_dict_field_valid(dict, s, data, n, field) || remap == NULL) return false;
+    type_offset_t element = *field;
+    element.count = 1;
+    for (size_t r = 0; r < n; r++) {
+        uint8_t *record = data + r * s->total_size;
+        for (size_t j = 0; j < field->count; j++) {
+            element.offset = field->offset + j * field->size;
+            uint32_t code = byte_struct_dict_unpack_code(s, &element, record);
+            if (code >= dict->size) return false;
+            byte_struct_dict_pack_code(s, &element, record, remap[code]);
+        }
+    }
+    return true;
+}
+
+#endif
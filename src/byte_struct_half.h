@@ -0,0 +1,140 @@
+#ifndef BYTE_STRUCT_HALF_H
+#define BYTE_STRUCT_HALF_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <string.h>
+
+/*
+float <-> IEEE half and bfloat16 bit patterns, round to nearest even. Included
+from byte_struct.h.
+
+Array conversions to and from half use F16C (8 lanes) or AVX-512F (16 lanes)
+when the compiler targets them (-mf16c, -mavx512f or -march=native), with the
+scalar code as fallback and for the tails. The scalar code produces the same
+bits as the hardware, including quiet NaNs that keep the top payload bits.
+
+bfloat16 is the top half of a float, so its conversions are plain integer
+loops that compilers vectorize on their own. VCVTNEPS2BF16 isn't used because
+it flushes subnormal inputs to zero, which would make results depend on the
+build flags.
+*/
+
+#if defined(__F16C__) || defined(__AVX512F__)
+#include <immintrin.h>
+#endif
+
+static inline uint32_t byte_struct_float_bits(float f) {
+    uint32_t u;
+    memcpy(&u, &f, sizeof(float));
+    return u;
+}
+
+static inline float byte_struct_bits_float(uint32_t u) {
+    float f;
+    memcpy(&f, &u, sizeof(float));
+    return f;
+}
+
+static inline uint16_t byte_struct_float_to_half(float value) {
+    uint32_t u = byte_struct_float_bits(value);
+    uint16_t sign = (uint16_t)((u >> 16) & 0x8000);
+    u &= 0x7fffffffu;
+
+    uint16_t h;
+    if (u >= 0x47800000u) {
+        // Overflows to infinity (>= 65536 before rounding), or NaN
+        h = u > 0x7f800000u ? (uint16_t)(0x7e00 | ((u >> 13) & 0x3ff)) : 0x7c00;
+    } else if (u < 0x38800000u) {
+        // Half subnormal or zero: adding 0.5 lines the half mantissa up with the float's low bits,
+        // and the FPU does the rounding
+        float f = byte_struct_bits_float(u) + 0.5f;
+        h = (uint16_t)(byte_struct_float_bits(f) - 0x3f000000u);
+    } else {
+        uint32_t mantissa_odd = (u >> 13) & 1;
+        u += 0xc8000fffu + mantissa_odd;  // rebias exponent (-112 << 23) and round
+        h = (uint16_t)(u >> 13);
+    }
+    return h | sign;
+}
+
+static inline float byte_struct_half_to_float(uint16_t h) {
+    uint32_t sign = (uint32_t)(h & 0x8000) << 16;
+    uint32_t exponent = (h >> 10) & 0x1f;
+    uint32_t mantissa = h & 0x3ff;
+    if (exponent == 0) {
+        // Zero or subnormal, exact in float
+        float f = (float)mantissa * 5.9604644775390625e-8f;
+        return byte_struct_bits_float(byte_struct_float_bits(f) | sign);
+    } else if (exponent == 0x1f) {
+        // Signaling NaNs come out quiet, as from VCVTPH2PS
+        uint32_t quiet = mantissa != 0 ? 0x00400000u : 0;
+        return byte_struct_bits_float(sign | 0x7f800000u | quiet | (mantissa << 13));
+    }
+    return byte_struct_bits_float(sign | ((exponent + 112) << 23) | (mantissa << 13));
+}
+
+static inline uint16_t byte_struct_float_to_bfloat16(float value) {
+    uint32_t u = byte_struct_float_bits(value);
+    if ((u & 0x7fffffffu) > 0x7f800000u) {
+        return (uint16_t)((u >> 16) | 0x40);
+    }
+    u += 0x7fff + ((u >> 16) & 1);
+    return (uint16_t)(u >> 16);
+}
+
+static inline float byte_struct_bfloat16_to_float(uint16_t h) {
+    return byte_struct_bits_float((uint32_t)h << 16);
+}
+
+static void byte_struct_float_to_half_array(const float *values, uint16_t *out, size_t n) {
+    size_t i = 0;
+#if defined(__AVX512F__)
+    for (; i + 16 <= n; i += 16) {
+        __m512 v = _mm512_loadu_ps(values + i);
+        _mm256_storeu_si256((__m256i *)(out + i), _mm512_cvtps_ph(v, _MM_FROUND_TO_NEAREST_INT | _MM_FROUND_NO_EXC));
+    }
+#endif
+#if defined(__F16C__)
+    for (; i + 8 <= n; i += 8) {
+        __m256 v = _mm256_loadu_ps(values + i);
+        _mm_storeu_si128((__m128i *)(out + i), _mm256_cvtps_ph(v, _MM_FROUND_TO_NEAREST_INT | _MM_FROUND_NO_EXC));
+    }
+#endif
+    for (; i < n; i++) {
+        out[i] = byte_struct_float_to_half(values[i]);
+    }
+}
+
+static void byte_struct_half_to_float_array(const uint16_t *halves, float *out, size_t n) {
+    size_t i = 0;
+#if defined(__AVX512F__)
+    for (; i + 16 <= n; i += 16) {
+        __m256i v = _mm256_loadu_si256((const __m256i *)(halves + i));
+        _mm512_storeu_ps(out + i, _mm512_cvtph_ps(v));
+    }
+#endif
+#if defined(__F16C__)
+    for (; i + 8 <= n; i += 8) {
+        __m128i v = _mm_loadu_si128((const __m128i *)(halves + i));
+        _mm256_storeu_ps(out + i, _mm256_cvtph_ps(v));
+    }
+#endif
+    for (; i < n; i++) {
+        out[i] = byte_struct_half_to_float(halves[i]);
+    }
+}
+
+static void byte_struct_float_to_bfloat16_array(const float *values, uint16_t *out, size_t n) {
+    for (size_t i = 0; i < n; i++) {
+        out[i] = byte_struct_float_to_bfloat16(values[i]);
+    }
+}
+
+static void byte_struct_bfloat16_to_float_array(const uint16_t *halves, float *out, size_t n) {
+    for (size_t i = 0; i < n; i++) {
+        out[i] = byte_struct_bfloat16_to_float(halves[i]);
+    }
+}
+
+#endif
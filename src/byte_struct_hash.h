@@ -0,0 +1,46 @@
+#ifndef BYTE_STRUCT_HASH_H
+#define BYTE_STRUCT_HASH_H
+
+#include <stdint.h>
+#include <stddef.h>
+
+#include "byte_order/byte_order.h"
+
+/*
+64-bit hash of packed bytes, shared by the filters, partitioning and sketches.
+Reads 8 bytes at a time with a multiply-xorshift mix per word and a final
+avalanche, so every output bit depends on every input bit. Not cryptographic.
+*/
+
+#define BYTE_STRUCT_HASH_PRIME_1 0x9e3779b97f4a7c15ull
+#define BYTE_STRUCT_HASH_PRIME_2 0xbf58476d1ce4e5b9ull
+#define BYTE_STRUCT_HASH_PRIME_3 0x94d049bb133111ebull
+
+// splitmix64 finalizer
+static inline uint64_t byte_struct_hash_mix(uint64_t h) {
+    h ^= h >> 30;
+    h *= BYTE_STRUCT_HASH_PRIME_2;
+    h ^= h >> 27;
+    h *= BYTE_STRUCT_HASH_PRIME_3;
+    h ^= h >> 31;
+    return h;
+}
+
+static inline uint64_t byte_struct_hash_bytes(const uint8_t *data, size_t len, uint64_t seed) {
+    uint64_t h = seed ^ ((uint64_t)len * BYTE_STRUCT_HASH_PRIME_1);
+    size_t i = 0;
+    for (; i + sizeof(uint64_t) <= len; i += sizeof(uint64_t)) {
+        uint64_t word = read_uint64_little_endian(data + i);
+        h = (h ^ byte_struct_hash_mix(word + BYTE_STRUCT_HASH_PRIME_1)) * BYTE_STRUCT_HASH_PRIME_1;
+    }
+    if (i < len) {
+        uint64_t word = 0;
+        for (size_t j = 0; i + j < len; j++) {
+            word |= (uint64_t)data[i + j] << (8 * j);
+        }
+        h = (h ^ byte_struct_hash_mix(word + BYTE_STRUCT_HASH_PRIME_1)) * BYTE_STRUCT_HASH_PRIME_1;
+    }
+    return byte_struct_hash_mix(h);
+}
+
+#endif
@@ -0,0 +1,314 @@
+#ifndef BYTE_STRUCT_MERGE_H
+#define BYTE_STRUCT_MERGE_H
+
+#include <stdint.h>
+#include <stdlib.h>
+#include <stdbool.h>
+#include <string.h>
+
+#include "byte_struct.h"
+
+/*
+Merge-based join and set operations over two buffers of BYTE_STRUCT_SORTABLE
+records, each sorted on its first k fields. Keys are compared as raw encoded
+bytes (memcmp on the first byte_struct_prefix_size(s, k) bytes), nothing is
+decoded.
+
+When one side is much larger than the other, it is advanced by galloping
+(exponential then binary search) instead of one record at a time, so
+intersecting a small buffer with a huge one costs O(small * log(huge)).
+
+The two sides may have different schemas as long as their first k fields are
+identical.
+*/
+
+// Gallop through a side once it is this many times larger than the other
+#define BYTE_STRUCT_MERGE_GALLOP_RATIO 8
+
+typedef struct byte_struct_merge_side {
+    uint8_t *data;
+    size_t n;
+    size_t record_size;
+    bool gallop;
+} byte_struct_merge_side_t;
+
+// Matching (a, b) record index pairs from byte_struct_merge_join
+typedef struct byte_struct_index_pairs {
+    size_t *a;
+    size_t *b;
+    size_t n;
+    size_t m;
+} byte_struct_index_pairs_t;
+
+static bool byte_struct_merge_prefix(byte_struct_t *s_a, byte_struct_t *s_b, size_t k, size_t *prefix_len) {
+    if (s_a == NULL || s_b == NULL || k == 0) return false;
+    if (s_a->byte_order != BYTE_STRUCT_SORTABLE || s_b->byte_order != BYTE_STRUCT_SORTABLE) return false;
+    if (k > s_a->num_fields || k > s_b->num_fields) return false;
+    for (size_t i = 0; i < k; i++) {
+        type_offset_t *a = &s_a->type_offsets[i];
+        type_offset_t *b = &s_b->type_offsets[i];
+        if (a->type != b->type || a->count != b->count || a->size != b->size || a->flags != b->flags) return false;
+    }
+    *prefix_len = byte_struct_prefix_size(s_a, k);
+    return true;
+}
+
+static void byte_struct_merge_sides(uint8_t *a, size_t na, size_t a_size, uint8_t *b, size_t nb, size_t b_size, byte_struct_merge_side_t *side_a, byte_struct_merge_side_t *side_b) {
+    *side_a = (byte_struct_merge_side_t){.data = a, .n = na, .record_size = a_size, .gallop = na / BYTE_STRUCT_MERGE_GALLOP_RATIO > nb};
+    *side_b = (byte_struct_merge_side_t){.data = b, .n = nb, .record_size = b_size, .gallop = nb / BYTE_STRUCT_MERGE_GALLOP_RATIO > na};
+}
+
+static inline uint8_t *byte_struct_merge_record(byte_struct_merge_side_t *side, size_t i) {
+    return side->data + i * side->record_size;
+}
+
+/*
+First index >= start whose key is >= key (or > key if past_equal). Steps
+linearly unless the side gallops.
+*/
+static size_t byte_struct_merge_seek(byte_struct_merge_side_t *side, size_t start, uint8_t *key, size_t prefix_len, bool past_equal) {
+    int limit = past_equal ? 0 : -1;
+    if (!side->gallop) {
+        while (start < side->n && memcmp(byte_struct_merge_record(side, start), key, prefix_len) <= limit) {
+            start++;
+        }
+        return start;
+    }
+    if (start >= side->n || memcmp(byte_struct_merge_record(side, start), key, prefix_len) > limit) return start;
+    // Invariant: record lo is before the target, record hi (if < n) is at or past it
+    size_t lo = start, step = 1, hi;
+    for (;;) {
+        hi = lo + step;
+        if (hi >= side->n || hi < lo) {
+            hi = side->n;
+            break;
+        }
+        if (memcmp(byte_struct_merge_record(side, hi), key, prefix_len) > limit) break;
+        lo = hi;
+        step *= 2;
+    }
+    while (hi - lo > 1) {
+        size_t mid = lo + (hi - lo) / 2;
+        if (memcmp(byte_struct_merge_record(side, mid), key, prefix_len) <= limit) {
+            lo = mid;
+        } else {
+            hi = mid;
+        }
+    }
+    return hi;
+}
+
+static bool byte_struct_index_pairs_push(byte_struct_index_pairs_t *pairs, size_t a, size_t b) {
+    if (pairs->n == pairs->m) {
+        size_t m = pairs->m > 0 ? pairs->m * 2 : 64;
+        if (m > SIZE_MAX / sizeof(size_t)) return false;
+        size_t *new_a = realloc(pairs->a, m * sizeof(size_t));
+        if (new_a == NULL) return false;
+        pairs->a = new_a;
+        size_t *new_b = realloc(pairs->b, m * sizeof(size_t));
+        if (new_b == NULL) return false;
+        pairs->b = new_b;
+        pairs->m = m;
+    }
+    pairs->a[pairs->n] = a;
+    pairs->b[pairs->n] = b;
+    pairs->n++;
+    return true;
+}
+
+void byte_struct_index_pairs_destroy(byte_struct_index_pairs_t *pairs) {
+    if (pairs == NULL) return;
+    free(pairs->a);
+    free(pairs->b);
+    pairs->a = NULL;
+    pairs->b = NULL;
+    pairs->n = 0;
+    pairs->m = 0;
+}
+
+/*
+Inner join on the first k fields. Every pair of records with equal keys is
+appended to out (zero-initialized by the caller, freed with
+byte_struct_index_pairs_destroy), in key order.
+*/
+bool byte_struct_merge_join(byte_struct_t *s_a, uint8_t *a, size_t na, byte_struct_t *s_b, uint8_t *b, size_t nb, size_t k, byte_struct_index_pairs_t *out) {
+    size_t prefix_len;
+    if (out == NULL || !byte_struct_merge_prefix(s_a, s_b, k, &prefix_len)) return false;
+    if ((a == NULL && na > 0) || (b == NULL && nb > 0)) return false;
+    byte_struct_merge_side_t side_a, side_b;
+    byte_struct_merge_sides(a, na, s_a->total_size, b, nb, s_b->total_size, &side_a, &side_b);
+
+    size_t i = 0, j = 0;
+    while (i < na && j < nb) {
+        uint8_t *key_a = byte_struct_merge_record(&side_a, i);
+        uint8_t *key_b = byte_struct_merge_record(&side_b, j);
+        int cmp = memcmp(key_a, key_b, prefix_len);
+        if (cmp < 0) {
+            i = byte_struct_merge_seek(&side_a, i + 1, key_b, prefix_len, false);
+        } else if (cmp > 0) {
+            j = byte_struct_merge_seek(&side_b, j + 1, key_a, prefix_len, false);
+        } else {
+            size_t end_a = byte_struct_merge_seek(&side_a, i + 1, key_a, prefix_len, true);
+            size_t end_b = byte_struct_merge_seek(&side_b, j + 1, key_a, prefix_len, true);
+            for (size_t x = i; x < end_a; x++) {
+                for (size_t y = j; y < end_b; y++) {
+                    if (!byte_struct_index_pairs_push(out, x, y)) return false;
+                }
+            }
+            i = end_a;
+            j = end_b;
+        }
+    }
+    return true;
+}
+
+/*
+Materializes joined pairs as the a record followed by the b record minus its
+key, i.e. records of the concatenated format with b's first k fields dropped.
+out needs room for pairs->n records of s_a->total_size + s_b->total_size -
+byte_struct_prefix_size(s_b, k) bytes.
+*/
+bool byte_struct_merge_join_records(byte_struct_t *s_a, uint8_t *a, byte_struct_t *s_b, uint8_t *b, size_t k, byte_struct_index_pairs_t *pairs, uint8_t *out) {
+    size_t prefix_len;
+    if (pairs == NULL || (out == NULL && pairs->n > 0) || !byte_struct_merge_prefix(s_a, s_b, k, &prefix_len)) return false;
+    size_t b_rest = s_b->total_size - prefix_len;
+    size_t out_size = s_a->total_size + b_rest;
+    for (size_t p = 0; p < pairs->n; p++) {
+        uint8_t *record = out + p * out_size;
+        memcpy(record, a + pairs->a[p] * s_a->total_size, s_a->total_size);
+        memcpy(record + s_a->total_size, b + pairs->b[p] * s_b->total_size + prefix_len, b_rest);
+    }
+    return true;
+}
+
+typedef enum {
+    BYTE_STRUCT_MERGE_INTERSECT,
+    BYTE_STRUCT_MERGE_DIFFERENCE
+} byte_struct_merge_filter_t;
+
+/*
+Indices of a records whose key does (INTERSECT) or doesn't (DIFFERENCE)
+appear in b, written to indices (room for na) in order. Returns the count.
+*/
+static size_t byte_struct_merge_filter_indices(byte_struct_merge_filter_t filter, byte_struct_merge_side_t *side_a, byte_struct_merge_side_t *side_b, size_t prefix_len, size_t *indices) {
+    size_t num_out = 0;
+    size_t i = 0, j = 0;
+    while (i < side_a->n) {
+        if (j >= side_b->n) {
+            if (filter == BYTE_STRUCT_MERGE_INTERSECT) break;
+            for (; i < side_a->n; i++) indices[num_out++] = i;
+            break;
+        }
+        uint8_t *key_a = byte_struct_merge_record(side_a, i);
+        uint8_t *key_b = byte_struct_merge_record(side_b, j);
+        int cmp = memcmp(key_a, key_b, prefix_len);
+        if (cmp < 0) {
+            size_t next = byte_struct_merge_seek(side_a, i + 1, key_b, prefix_len, false);
+            if (filter == BYTE_STRUCT_MERGE_DIFFERENCE) {
+                for (; i < next; i++) indices[num_out++] = i;
+            }
+            i = next;
+        } else if (cmp > 0) {
+            j = byte_struct_merge_seek(side_b, j + 1, key_a, prefix_len, false);
+        } else {
+            size_t end_a = byte_struct_merge_seek(side_a, i + 1, key_a, prefix_len, true);
+            if (filter == BYTE_STRUCT_MERGE_INTERSECT) {
+                for (; i < end_a; i++) indices[num_out++] = i;
+            }
+            i = end_a;
+            j = byte_struct_merge_seek(side_b, j + 1, key_a, prefix_len, true);
+        }
+    }
+    return num_out;
+}
+
+static size_t byte_struct_merge_filter(byte_struct_merge_filter_t filter, byte_struct_t *s, uint8_t *a, size_t na, uint8_t *b, size_t nb, size_t k, size_t *indices, uint8_t *out) {
+    size_t prefix_len;
+    if (!byte_struct_merge_prefix(s, s, k, &prefix_len)) return 0;
+    if ((a == NULL && na > 0) || (b == NULL && nb > 0) || (indices == NULL && out == NULL)) return 0;
+    byte_struct_merge_side_t side_a, side_b;
+    byte_struct_merge_sides(a, na, s->total_size, b, nb, s->total_size, &side_a, &side_b);
+
+    size_t *selected = indices;
+    if (selected == NULL) {
+        selected = malloc((na > 0 ? na : 1) * sizeof(size_t));
+        if (selected == NULL) return 0;
+    }
+    size_t num_out = byte_struct_merge_filter_indices(filter, &side_a, &side_b, prefix_len, selected);
+    if (out != NULL) {
+        // Copy runs of consecutive indices with one memcpy each
+        size_t written = 0;
+        for (size_t r = 0; r < num_out;) {
+            size_t run = 1;
+            while (r + run < num_out && selected[r + run] == selected[r] + run) run++;
+            memcpy(out + written * s->total_size, a + selected[r] * s->total_size, run * s->total_size);
+            written += run;
+            r += run;
+        }
+    }
+    if (indices == NULL) free(selected);
+    return num_out;
+}
+
+/*
+Records of a whose first k fields match some record of b (a semi-join). Writes
+their indices to indices and/or the records themselves to out (either may be
+NULL, each needs room for na). Returns how many there are.
+*/
+size_t byte_struct_merge_intersect(byte_struct_t *s, uint8_t *a, size_t na, uint8_t *b, size_t nb, size_t k, size_t *indices, uint8_t *out) {
+    return byte_struct_merge_filter(BYTE_STRUCT_MERGE_INTERSECT, s, a, na, b, nb, k, indices, out);
+}
+
+// Records of a whose first k fields match no record of b (an anti-join), otherwise as byte_struct_merge_intersect
+size_t byte_struct_merge_difference(byte_struct_t *s, uint8_t *a, size_t na, uint8_t *b, size_t nb, size_t k, size_t *indices, uint8_t *out) {
+    return byte_struct_merge_filter(BYTE_STRUCT_MERGE_DIFFERENCE, s, a, na, b, nb, k, indices, out);
+}
+
+/*
+Merges a with the records of b whose key isn't in a into out (room for na + nb
+records), in key order. Returns the number of records written.
+*/
+size_t byte_struct_merge_union(byte_struct_t *s, uint8_t *a, size_t na, uint8_t *b, size_t nb, size_t k, uint8_t *out) {
+    size_t prefix_len;
+    if (out == NULL || !byte_struct_merge_prefix(s, s, k, &prefix_len)) return 0;
+    if ((a == NULL && na > 0) || (b == NULL && nb > 0)) return 0;
+    byte_struct_merge_side_t side_a, side_b;
+    byte_struct_merge_sides(a, na, s->total_size, b, nb, s->total_size, &side_a, &side_b);
+    size_t size = s->total_size;
+
+    size_t num_out = 0;
+    size_t i = 0, j = 0;
+    while (i < na && j < nb) {
+        uint8_t *key_a = a + i * size;
+        uint8_t *key_b = b + j * size;
+        int cmp = memcmp(key_a, key_b, prefix_len);
+        if (cmp < 0) {
+            size_t next = byte_struct_merge_seek(&side_a, i + 1, key_b, prefix_len, false);
+            memcpy(out + num_out * size, key_a, (next - i) * size);
+            num_out += next - i;
+            i = next;
+        } else if (cmp > 0) {
+            size_t next = byte_struct_merge_seek(&side_b, j + 1, key_a, prefix_len, false);
+            memcpy(out + num_out * size, key_b, (next - j) * size);
+            num_out += next - j;
+            j = next;
+        } else {
+            size_t end_a = byte_struct_merge_seek(&side_a, i + 1, key_a, prefix_len, true);
+            memcpy(out + num_out * size, key_a, (end_a - i) * size);
+            num_out += end_a - i;
+            i = end_a;
+            j = byte_struct_merge_seek(&side_b, j + 1, key_a, prefix_len, true);
+        }
+    }
+    if (i < na) {
+        memcpy(out + num_out * size, a + i * size, (na - i) * size);
+        num_out += na - i;
+    }
+    if (j < nb) {
+        memcpy(out + num_out * size, b + j * size, (nb - j) * size);
+        num_out += nb - j;
+    }
+    return num_out;
+}
+
+#endif
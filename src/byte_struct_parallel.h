@@ -0,0 +1,462 @@
+#ifndef BYTE_STRUCT_PARALLEL_H
+#define BYTE_STRUCT_PARALLEL_H
+
+#include <stdlib.h>
+#include <stdbool.h>
+#include <string.h>
+
+#include "byte_struct.h"
+#include "byte_struct_atomic.h"
+
+#ifdef _WIN32
+#include <windows.h>
+
+typedef HANDLE byte_struct_thread_t;
+typedef SRWLOCK byte_struct_mutex_t;
+typedef CONDITION_VARIABLE byte_struct_cond_t;
+#define BYTE_STRUCT_THREAD_RETURN DWORD WINAPI
+#define BYTE_STRUCT_THREAD_RETURN_VALUE 0
+#define BYTE_STRUCT_THREAD_LOCAL __declspec(thread)
+
+static void byte_struct_mutex_init(byte_struct_mutex_t *m) { InitializeSRWLock(m); }
+static void byte_struct_mutex_destroy(byte_struct_mutex_t *m) { (void)m; }
+static void byte_struct_mutex_lock(byte_struct_mutex_t *m) { AcquireSRWLockExclusive(m); }
+static void byte_struct_mutex_unlock(byte_struct_mutex_t *m) { ReleaseSRWLockExclusive(m); }
+static void byte_struct_cond_init(byte_struct_cond_t *c) { InitializeConditionVariable(c); }
+static void byte_struct_cond_destroy(byte_struct_cond_t *c) { (void)c; }
+static void byte_struct_cond_wait(byte_struct_cond_t *c, byte_struct_mutex_t *m) { SleepConditionVariableSRW(c, m, INFINITE, 0); }
+static void byte_struct_cond_signal(byte_struct_cond_t *c) { WakeConditionVariable(c); }
+static void byte_struct_cond_broadcast(byte_struct_cond_t *c) { WakeAllConditionVariable(c); }
+
+static bool byte_struct_thread_create(byte_struct_thread_t *t, DWORD (WINAPI *fn)(void *), void *arg) {
+    *t = CreateThread(NULL, 0, fn, arg, 0, NULL);
+    return *t != NULL;
+}
+
+static void byte_struct_thread_join(byte_struct_thread_t t) {
+    WaitForSingleObject(t, INFINITE);
+    CloseHandle(t);
+}
+
+static size_t byte_struct_num_cpus(void) {
+    SYSTEM_INFO info;
+    GetSystemInfo(&info);
+    return info.dwNumberOfProcessors > 0 ? (size_t)info.dwNumberOfProcessors : 1;
+}
+
+#else
+#include <pthread.h>
+#include <unistd.h>
+
+typedef pthread_t byte_struct_thread_t;
+typedef pthread_mutex_t byte_struct_mutex_t;
+typedef pthread_cond_t byte_struct_cond_t;
+#define BYTE_STRUCT_THREAD_RETURN void *
+#define BYTE_STRUCT_THREAD_RETURN_VALUE NULL
+#if defined(__STDC_VERSION__) && __STDC_VERSION__ >= 201112L
+#define BYTE_STRUCT_THREAD_LOCAL _Thread_local
+#else
+#define BYTE_STRUCT_THREAD_LOCAL __thread
+#endif
+
+static void byte_struct_mutex_init(byte_struct_mutex_t *m) { pthread_mutex_init(m, NULL); }
+static void byte_struct_mutex_destroy(byte_struct_mutex_t *m) { pthread_mutex_destroy(m); }
+static void byte_struct_mutex_lock(byte_struct_mutex_t *m) { pthread_mutex_lock(m); }
+static void byte_struct_mutex_unlock(byte_struct_mutex_t *m) { pthread_mutex_unlock(m); }
+static void byte_struct_cond_init(byte_struct_cond_t *c) { pthread_cond_init(c, NULL); }
+static void byte_struct_cond_destroy(byte_struct_cond_t *c) { pthread_cond_destroy(c); }
+static void byte_struct_cond_wait(byte_struct_cond_t *c, byte_struct_mutex_t *m) { pthread_cond_wait(c, m); }
+static void byte_struct_cond_signal(byte_struct_cond_t *c) { pthread_cond_signal(c); }
+static void byte_struct_cond_broadcast(byte_struct_cond_t *c) { pthread_cond_broadcast(c); }
+
+static bool byte_struct_thread_create(byte_struct_thread_t *t, void *(*fn)(void *), void *arg) {
+    return pthread_create(t, NULL, fn, arg) == 0;
+}
+
+static void byte_struct_thread_join(byte_struct_thread_t t) {
+    pthread_join(t, NULL);
+}
+
+static size_t byte_struct_num_cpus(void) {
+#ifdef _SC_NPROCESSORS_ONLN
+    long n = sysconf(_SC_NPROCESSORS_ONLN);
+    return n > 0 ? (size_t)n : 1;
+#else
+    return 1;
+#endif
+}
+#endif
+
+// Called with a half-open range of record indices [start, end)
+typedef void (*byte_struct_parallel_fn)(void *arg, size_t start, size_t end);
+
+/*
+Each thread owns one contiguous range of the input so the pages it touches first
+stay local to it (first-touch NUMA placement), and claims grains from the front
+of that range. Once its own range is drained it steals grains from the other
+threads' ranges, so uneven chunks still balance out.
+*/
+typedef struct byte_struct_parallel_range {
+    volatile uint64_t next;
+    uint64_t end;
+    uint8_t padding[BYTE_STRUCT_CACHE_LINE_SIZE - 2 * sizeof(uint64_t)];
+} byte_struct_parallel_range_t;
+
+struct byte_struct_thread_pool;
+
+typedef struct byte_struct_thread_pool_worker {
+    struct byte_struct_thread_pool *pool;
+    size_t id;
+} byte_struct_thread_pool_worker_t;
+
+typedef struct byte_struct_thread_pool {
+    size_t num_threads;
+    byte_struct_thread_t *threads;
+    byte_struct_thread_pool_worker_t *workers;
+    uint8_t *ranges_mem;
+    byte_struct_parallel_range_t *ranges;
+    byte_struct_mutex_t submit_lock;
+    byte_struct_mutex_t lock;
+    byte_struct_cond_t work_cond;
+    byte_struct_cond_t done_cond;
+    uint64_t generation;
+    size_t active;
+    bool shutdown;
+    byte_struct_parallel_fn fn;
+    void *arg;
+    size_t grain;
+} byte_struct_thread_pool_t;
+
+// Number of pool tasks running on this thread, see byte_struct_thread_pool_for
+static BYTE_STRUCT_THREAD_LOCAL size_t byte_struct_thread_pool_depth = 0;
+
+static void byte_struct_thread_pool_work(byte_struct_thread_pool_t *pool, size_t id) {
+    byte_struct_thread_pool_depth++;
+    size_t num_threads = pool->num_threads;
+    size_t grain = pool->grain;
+    for (size_t k = 0; k < num_threads; k++) {
+        byte_struct_parallel_range_t *range = &pool->ranges[(id + k) % num_threads];
+        while (true) {
+            uint64_t start = byte_struct_atomic_fetch_add(&range->next, grain);
+            if (start >= range->end) break;
+            uint64_t end = range->end - start < grain ? range->end : start + grain;
+            pool->fn(pool->arg, (size_t)start, (size_t)end);
+        }
+    }
+    byte_struct_thread_pool_depth--;
+}
+
+static BYTE_STRUCT_THREAD_RETURN byte_struct_thread_pool_worker_main(void *arg) {
+    byte_struct_thread_pool_worker_t *worker = arg;
+    byte_struct_thread_pool_t *pool = worker->pool;
+    uint64_t seen = 0;
+
+    byte_struct_mutex_lock(&pool->lock);
+    while (true) {
+        while (!pool->shutdown && pool->generation == seen) {
+            byte_struct_cond_wait(&pool->work_cond, &pool->lock);
+        }
+        if (pool->shutdown) break;
+        seen = pool->generation;
+        byte_struct_mutex_unlock(&pool->lock);
+
+        byte_struct_thread_pool_work(pool, worker->id);
+
+        byte_struct_mutex_lock(&pool->lock);
+        if (--pool->active == 0) {
+            byte_struct_cond_signal(&pool->done_cond);
+        }
+    }
+    byte_struct_mutex_unlock(&pool->lock);
+    return BYTE_STRUCT_THREAD_RETURN_VALUE;
+}
+
+void byte_struct_thread_pool_destroy(byte_struct_thread_pool_t *pool);
+
+// num_threads includes the calling thread, 0 means one per online CPU
+byte_struct_thread_pool_t *byte_struct_thread_pool_new(size_t num_threads) {
+    if (num_threads == 0) num_threads = byte_struct_num_cpus();
+
+    byte_struct_thread_pool_t *pool = calloc(1, sizeof(byte_struct_thread_pool_t));
+    if (pool == NULL) return NULL;
+
+    pool->ranges_mem = malloc((num_threads + 1) * sizeof(byte_struct_parallel_range_t));
+    pool->threads = malloc(num_threads * sizeof(byte_struct_thread_t));
+    pool->workers = malloc(num_threads * sizeof(byte_struct_thread_pool_worker_t));
+    if (pool->ranges_mem == NULL || pool->threads == NULL || pool->workers == NULL) {
+        free(pool->ranges_mem);
+        free(pool->threads);
+        free(pool->workers);
+        free(pool);
+        return NULL;
+    }
+    uintptr_t aligned = ((uintptr_t)pool->ranges_mem + BYTE_STRUCT_CACHE_LINE_SIZE - 1) & ~(uintptr_t)(BYTE_STRUCT_CACHE_LINE_SIZE - 1);
+    pool->ranges = (byte_struct_parallel_range_t *)aligned;
+
+    byte_struct_mutex_init(&pool->submit_lock);
+    byte_struct_mutex_init(&pool->lock);
+    byte_struct_cond_init(&pool->work_cond);
+    byte_struct_cond_init(&pool->done_cond);
+
+    // Thread 0 is the caller, which works alongside the pool
+    pool->num_threads = 1;
+    for (size_t i = 1; i < num_threads; i++) {
+        pool->workers[i] = (byte_struct_thread_pool_worker_t){.pool = pool, .id = i};
+        if (!byte_struct_thread_create(&pool->threads[i], byte_struct_thread_pool_worker_main, &pool->workers[i])) {
+            break;
+        }
+        pool->num_threads++;
+    }
+    return pool;
+}
+
+size_t byte_struct_thread_pool_size(byte_struct_thread_pool_t *pool) {
+    return pool == NULL ? 1 : pool->num_threads;
+}
+
+/*
+Runs fn over [0, n) in chunks of grain records. A NULL pool (or a pool with
+one thread) runs everything on the calling thread, and so does a call made
+from inside a pool task (e.g. a worker starting a parallel sort), which would
+otherwise wait on the pool it is running in.
+*/
+bool byte_struct_thread_pool_for(byte_struct_thread_pool_t *pool, size_t n, size_t grain, byte_struct_parallel_fn fn, void *arg) {
+    if (fn == NULL) return false;
+    if (n == 0) return true;
+    if (grain == 0) grain = 1;
+    if (pool == NULL || pool->num_threads <= 1 || n <= grain || byte_struct_thread_pool_depth > 0) {
+        fn(arg, 0, n);
+        return true;
+    }
+
+    byte_struct_mutex_lock(&pool->submit_lock);
+
+    size_t num_threads = pool->num_threads;
+    size_t num_chunks = n / grain + (n % grain != 0);
+    for (size_t t = 0; t < num_threads; t++) {
+        uint64_t start = (uint64_t)(num_chunks * t / num_threads) * grain;
+        uint64_t end = (uint64_t)(num_chunks * (t + 1) / num_threads) * grain;
+        if (start > n) start = n;
+        if (end > n) end = n;
+        pool->ranges[t].next = start;
+        pool->ranges[t].end = end;
+    }
+
+    byte_struct_mutex_lock(&pool->lock);
+    pool->fn = fn;
+    pool->arg = arg;
+    pool->grain = grain;
+    pool->active = num_threads - 1;
+    pool->generation++;
+    byte_struct_cond_broadcast(&pool->work_cond);
+    byte_struct_mutex_unlock(&pool->lock);
+
+    byte_struct_thread_pool_work(pool, 0);
+
+    byte_struct_mutex_lock(&pool->lock);
+    while (pool->active > 0) {
+        byte_struct_cond_wait(&pool->done_cond, &pool->lock);
+    }
+    byte_struct_mutex_unlock(&pool->lock);
+
+    byte_struct_mutex_unlock(&pool->submit_lock);
+    return true;
+}
+
+void byte_struct_thread_pool_destroy(byte_struct_thread_pool_t *pool) {
+    if (pool == NULL) return;
+    byte_struct_mutex_lock(&pool->lock);
+    pool->shutdown = true;
+    byte_struct_cond_broadcast(&pool->work_cond);
+    byte_struct_mutex_unlock(&pool->lock);
+
+    for (size_t i = 1; i < pool->num_threads; i++) {
+        byte_struct_thread_join(pool->threads[i]);
+    }
+
+    byte_struct_cond_destroy(&pool->done_cond);
+    byte_struct_cond_destroy(&pool->work_cond);
+    byte_struct_mutex_destroy(&pool->lock);
+    byte_struct_mutex_destroy(&pool->submit_lock);
+    free(pool->ranges_mem);
+    free(pool->threads);
+    free(pool->workers);
+    free(pool);
+}
+
+#define BYTE_STRUCT_PARALLEL_DEFAULT_CHUNK_BYTES (64 * 1024)
+
+/*
+Default grain is ~64KB of records. Grains are rounded so that chunk boundaries
+fall on cache line boundaries of a cache-line-aligned buffer, so two threads
+never write the same line.
+*/
+size_t byte_struct_parallel_grain(byte_struct_t *s, size_t grain) {
+    size_t total_size = (s == NULL || s->total_size == 0) ? 1 : s->total_size;
+    if (grain == 0) {
+        grain = BYTE_STRUCT_PARALLEL_DEFAULT_CHUNK_BYTES / total_size;
+        if (grain == 0) grain = 1;
+    }
+    size_t a = total_size, b = BYTE_STRUCT_CACHE_LINE_SIZE;
+    while (b != 0) {
+        size_t r = a % b;
+        a = b;
+        b = r;
+    }
+    size_t line_records = BYTE_STRUCT_CACHE_LINE_SIZE / a;
+    if (grain % line_records != 0 && grain <= SIZE_MAX - line_records) {
+        grain += line_records - grain % line_records;
+    }
+    return grain;
+}
+
+typedef struct byte_struct_parallel_batch_arg {
+    byte_struct_t *s;
+    uint8_t *data;
+    void **columns;
+} byte_struct_parallel_batch_arg_t;
+
+static void byte_struct_parallel_pack_batch_fn(void *arg, size_t start, size_t end) {
+    byte_struct_parallel_batch_arg_t *batch = arg;
+    byte_struct_pack_batch_range(batch->s, batch->data, start, end, batch->columns);
+}
+
+static void byte_struct_parallel_unpack_batch_fn(void *arg, size_t start, size_t end) {
+    byte_struct_parallel_batch_arg_t *batch = arg;
+    byte_struct_unpack_batch_range(batch->s, batch->data, start, end, batch->columns);
+}
+
+bool byte_struct_pack_batch_parallel(byte_struct_thread_pool_t *pool, byte_struct_t *s, uint8_t *data, size_t n, void **columns, size_t grain) {
+    BYTE_STRUCT_STATS_ADD(pack_calls, 1);
+    if (!byte_struct_batch_valid(s, data, columns)) return false;
+    byte_struct_parallel_batch_arg_t arg = {.s = s, .data = data, .columns = columns};
+    return byte_struct_thread_pool_for(pool, n, byte_struct_parallel_grain(s, grain), byte_struct_parallel_pack_batch_fn, &arg);
+}
+
+bool byte_struct_unpack_batch_parallel(byte_struct_thread_pool_t *pool, byte_struct_t *s, uint8_t *data, size_t n, void **columns, size_t grain) {
+    BYTE_STRUCT_STATS_ADD(unpack_calls, 1);
+    if (!byte_struct_batch_valid(s, data, columns)) return false;
+    byte_struct_parallel_batch_arg_t arg = {.s = s, .data = data, .columns = columns};
+    return byte_struct_thread_pool_for(pool, n, byte_struct_parallel_grain(s, grain), byte_struct_parallel_unpack_batch_fn, &arg);
+}
+
+typedef struct byte_struct_parallel_convert_arg {
+    byte_struct_t *s;
+    uint8_t *src;
+    uint8_t *dst;
+    byte_order_t byte_order;
+} byte_struct_parallel_convert_arg_t;
+
+static void byte_struct_parallel_convert_fn(void *arg, size_t start, size_t end) {
+    byte_struct_parallel_convert_arg_t *convert = arg;
+    byte_struct_convert_range(convert->s, convert->src, start, end, convert->byte_order, convert->dst);
+}
+
+bool byte_struct_convert_parallel(byte_struct_thread_pool_t *pool, byte_struct_t *s, uint8_t *src, size_t n, byte_order_t byte_order, uint8_t *dst, size_t grain) {
+    if (s == NULL || s->num_fields == 0) return false;
+    if (src == NULL || dst == NULL) return false;
+    if (s->byte_order == byte_order && src == dst) return true;
+    byte_struct_parallel_convert_arg_t arg = {.s = s, .src = src, .dst = dst, .byte_order = byte_order};
+    return byte_struct_thread_pool_for(pool, n, byte_struct_parallel_grain(s, grain), byte_struct_parallel_convert_fn, &arg);
+}
+
+/*
+Merge path split: the number of records taken from a when the first d records
+of merge(a, b) have been written. Ties go to a, matching byte_struct_merge_records.
+*/
+static size_t byte_struct_merge_path_split(uint8_t *a, size_t na, uint8_t *b, size_t nb, size_t d, size_t size) {
+    size_t lo = d > nb ? d - nb : 0;
+    size_t hi = d < na ? d : na;
+    while (lo < hi) {
+        size_t i = lo + (hi - lo) / 2;
+        size_t j = d - i;
+        if (j > 0 && memcmp(b + (j - 1) * size, a + i * size, size) >= 0) {
+            lo = i + 1;
+        } else {
+            hi = i;
+        }
+    }
+    return lo;
+}
+
+typedef struct byte_struct_parallel_sort_arg {
+    uint8_t *src;
+    uint8_t *dst;
+    size_t n;
+    size_t size;
+    size_t run_records;
+    size_t pieces;
+} byte_struct_parallel_sort_arg_t;
+
+static void byte_struct_parallel_sort_runs_fn(void *arg, size_t start, size_t end) {
+    byte_struct_parallel_sort_arg_t *sort = arg;
+    for (size_t run = start; run < end; run++) {
+        size_t first = run * sort->run_records;
+        if (first >= sort->n) continue;
+        size_t m = sort->n - first < sort->run_records ? sort->n - first : sort->run_records;
+        byte_struct_sort_records(sort->src + first * sort->size, m, sort->size, sort->dst + first * sort->size);
+    }
+}
+
+// Each task merges one slice of one pair of runs, so the last rounds still use every thread
+static void byte_struct_parallel_merge_runs_fn(void *arg, size_t start, size_t end) {
+    byte_struct_parallel_sort_arg_t *sort = arg;
+    size_t size = sort->size;
+    for (size_t task = start; task < end; task++) {
+        size_t pair = task / sort->pieces;
+        size_t piece = task % sort->pieces;
+        size_t first = pair * 2 * sort->run_records;
+        if (first >= sort->n) continue;
+        size_t na = sort->n - first < sort->run_records ? sort->n - first : sort->run_records;
+        size_t nb = sort->n - first - na < sort->run_records ? sort->n - first - na : sort->run_records;
+        uint8_t *a = sort->src + first * size;
+        uint8_t *b = a + na * size;
+        size_t total = na + nb;
+        size_t d0 = total * piece / sort->pieces;
+        size_t d1 = total * (piece + 1) / sort->pieces;
+        size_t i0 = byte_struct_merge_path_split(a, na, b, nb, d0, size);
+        size_t i1 = byte_struct_merge_path_split(a, na, b, nb, d1, size);
+        byte_struct_merge_records(a + i0 * size, i1 - i0, b + (d0 - i0) * size, (d1 - i1) - (d0 - i0), sort->dst + (first + d0) * size, size);
+    }
+}
+
+bool byte_struct_sort_parallel(byte_struct_thread_pool_t *pool, byte_struct_t *s, uint8_t *data, size_t n) {
+    if (s == NULL || s->total_size == 0 || data == NULL) return false;
+    size_t num_threads = byte_struct_thread_pool_size(pool);
+    if (num_threads <= 1 || n < num_threads * BYTE_STRUCT_SORT_INSERTION_THRESHOLD) {
+        return byte_struct_sort(s, data, n);
+    }
+
+    size_t size = s->total_size;
+    uint8_t *tmp = malloc(n * size);
+    if (tmp == NULL) return false;
+
+    byte_struct_parallel_sort_arg_t arg = {
+        .src = data,
+        .dst = tmp,
+        .n = n,
+        .size = size,
+        .run_records = n / num_threads + (n % num_threads != 0),
+        .pieces = 1
+    };
+    byte_struct_thread_pool_for(pool, num_threads, 1, byte_struct_parallel_sort_runs_fn, &arg);
+
+    uint8_t *src = data;
+    uint8_t *dst = tmp;
+    for (size_t run_records = arg.run_records; run_records < n; run_records *= 2) {
+        size_t num_pairs = n / (2 * run_records) + (n % (2 * run_records) != 0);
+        arg.src = src;
+        arg.dst = dst;
+        arg.run_records = run_records;
+        arg.pieces = num_threads / num_pairs > 0 ? num_threads / num_pairs : 1;
+        byte_struct_thread_pool_for(pool, num_pairs * arg.pieces, 1, byte_struct_parallel_merge_runs_fn, &arg);
+        uint8_t *swap = src;
+        src = dst;
+        dst = swap;
+    }
+    if (src != data) memcpy(data, src, n * size);
+    free(tmp);
+    return true;
+}
+
+#endif
@@ -0,0 +1,280 @@
+#ifndef BYTE_STRUCT_PARTITION_H
+#define BYTE_STRUCT_PARTITION_H
+
+#include <stdint.h>
+#include <stdlib.h>
+#include <stdbool.h>
+#include <string.h>
+
+#include "byte_struct.h"
+#include "byte_struct_hash.h"
+#include "byte_struct_parallel.h"
+
+/*
+Partitions a record buffer into 2^bits contiguous regions by the first k fields
+of each record, e.g. to hand one region per worker to a join or aggregation.
+
+- HASH partitions by the top bits of byte_struct_hash_bytes of the key bytes.
+- RADIX partitions by the leading bits of the key bytes themselves, so with
+  BYTE_STRUCT_SORTABLE every key in partition p sorts before every key in
+  partition p + 1. Keys whose leading bytes rarely vary (small integers in
+  wide fields) land in few partitions; hash them instead.
+
+Each pass builds per-chunk histograms in parallel, prefix-sums them into write
+cursors and scatters in parallel. The scatter stages records in a small software
+write-combining buffer per partition and copies out whole buffers, so the
+stores go out in cache line sized runs instead of one scattered record at a
+time. Beyond BYTE_STRUCT_PARTITION_PASS_BITS partitions the TLB and cache can't
+keep every output region's write position hot, so the partition runs in two
+passes: the top half of the bits first, then each first-level partition on its
+own by the rest. The output is stable: records keep their input order within a
+partition.
+*/
+
+typedef enum {
+    BYTE_STRUCT_PARTITION_HASH,
+    BYTE_STRUCT_PARTITION_RADIX
+} byte_struct_partition_mode_t;
+
+#define BYTE_STRUCT_PARTITION_MAX_BITS 16
+// Fan-out of a single pass, 256 partitions
+#define BYTE_STRUCT_PARTITION_PASS_BITS 8
+// Write-combining buffer per partition
+#define BYTE_STRUCT_PARTITION_BUFFER_SIZE (4 * BYTE_STRUCT_CACHE_LINE_SIZE)
+// Fewest records per histogram chunk, and chunks per thread
+#define BYTE_STRUCT_PARTITION_MIN_CHUNK 4096
+#define BYTE_STRUCT_PARTITION_CHUNKS_PER_THREAD 4
+#define BYTE_STRUCT_PARTITION_SEED 0x7061727469746e6full
+
+typedef struct byte_struct_partition_pass {
+    size_t record_size;
+    size_t key_len;
+    byte_struct_partition_mode_t mode;
+    // bits consumed by earlier passes, and bits of this pass
+    size_t shift;
+    size_t bits;
+    uint8_t *src;
+    uint8_t *dst;
+    size_t n;
+    size_t chunk_records;
+    // num_chunks x fanout counts, turned into write cursors by the prefix sum
+    size_t *histograms;
+    // second pass: first-level offsets, and the final offsets to fill in
+    size_t *first_offsets;
+    size_t *offsets;
+} byte_struct_partition_pass_t;
+
+static inline uint64_t byte_struct_partition_key_bits(uint8_t *record, size_t key_len, byte_struct_partition_mode_t mode) {
+    if (mode == BYTE_STRUCT_PARTITION_HASH) {
+        return byte_struct_hash_bytes(record, key_len, BYTE_STRUCT_PARTITION_SEED);
+    }
+    // Leading key bytes, big-endian, zero padded
+    uint64_t v = 0;
+    size_t m = key_len < sizeof(uint64_t) ? key_len : sizeof(uint64_t);
+    for (size_t i = 0; i < m; i++) {
+        v = (v << 8) | record[i];
+    }
+    return m == sizeof(uint64_t) ? v : v << (8 * (sizeof(uint64_t) - m));
+}
+
+static inline size_t byte_struct_partition_digit(byte_struct_partition_pass_t *pass, uint8_t *record) {
+    uint64_t v = byte_struct_partition_key_bits(record, pass->key_len, pass->mode);
+    return (size_t)((v << pass->shift) >> (64 - pass->bits));
+}
+
+static void byte_struct_partition_count(byte_struct_partition_pass_t *pass, uint8_t *src, size_t count, size_t *histogram) {
+    size_t fanout = (size_t)1 << pass->bits;
+    memset(histogram, 0, fanout * sizeof(size_t));
+    for (size_t i = 0; i < count; i++) {
+        histogram[byte_struct_partition_digit(pass, src + i * pass->record_size)]++;
+    }
+}
+
+/*
+Moves count records from src to dst[cursors[digit]...], advancing the cursors.
+Records too large to batch in a write-combining buffer are copied directly.
+*/
+static void byte_struct_partition_scatter(byte_struct_partition_pass_t *pass, uint8_t *src, size_t count, size_t *cursors) {
+    size_t fanout = (size_t)1 << pass->bits;
+    size_t size = pass->record_size;
+    size_t buffer_records = BYTE_STRUCT_PARTITION_BUFFER_SIZE / size;
+    uint8_t *buffers = NULL;
+    size_t *fill = NULL;
+    if (buffer_records > 1) {
+        buffers = malloc(fanout * buffer_records * size);
+        fill = calloc(fanout, sizeof(size_t));
+    }
+    if (buffers == NULL || fill == NULL) {
+        for (size_t i = 0; i < count; i++) {
+            uint8_t *record = src + i * size;
+            size_t d = byte_struct_partition_digit(pass, record);
+            memcpy(pass->dst + cursors[d]++ * size, record, size);
+        }
+        free(buffers);
+        free(fill);
+        return;
+    }
+    for (size_t i = 0; i < count; i++) {
+        uint8_t *record = src + i * size;
+        size_t d = byte_struct_partition_digit(pass, record);
+        uint8_t *buffer = buffers + d * buffer_records * size;
+        memcpy(buffer + fill[d] * size, record, size);
+        if (++fill[d] == buffer_records) {
+            memcpy(pass->dst + cursors[d] * size, buffer, buffer_records * size);
+            cursors[d] += buffer_records;
+            fill[d] = 0;
+        }
+    }
+    for (size_t d = 0; d < fanout; d++) {
+        memcpy(pass->dst + cursors[d] * size, buffers + d * buffer_records * size, fill[d] * size);
+        cursors[d] += fill[d];
+    }
+    free(buffers);
+    free(fill);
+}
+
+static void byte_struct_partition_chunk(byte_struct_partition_pass_t *pass, size_t c, size_t *start, size_t *count) {
+    *start = c * pass->chunk_records;
+    *count = pass->n - *start < pass->chunk_records ? pass->n - *start : pass->chunk_records;
+}
+
+static void byte_struct_partition_count_fn(void *arg, size_t start, size_t end) {
+    byte_struct_partition_pass_t *pass = arg;
+    size_t fanout = (size_t)1 << pass->bits;
+    for (size_t c = start; c < end; c++) {
+        size_t first, count;
+        byte_struct_partition_chunk(pass, c, &first, &count);
+        byte_struct_partition_count(pass, pass->src + first * pass->record_size, count, pass->histograms + c * fanout);
+    }
+}
+
+static void byte_struct_partition_scatter_fn(void *arg, size_t start, size_t end) {
+    byte_struct_partition_pass_t *pass = arg;
+    size_t fanout = (size_t)1 << pass->bits;
+    for (size_t c = start; c < end; c++) {
+        size_t first, count;
+        byte_struct_partition_chunk(pass, c, &first, &count);
+        byte_struct_partition_scatter(pass, pass->src + first * pass->record_size, count, pass->histograms + c * fanout);
+    }
+}
+
+// Second pass: each first-level partition is partitioned on its own, in place in dst's range
+static void byte_struct_partition_second_fn(void *arg, size_t start, size_t end) {
+    byte_struct_partition_pass_t *pass = arg;
+    size_t fanout = (size_t)1 << pass->bits;
+    size_t *cursors = malloc(fanout * sizeof(size_t));
+    for (size_t p = start; p < end; p++) {
+        size_t first = pass->first_offsets[p];
+        size_t count = pass->first_offsets[p + 1] - first;
+        size_t *offsets = pass->offsets + p * fanout;
+        if (cursors == NULL || count == 0) {
+            // Allocation failures are reported by the caller through offsets[0]
+            for (size_t d = 0; d < fanout; d++) offsets[d] = cursors == NULL ? SIZE_MAX : first;
+            continue;
+        }
+        byte_struct_partition_count(pass, pass->src + first * pass->record_size, count, cursors);
+        size_t running = first;
+        for (size_t d = 0; d < fanout; d++) {
+            size_t c = cursors[d];
+            cursors[d] = running;
+            offsets[d] = running;
+            running += c;
+        }
+        byte_struct_partition_scatter(pass, pass->src + first * pass->record_size, count, cursors);
+    }
+    free(cursors);
+}
+
+// One parallel pass of src into dst, offsets[0..fanout] receiving the region bounds
+static bool byte_struct_partition_pass(byte_struct_thread_pool_t *pool, byte_struct_partition_pass_t *pass, size_t *offsets) {
+    size_t fanout = (size_t)1 << pass->bits;
+    size_t max_chunks = byte_struct_thread_pool_size(pool) * BYTE_STRUCT_PARTITION_CHUNKS_PER_THREAD;
+    size_t num_chunks = pass->n / BYTE_STRUCT_PARTITION_MIN_CHUNK + 1;
+    if (num_chunks > max_chunks) num_chunks = max_chunks;
+    pass->chunk_records = pass->n / num_chunks + (pass->n % num_chunks != 0);
+    if (pass->chunk_records == 0) pass->chunk_records = 1;
+    pass->histograms = malloc(num_chunks * fanout * sizeof(size_t));
+    if (pass->histograms == NULL) return false;
+
+    byte_struct_thread_pool_for(pool, num_chunks, 1, byte_struct_partition_count_fn, pass);
+    // Partition-major prefix sum, so chunk c writes after chunks < c in every partition
+    size_t running = 0;
+    for (size_t d = 0; d < fanout; d++) {
+        offsets[d] = running;
+        for (size_t c = 0; c < num_chunks; c++) {
+            size_t count = pass->histograms[c * fanout + d];
+            pass->histograms[c * fanout + d] = running;
+            running += count;
+        }
+    }
+    offsets[fanout] = running;
+    byte_struct_thread_pool_for(pool, num_chunks, 1, byte_struct_partition_scatter_fn, pass);
+    free(pass->histograms);
+    pass->histograms = NULL;
+    return true;
+}
+
+// Partition of one record (or packed key), for routing probes to the matching region
+size_t byte_struct_partition_of(byte_struct_t *s, uint8_t *record, size_t prefix_fields, byte_struct_partition_mode_t mode, size_t bits) {
+    if (s == NULL || record == NULL || bits == 0 || bits > BYTE_STRUCT_PARTITION_MAX_BITS) return 0;
+    if (prefix_fields == 0 || prefix_fields > s->num_fields) return 0;
+    byte_struct_partition_pass_t pass = {.key_len = byte_struct_prefix_size(s, prefix_fields), .mode = mode, .bits = bits};
+    return byte_struct_partition_digit(&pass, record);
+}
+
+/*
+Writes the n records of data to out (n records, not overlapping data) grouped
+into 2^bits partitions by their first prefix_fields fields. Partition p is
+records [offsets[p], offsets[p + 1]) of out; offsets has 2^bits + 1 entries.
+*/
+bool byte_struct_partition(byte_struct_thread_pool_t *pool, byte_struct_t *s, uint8_t *data, size_t n, size_t prefix_fields, byte_struct_partition_mode_t mode, size_t bits, uint8_t *out, size_t *offsets) {
+    if (s == NULL || s->num_fields == 0 || out == NULL || offsets == NULL) return false;
+    if (data == NULL && n > 0) return false;
+    if (prefix_fields == 0 || prefix_fields > s->num_fields) return false;
+    if (mode != BYTE_STRUCT_PARTITION_HASH && mode != BYTE_STRUCT_PARTITION_RADIX) return false;
+    if (bits == 0 || bits > BYTE_STRUCT_PARTITION_MAX_BITS) return false;
+
+    byte_struct_partition_pass_t pass = {
+        .record_size = s->total_size,
+        .key_len = byte_struct_prefix_size(s, prefix_fields),
+        .mode = mode,
+        .n = n,
+    };
+    if (bits <= BYTE_STRUCT_PARTITION_PASS_BITS) {
+        pass.bits = bits;
+        pass.src = data;
+        pass.dst = out;
+        return byte_struct_partition_pass(pool, &pass, offsets);
+    }
+
+    size_t first_bits = (bits + 1) / 2;
+    size_t first_fanout = (size_t)1 << first_bits;
+    size_t *first_offsets = malloc((first_fanout + 1) * sizeof(size_t));
+    uint8_t *scratch = malloc(n == 0 ? 1 : n * s->total_size);
+    bool ok = first_offsets != NULL && scratch != NULL;
+    if (ok) {
+        pass.bits = first_bits;
+        pass.src = data;
+        pass.dst = scratch;
+        ok = byte_struct_partition_pass(pool, &pass, first_offsets);
+    }
+    if (ok) {
+        pass.shift = first_bits;
+        pass.bits = bits - first_bits;
+        pass.src = scratch;
+        pass.dst = out;
+        pass.first_offsets = first_offsets;
+        pass.offsets = offsets;
+        byte_struct_thread_pool_for(pool, first_fanout, 1, byte_struct_partition_second_fn, &pass);
+        size_t num_partitions = (size_t)1 << bits;
+        offsets[num_partitions] = n;
+        for (size_t p = 0; p < num_partitions && ok; p++) {
+            ok = offsets[p] != SIZE_MAX;
+        }
+    }
+    free(scratch);
+    free(first_offsets);
+    return ok;
+}
+
+#endif
@@ -0,0 +1,112 @@
+#ifndef BYTE_STRUCT_RELPTR_H
+#define BYTE_STRUCT_RELPTR_H
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#include "byte_struct.h"
+
+/*
+References between records of a pool that survive the pool being written to a
+file, mapped at another address or shared with another process.
+
+'r' fields are self-relative: pack takes a pointer and stores its distance from
+the field, unpack turns it back into a pointer at the field's current address.
+Pools can also reference by offset from the pool base in an int64 ('l') or
+uint64 ('L') field, which stays valid when single records are copied between
+pools and is what external indexes usually want to store.
+
+The helpers below read or write one reference in place without touching the
+rest of the record. field is s->type_offsets[i] or the result of
+byte_struct_field_path; for array fields the first element is used. The pool
+variants take the size of the referenced records and check that the whole
+target lies in [base, base + size), so a corrupt or hostile file can't send a
+traversal outside the mapping.
+*/
+
+// Stored in base-relative fields for NULL, no valid offset from base is negative
+#define BYTE_STRUCT_POOL_NULL_OFFSET (-1)
+
+static bool byte_struct_relptr_field_valid(byte_struct_t *s, uint8_t *record, type_offset_t *field) {
+    return s != NULL && record != NULL && field != NULL && field->type == BYTE_STRUCT_TYPE_RELPTR;
+}
+
+static bool byte_struct_pool_field_valid(byte_struct_t *s, uint8_t *record, type_offset_t *field) {
+    if (s == NULL || record == NULL || field == NULL) return false;
+    return field->type == BYTE_STRUCT_TYPE_RELPTR || field->type == BYTE_STRUCT_TYPE_INT64 || field->type == BYTE_STRUCT_TYPE_UINT64;
+}
+
+void *byte_struct_relptr_resolve(byte_struct_t *s, uint8_t *record, type_offset_t *field) {
+    if (!byte_struct_relptr_field_valid(s, record, field)) return NULL;
+    type_offset_t element = *field;
+    element.count = 1;
+    void *target = NULL;
+    byte_struct_unpack_field(s, &element, record, &target);
+    return target;
+}
+
+bool byte_struct_relptr_assign(byte_struct_t *s, uint8_t *record, type_offset_t *field, void *target) {
+    if (!byte_struct_relptr_field_valid(s, record, field)) return false;
+    type_offset_t element = *field;
+    element.count = 1;
+    byte_struct_pack_field(s, &element, record, &target);
+    return true;
+}
+
+// Whether target_size bytes at address fit in the pool
+static inline bool byte_struct_pool_contains(uint8_t *base, size_t size, size_t target_size, uintptr_t address) {
+    return address - (uintptr_t)base <= size - target_size;
+}
+
+/*
+Resolves a reference stored in a pool of size bytes at base to a record of
+target_size bytes. Returns false if the field can't hold a reference or any
+part of the target lies outside the pool, otherwise *target is the referenced
+address or NULL.
+*/
+bool byte_struct_pool_resolve(byte_struct_t *s, uint8_t *base, size_t size, size_t target_size, uint8_t *record, type_offset_t *field, void **target) {
+    if (!byte_struct_pool_field_valid(s, record, field) || base == NULL || target == NULL) return false;
+    if (target_size == 0 || target_size > size) return false;
+    type_offset_t element = *field;
+    element.count = 1;
+    // Read the stored offset itself so nothing out of range becomes a pointer
+    if (element.type == BYTE_STRUCT_TYPE_RELPTR) element.type = BYTE_STRUCT_TYPE_INT64;
+    int64_t offset = 0;
+    byte_struct_unpack_field(s, &element, record, &offset);
+
+    uintptr_t address;
+    if (field->type == BYTE_STRUCT_TYPE_RELPTR) {
+        if (offset == BYTE_STRUCT_RELPTR_NULL_OFFSET) {
+            *target = NULL;
+            return true;
+        }
+        address = (uintptr_t)(record + field->offset) + (uintptr_t)(intptr_t)offset;
+    } else {
+        if (offset == BYTE_STRUCT_POOL_NULL_OFFSET) {
+            *target = NULL;
+            return true;
+        }
+        if (offset < 0 || (uint64_t)offset >= size) return false;
+        address = (uintptr_t)base + (uintptr_t)offset;
+    }
+    if (!byte_struct_pool_contains(base, size, target_size, address)) return false;
+    *target = (void *)address;
+    return true;
+}
+
+bool byte_struct_pool_assign(byte_struct_t *s, uint8_t *base, size_t size, size_t target_size, uint8_t *record, type_offset_t *field, void *target) {
+    if (!byte_struct_pool_field_valid(s, record, field) || base == NULL) return false;
+    if (target_size == 0 || target_size > size) return false;
+    if (target != NULL && !byte_struct_pool_contains(base, size, target_size, (uintptr_t)target)) return false;
+    type_offset_t element = *field;
+    element.count = 1;
+    if (field->type == BYTE_STRUCT_TYPE_RELPTR) {
+        byte_struct_pack_field(s, &element, record, &target);
+        return true;
+    }
+    int64_t offset = target == NULL ? BYTE_STRUCT_POOL_NULL_OFFSET : (int64_t)((uintptr_t)target - (uintptr_t)base);
+    byte_struct_pack_field(s, &element, record, &offset);
+    return true;
+}
+
+#endif
@@ -0,0 +1,329 @@
+#ifndef BYTE_STRUCT_RING_H
+#define BYTE_STRUCT_RING_H
+
+#include <stdint.h>
+#include <stdlib.h>
+#include <stdbool.h>
+#include <string.h>
+
+#include "byte_struct.h"
+#include "byte_struct_atomic.h"
+
+/*
+Bounded lock-free ring of packed records. Every slot is exactly total_size
+bytes and slots are contiguous, so producers pack straight into reserved slots
+and consumers read them in place, a run of slots at a time.
+
+SPSC rings are a pair of head/tail counters. MPMC rings add a sequence number
+per slot (Vyukov's bounded queue), kept in a separate array so the slots stay
+contiguous, and reservations claim a run of ready slots with one CAS.
+
+Everything lives in one caller-provided region with no pointers in it: a
+header (including the format string), the sequence array and the slots. The
+region can be mmap'd from memfd_create/shm_open and attached to from another
+process, which re-parses the schema from the header.
+*/
+
+#define BYTE_STRUCT_RING_MAGIC 0x474e495254534242ull  // "BBSTRING"
+#define BYTE_STRUCT_RING_LAYOUT_VERSION 1
+
+typedef enum {
+    BYTE_STRUCT_RING_SPSC,
+    BYTE_STRUCT_RING_MPMC
+} byte_struct_ring_mode_t;
+
+typedef struct byte_struct_ring_header {
+    uint64_t magic;
+    uint64_t layout_version;
+    uint64_t mode;
+    uint64_t byte_order;
+    uint64_t capacity;
+    uint64_t slot_size;
+    uint64_t format_len;
+    uint64_t sequences_offset;
+    uint64_t slots_offset;
+    uint8_t padding0[BYTE_STRUCT_CACHE_LINE_SIZE - 9 * sizeof(uint64_t) % BYTE_STRUCT_CACHE_LINE_SIZE];
+    // next position to produce, written by producers
+    volatile uint64_t head;
+    uint8_t padding1[BYTE_STRUCT_CACHE_LINE_SIZE - sizeof(uint64_t)];
+    // next position to consume, written by consumers
+    volatile uint64_t tail;
+    uint8_t padding2[BYTE_STRUCT_CACHE_LINE_SIZE - sizeof(uint64_t)];
+    // format string follows
+} byte_struct_ring_header_t;
+
+// Process-local handle onto a ring region
+typedef struct byte_struct_ring {
+    byte_struct_t *schema;
+    byte_struct_ring_header_t *header;
+    volatile uint64_t *sequences;
+    uint8_t *slots;
+    uint64_t capacity;
+    uint64_t mask;
+    bool owns_memory;
+} byte_struct_ring_t;
+
+// A run of count contiguous slots starting at data
+typedef struct byte_struct_ring_reservation {
+    uint8_t *data;
+    size_t count;
+    uint64_t position;
+} byte_struct_ring_reservation_t;
+
+static size_t byte_struct_ring_align(size_t value) {
+    return (value + BYTE_STRUCT_CACHE_LINE_SIZE - 1) & ~(size_t)(BYTE_STRUCT_CACHE_LINE_SIZE - 1);
+}
+
+static bool byte_struct_ring_layout(size_t format_len, size_t slot_size, size_t capacity, byte_struct_ring_mode_t mode, size_t *sequences_offset, size_t *slots_offset, size_t *memory_size) {
+    if (capacity == 0 || (capacity & (capacity - 1)) != 0) return false;
+    if (mode != BYTE_STRUCT_RING_SPSC && mode != BYTE_STRUCT_RING_MPMC) return false;
+    if (format_len > SIZE_MAX / 4 || capacity > SIZE_MAX / 4 / sizeof(uint64_t)) return false;
+    if (slot_size > 0 && capacity > SIZE_MAX / 4 / slot_size) return false;
+    *sequences_offset = byte_struct_ring_align(sizeof(byte_struct_ring_header_t) + format_len + 1);
+    size_t sequences_size = mode == BYTE_STRUCT_RING_MPMC ? capacity * sizeof(uint64_t) : 0;
+    *slots_offset = byte_struct_ring_align(*sequences_offset + sequences_size);
+    if (SIZE_MAX - *slots_offset < slot_size * capacity) return false;
+    *memory_size = *slots_offset + slot_size * capacity;
+    return true;
+}
+
+/*
+Bytes needed for a ring of capacity (a power of two) records of format, or 0
+if the format or capacity is invalid.
+*/
+size_t byte_struct_ring_memory_size(const char *format, size_t len, size_t capacity, byte_struct_ring_mode_t mode) {
+    byte_struct_t *s = byte_struct_new_len_options(format, len, BYTE_STRUCT_BIG_ENDIAN);
+    if (s == NULL) return 0;
+    size_t sequences_offset, slots_offset, memory_size;
+    bool valid = byte_struct_ring_layout(len, s->total_size, capacity, mode, &sequences_offset, &slots_offset, &memory_size);
+    byte_struct_destroy(s);
+    return valid ? memory_size : 0;
+}
+
+static byte_struct_ring_t *byte_struct_ring_handle(void *memory, bool owns_memory) {
+    byte_struct_ring_header_t *header = memory;
+    byte_struct_ring_t *ring = calloc(1, sizeof(byte_struct_ring_t));
+    if (ring == NULL) return NULL;
+    ring->schema = byte_struct_new_len_options((char *)(header + 1), (size_t)header->format_len, (byte_order_t)header->byte_order);
+    if (ring->schema == NULL || ring->schema->total_size != header->slot_size) {
+        byte_struct_destroy(ring->schema);
+        free(ring);
+        return NULL;
+    }
+    ring->header = header;
+    ring->sequences = header->mode == BYTE_STRUCT_RING_MPMC ? (volatile uint64_t *)((uint8_t *)memory + header->sequences_offset) : NULL;
+    ring->slots = (uint8_t *)memory + header->slots_offset;
+    ring->capacity = header->capacity;
+    ring->mask = header->capacity - 1;
+    ring->owns_memory = owns_memory;
+    return ring;
+}
+
+/*
+Formats memory (at least byte_struct_ring_memory_size bytes, 8-byte aligned)
+as an empty ring. The memory is not owned by the ring, byte_struct_ring_destroy
+leaves it alone.
+*/
+byte_struct_ring_t *byte_struct_ring_init(void *memory, size_t memory_size, const char *format, size_t len, byte_order_t byte_order, size_t capacity, byte_struct_ring_mode_t mode) {
+    if (memory == NULL || format == NULL || ((uintptr_t)memory & (sizeof(uint64_t) - 1)) != 0) return NULL;
+    byte_struct_t *s = byte_struct_new_len_options(format, len, byte_order);
+    if (s == NULL) return NULL;
+    size_t slot_size = s->total_size;
+    byte_struct_destroy(s);
+
+    size_t sequences_offset, slots_offset, required_size;
+    if (!byte_struct_ring_layout(len, slot_size, capacity, mode, &sequences_offset, &slots_offset, &required_size)) return NULL;
+    if (memory_size < required_size) return NULL;
+
+    byte_struct_ring_header_t *header = memory;
+    memset(header, 0, sizeof(byte_struct_ring_header_t));
+    header->layout_version = BYTE_STRUCT_RING_LAYOUT_VERSION;
+    header->mode = mode;
+    header->byte_order = byte_order;
+    header->capacity = capacity;
+    header->slot_size = slot_size;
+    header->format_len = len;
+    header->sequences_offset = sequences_offset;
+    header->slots_offset = slots_offset;
+    memcpy(header + 1, format, len);
+    ((char *)(header + 1))[len] = '\0';
+    if (mode == BYTE_STRUCT_RING_MPMC) {
+        volatile uint64_t *sequences = (volatile uint64_t *)((uint8_t *)memory + sequences_offset);
+        for (size_t i = 0; i < capacity; i++) {
+            sequences[i] = i;
+        }
+    }
+    // Publish last so a concurrent attach never sees a half-written header
+    byte_struct_atomic_store(&header->magic, BYTE_STRUCT_RING_MAGIC);
+
+    return byte_struct_ring_handle(memory, false);
+}
+
+// Ring in malloc'd memory, freed by byte_struct_ring_destroy
+byte_struct_ring_t *byte_struct_ring_new(const char *format, size_t len, byte_order_t byte_order, size_t capacity, byte_struct_ring_mode_t mode) {
+    size_t memory_size = byte_struct_ring_memory_size(format, len, capacity, mode);
+    if (memory_size == 0) return NULL;
+    void *memory = malloc(memory_size);
+    if (memory == NULL) return NULL;
+    byte_struct_ring_t *ring = byte_struct_ring_init(memory, memory_size, format, len, byte_order, capacity, mode);
+    if (ring == NULL) {
+        free(memory);
+        return NULL;
+    }
+    ring->owns_memory = true;
+    return ring;
+}
+
+/*
+Attaches to a ring another thread or process initialized in memory, checking
+the header against memory_size. The schema is re-parsed from the stored format.
+*/
+byte_struct_ring_t *byte_struct_ring_attach(void *memory, size_t memory_size) {
+    if (memory == NULL || memory_size < sizeof(byte_struct_ring_header_t)) return NULL;
+    byte_struct_ring_header_t *header = memory;
+    if (byte_struct_atomic_load(&header->magic) != BYTE_STRUCT_RING_MAGIC) return NULL;
+    if (header->layout_version != BYTE_STRUCT_RING_LAYOUT_VERSION) return NULL;
+    if (header->byte_order >= BYTE_STRUCT_NUM_BYTE_ORDERS) return NULL;
+    if (header->format_len > memory_size - sizeof(byte_struct_ring_header_t)) return NULL;
+
+    size_t sequences_offset, slots_offset, required_size;
+    if (!byte_struct_ring_layout((size_t)header->format_len, (size_t)header->slot_size, (size_t)header->capacity, (byte_struct_ring_mode_t)header->mode, &sequences_offset, &slots_offset, &required_size)) return NULL;
+    if (sequences_offset != header->sequences_offset || slots_offset != header->slots_offset || memory_size < required_size) return NULL;
+
+    return byte_struct_ring_handle(memory, false);
+}
+
+/*
+Producer side: claims up to max free slots, contiguous in memory (a run stops
+at the end of the slot array). Pack into out->data + i * total_size, then
+byte_struct_ring_commit. Returns false if the ring is full.
+*/
+bool byte_struct_ring_reserve(byte_struct_ring_t *ring, size_t max, byte_struct_ring_reservation_t *out) {
+    if (ring == NULL || out == NULL || max == 0) return false;
+    byte_struct_ring_header_t *header = ring->header;
+
+    if (ring->sequences == NULL) {
+        uint64_t head = byte_struct_atomic_load_relaxed(&header->head);
+        uint64_t tail = byte_struct_atomic_load(&header->tail);
+        uint64_t free_slots = ring->capacity - (head - tail);
+        if (free_slots == 0) return false;
+        uint64_t run = ring->capacity - (head & ring->mask);
+        uint64_t count = max < free_slots ? max : free_slots;
+        if (count > run) count = run;
+        out->position = head;
+        out->count = (size_t)count;
+        out->data = ring->slots + (head & ring->mask) * ring->schema->total_size;
+        return true;
+    }
+
+    uint64_t head = byte_struct_atomic_load_relaxed(&header->head);
+    for (;;) {
+        uint64_t sequence = byte_struct_atomic_load(&ring->sequences[head & ring->mask]);
+        if (sequence < head) return false;
+        if (sequence > head) {
+            // Another producer got here first
+            head = byte_struct_atomic_load_relaxed(&header->head);
+            continue;
+        }
+        uint64_t run = ring->capacity - (head & ring->mask);
+        uint64_t count = 1;
+        while (count < max && count < run && byte_struct_atomic_load(&ring->sequences[(head + count) & ring->mask]) == head + count) {
+            count++;
+        }
+        if (byte_struct_atomic_cas(&header->head, &head, head + count)) {
+            out->position = head;
+            out->count = (size_t)count;
+            out->data = ring->slots + (head & ring->mask) * ring->schema->total_size;
+            return true;
+        }
+        byte_struct_cpu_relax();
+    }
+}
+
+// Publishes every slot of a reservation to consumers
+void byte_struct_ring_commit(byte_struct_ring_t *ring, byte_struct_ring_reservation_t *reservation) {
+    if (ring == NULL || reservation == NULL) return;
+    if (ring->sequences == NULL) {
+        byte_struct_atomic_store(&ring->header->head, reservation->position + reservation->count);
+        return;
+    }
+    for (size_t i = 0; i < reservation->count; i++) {
+        uint64_t position = reservation->position + i;
+        byte_struct_atomic_store(&ring->sequences[position & ring->mask], position + 1);
+    }
+}
+
+/*
+Consumer side: up to max filled slots, contiguous in memory, readable in place
+until byte_struct_ring_release. Returns false if the ring is empty.
+*/
+bool byte_struct_ring_acquire(byte_struct_ring_t *ring, size_t max, byte_struct_ring_reservation_t *out) {
+    if (ring == NULL || out == NULL || max == 0) return false;
+    byte_struct_ring_header_t *header = ring->header;
+
+    if (ring->sequences == NULL) {
+        uint64_t tail = byte_struct_atomic_load_relaxed(&header->tail);
+        uint64_t head = byte_struct_atomic_load(&header->head);
+        uint64_t available = head - tail;
+        if (available == 0) return false;
+        uint64_t run = ring->capacity - (tail & ring->mask);
+        uint64_t count = max < available ? max : available;
+        if (count > run) count = run;
+        out->position = tail;
+        out->count = (size_t)count;
+        out->data = ring->slots + (tail & ring->mask) * ring->schema->total_size;
+        return true;
+    }
+
+    uint64_t tail = byte_struct_atomic_load_relaxed(&header->tail);
+    for (;;) {
+        uint64_t sequence = byte_struct_atomic_load(&ring->sequences[tail & ring->mask]);
+        if (sequence < tail + 1) return false;
+        if (sequence > tail + 1) {
+            tail = byte_struct_atomic_load_relaxed(&header->tail);
+            continue;
+        }
+        uint64_t run = ring->capacity - (tail & ring->mask);
+        uint64_t count = 1;
+        while (count < max && count < run && byte_struct_atomic_load(&ring->sequences[(tail + count) & ring->mask]) == tail + count + 1) {
+            count++;
+        }
+        if (byte_struct_atomic_cas(&header->tail, &tail, tail + count)) {
+            out->position = tail;
+            out->count = (size_t)count;
+            out->data = ring->slots + (tail & ring->mask) * ring->schema->total_size;
+            return true;
+        }
+        byte_struct_cpu_relax();
+    }
+}
+
+// Returns the slots of an acquired run to producers
+void byte_struct_ring_release(byte_struct_ring_t *ring, byte_struct_ring_reservation_t *reservation) {
+    if (ring == NULL || reservation == NULL) return;
+    if (ring->sequences == NULL) {
+        byte_struct_atomic_store(&ring->header->tail, reservation->position + reservation->count);
+        return;
+    }
+    for (size_t i = 0; i < reservation->count; i++) {
+        uint64_t position = reservation->position + i;
+        byte_struct_atomic_store(&ring->sequences[position & ring->mask], position + ring->capacity);
+    }
+}
+
+// Records reserved but not yet released, exact only when the ring is quiescent
+size_t byte_struct_ring_size(byte_struct_ring_t *ring) {
+    if (ring == NULL) return 0;
+    uint64_t tail = byte_struct_atomic_load(&ring->header->tail);
+    uint64_t head = byte_struct_atomic_load(&ring->header->head);
+    return head > tail ? (size_t)(head - tail) : 0;
+}
+
+void byte_struct_ring_destroy(byte_struct_ring_t *ring) {
+    if (ring == NULL) return;
+    byte_struct_destroy(ring->schema);
+    if (ring->owns_memory) free(ring->header);
+    free(ring);
+}
+
+#endif
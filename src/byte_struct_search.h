@@ -0,0 +1,332 @@
+#ifndef BYTE_STRUCT_SEARCH_H
+#define BYTE_STRUCT_SEARCH_H
+
+#include <stdint.h>
+#include <stdlib.h>
+#include <stdbool.h>
+#include <string.h>
+
+#include "byte_struct.h"
+#include "byte_struct_atomic.h"
+
+/*
+Read-only search structures over a sorted buffer of BYTE_STRUCT_SORTABLE
+records. The keys (first k fields, compared with memcmp like the merge
+functions) are copied out of the records into an order that suits lower_bound
+better than a plain binary search, where every probe of a large buffer is a
+cache miss:
+
+- EYTZINGER stores the implicit binary search tree in breadth-first order, so
+  the top levels share a few cache lines and the 16 descendants four levels
+  down are contiguous and can be prefetched while the current levels resolve.
+  The descent is branchless.
+- STREE is the implicit static B-tree: nodes of one cache line worth of keys,
+  each with one more child than keys, so a lookup touches log_(B+1) n lines.
+
+Lookups return the rank of the match, i.e. its index in the sorted input, so
+payloads and the original records stay where they are and are indexed by rank.
+
+The batch lookups walk BYTE_STRUCT_SEARCH_BATCH keys down the tree in lockstep,
+one level of each per round. A key's next node is prefetched when it steps down
+and only read a round later, after the other keys have stepped, so the cache
+misses of a whole batch overlap instead of costing one full miss per level per
+key (group prefetching).
+*/
+
+typedef enum {
+    BYTE_STRUCT_SEARCH_EYTZINGER,
+    BYTE_STRUCT_SEARCH_STREE
+} byte_struct_search_layout_t;
+
+// Keys per STREE node are chosen to fill this many bytes, at least 2
+#define BYTE_STRUCT_SEARCH_NODE_SIZE BYTE_STRUCT_CACHE_LINE_SIZE
+// Lookups in flight at once in the batch functions
+#define BYTE_STRUCT_SEARCH_BATCH 16
+
+typedef struct byte_struct_search {
+    byte_struct_search_layout_t layout;
+    size_t n;
+    size_t key_len;
+    // stride of the keys passed to the batch lookups
+    size_t record_size;
+    // STREE: keys per node and number of nodes
+    size_t node_keys;
+    size_t num_nodes;
+    // slot -> rank in the sorted input, n for STREE padding
+    size_t *ranks;
+    // keys in layout order, cache line aligned within keys_mem
+    uint8_t *keys;
+    void *keys_mem;
+} byte_struct_search_t;
+
+static inline uint8_t *byte_struct_search_key(byte_struct_search_t *search, size_t slot) {
+    return search->keys + slot * search->key_len;
+}
+
+// In-order walk of the 1-based implicit tree assigns sorted keys to slots
+static size_t byte_struct_search_fill_eytzinger(byte_struct_search_t *search, uint8_t *data, size_t record_size, size_t rank, size_t k) {
+    if (k > search->n) return rank;
+    rank = byte_struct_search_fill_eytzinger(search, data, record_size, rank, 2 * k);
+    memcpy(byte_struct_search_key(search, k), data + rank * record_size, search->key_len);
+    search->ranks[k] = rank;
+    rank++;
+    return byte_struct_search_fill_eytzinger(search, data, record_size, rank, 2 * k + 1);
+}
+
+/*
+Same for the B-tree, where node k's children are k * (B + 1) + 1 + i. Slots left
+over once the keys run out hold copies of the largest key with rank n; they come
+after every real key in order, so they never become a lower bound for a key that
+is present.
+*/
+static size_t byte_struct_search_fill_stree(byte_struct_search_t *search, uint8_t *data, size_t record_size, size_t rank, size_t k) {
+    if (k >= search->num_nodes) return rank;
+    size_t b = search->node_keys;
+    for (size_t i = 0; i < b; i++) {
+        rank = byte_struct_search_fill_stree(search, data, record_size, rank, k * (b + 1) + 1 + i);
+        size_t slot = k * b + i;
+        size_t source = rank < search->n ? rank : search->n - 1;
+        memcpy(byte_struct_search_key(search, slot), data + source * record_size, search->key_len);
+        search->ranks[slot] = rank < search->n ? rank++ : search->n;
+    }
+    return byte_struct_search_fill_stree(search, data, record_size, rank, k * (b + 1) + 1 + b);
+}
+
+/*
+Builds a search structure over n records of s sorted on their first
+prefix_fields fields. data is only read during the build.
+*/
+byte_struct_search_t *byte_struct_search_new(byte_struct_t *s, uint8_t *data, size_t n, size_t prefix_fields, byte_struct_search_layout_t layout) {
+    if (s == NULL || data == NULL || n == 0) return NULL;
+    if (s->byte_order != BYTE_STRUCT_SORTABLE) return NULL;
+    if (prefix_fields == 0 || prefix_fields > s->num_fields) return NULL;
+    if (layout != BYTE_STRUCT_SEARCH_EYTZINGER && layout != BYTE_STRUCT_SEARCH_STREE) return NULL;
+
+    byte_struct_search_t *search = calloc(1, sizeof(byte_struct_search_t));
+    if (search == NULL) return NULL;
+    search->layout = layout;
+    search->n = n;
+    search->key_len = byte_struct_prefix_size(s, prefix_fields);
+    search->record_size = s->total_size;
+
+    size_t num_slots;
+    if (layout == BYTE_STRUCT_SEARCH_EYTZINGER) {
+        // slot 0 is unused so children of k are 2k and 2k + 1
+        num_slots = n + 1;
+    } else {
+        search->node_keys = BYTE_STRUCT_SEARCH_NODE_SIZE / search->key_len;
+        if (search->node_keys < 2) search->node_keys = 2;
+        search->num_nodes = n / search->node_keys + (n % search->node_keys != 0);
+        num_slots = search->num_nodes * search->node_keys;
+    }
+    if (num_slots > (SIZE_MAX - BYTE_STRUCT_CACHE_LINE_SIZE) / search->key_len || num_slots > SIZE_MAX / sizeof(size_t)) {
+        free(search);
+        return NULL;
+    }
+    search->ranks = malloc(num_slots * sizeof(size_t));
+    search->keys_mem = malloc(num_slots * search->key_len + BYTE_STRUCT_CACHE_LINE_SIZE - 1);
+    if (search->ranks == NULL || search->keys_mem == NULL) {
+        free(search->ranks);
+        free(search->keys_mem);
+        free(search);
+        return NULL;
+    }
+    uintptr_t aligned = ((uintptr_t)search->keys_mem + BYTE_STRUCT_CACHE_LINE_SIZE - 1) & ~(uintptr_t)(BYTE_STRUCT_CACHE_LINE_SIZE - 1);
+    search->keys = (uint8_t *)aligned;
+
+    if (layout == BYTE_STRUCT_SEARCH_EYTZINGER) {
+        memset(search->keys, 0, search->key_len);
+        search->ranks[0] = n;
+        byte_struct_search_fill_eytzinger(search, data, s->total_size, 0, 1);
+    } else {
+        byte_struct_search_fill_stree(search, data, s->total_size, 0, 0);
+    }
+    return search;
+}
+
+// Both descents return the slot of the lower bound, 0 / num_slots when there is none
+
+static size_t byte_struct_search_slot_eytzinger(byte_struct_search_t *search, uint8_t *key) {
+    size_t n = search->n;
+    size_t key_len = search->key_len;
+    size_t k = 1;
+    while (k <= n) {
+        // Four levels ahead, 0 once past the leaves so the address stays in bounds
+        size_t ahead = 16 * k <= n ? 16 * k : 0;
+        byte_struct_prefetch(byte_struct_search_key(search, ahead));
+        k = 2 * k + (memcmp(byte_struct_search_key(search, k), key, key_len) < 0);
+    }
+    // Undo the right turns taken after the last left turn, whose node is the answer
+    while (k & 1) k >>= 1;
+    return k >> 1;
+}
+
+static size_t byte_struct_search_slot_stree(byte_struct_search_t *search, uint8_t *key) {
+    size_t b = search->node_keys;
+    size_t key_len = search->key_len;
+    size_t slot = search->num_nodes * b;
+    size_t k = 0;
+    while (k < search->num_nodes) {
+        uint8_t *node = byte_struct_search_key(search, k * b);
+        size_t i = 0;
+        for (size_t j = 0; j < b; j++) {
+            i += memcmp(node + j * key_len, key, key_len) < 0;
+        }
+        if (i < b) slot = k * b + i;
+        k = k * (b + 1) + 1 + i;
+    }
+    return slot;
+}
+
+static void byte_struct_search_slots_eytzinger(byte_struct_search_t *search, uint8_t *keys, size_t m, size_t *slots) {
+    size_t n = search->n;
+    size_t key_len = search->key_len;
+    size_t record_size = search->record_size;
+    size_t k[BYTE_STRUCT_SEARCH_BATCH];
+    for (size_t j = 0; j < m; j++) k[j] = 1;
+    // Every key takes floor(log2 n) or one more steps, so lanes finish together
+    bool active = true;
+    while (active) {
+        active = false;
+        for (size_t j = 0; j < m; j++) {
+            if (k[j] > n) continue;
+            k[j] = 2 * k[j] + (memcmp(byte_struct_search_key(search, k[j]), keys + j * record_size, key_len) < 0);
+            byte_struct_prefetch(byte_struct_search_key(search, k[j] <= n ? k[j] : 0));
+            active = true;
+        }
+    }
+    for (size_t j = 0; j < m; j++) {
+        size_t slot = k[j];
+        while (slot & 1) slot >>= 1;
+        slots[j] = slot >> 1;
+    }
+}
+
+static void byte_struct_search_slots_stree(byte_struct_search_t *search, uint8_t *keys, size_t m, size_t *slots) {
+    size_t b = search->node_keys;
+    size_t key_len = search->key_len;
+    size_t record_size = search->record_size;
+    size_t k[BYTE_STRUCT_SEARCH_BATCH];
+    for (size_t j = 0; j < m; j++) {
+        k[j] = 0;
+        slots[j] = search->num_nodes * b;
+    }
+    bool active = true;
+    while (active) {
+        active = false;
+        for (size_t j = 0; j < m; j++) {
+            if (k[j] >= search->num_nodes) continue;
+            uint8_t *node = byte_struct_search_key(search, k[j] * b);
+            uint8_t *key = keys + j * record_size;
+            size_t i = 0;
+            for (size_t c = 0; c < b; c++) {
+                i += memcmp(node + c * key_len, key, key_len) < 0;
+            }
+            if (i < b) slots[j] = k[j] * b + i;
+            k[j] = k[j] * (b + 1) + 1 + i;
+            if (k[j] < search->num_nodes) {
+                // Nodes with two keys wider than half a line can straddle two lines
+                uint8_t *next = byte_struct_search_key(search, k[j] * b);
+                byte_struct_prefetch(next);
+                byte_struct_prefetch(next + b * key_len - 1);
+            }
+            active = true;
+        }
+    }
+}
+
+// Rank at a slot found by the descents, n when there is no lower bound
+static inline size_t byte_struct_search_slot_rank(byte_struct_search_t *search, size_t slot) {
+    if (search->layout == BYTE_STRUCT_SEARCH_STREE && slot == search->num_nodes * search->node_keys) return search->n;
+    return search->ranks[slot];
+}
+
+static void byte_struct_search_slots(byte_struct_search_t *search, uint8_t *keys, size_t m, size_t *slots) {
+    if (search->layout == BYTE_STRUCT_SEARCH_EYTZINGER) {
+        byte_struct_search_slots_eytzinger(search, keys, m, slots);
+    } else {
+        byte_struct_search_slots_stree(search, keys, m, slots);
+    }
+}
+
+/*
+Rank of the first record whose key is >= the first key_len bytes of key (a
+packed record or key prefix), or n if there is none.
+*/
+size_t byte_struct_search_lower_bound(byte_struct_search_t *search, uint8_t *key) {
+    if (search == NULL || key == NULL) return 0;
+    if (search->layout == BYTE_STRUCT_SEARCH_EYTZINGER) {
+        return search->ranks[byte_struct_search_slot_eytzinger(search, key)];
+    }
+    size_t slot = byte_struct_search_slot_stree(search, key);
+    return slot < search->num_nodes * search->node_keys ? search->ranks[slot] : search->n;
+}
+
+// Exact match: true with the rank of the first equal key in *rank
+bool byte_struct_search_find(byte_struct_search_t *search, uint8_t *key, size_t *rank) {
+    if (search == NULL || key == NULL || rank == NULL) return false;
+    size_t slot;
+    if (search->layout == BYTE_STRUCT_SEARCH_EYTZINGER) {
+        slot = byte_struct_search_slot_eytzinger(search, key);
+        if (slot == 0) return false;
+    } else {
+        slot = byte_struct_search_slot_stree(search, key);
+        if (slot == search->num_nodes * search->node_keys) return false;
+    }
+    if (search->ranks[slot] == search->n) return false;
+    if (memcmp(byte_struct_search_key(search, slot), key, search->key_len) != 0) return false;
+    *rank = search->ranks[slot];
+    return true;
+}
+
+/*
+byte_struct_search_lower_bound for n keys spaced record_size bytes apart
+(packed records of the schema the search was built with), ranks in key order.
+*/
+bool byte_struct_search_lower_bound_batch(byte_struct_search_t *search, uint8_t *keys, size_t n, size_t *ranks) {
+    if (search == NULL || keys == NULL || ranks == NULL) return false;
+    size_t slots[BYTE_STRUCT_SEARCH_BATCH];
+    for (size_t r = 0; r < n; r += BYTE_STRUCT_SEARCH_BATCH) {
+        size_t m = n - r < BYTE_STRUCT_SEARCH_BATCH ? n - r : BYTE_STRUCT_SEARCH_BATCH;
+        byte_struct_search_slots(search, keys + r * search->record_size, m, slots);
+        for (size_t j = 0; j < m; j++) {
+            ranks[r + j] = byte_struct_search_slot_rank(search, slots[j]);
+        }
+    }
+    return true;
+}
+
+/*
+Exact match for n keys like byte_struct_search_lower_bound_batch: ranks[i] is
+the rank of the first key equal to key i, or n when there is none. Returns the
+number of keys found.
+*/
+size_t byte_struct_search_find_batch(byte_struct_search_t *search, uint8_t *keys, size_t n, size_t *ranks) {
+    if (search == NULL || keys == NULL || ranks == NULL) return 0;
+    size_t slots[BYTE_STRUCT_SEARCH_BATCH];
+    size_t found = 0;
+    for (size_t r = 0; r < n; r += BYTE_STRUCT_SEARCH_BATCH) {
+        size_t m = n - r < BYTE_STRUCT_SEARCH_BATCH ? n - r : BYTE_STRUCT_SEARCH_BATCH;
+        uint8_t *batch = keys + r * search->record_size;
+        byte_struct_search_slots(search, batch, m, slots);
+        for (size_t j = 0; j < m; j++) {
+            size_t slot = slots[j];
+            size_t rank = byte_struct_search_slot_rank(search, slot);
+            if (rank != search->n && memcmp(byte_struct_search_key(search, slot), batch + j * search->record_size, search->key_len) != 0) {
+                rank = search->n;
+            }
+            ranks[r + j] = rank;
+            found += rank != search->n;
+        }
+    }
+    return found;
+}
+
+void byte_struct_search_destroy(byte_struct_search_t *search) {
+    if (search == NULL) return;
+    free(search->ranks);
+    free(search->keys_mem);
+    free(search);
+}
+
+#endif
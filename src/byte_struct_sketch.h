@@ -0,0 +1,641 @@
+#ifndef BYTE_STRUCT_SKETCH_H
+#define BYTE_STRUCT_SKETCH_H
+
+#include <stdint.h>
+#include <stdlib.h>
+#include <stdbool.h>
+#include <string.h>
+
+#include "byte_struct.h"
+#include "byte_struct_hash.h"
+
+/*
+Small, mergeable summaries of record buffers for planning: how many distinct
+keys there are (to size a hash table or pick a partition count) and how the
+values of a field are distributed (to pick split points).
+
+byte_struct_hll_t is a HyperLogLog over the encoded bytes of the first k fields
+(byte_struct_prefix_size), so like the bloom filter it counts distinct prefixes
+of one schema and byte order. 2^precision one-byte registers give a standard
+error of about 1.04 / sqrt(2^precision), 0.8% at the default of 14 (16KB).
+
+byte_struct_kll_t is a KLL quantile sketch of one numeric field, decoded per
+type to double. Items are kept in levels of compactors, an item at level h
+standing for 2^h inputs; a full level is sorted and every other item (odd or
+even positions, by coin flip) moves up. With parameter k the rank error is
+about 1.7 / k (k = 200: ~1%) using O(k) space however many values go in.
+
+Both merge (e.g. one sketch per thread, combined at the end) and serialize to
+little-endian bytes like the bloom filter.
+*/
+
+#define BYTE_STRUCT_HLL_MIN_PRECISION 4
+#define BYTE_STRUCT_HLL_MAX_PRECISION 18
+#define BYTE_STRUCT_HLL_DEFAULT_PRECISION 14
+#define BYTE_STRUCT_HLL_SEED 0x68797065726c6f67ull
+
+#define BYTE_STRUCT_HLL_MAGIC 0x4c485342u  // "BSHL" little-endian
+#define BYTE_STRUCT_KLL_MAGIC 0x4c4b5342u  // "BSKL" little-endian
+#define BYTE_STRUCT_SKETCH_LAYOUT_VERSION 1
+// magic, version, then precision, key_len, record_size
+#define BYTE_STRUCT_HLL_HEADER_SIZE (2 * sizeof(uint32_t) + 3 * sizeof(uint64_t))
+// magic, version, then k, field type, n, min, max, num_levels, followed by one size per level
+#define BYTE_STRUCT_KLL_HEADER_SIZE (2 * sizeof(uint32_t) + 6 * sizeof(uint64_t))
+
+#define BYTE_STRUCT_KLL_DEFAULT_K 200
+#define BYTE_STRUCT_KLL_MIN_K 8
+// Lower levels shrink by this factor each, down to a floor
+#define BYTE_STRUCT_KLL_LEVEL_RATIO (2.0 / 3.0)
+#define BYTE_STRUCT_KLL_MIN_LEVEL_CAPACITY 8
+#define BYTE_STRUCT_KLL_MAX_LEVELS 64
+#define BYTE_STRUCT_KLL_SEED 0x6b6c6c736b657463ull
+
+typedef struct byte_struct_hll {
+    uint32_t precision;
+    // bytes hashed per key
+    size_t key_len;
+    // stride of record buffers passed to the batch functions
+    size_t record_size;
+    uint8_t *registers;
+} byte_struct_hll_t;
+
+static inline size_t byte_struct_hll_num_registers(byte_struct_hll_t *hll) {
+    return (size_t)1 << hll->precision;
+}
+
+static byte_struct_hll_t *byte_struct_hll_alloc(uint32_t precision, size_t key_len, size_t record_size) {
+    if (precision < BYTE_STRUCT_HLL_MIN_PRECISION || precision > BYTE_STRUCT_HLL_MAX_PRECISION) return NULL;
+    if (key_len == 0 || key_len > record_size) return NULL;
+    byte_struct_hll_t *hll = malloc(sizeof(byte_struct_hll_t));
+    if (hll == NULL) return NULL;
+    hll->registers = calloc((size_t)1 << precision, 1);
+    if (hll->registers == NULL) {
+        free(hll);
+        return NULL;
+    }
+    hll->precision = precision;
+    hll->key_len = key_len;
+    hll->record_size = record_size;
+    return hll;
+}
+
+/*
+Distinct count sketch of the first prefix_fields fields of records of s
+(s->num_fields for whole records) with 2^precision registers, 0 for the default.
+*/
+byte_struct_hll_t *byte_struct_hll_new(byte_struct_t *s, size_t prefix_fields, uint32_t precision) {
+    if (s == NULL || prefix_fields == 0 || prefix_fields > s->num_fields) return NULL;
+    if (precision == 0) precision = BYTE_STRUCT_HLL_DEFAULT_PRECISION;
+    return byte_struct_hll_alloc(precision, byte_struct_prefix_size(s, prefix_fields), s->total_size);
+}
+
+// Register index from the top precision bits, rank of the first set bit in the rest
+static inline void byte_struct_hll_add_hash(byte_struct_hll_t *hll, uint64_t hash) {
+    uint32_t p = hll->precision;
+    size_t index = (size_t)(hash >> (64 - p));
+    uint64_t rest = hash << p;
+    uint8_t rank = 1;
+    while (rank <= 64 - p && (rest & (1ull << 63)) == 0) {
+        rest <<= 1;
+        rank++;
+    }
+    if (rank > hll->registers[index]) hll->registers[index] = rank;
+}
+
+// key is a packed record, or at least its first key_len bytes
+void byte_struct_hll_add(byte_struct_hll_t *hll, uint8_t *key) {
+    if (hll == NULL || key == NULL) return;
+    byte_struct_hll_add_hash(hll, byte_struct_hash_bytes(key, hll->key_len, BYTE_STRUCT_HLL_SEED));
+}
+
+// Adds n records of record_size bytes each
+void byte_struct_hll_add_batch(byte_struct_hll_t *hll, uint8_t *data, size_t n) {
+    if (hll == NULL || data == NULL) return;
+    for (size_t r = 0; r < n; r++) {
+        byte_struct_hll_add_hash(hll, byte_struct_hash_bytes(data + r * hll->record_size, hll->key_len, BYTE_STRUCT_HLL_SEED));
+    }
+}
+
+// Natural log for x >= 1, 2 atanh((f - 1) / (f + 1)) on the mantissa, to stay clear of libm
+static double byte_struct_sketch_log(double x) {
+    static const double ln2 = 0.69314718055994530942;
+    int exponent = 0;
+    while (x >= 2.0) {
+        x *= 0.5;
+        exponent++;
+    }
+    double y = (x - 1.0) / (x + 1.0);
+    double y2 = y * y;
+    double term = y;
+    double sum = 0.0;
+    for (int i = 1; i < 40; i += 2) {
+        sum += term / i;
+        term *= y2;
+    }
+    return exponent * ln2 + 2.0 * sum;
+}
+
+/*
+Estimated number of distinct keys. The raw HyperLogLog estimate is biased for
+small counts, where linear counting on the empty registers is used instead.
+64-bit hashes make the large range correction unnecessary.
+*/
+double byte_struct_hll_estimate(byte_struct_hll_t *hll) {
+    if (hll == NULL) return 0.0;
+    size_t m = byte_struct_hll_num_registers(hll);
+    double sum = 0.0;
+    size_t zeros = 0;
+    for (size_t i = 0; i < m; i++) {
+        sum += 1.0 / (double)(1ull << hll->registers[i]);
+        zeros += hll->registers[i] == 0;
+    }
+    double alpha;
+    if (m == 16) {
+        alpha = 0.673;
+    } else if (m == 32) {
+        alpha = 0.697;
+    } else if (m == 64) {
+        alpha = 0.709;
+    } else {
+        alpha = 0.7213 / (1.0 + 1.079 / (double)m);
+    }
+    double estimate = alpha * (double)m * (double)m / sum;
+    if (estimate <= 2.5 * (double)m && zeros > 0) {
+        estimate = (double)m * byte_struct_sketch_log((double)m / (double)zeros);
+    }
+    return estimate;
+}
+
+// Combines sketches of the same keys and precision, e.g. one per thread
+bool byte_struct_hll_merge(byte_struct_hll_t *dst, byte_struct_hll_t *src) {
+    if (dst == NULL || src == NULL) return false;
+    if (dst->precision != src->precision || dst->key_len != src->key_len) return false;
+    size_t m = byte_struct_hll_num_registers(dst);
+    for (size_t i = 0; i < m; i++) {
+        if (src->registers[i] > dst->registers[i]) dst->registers[i] = src->registers[i];
+    }
+    return true;
+}
+
+void byte_struct_hll_reset(byte_struct_hll_t *hll) {
+    if (hll != NULL) memset(hll->registers, 0, byte_struct_hll_num_registers(hll));
+}
+
+size_t byte_struct_hll_serialized_size(byte_struct_hll_t *hll) {
+    if (hll == NULL) return 0;
+    return BYTE_STRUCT_HLL_HEADER_SIZE + byte_struct_hll_num_registers(hll);
+}
+
+bool byte_struct_hll_serialize(byte_struct_hll_t *hll, uint8_t *out) {
+    if (hll == NULL || out == NULL) return false;
+    write_uint32_little_endian(out, BYTE_STRUCT_HLL_MAGIC);
+    write_uint32_little_endian(out + 4, BYTE_STRUCT_SKETCH_LAYOUT_VERSION);
+    write_uint64_little_endian(out + 8, (uint64_t)hll->precision);
+    write_uint64_little_endian(out + 16, (uint64_t)hll->key_len);
+    write_uint64_little_endian(out + 24, (uint64_t)hll->record_size);
+    memcpy(out + BYTE_STRUCT_HLL_HEADER_SIZE, hll->registers, byte_struct_hll_num_registers(hll));
+    return true;
+}
+
+byte_struct_hll_t *byte_struct_hll_deserialize(uint8_t *data, size_t len) {
+    if (data == NULL || len < BYTE_STRUCT_HLL_HEADER_SIZE) return NULL;
+    if (read_uint32_little_endian(data) != BYTE_STRUCT_HLL_MAGIC) return NULL;
+    if (read_uint32_little_endian(data + 4) != BYTE_STRUCT_SKETCH_LAYOUT_VERSION) return NULL;
+    uint64_t precision = read_uint64_little_endian(data + 8);
+    uint64_t key_len = read_uint64_little_endian(data + 16);
+    uint64_t record_size = read_uint64_little_endian(data + 24);
+    if (precision < BYTE_STRUCT_HLL_MIN_PRECISION || precision > BYTE_STRUCT_HLL_MAX_PRECISION) return NULL;
+    if (key_len > SIZE_MAX || record_size > SIZE_MAX) return NULL;
+    if (len - BYTE_STRUCT_HLL_HEADER_SIZE < (1ull << precision)) return NULL;
+
+    byte_struct_hll_t *hll = byte_struct_hll_alloc((uint32_t)precision, (size_t)key_len, (size_t)record_size);
+    if (hll == NULL) return NULL;
+    uint8_t *registers = data + BYTE_STRUCT_HLL_HEADER_SIZE;
+    for (size_t i = 0; i < byte_struct_hll_num_registers(hll); i++) {
+        // a register can't exceed the bits left after the index
+        if (registers[i] > 65 - precision) {
+            free(hll->registers);
+            free(hll);
+            return NULL;
+        }
+        hll->registers[i] = registers[i];
+    }
+    return hll;
+}
+
+void byte_struct_hll_destroy(byte_struct_hll_t *hll) {
+    if (hll == NULL) return;
+    free(hll->registers);
+    free(hll);
+}
+
+typedef struct byte_struct_kll_level {
+    double *items;
+    size_t size;
+    size_t capacity;
+} byte_struct_kll_level_t;
+
+typedef struct byte_struct_kll {
+    // schema and field values are decoded with
+    byte_struct_t *s;
+    type_offset_t field;
+    uint32_t k;
+    // values summarized, NaNs and nulls are skipped
+    uint64_t n;
+    double min;
+    double max;
+    // item count at which the levels are compacted, sum of the level capacities
+    size_t max_size;
+    size_t size;
+    size_t num_levels;
+    byte_struct_kll_level_t levels[BYTE_STRUCT_KLL_MAX_LEVELS];
+    uint64_t random;
+} byte_struct_kll_t;
+
+static bool byte_struct_kll_field_valid(byte_struct_t *s, type_offset_t *field) {
+    if (s == NULL || field == NULL) return false;
+    switch (field->type) {
+        case BYTE_STRUCT_TYPE_CHAR:
+        case BYTE_STRUCT_TYPE_PTR:
+        case BYTE_STRUCT_TYPE_RELPTR:
+        case BYTE_STRUCT_TYPE_GROUP:
+            return false;
+        default:
+            return true;
+    }
+}
+
+// Level h of num_levels holds up to k (2/3)^(num_levels - 1 - h) items, the top level k
+static size_t byte_struct_kll_level_capacity(byte_struct_kll_t *kll, size_t h) {
+    double capacity = (double)kll->k;
+    for (size_t depth = h + 1; depth < kll->num_levels; depth++) {
+        capacity *= BYTE_STRUCT_KLL_LEVEL_RATIO;
+    }
+    size_t c = (size_t)capacity;
+    return c < BYTE_STRUCT_KLL_MIN_LEVEL_CAPACITY ? BYTE_STRUCT_KLL_MIN_LEVEL_CAPACITY : c;
+}
+
+static bool byte_struct_kll_add_level(byte_struct_kll_t *kll) {
+    if (kll->num_levels == BYTE_STRUCT_KLL_MAX_LEVELS) return false;
+    kll->levels[kll->num_levels++] = (byte_struct_kll_level_t){0};
+    kll->max_size = 0;
+    for (size_t h = 0; h < kll->num_levels; h++) {
+        kll->max_size += byte_struct_kll_level_capacity(kll, h);
+    }
+    return true;
+}
+
+static bool byte_struct_kll_reserve(byte_struct_kll_level_t *level, size_t size) {
+    if (size <= level->capacity) return true;
+    size_t capacity = level->capacity == 0 ? BYTE_STRUCT_KLL_MIN_LEVEL_CAPACITY : level->capacity;
+    while (capacity < size) capacity *= 2;
+    double *items = realloc(level->items, capacity * sizeof(double));
+    if (items == NULL) return false;
+    level->items = items;
+    level->capacity = capacity;
+    return true;
+}
+
+/*
+Quantile sketch of field (s->type_offsets[i] or from byte_struct_field_path,
+any numeric type, every element of an array counts) with parameter k, 0 for
+the default.
+*/
+byte_struct_kll_t *byte_struct_kll_new(byte_struct_t *s, type_offset_t *field, uint32_t k) {
+    if (!byte_struct_kll_field_valid(s, field)) return NULL;
+    if (k == 0) k = BYTE_STRUCT_KLL_DEFAULT_K;
+    if (k < BYTE_STRUCT_KLL_MIN_K) return NULL;
+    byte_struct_kll_t *kll = calloc(1, sizeof(byte_struct_kll_t));
+    if (kll == NULL) return NULL;
+    kll->s = s;
+    kll->field = *field;
+    kll->k = k;
+    kll->random = BYTE_STRUCT_KLL_SEED;
+    byte_struct_kll_add_level(kll);
+    return kll;
+}
+
+static void byte_struct_kll_sort(double *items, size_t n) {
+    // Levels are small and mostly made of sorted runs, where insertion sort is quick
+    for (size_t i = 1; i < n; i++) {
+        double x = items[i];
+        size_t j = i;
+        while (j > 0 && items[j - 1] > x) {
+            items[j] = items[j - 1];
+            j--;
+        }
+        items[j] = x;
+    }
+}
+
+static bool byte_struct_kll_coin(byte_struct_kll_t *kll) {
+    kll->random ^= kll->random << 13;
+    kll->random ^= kll->random >> 7;
+    kll->random ^= kll->random << 17;
+    return (kll->random >> 32) & 1;
+}
+
+/*
+Compacts the lowest full level into the one above, adding a level on top when
+needed, until the items fit in max_size again.
+*/
+static bool byte_struct_kll_compress(byte_struct_kll_t *kll) {
+    while (kll->size >= kll->max_size) {
+        size_t h = 0;
+        while (h < kll->num_levels && kll->levels[h].size < byte_struct_kll_level_capacity(kll, h)) h++;
+        // max_size is the sum of the capacities, so some level is full
+        if (h == kll->num_levels) return true;
+        if (h + 1 == kll->num_levels && !byte_struct_kll_add_level(kll)) return false;
+        byte_struct_kll_level_t *level = &kll->levels[h];
+        byte_struct_kll_level_t *above = &kll->levels[h + 1];
+        byte_struct_kll_sort(level->items, level->size);
+        // An odd item out stays behind
+        size_t pairs = level->size / 2;
+        if (!byte_struct_kll_reserve(above, above->size + pairs)) return false;
+        size_t offset = byte_struct_kll_coin(kll);
+        for (size_t i = 0; i < pairs; i++) {
+            above->items[above->size++] = level->items[2 * i + offset];
+        }
+        if (level->size % 2 == 1) level->items[0] = level->items[level->size - 1];
+        level->size %= 2;
+        kll->size -= pairs;
+    }
+    return true;
+}
+
+bool byte_struct_kll_add_value(byte_struct_kll_t *kll, double value) {
+    if (kll == NULL) return false;
+    // NaN has no rank
+    if (value != value) return true;
+    byte_struct_kll_level_t *level = &kll->levels[0];
+    if (!byte_struct_kll_reserve(level, level->size + 1)) return false;
+    level->items[level->size++] = value;
+    kll->size++;
+    if (kll->n == 0 || value < kll->min) kll->min = value;
+    if (kll->n == 0 || value > kll->max) kll->max = value;
+    kll->n++;
+    return byte_struct_kll_compress(kll);
+}
+
+// Decodes one element of the sketched field
+static double byte_struct_kll_read(byte_struct_kll_t *kll, type_offset_t *element, uint8_t *record) {
+    union {
+        uint64_t u64;
+        int8_t i8;
+        uint8_t u8;
+        int16_t i16;
+        uint16_t u16;
+        int32_t i32;
+        uint32_t u32;
+        int64_t i64;
+        float f;
+        double d;
+    } value;
+    byte_struct_unpack_field(kll->s, element, record, &value);
+    switch (element->type) {
+        case BYTE_STRUCT_TYPE_INT8: return value.i8;
+        case BYTE_STRUCT_TYPE_UINT8: return value.u8;
+        case BYTE_STRUCT_TYPE_INT16: return value.i16;
+        case BYTE_STRUCT_TYPE_UINT16: return value.u16;
+        case BYTE_STRUCT_TYPE_INT32: return value.i32;
+        case BYTE_STRUCT_TYPE_UINT32: return value.u32;
+        case BYTE_STRUCT_TYPE_INT64: return (double)value.i64;
+        case BYTE_STRUCT_TYPE_UINT64: return (double)value.u64;
+        case BYTE_STRUCT_TYPE_FLOAT:
+        case BYTE_STRUCT_TYPE_HALF:
+        case BYTE_STRUCT_TYPE_BFLOAT16: return value.f;
+        case BYTE_STRUCT_TYPE_DOUBLE: return value.d;
+        default: return 0.0;
+    }
+}
+
+// Adds the field of n records packed with the sketch's schema, skipping nulls
+bool byte_struct_kll_add_batch(byte_struct_kll_t *kll, uint8_t *data, size_t n) {
+    if (kll == NULL || data == NULL) return false;
+    type_offset_t element = kll->field;
+    element.count = 1;
+    for (size_t r = 0; r < n; r++) {
+        uint8_t *record = data + r * kll->s->total_size;
+        if (byte_struct_is_null(kll->s, record, &kll->field)) continue;
+        for (size_t j = 0; j < kll->field.count; j++) {
+            element.offset = kll->field.offset + j * kll->field.size;
+            if (!byte_struct_kll_add_value(kll, byte_struct_kll_read(kll, &element, record))) return false;
+        }
+    }
+    return true;
+}
+
+uint64_t byte_struct_kll_count(byte_struct_kll_t *kll) {
+    return kll == NULL ? 0 : kll->n;
+}
+
+// Combines sketches, e.g. one per thread. src is unchanged
+bool byte_struct_kll_merge(byte_struct_kll_t *dst, byte_struct_kll_t *src) {
+    if (dst == NULL || src == NULL) return false;
+    while (dst->num_levels < src->num_levels) {
+        if (!byte_struct_kll_add_level(dst)) return false;
+    }
+    for (size_t h = 0; h < src->num_levels; h++) {
+        byte_struct_kll_level_t *from = &src->levels[h];
+        byte_struct_kll_level_t *to = &dst->levels[h];
+        if (!byte_struct_kll_reserve(to, to->size + from->size)) return false;
+        memcpy(to->items + to->size, from->items, from->size * sizeof(double));
+        to->size += from->size;
+        dst->size += from->size;
+    }
+    if (src->n > 0) {
+        if (dst->n == 0 || src->min < dst->min) dst->min = src->min;
+        if (dst->n == 0 || src->max > dst->max) dst->max = src->max;
+    }
+    dst->n += src->n;
+    return byte_struct_kll_compress(dst);
+}
+
+typedef struct byte_struct_kll_item {
+    double value;
+    uint64_t weight;
+} byte_struct_kll_item_t;
+
+static void byte_struct_kll_merge_items(byte_struct_kll_item_t *a, size_t na, byte_struct_kll_item_t *b, size_t nb, byte_struct_kll_item_t *out) {
+    size_t i = 0, j = 0, o = 0;
+    while (i < na && j < nb) out[o++] = b[j].value < a[i].value ? b[j++] : a[i++];
+    while (i < na) out[o++] = a[i++];
+    while (j < nb) out[o++] = b[j++];
+}
+
+// Every retained item with its weight, sorted by value; NULL when empty or out of memory
+static byte_struct_kll_item_t *byte_struct_kll_items(byte_struct_kll_t *kll, size_t *num_items) {
+    size_t n = kll->size;
+    if (n == 0) return NULL;
+    byte_struct_kll_item_t *items = malloc(2 * n * sizeof(byte_struct_kll_item_t));
+    if (items == NULL) return NULL;
+    byte_struct_kll_item_t *tmp = items + n;
+    // Merge the levels in one at a time, each sorted on its own
+    size_t size = 0;
+    for (size_t h = 0; h < kll->num_levels; h++) {
+        byte_struct_kll_level_t *level = &kll->levels[h];
+        if (level->size == 0) continue;
+        byte_struct_kll_sort(level->items, level->size);
+        for (size_t i = 0; i < level->size; i++) {
+            tmp[size + i] = (byte_struct_kll_item_t){.value = level->items[i], .weight = 1ull << h};
+        }
+        byte_struct_kll_merge_items(items, size, tmp + size, level->size, tmp);
+        memcpy(items, tmp, (size + level->size) * sizeof(byte_struct_kll_item_t));
+        size += level->size;
+    }
+    *num_items = size;
+    return items;
+}
+
+/*
+Values at m normalized ranks qs[i] in [0, 1] (0 is the minimum, 1 the maximum),
+e.g. partition split points. False if the sketch is empty.
+*/
+bool byte_struct_kll_quantiles(byte_struct_kll_t *kll, double *qs, size_t m, double *values) {
+    if (kll == NULL || qs == NULL || values == NULL || kll->n == 0) return false;
+    size_t num_items = 0;
+    byte_struct_kll_item_t *items = byte_struct_kll_items(kll, &num_items);
+    if (items == NULL) return false;
+    uint64_t total = 0;
+    for (size_t i = 0; i < num_items; i++) total += items[i].weight;
+    for (size_t q = 0; q < m; q++) {
+        if (qs[q] <= 0.0) {
+            values[q] = kll->min;
+            continue;
+        }
+        if (qs[q] >= 1.0) {
+            values[q] = kll->max;
+            continue;
+        }
+        // First item whose cumulative weight passes q of the total
+        double target = qs[q] * (double)total;
+        uint64_t cumulative = 0;
+        size_t i = 0;
+        while (i + 1 < num_items && (double)(cumulative + items[i].weight) <= target) {
+            cumulative += items[i].weight;
+            i++;
+        }
+        values[q] = items[i].value;
+    }
+    free(items);
+    return true;
+}
+
+bool byte_struct_kll_quantile(byte_struct_kll_t *kll, double q, double *value) {
+    return byte_struct_kll_quantiles(kll, &q, 1, value);
+}
+
+// Estimated fraction of values <= value
+double byte_struct_kll_rank(byte_struct_kll_t *kll, double value) {
+    if (kll == NULL || kll->n == 0) return 0.0;
+    uint64_t below = 0, total = 0;
+    for (size_t h = 0; h < kll->num_levels; h++) {
+        byte_struct_kll_level_t *level = &kll->levels[h];
+        for (size_t i = 0; i < level->size; i++) {
+            total += 1ull << h;
+            if (level->items[i] <= value) below += 1ull << h;
+        }
+    }
+    return total == 0 ? 0.0 : (double)below / (double)total;
+}
+
+static inline uint64_t byte_struct_kll_double_bits(double value) {
+    uint64_t bits;
+    memcpy(&bits, &value, sizeof(bits));
+    return bits;
+}
+
+static inline double byte_struct_kll_bits_double(uint64_t bits) {
+    double value;
+    memcpy(&value, &bits, sizeof(value));
+    return value;
+}
+
+size_t byte_struct_kll_serialized_size(byte_struct_kll_t *kll) {
+    if (kll == NULL) return 0;
+    return BYTE_STRUCT_KLL_HEADER_SIZE + kll->num_levels * sizeof(uint64_t) + kll->size * sizeof(double);
+}
+
+bool byte_struct_kll_serialize(byte_struct_kll_t *kll, uint8_t *out) {
+    if (kll == NULL || out == NULL) return false;
+    write_uint32_little_endian(out, BYTE_STRUCT_KLL_MAGIC);
+    write_uint32_little_endian(out + 4, BYTE_STRUCT_SKETCH_LAYOUT_VERSION);
+    write_uint64_little_endian(out + 8, (uint64_t)kll->k);
+    write_uint64_little_endian(out + 16, (uint64_t)kll->field.type);
+    write_uint64_little_endian(out + 24, kll->n);
+    write_uint64_little_endian(out + 32, byte_struct_kll_double_bits(kll->min));
+    write_uint64_little_endian(out + 40, byte_struct_kll_double_bits(kll->max));
+    write_uint64_little_endian(out + 48, (uint64_t)kll->num_levels);
+    uint8_t *p = out + BYTE_STRUCT_KLL_HEADER_SIZE;
+    for (size_t h = 0; h < kll->num_levels; h++) {
+        write_uint64_little_endian(p, (uint64_t)kll->levels[h].size);
+        p += sizeof(uint64_t);
+    }
+    for (size_t h = 0; h < kll->num_levels; h++) {
+        for (size_t i = 0; i < kll->levels[h].size; i++) {
+            write_uint64_little_endian(p, byte_struct_kll_double_bits(kll->levels[h].items[i]));
+            p += sizeof(uint64_t);
+        }
+    }
+    return true;
+}
+
+void byte_struct_kll_destroy(byte_struct_kll_t *kll);
+
+/*
+Reads a sketch back for further ingest and merging with records of s, field
+must have the type it was built on.
+*/
+byte_struct_kll_t *byte_struct_kll_deserialize(byte_struct_t *s, type_offset_t *field, uint8_t *data, size_t len) {
+    if (data == NULL || len < BYTE_STRUCT_KLL_HEADER_SIZE) return NULL;
+    if (read_uint32_little_endian(data) != BYTE_STRUCT_KLL_MAGIC) return NULL;
+    if (read_uint32_little_endian(data + 4) != BYTE_STRUCT_SKETCH_LAYOUT_VERSION) return NULL;
+    uint64_t k = read_uint64_little_endian(data + 8);
+    uint64_t type = read_uint64_little_endian(data + 16);
+    uint64_t num_levels = read_uint64_little_endian(data + 48);
+    if (k < BYTE_STRUCT_KLL_MIN_K || k > UINT32_MAX) return NULL;
+    if (num_levels == 0 || num_levels > BYTE_STRUCT_KLL_MAX_LEVELS) return NULL;
+    if (field == NULL || type != (uint64_t)field->type) return NULL;
+    size_t remaining = len - BYTE_STRUCT_KLL_HEADER_SIZE;
+    if (remaining / sizeof(uint64_t) < num_levels) return NULL;
+    remaining -= num_levels * sizeof(uint64_t);
+
+    byte_struct_kll_t *kll = byte_struct_kll_new(s, field, (uint32_t)k);
+    if (kll == NULL) return NULL;
+    while (kll->num_levels < num_levels) byte_struct_kll_add_level(kll);
+    kll->n = read_uint64_little_endian(data + 24);
+    kll->min = byte_struct_kll_bits_double(read_uint64_little_endian(data + 32));
+    kll->max = byte_struct_kll_bits_double(read_uint64_little_endian(data + 40));
+    uint8_t *sizes = data + BYTE_STRUCT_KLL_HEADER_SIZE;
+    uint8_t *p = sizes + num_levels * sizeof(uint64_t);
+    for (size_t h = 0; h < num_levels; h++) {
+        uint64_t size = read_uint64_little_endian(sizes + h * sizeof(uint64_t));
+        byte_struct_kll_level_t *level = &kll->levels[h];
+        if (size > remaining / sizeof(double) || !byte_struct_kll_reserve(level, (size_t)size)) {
+            byte_struct_kll_destroy(kll);
+            return NULL;
+        }
+        for (size_t i = 0; i < size; i++) {
+            level->items[i] = byte_struct_kll_bits_double(read_uint64_little_endian(p));
+            p += sizeof(uint64_t);
+        }
+        level->size = (size_t)size;
+        kll->size += (size_t)size;
+        remaining -= (size_t)size * sizeof(double);
+    }
+    if (!byte_struct_kll_compress(kll)) {
+        byte_struct_kll_destroy(kll);
+        return NULL;
+    }
+    return kll;
+}
+
+void byte_struct_kll_destroy(byte_struct_kll_t *kll) {
+    if (kll == NULL) return;
+    for (size_t h = 0; h < kll->num_levels; h++) {
+        free(kll->levels[h].items);
+    }
+    free(kll);
+}
+
+#endif
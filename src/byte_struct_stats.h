@@ -0,0 +1,208 @@
+#ifndef BYTE_STRUCT_STATS_H
+#define BYTE_STRUCT_STATS_H
+
+/*
+Hot path counters and sampled latency histograms, compiled in with
+-DBYTE_STRUCT_STATS. Included from byte_struct.h, don't include directly.
+
+Counters are per thread (plain increments, no shared cache lines). Each thread's
+block is pushed onto a global list the first time it records anything, and
+byte_struct_stats_snapshot sums over the list. Blocks are never freed, they're
+a few hundred bytes per thread that ever touched the library.
+*/
+
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "byte_struct_atomic.h"
+
+#ifdef _WIN32
+#include <windows.h>
+#endif
+
+#if defined(__STDC_VERSION__) && __STDC_VERSION__ >= 201112L && !defined(__STDC_NO_THREADS__)
+#define BYTE_STRUCT_THREAD_LOCAL _Thread_local
+#elif defined(_MSC_VER)
+#define BYTE_STRUCT_THREAD_LOCAL __declspec(thread)
+#else
+#define BYTE_STRUCT_THREAD_LOCAL __thread
+#endif
+
+// Time one call in every BYTE_STRUCT_STATS_SAMPLE_RATE per thread
+#ifndef BYTE_STRUCT_STATS_SAMPLE_RATE
+#define BYTE_STRUCT_STATS_SAMPLE_RATE 64
+#endif
+
+#define BYTE_STRUCT_LATENCY_BUCKETS 64
+
+typedef struct byte_struct_stats {
+    uint64_t parse_calls;
+    uint64_t parse_failures;
+    uint64_t pack_calls;
+    uint64_t pack_records;
+    uint64_t pack_bytes;
+    uint64_t unpack_calls;
+    uint64_t unpack_records;
+    uint64_t unpack_bytes;
+    uint64_t null_schema_failures;
+    uint64_t null_data_failures;
+    uint64_t short_data_failures;
+    uint64_t pack_bytes_by_order[BYTE_STRUCT_NUM_BYTE_ORDERS];
+    uint64_t unpack_bytes_by_order[BYTE_STRUCT_NUM_BYTE_ORDERS];
+    uint64_t pack_fields_by_type[BYTE_STRUCT_NUM_TYPES];
+    uint64_t unpack_fields_by_type[BYTE_STRUCT_NUM_TYPES];
+} byte_struct_stats_t;
+
+#define BYTE_STRUCT_STATS_NUM_COUNTERS (sizeof(byte_struct_stats_t) / sizeof(uint64_t))
+
+typedef struct byte_struct_stats_thread {
+    byte_struct_stats_t stats;
+    uint64_t sample_counter;
+    struct byte_struct_stats_thread *next;
+} byte_struct_stats_thread_t;
+
+/*
+Bucket i counts sampled calls that took [2^i, 2^(i+1)) nanoseconds,
+bucket 0 also holds sub-nanosecond samples.
+*/
+typedef struct byte_struct_latency_histogram {
+    uint64_t pack[BYTE_STRUCT_LATENCY_BUCKETS];
+    uint64_t unpack[BYTE_STRUCT_LATENCY_BUCKETS];
+} byte_struct_latency_histogram_t;
+
+typedef struct byte_struct_latency {
+    volatile uint64_t pack[BYTE_STRUCT_LATENCY_BUCKETS];
+    volatile uint64_t unpack[BYTE_STRUCT_LATENCY_BUCKETS];
+} byte_struct_latency_t;
+
+static volatile uint64_t byte_struct_stats_head = 0;
+static byte_struct_stats_thread_t byte_struct_stats_fallback;
+static byte_struct_stats_t byte_struct_stats_baseline;
+static BYTE_STRUCT_THREAD_LOCAL byte_struct_stats_thread_t *byte_struct_stats_thread = NULL;
+
+static byte_struct_stats_thread_t *byte_struct_stats_register(void) {
+    byte_struct_stats_thread_t *thread_stats = calloc(1, sizeof(byte_struct_stats_thread_t));
+    if (thread_stats == NULL) {
+        // Shared and racy, but keeps counting rather than failing the call
+        byte_struct_stats_thread = &byte_struct_stats_fallback;
+        return byte_struct_stats_thread;
+    }
+    uint64_t head = byte_struct_atomic_load(&byte_struct_stats_head);
+    do {
+        thread_stats->next = (byte_struct_stats_thread_t *)(uintptr_t)head;
+    } while (!byte_struct_atomic_cas(&byte_struct_stats_head, &head, (uint64_t)(uintptr_t)thread_stats));
+    byte_struct_stats_thread = thread_stats;
+    return thread_stats;
+}
+
+static inline byte_struct_stats_t *byte_struct_stats_local(void) {
+    byte_struct_stats_thread_t *thread_stats = byte_struct_stats_thread;
+    if (thread_stats == NULL) thread_stats = byte_struct_stats_register();
+    return &thread_stats->stats;
+}
+
+static inline uint64_t byte_struct_stats_now_ns(void) {
+#if defined(_WIN32)
+    LARGE_INTEGER freq, counter;
+    QueryPerformanceFrequency(&freq);
+    QueryPerformanceCounter(&counter);
+    return (uint64_t)((double)counter.QuadPart * 1e9 / (double)freq.QuadPart);
+#elif defined(CLOCK_MONOTONIC)
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ull + (uint64_t)ts.tv_nsec;
+#else
+    // Strict C99 without POSIX timers, coarse but still gives the distribution shape
+    return (uint64_t)((double)clock() * (1e9 / CLOCKS_PER_SEC));
+#endif
+}
+
+// Returns a start timestamp for sampled calls, 0 otherwise
+static inline uint64_t byte_struct_stats_sample_start(void) {
+    byte_struct_stats_local();
+    if (byte_struct_stats_thread->sample_counter++ % BYTE_STRUCT_STATS_SAMPLE_RATE != 0) return 0;
+    return byte_struct_stats_now_ns();
+}
+
+static inline void byte_struct_stats_sample_end(volatile uint64_t *buckets, uint64_t start) {
+    if (start == 0) return;
+    uint64_t elapsed = byte_struct_stats_now_ns() - start;
+    size_t bucket = 0;
+    while (elapsed > 1 && bucket < BYTE_STRUCT_LATENCY_BUCKETS - 1) {
+        elapsed >>= 1;
+        bucket++;
+    }
+    byte_struct_atomic_fetch_add(&buckets[bucket], 1);
+}
+
+static void byte_struct_stats_sum(byte_struct_stats_t *out) {
+    uint64_t *totals = (uint64_t *)out;
+    memset(out, 0, sizeof(byte_struct_stats_t));
+    byte_struct_stats_thread_t *thread_stats = (byte_struct_stats_thread_t *)(uintptr_t)byte_struct_atomic_load(&byte_struct_stats_head);
+    for (; thread_stats != NULL; thread_stats = thread_stats->next) {
+        volatile uint64_t *counters = (volatile uint64_t *)&thread_stats->stats;
+        for (size_t i = 0; i < BYTE_STRUCT_STATS_NUM_COUNTERS; i++) {
+            totals[i] += counters[i];
+        }
+    }
+    volatile uint64_t *fallback = (volatile uint64_t *)&byte_struct_stats_fallback.stats;
+    for (size_t i = 0; i < BYTE_STRUCT_STATS_NUM_COUNTERS; i++) {
+        totals[i] += fallback[i];
+    }
+}
+
+/*
+Counters since the last reset, summed over all threads. Threads that are
+mid-call may or may not be included, so treat this as a point-in-time estimate.
+*/
+void byte_struct_stats_snapshot(byte_struct_stats_t *out) {
+    if (out == NULL) return;
+    byte_struct_stats_sum(out);
+    uint64_t *totals = (uint64_t *)out;
+    uint64_t *baseline = (uint64_t *)&byte_struct_stats_baseline;
+    for (size_t i = 0; i < BYTE_STRUCT_STATS_NUM_COUNTERS; i++) {
+        totals[i] -= baseline[i];
+    }
+}
+
+// Other threads own their counters, so reset moves the baseline instead of writing them
+void byte_struct_stats_reset(void) {
+    byte_struct_stats_sum(&byte_struct_stats_baseline);
+}
+
+static inline void byte_struct_latency_record(byte_struct_t *s, bool pack, uint64_t start) {
+    if (s->latency == NULL) return;
+    byte_struct_stats_sample_end(pack ? s->latency->pack : s->latency->unpack, start);
+}
+
+// Sampled byte_struct_pack/byte_struct_unpack latencies for one schema
+bool byte_struct_latency_snapshot(byte_struct_t *s, byte_struct_latency_histogram_t *out) {
+    if (s == NULL || s->latency == NULL || out == NULL) return false;
+    for (size_t i = 0; i < BYTE_STRUCT_LATENCY_BUCKETS; i++) {
+        out->pack[i] = byte_struct_atomic_load_relaxed(&s->latency->pack[i]);
+        out->unpack[i] = byte_struct_atomic_load_relaxed(&s->latency->unpack[i]);
+    }
+    return true;
+}
+
+void byte_struct_latency_reset(byte_struct_t *s) {
+    if (s == NULL || s->latency == NULL) return;
+    for (size_t i = 0; i < BYTE_STRUCT_LATENCY_BUCKETS; i++) {
+        byte_struct_atomic_store(&s->latency->pack[i], 0);
+        byte_struct_atomic_store(&s->latency->unpack[i], 0);
+    }
+}
+
+#define BYTE_STRUCT_STATS_ADD(counter, n) (byte_struct_stats_local()->counter += (n))
+#define BYTE_STRUCT_STATS_RECORDS(op, s, n) do { \
+    byte_struct_stats_t *stats_ = byte_struct_stats_local(); \
+    stats_->op##_records += (n); \
+    stats_->op##_bytes += (uint64_t)(n) * (s)->total_size; \
+    stats_->op##_bytes_by_order[(s)->byte_order] += (uint64_t)(n) * (s)->total_size; \
+} while (0)
+#define BYTE_STRUCT_STATS_SAMPLE_START(start) uint64_t start = byte_struct_stats_sample_start()
+#define BYTE_STRUCT_STATS_SAMPLE_END(s, op, start) byte_struct_latency_record((s), op, (start))
+
+#endif
@@ -0,0 +1,271 @@
+#ifndef BYTE_STRUCT_TOPK_H
+#define BYTE_STRUCT_TOPK_H
+
+#include <stdint.h>
+#include <stdlib.h>
+#include <stdbool.h>
+#include <string.h>
+
+#include "byte_struct.h"
+
+/*
+Top-k selection by the leading fields of BYTE_STRUCT_SORTABLE records, compared
+with memcmp like byte_struct_sort, without sorting the whole input. "Top" is
+the front of the sort order: the smallest keys, or the largest for fields
+declared descending ('-').
+
+byte_struct_topk_t is for streams: a fixed-capacity max-heap of inline records
+whose root is the worst record kept. Once full, a candidate is first compared
+with the root and dropped unless it beats it, which for large inputs is almost
+every candidate, so the cost is close to one memcmp per record. Which of several
+records with keys equal to the cutoff are kept is unspecified.
+
+byte_struct_select_nth and byte_struct_partial_sort work in place on a buffer
+already in memory, like std::nth_element and std::partial_sort.
+*/
+
+#define BYTE_STRUCT_SELECT_INSERTION_THRESHOLD 16
+
+typedef struct byte_struct_topk {
+    size_t record_size;
+    size_t key_len;
+    size_t capacity;
+    size_t n;
+    // n records in heap order, heap[0] is the cutoff
+    uint8_t *heap;
+    uint8_t *tmp;
+} byte_struct_topk_t;
+
+static inline uint8_t *byte_struct_topk_record(byte_struct_topk_t *topk, size_t i) {
+    return topk->heap + i * topk->record_size;
+}
+
+static inline int byte_struct_topk_compare(byte_struct_topk_t *topk, size_t i, size_t j) {
+    return memcmp(byte_struct_topk_record(topk, i), byte_struct_topk_record(topk, j), topk->key_len);
+}
+
+static void byte_struct_topk_swap(uint8_t *a, uint8_t *b, uint8_t *tmp, size_t size) {
+    memcpy(tmp, a, size);
+    memcpy(a, b, size);
+    memcpy(b, tmp, size);
+}
+
+static void byte_struct_topk_sift_down(byte_struct_topk_t *topk, size_t i) {
+    size_t n = topk->n;
+    while (true) {
+        size_t largest = i;
+        size_t left = 2 * i + 1;
+        size_t right = left + 1;
+        if (left < n && byte_struct_topk_compare(topk, left, largest) > 0) largest = left;
+        if (right < n && byte_struct_topk_compare(topk, right, largest) > 0) largest = right;
+        if (largest == i) return;
+        byte_struct_topk_swap(byte_struct_topk_record(topk, i), byte_struct_topk_record(topk, largest), topk->tmp, topk->record_size);
+        i = largest;
+    }
+}
+
+static void byte_struct_topk_sift_up(byte_struct_topk_t *topk, size_t i) {
+    while (i > 0) {
+        size_t parent = (i - 1) / 2;
+        if (byte_struct_topk_compare(topk, parent, i) >= 0) return;
+        byte_struct_topk_swap(byte_struct_topk_record(topk, i), byte_struct_topk_record(topk, parent), topk->tmp, topk->record_size);
+        i = parent;
+    }
+}
+
+// Keeps the k best records of s by their first prefix_fields fields
+byte_struct_topk_t *byte_struct_topk_new(byte_struct_t *s, size_t k, size_t prefix_fields) {
+    if (s == NULL || s->byte_order != BYTE_STRUCT_SORTABLE || k == 0) return NULL;
+    if (prefix_fields == 0 || prefix_fields > s->num_fields) return NULL;
+    if (k > SIZE_MAX / s->total_size - 1) return NULL;
+    byte_struct_topk_t *topk = malloc(sizeof(byte_struct_topk_t));
+    if (topk == NULL) return NULL;
+    topk->record_size = s->total_size;
+    topk->key_len = byte_struct_prefix_size(s, prefix_fields);
+    topk->capacity = k;
+    topk->n = 0;
+    // one extra record of scratch for swaps
+    topk->heap = malloc((k + 1) * s->total_size);
+    if (topk->heap == NULL) {
+        free(topk);
+        return NULL;
+    }
+    topk->tmp = topk->heap + k * s->total_size;
+    return topk;
+}
+
+// True if record made it into the top k (so far)
+bool byte_struct_topk_push(byte_struct_topk_t *topk, uint8_t *record) {
+    if (topk == NULL || record == NULL) return false;
+    if (topk->n < topk->capacity) {
+        memcpy(byte_struct_topk_record(topk, topk->n), record, topk->record_size);
+        byte_struct_topk_sift_up(topk, topk->n++);
+        return true;
+    }
+    if (memcmp(record, topk->heap, topk->key_len) >= 0) return false;
+    memcpy(topk->heap, record, topk->record_size);
+    byte_struct_topk_sift_down(topk, 0);
+    return true;
+}
+
+// Pushes n consecutive records, returns how many were kept at the time
+size_t byte_struct_topk_push_batch(byte_struct_topk_t *topk, uint8_t *data, size_t n) {
+    if (topk == NULL || data == NULL) return 0;
+    size_t size = topk->record_size;
+    size_t key_len = topk->key_len;
+    size_t kept = 0;
+    size_t i = 0;
+    for (; i < n && topk->n < topk->capacity; i++) {
+        kept += byte_struct_topk_push(topk, data + i * size);
+    }
+    for (; i < n; i++) {
+        uint8_t *record = data + i * size;
+        // the cutoff check, the only work for most records
+        if (memcmp(record, topk->heap, key_len) >= 0) continue;
+        memcpy(topk->heap, record, size);
+        byte_struct_topk_sift_down(topk, 0);
+        kept++;
+    }
+    return kept;
+}
+
+size_t byte_struct_topk_size(byte_struct_topk_t *topk) {
+    return topk == NULL ? 0 : topk->n;
+}
+
+// Sorts a valid heap in place by repeatedly moving the worst record to the end
+static void byte_struct_topk_heap_sort(byte_struct_topk_t *heap) {
+    size_t size = heap->record_size;
+    for (size_t end = heap->n; end > 1; end--) {
+        byte_struct_topk_swap(heap->heap, byte_struct_topk_record(heap, end - 1), heap->tmp, size);
+        heap->n = end - 1;
+        byte_struct_topk_sift_down(heap, 0);
+    }
+}
+
+/*
+Copies the records kept so far to out in order, best first, and returns how
+many. The heap is left as it is, so pushing can continue.
+*/
+size_t byte_struct_topk_result(byte_struct_topk_t *topk, uint8_t *out) {
+    if (topk == NULL || out == NULL) return 0;
+    size_t n = topk->n;
+    memcpy(out, topk->heap, n * topk->record_size);
+    byte_struct_topk_t sorted = *topk;
+    sorted.heap = out;
+    byte_struct_topk_heap_sort(&sorted);
+    return n;
+}
+
+void byte_struct_topk_reset(byte_struct_topk_t *topk) {
+    if (topk != NULL) topk->n = 0;
+}
+
+void byte_struct_topk_destroy(byte_struct_topk_t *topk) {
+    if (topk == NULL) return;
+    free(topk->heap);
+    free(topk);
+}
+
+static void byte_struct_select_insertion_sort(uint8_t *data, size_t n, size_t size, size_t key_len, uint8_t *tmp) {
+    for (size_t i = 1; i < n; i++) {
+        size_t j = i;
+        if (memcmp(data + (j - 1) * size, data + j * size, key_len) <= 0) continue;
+        memcpy(tmp, data + i * size, size);
+        while (j > 0 && memcmp(data + (j - 1) * size, tmp, key_len) > 0) {
+            j--;
+        }
+        memmove(data + (j + 1) * size, data + j * size, (i - j) * size);
+        memcpy(data + j * size, tmp, size);
+    }
+}
+
+/*
+Quickselect with median-of-three pivots. Past 2 log2(n) rounds (adversarial
+input) the remaining range is merge sorted instead, so the worst case stays
+O(n log n).
+*/
+static bool byte_struct_select_range(uint8_t *data, size_t n, size_t nth, size_t size, size_t key_len, uint8_t *scratch) {
+    uint8_t *pivot = scratch;
+    uint8_t *tmp = scratch + size;
+    size_t lo = 0, hi = n - 1;
+    size_t depth = 0;
+    for (size_t m = n; m > 1; m >>= 1) depth += 2;
+
+    while (hi - lo + 1 > BYTE_STRUCT_SELECT_INSERTION_THRESHOLD) {
+        if (depth-- == 0) {
+            // Full-record order is also key order since the key is a prefix
+            uint8_t *sort_tmp = malloc((hi - lo + 1) * size);
+            if (sort_tmp == NULL) return false;
+            byte_struct_sort_records(data + lo * size, hi - lo + 1, size, sort_tmp);
+            free(sort_tmp);
+            return true;
+        }
+        size_t mid = lo + (hi - lo) / 2;
+        uint8_t *a = data + lo * size, *b = data + mid * size, *c = data + hi * size;
+        uint8_t *median;
+        if (memcmp(a, b, key_len) < 0) {
+            median = memcmp(b, c, key_len) < 0 ? b : (memcmp(a, c, key_len) < 0 ? c : a);
+        } else {
+            median = memcmp(a, c, key_len) < 0 ? a : (memcmp(b, c, key_len) < 0 ? c : b);
+        }
+        memcpy(pivot, median, size);
+
+        // Hoare partition, the pivot's value in the range keeps both scans in bounds
+        size_t i = lo, j = hi;
+        while (i <= j) {
+            while (memcmp(data + i * size, pivot, key_len) < 0) i++;
+            while (memcmp(data + j * size, pivot, key_len) > 0) j--;
+            if (i > j) break;
+            if (i != j) byte_struct_topk_swap(data + i * size, data + j * size, tmp, size);
+            i++;
+            // j wraps to SIZE_MAX when everything from 0 on is >= pivot
+            if (j-- == 0) break;
+        }
+        // [lo, j] <= pivot, (j, i) == pivot, [i, hi] >= pivot
+        if (j != SIZE_MAX && nth <= j) {
+            hi = j;
+        } else if (nth >= i) {
+            lo = i;
+        } else {
+            return true;
+        }
+    }
+    byte_struct_select_insertion_sort(data + lo * size, hi - lo + 1, size, key_len, tmp);
+    return true;
+}
+
+/*
+Reorders n records of s so record nth is the one a sort by the first
+prefix_fields fields would put there, records before it have keys <= its key
+and records after it >= its key. Neither side is sorted.
+*/
+bool byte_struct_select_nth(byte_struct_t *s, uint8_t *data, size_t n, size_t nth, size_t prefix_fields) {
+    if (s == NULL || s->byte_order != BYTE_STRUCT_SORTABLE || data == NULL) return false;
+    if (prefix_fields == 0 || prefix_fields > s->num_fields) return false;
+    if (nth >= n) return n == 0;
+    uint8_t *scratch = malloc(2 * s->total_size);
+    if (scratch == NULL) return false;
+    bool ok = byte_struct_select_range(data, n, nth, s->total_size, byte_struct_prefix_size(s, prefix_fields), scratch);
+    free(scratch);
+    return ok;
+}
+
+// Puts the k best records, sorted by key, at the front of data
+bool byte_struct_partial_sort(byte_struct_t *s, uint8_t *data, size_t n, size_t k, size_t prefix_fields) {
+    if (k > n) k = n;
+    if (k == 0) return s != NULL && data != NULL;
+    if (!byte_struct_select_nth(s, data, n, k - 1, prefix_fields)) return false;
+    uint8_t *tmp = malloc(s->total_size);
+    if (tmp == NULL) return false;
+    // Heapify the front k in place and heap sort it
+    byte_struct_topk_t heap = {.record_size = s->total_size, .key_len = byte_struct_prefix_size(s, prefix_fields), .capacity = k, .n = k, .heap = data, .tmp = tmp};
+    for (size_t i = k / 2; i > 0; i--) {
+        byte_struct_topk_sift_down(&heap, i - 1);
+    }
+    byte_struct_topk_heap_sort(&heap);
+    free(tmp);
+    return true;
+}
+
+#endif
@@ -0,0 +1,702 @@
+#ifndef BYTE_STRUCT_TRANSCODE_H
+#define BYTE_STRUCT_TRANSCODE_H
+
+#include <stdlib.h>
+#include <stdbool.h>
+#include <string.h>
+
+#include "byte_struct.h"
+#include "byte_struct_parallel.h"
+
+/*
+Transcoder between two schemas (and/or byte orders) compiled from a field
+mapping. Each destination field becomes one op:
+
+- COPY: encodings are byte-identical, memcpy
+- TRANSFORM: same element width, dst bytes = permute(src bytes) ^ mask where
+  permute is identity or a byte reversal (endian swap) and mask handles sign
+  flips. Chosen by probing the real encoders, so e.g. BIG_ENDIAN <-> SORTABLE
+  for unsigned ints is a copy, for signed ints a sign-bit flip and flipping a
+  field's sort direction a complement.
+- WIDEN: integer to a wider integer that holds every source value, e.g. int16
+  to int32 or uint8 to int64. A transform brings each element to plain
+  big-endian, it is sign or zero-extended to the destination width and a
+  second transform takes it to the destination encoding.
+- CONVERT: anything else (int <-> float, narrowing, sortable floats), decoded
+  and re-encoded element by element
+- DEFAULT: destination field with no source, gets the encoding of zero, or
+  null if the destination field is nullable
+
+A field that is nullable on either side always CONVERTs: nulls stay null when
+both sides are nullable and become zero when only the source is.
+
+An 'r' field mapped to an 'r' field carries its stored offset over unchanged,
+like byte_struct_convert, so a transcoded pool links within itself. That only
+holds while the field keeps its position and the record size stays the same, so
+mappings that move one fail. Mapped to any other type, 'r' fields are resolved
+against the source record like unpack does.
+
+Adjacent ops of the same kind are merged, and ops run column-at-a-time over
+blocks of records so the inner loops are simple strided byte loops.
+*/
+
+// field_map value for destination fields that have no source field
+#define BYTE_STRUCT_TRANSCODE_DEFAULT SIZE_MAX
+
+#define BYTE_STRUCT_TRANSCODE_BLOCK_RECORDS 64
+#define BYTE_STRUCT_TRANSCODE_MAX_ELEMENT_SIZE 8
+
+typedef enum {
+    BYTE_STRUCT_TRANSCODE_COPY,
+    BYTE_STRUCT_TRANSCODE_TRANSFORM,
+    BYTE_STRUCT_TRANSCODE_WIDEN,
+    BYTE_STRUCT_TRANSCODE_CONVERT,
+    BYTE_STRUCT_TRANSCODE_DEFAULT_VALUE
+} byte_struct_transcode_op_type_t;
+
+typedef struct byte_struct_transcode_op {
+    byte_struct_transcode_op_type_t op_type;
+    size_t src_offset;
+    size_t dst_offset;
+    // COPY/DEFAULT: size in bytes, TRANSFORM/WIDEN: src element width
+    size_t size;
+    size_t count;
+    bool reverse;
+    uint8_t mask[BYTE_STRUCT_TRANSCODE_MAX_ELEMENT_SIZE];
+    // WIDEN only: reverse and mask above give plain big-endian src elements, these encode the extended value
+    size_t dst_size;
+    bool sign_extend;
+    bool dst_reverse;
+    uint8_t dst_mask[BYTE_STRUCT_TRANSCODE_MAX_ELEMENT_SIZE];
+    // CONVERT only
+    type_offset_t src_field;
+    type_offset_t dst_field;
+} byte_struct_transcode_op_t;
+
+typedef struct byte_struct_transcoder {
+    byte_struct_t *src;
+    byte_struct_t *dst;
+    size_t num_ops;
+    byte_struct_transcode_op_t *ops;
+    // dst record with every field encoding zero, source of DEFAULT ops
+    uint8_t *default_record;
+} byte_struct_transcoder_t;
+
+typedef union byte_struct_transcode_value {
+    char c;
+    int8_t i8;
+    uint8_t u8;
+    int16_t i16;
+    uint16_t u16;
+    int32_t i32;
+    uint32_t u32;
+    int64_t i64;
+    uint64_t u64;
+    float f;
+    double d;
+    void *p;
+} byte_struct_transcode_value_t;
+
+static void byte_struct_transcode_value_convert(byte_struct_type_t src_type, byte_struct_transcode_value_t *src, byte_struct_type_t dst_type, byte_struct_transcode_value_t *dst) {
+    bool is_float = false, is_signed = false;
+    double d = 0.0;
+    int64_t i = 0;
+    uint64_t u = 0;
+    switch (src_type) {
+        case BYTE_STRUCT_TYPE_CHAR: i = src->c; is_signed = true; break;
+        case BYTE_STRUCT_TYPE_INT8: i = src->i8; is_signed = true; break;
+        case BYTE_STRUCT_TYPE_UINT8: u = src->u8; break;
+        case BYTE_STRUCT_TYPE_INT16: i = src->i16; is_signed = true; break;
+        case BYTE_STRUCT_TYPE_UINT16: u = src->u16; break;
+        case BYTE_STRUCT_TYPE_INT32: i = src->i32; is_signed = true; break;
+        case BYTE_STRUCT_TYPE_UINT32: u = src->u32; break;
+        case BYTE_STRUCT_TYPE_INT64: i = src->i64; is_signed = true; break;
+        case BYTE_STRUCT_TYPE_UINT64: u = src->u64; break;
+        case BYTE_STRUCT_TYPE_FLOAT: d = src->f; is_float = true; break;
+        case BYTE_STRUCT_TYPE_DOUBLE: d = src->d; is_float = true; break;
+        case BYTE_STRUCT_TYPE_HALF:
+        case BYTE_STRUCT_TYPE_BFLOAT16: d = src->f; is_float = true; break;
+        case BYTE_STRUCT_TYPE_PTR: u = (uint64_t)(uintptr_t)src->p; break;
+        case BYTE_STRUCT_TYPE_RELPTR: u = (uint64_t)(uintptr_t)src->p; break;
+        case BYTE_STRUCT_TYPE_GROUP: break;
+    }
+    if (is_float) {
+        // Saturate out of range values rather than hitting undefined conversions
+        if (d != d) {
+            i = 0;
+        } else if (d >= 9223372036854775807.0) {
+            i = INT64_MAX;
+        } else if (d <= -9223372036854775808.0) {
+            i = INT64_MIN;
+        } else {
+            i = (int64_t)d;
+        }
+        if (d >= 18446744073709551615.0) {
+            u = UINT64_MAX;
+        } else {
+            u = d > 0.0 ? (uint64_t)d : (uint64_t)i;
+        }
+    } else if (is_signed) {
+        u = (uint64_t)i;
+        d = (double)i;
+    } else {
+        i = (int64_t)u;
+        d = (double)u;
+    }
+    switch (dst_type) {
+        case BYTE_STRUCT_TYPE_CHAR: dst->c = (char)i; break;
+        case BYTE_STRUCT_TYPE_INT8: dst->i8 = (int8_t)i; break;
+        case BYTE_STRUCT_TYPE_UINT8: dst->u8 = (uint8_t)u; break;
+        case BYTE_STRUCT_TYPE_INT16: dst->i16 = (int16_t)i; break;
+        case BYTE_STRUCT_TYPE_UINT16: dst->u16 = (uint16_t)u; break;
+        case BYTE_STRUCT_TYPE_INT32: dst->i32 = (int32_t)i; break;
+        case BYTE_STRUCT_TYPE_UINT32: dst->u32 = (uint32_t)u; break;
+        case BYTE_STRUCT_TYPE_INT64: dst->i64 = i; break;
+        case BYTE_STRUCT_TYPE_UINT64: dst->u64 = u; break;
+        case BYTE_STRUCT_TYPE_FLOAT: dst->f = (float)d; break;
+        case BYTE_STRUCT_TYPE_DOUBLE: dst->d = d; break;
+        case BYTE_STRUCT_TYPE_HALF:
+        case BYTE_STRUCT_TYPE_BFLOAT16: dst->f = (float)d; break;
+        case BYTE_STRUCT_TYPE_PTR: dst->p = (void *)(uintptr_t)u; break;
+        case BYTE_STRUCT_TYPE_RELPTR: dst->p = (void *)(uintptr_t)u; break;
+        case BYTE_STRUCT_TYPE_GROUP: break;
+    }
+}
+
+// An 'r' field mapped to an 'r' field, directly or as group members
+static bool byte_struct_transcode_relptr_mapped(byte_struct_t *src, type_offset_t *src_field, byte_struct_t *dst, type_offset_t *dst_field) {
+    if (src_field->type == BYTE_STRUCT_TYPE_RELPTR && dst_field->type == BYTE_STRUCT_TYPE_RELPTR) return true;
+    if (src_field->type != BYTE_STRUCT_TYPE_GROUP || dst_field->type != BYTE_STRUCT_TYPE_GROUP) return false;
+    size_t num_children = src_field->num_children < dst_field->num_children ? src_field->num_children : dst_field->num_children;
+    for (size_t c = 0; c < num_children; c++) {
+        if (byte_struct_transcode_relptr_mapped(src, &src->type_offsets[src_field->first_child + c], dst, &dst->type_offsets[dst_field->first_child + c])) return true;
+    }
+    return false;
+}
+
+// Offsets carried over stay valid only if those 'r' fields keep their position
+static bool byte_struct_transcode_relptrs_fixed(byte_struct_t *src, type_offset_t *src_field, byte_struct_t *dst, type_offset_t *dst_field) {
+    if (!byte_struct_transcode_relptr_mapped(src, src_field, dst, dst_field)) return true;
+    if (src_field->offset != dst_field->offset || src_field->size != dst_field->size) return false;
+    if (src_field->type != BYTE_STRUCT_TYPE_GROUP) return true;
+    for (size_t c = 0; c < src_field->num_children; c++) {
+        if (!byte_struct_transcode_relptrs_fixed(src, &src->type_offsets[src_field->first_child + c], dst, &dst->type_offsets[dst_field->first_child + c])) {
+            return false;
+        }
+    }
+    return true;
+}
+
+// 'r' to 'r' goes through the stored offset as a plain int64
+static void byte_struct_transcode_relptr_offsets(type_offset_t *src_element, type_offset_t *dst_element) {
+    if (src_element->type != BYTE_STRUCT_TYPE_RELPTR || dst_element->type != BYTE_STRUCT_TYPE_RELPTR) return;
+    src_element->type = dst_element->type = BYTE_STRUCT_TYPE_INT64;
+    src_element->native_size = dst_element->native_size = sizeof(int64_t);
+}
+
+/*
+Groups transcode member by member, so both sides must have the same shape:
+same number of members with groups in the same positions.
+*/
+static bool byte_struct_transcode_groups_compatible(byte_struct_t *src, type_offset_t *src_field, byte_struct_t *dst, type_offset_t *dst_field) {
+    bool src_group = src_field->type == BYTE_STRUCT_TYPE_GROUP;
+    bool dst_group = dst_field->type == BYTE_STRUCT_TYPE_GROUP;
+    if (src_group != dst_group) return false;
+    if (!src_group) return true;
+    if (src_field->num_children != dst_field->num_children) return false;
+    for (size_t c = 0; c < src_field->num_children; c++) {
+        if (!byte_struct_transcode_groups_compatible(src, &src->type_offsets[src_field->first_child + c], dst, &dst->type_offsets[dst_field->first_child + c])) {
+            return false;
+        }
+    }
+    return true;
+}
+
+static void byte_struct_transcode_default_field(byte_struct_t *dst, type_offset_t *field, uint8_t *record, void *zeros);
+
+/*
+Element-wise decode, convert, encode for up to count elements of one field.
+Group members whose counts differ transcode the common prefix and zero the rest,
+like top-level fields.
+*/
+static void byte_struct_transcode_convert_elements(byte_struct_t *src, type_offset_t *src_field, uint8_t *src_record, byte_struct_t *dst, type_offset_t *dst_field, uint8_t *dst_record, size_t count) {
+    size_t src_size = src_field->size;
+    size_t dst_size = dst_field->size;
+    if (src_field->type == BYTE_STRUCT_TYPE_GROUP) {
+        for (size_t j = 0; j < count; j++) {
+            uint8_t *src_element = src_record + src_field->offset + j * src_size;
+            uint8_t *dst_element = dst_record + dst_field->offset + j * dst_size;
+            for (size_t c = 0; c < dst_field->num_children; c++) {
+                type_offset_t *src_child = &src->type_offsets[src_field->first_child + c];
+                type_offset_t *dst_child = &dst->type_offsets[dst_field->first_child + c];
+                size_t common = src_child->count < dst_child->count ? src_child->count : dst_child->count;
+                byte_struct_transcode_convert_elements(src, src_child, src_element, dst, dst_child, dst_element, common);
+                if (common < dst_child->count) {
+                    // Zero the elements the source doesn't have, the marker already came over with the rest
+                    uint64_t zeros[BYTE_STRUCT_CONVERT_SCRATCH_SIZE / sizeof(uint64_t)] = {0};
+                    type_offset_t tail = *dst_child;
+                    tail.offset = dst_child->offset + common * dst_child->size;
+                    tail.count = dst_child->count - common;
+                    tail.flags &= ~(uint32_t)BYTE_STRUCT_FIELD_NULLABLE;
+                    byte_struct_transcode_default_field(dst, &tail, dst_element, zeros);
+                }
+            }
+        }
+        return;
+    }
+    type_offset_t src_element = *src_field;
+    type_offset_t dst_element = *dst_field;
+    src_element.count = 1;
+    dst_element.count = 1;
+    byte_struct_transcode_relptr_offsets(&src_element, &dst_element);
+    for (size_t j = 0; j < count; j++) {
+        byte_struct_transcode_value_t src_value = {0}, dst_value = {0};
+        src_element.offset = src_field->offset + j * src_size;
+        dst_element.offset = dst_field->offset + j * dst_size;
+        byte_struct_unpack_field(src, &src_element, src_record, &src_value);
+        byte_struct_transcode_value_convert(src_element.type, &src_value, dst_element.type, &dst_value);
+        byte_struct_pack_field(dst, &dst_element, dst_record, &dst_value);
+    }
+    // Nulls hold the encoding of zero, so only the marker is left to carry over
+    if (byte_struct_is_null(src, src_record, src_field) && byte_struct_field_nullable(dst_field)) {
+        dst_record[dst_field->null_offset] = byte_struct_null_marker(dst_field, true);
+    }
+}
+
+#define BYTE_STRUCT_TRANSCODE_NUM_PROBES 8
+
+static void byte_struct_transcode_probe_value(byte_struct_type_t type, size_t probe, byte_struct_transcode_value_t *value) {
+    static const int64_t ints[BYTE_STRUCT_TRANSCODE_NUM_PROBES] = {0, 1, -1, 127, -128, 0x0102030405060708LL, INT64_MIN, INT64_MAX};
+    static const double floats[BYTE_STRUCT_TRANSCODE_NUM_PROBES] = {0.0, -0.0, 1.5, -2.25, 1e30, -1e-30, 65504.0, -3.0e38};
+    byte_struct_transcode_value_t source;
+    if (type == BYTE_STRUCT_TYPE_FLOAT || type == BYTE_STRUCT_TYPE_DOUBLE || type == BYTE_STRUCT_TYPE_HALF || type == BYTE_STRUCT_TYPE_BFLOAT16) {
+        source.d = floats[probe];
+        byte_struct_transcode_value_convert(BYTE_STRUCT_TYPE_DOUBLE, &source, type, value);
+    } else {
+        source.i64 = ints[probe];
+        byte_struct_transcode_value_convert(BYTE_STRUCT_TYPE_INT64, &source, type, value);
+    }
+}
+
+static void byte_struct_transcode_apply_element(uint8_t *dst, uint8_t *src, size_t size, bool reverse, uint8_t *mask) {
+    for (size_t b = 0; b < size; b++) {
+        dst[b] = src[reverse ? size - 1 - b : b] ^ mask[b];
+    }
+}
+
+// Constant element sizes let the compiler unroll and vectorize the byte loops
+#define BYTE_STRUCT_TRANSCODE_APPLY_RUN(size) \
+    if (reverse) { \
+        for (size_t j = 0; j < count; j++) { \
+            for (size_t b = 0; b < (size); b++) { \
+                dst[j * (size) + b] = src[j * (size) + (size) - 1 - b] ^ mask[b]; \
+            } \
+        } \
+    } else { \
+        for (size_t j = 0; j < count; j++) { \
+            for (size_t b = 0; b < (size); b++) { \
+                dst[j * (size) + b] = src[j * (size) + b] ^ mask[b]; \
+            } \
+        } \
+    }
+
+static void byte_struct_transcode_apply_run(uint8_t *dst, uint8_t *src, size_t size, size_t count, bool reverse, uint8_t *mask) {
+    switch (size) {
+        case 1:
+            BYTE_STRUCT_TRANSCODE_APPLY_RUN(1)
+            break;
+        case 2:
+            BYTE_STRUCT_TRANSCODE_APPLY_RUN(2)
+            break;
+        case 4:
+            BYTE_STRUCT_TRANSCODE_APPLY_RUN(4)
+            break;
+        case 8:
+            BYTE_STRUCT_TRANSCODE_APPLY_RUN(8)
+            break;
+        default:
+            for (size_t j = 0; j < count; j++) {
+                byte_struct_transcode_apply_element(dst + j * size, src + j * size, size, reverse, mask);
+            }
+            break;
+    }
+}
+
+// Decode to plain big-endian, extend with the sign byte or zeros, encode
+#define BYTE_STRUCT_TRANSCODE_WIDEN_RUN(src_size, dst_size) \
+    for (size_t j = 0; j < count; j++) { \
+        uint8_t wide[(dst_size)]; \
+        for (size_t b = 0; b < (src_size); b++) { \
+            wide[(dst_size) - (src_size) + b] = src[j * (src_size) + (op->reverse ? (src_size) - 1 - b : b)] ^ op->mask[b]; \
+        } \
+        uint8_t fill = op->sign_extend && (wide[(dst_size) - (src_size)] & 0x80) ? 0xff : 0x00; \
+        for (size_t b = 0; b < (dst_size) - (src_size); b++) { \
+            wide[b] = fill; \
+        } \
+        for (size_t b = 0; b < (dst_size); b++) { \
+            dst[j * (dst_size) + b] = wide[op->dst_reverse ? (dst_size) - 1 - b : b] ^ op->dst_mask[b]; \
+        } \
+    }
+
+static void byte_struct_transcode_widen_run(uint8_t *dst, uint8_t *src, size_t count, byte_struct_transcode_op_t *op) {
+    switch (op->size * 16 + op->dst_size) {
+        case 1 * 16 + 2:
+            BYTE_STRUCT_TRANSCODE_WIDEN_RUN(1, 2)
+            break;
+        case 1 * 16 + 4:
+            BYTE_STRUCT_TRANSCODE_WIDEN_RUN(1, 4)
+            break;
+        case 1 * 16 + 8:
+            BYTE_STRUCT_TRANSCODE_WIDEN_RUN(1, 8)
+            break;
+        case 2 * 16 + 4:
+            BYTE_STRUCT_TRANSCODE_WIDEN_RUN(2, 4)
+            break;
+        case 2 * 16 + 8:
+            BYTE_STRUCT_TRANSCODE_WIDEN_RUN(2, 8)
+            break;
+        case 4 * 16 + 8:
+            BYTE_STRUCT_TRANSCODE_WIDEN_RUN(4, 8)
+            break;
+        default:
+            break;
+    }
+}
+
+/*
+Tries to express src_type -> dst_type as a per-element byte permutation plus
+xor mask by checking candidates against the real encoders on probe values.
+*/
+static bool byte_struct_transcode_find_transform(byte_struct_t *src, type_offset_t *src_field, byte_struct_t *dst, type_offset_t *dst_field, byte_struct_transcode_op_t *op) {
+    if (src_field->type == BYTE_STRUCT_TYPE_GROUP || dst_field->type == BYTE_STRUCT_TYPE_GROUP) return false;
+    if (byte_struct_field_nullable(src_field) || byte_struct_field_nullable(dst_field)) return false;
+    size_t size = src_field->size;
+    if (size != dst_field->size || size > BYTE_STRUCT_TRANSCODE_MAX_ELEMENT_SIZE) return false;
+    type_offset_t src_element = *src_field;
+    type_offset_t dst_element = *dst_field;
+    src_element.offset = 0;
+    src_element.count = 1;
+    dst_element.offset = 0;
+    dst_element.count = 1;
+    byte_struct_transcode_relptr_offsets(&src_element, &dst_element);
+    byte_struct_type_t src_type = src_element.type;
+    byte_struct_type_t dst_type = dst_element.type;
+    // Resolving an 'r' field depends on its address
+    if (src_type == BYTE_STRUCT_TYPE_RELPTR || dst_type == BYTE_STRUCT_TYPE_RELPTR) return false;
+
+    uint8_t src_bytes[BYTE_STRUCT_TRANSCODE_NUM_PROBES][BYTE_STRUCT_TRANSCODE_MAX_ELEMENT_SIZE];
+    uint8_t dst_bytes[BYTE_STRUCT_TRANSCODE_NUM_PROBES][BYTE_STRUCT_TRANSCODE_MAX_ELEMENT_SIZE];
+    for (size_t p = 0; p < BYTE_STRUCT_TRANSCODE_NUM_PROBES; p++) {
+        byte_struct_transcode_value_t src_value = {0}, dst_value = {0};
+        byte_struct_transcode_probe_value(src_type, p, &src_value);
+        byte_struct_transcode_value_convert(src_type, &src_value, dst_type, &dst_value);
+        byte_struct_pack_field(src, &src_element, src_bytes[p], &src_value);
+        byte_struct_pack_field(dst, &dst_element, dst_bytes[p], &dst_value);
+        // Lossy pairs (e.g. int32 -> float) can't be a byte transform
+        byte_struct_transcode_value_t round_trip = {0};
+        byte_struct_transcode_value_convert(dst_type, &dst_value, src_type, &round_trip);
+        if (memcmp(&round_trip, &src_value, src_element.native_size) != 0) return false;
+    }
+
+    for (int reverse = 0; reverse <= 1; reverse++) {
+        if (reverse && size == 1) break;
+        uint8_t mask[BYTE_STRUCT_TRANSCODE_MAX_ELEMENT_SIZE];
+        for (size_t b = 0; b < size; b++) {
+            mask[b] = src_bytes[0][reverse ? size - 1 - b : b] ^ dst_bytes[0][b];
+        }
+        bool matches = true;
+        for (size_t p = 1; p < BYTE_STRUCT_TRANSCODE_NUM_PROBES && matches; p++) {
+            uint8_t out[BYTE_STRUCT_TRANSCODE_MAX_ELEMENT_SIZE];
+            byte_struct_transcode_apply_element(out, src_bytes[p], size, reverse, mask);
+            matches = memcmp(out, dst_bytes[p], size) == 0;
+        }
+        if (matches) {
+            bool zero_mask = true;
+            for (size_t b = 0; b < size; b++) {
+                if (mask[b] != 0) zero_mask = false;
+            }
+            op->op_type = (!reverse && zero_mask) ? BYTE_STRUCT_TRANSCODE_COPY : BYTE_STRUCT_TRANSCODE_TRANSFORM;
+            op->reverse = reverse;
+            memset(op->mask, 0, sizeof(op->mask));
+            memcpy(op->mask, mask, size);
+            op->size = size;
+            return true;
+        }
+    }
+    return false;
+}
+
+static bool byte_struct_transcode_integer(byte_struct_type_t type, bool *is_signed) {
+    switch (type) {
+        case BYTE_STRUCT_TYPE_INT8:
+        case BYTE_STRUCT_TYPE_INT16:
+        case BYTE_STRUCT_TYPE_INT32:
+        case BYTE_STRUCT_TYPE_INT64:
+            *is_signed = true;
+            return true;
+        case BYTE_STRUCT_TYPE_UINT8:
+        case BYTE_STRUCT_TYPE_UINT16:
+        case BYTE_STRUCT_TYPE_UINT32:
+        case BYTE_STRUCT_TYPE_UINT64:
+            *is_signed = false;
+            return true;
+        default:
+            return false;
+    }
+}
+
+/*
+Integer widening as transform to plain big-endian, extension and transform to
+the destination encoding. Signed to unsigned isn't value preserving and stays a
+CONVERT.
+*/
+static bool byte_struct_transcode_find_widen(byte_struct_t *src, type_offset_t *src_field, byte_struct_t *dst, type_offset_t *dst_field, byte_struct_transcode_op_t *op) {
+    bool src_signed, dst_signed;
+    if (!byte_struct_transcode_integer(src_field->type, &src_signed) || !byte_struct_transcode_integer(dst_field->type, &dst_signed)) return false;
+    if (src_field->size >= dst_field->size || (src_signed && !dst_signed)) return false;
+    if (byte_struct_field_nullable(src_field) || byte_struct_field_nullable(dst_field)) return false;
+
+    byte_struct_t plain = *src;
+    plain.byte_order = BYTE_STRUCT_BIG_ENDIAN;
+    type_offset_t plain_src = *src_field;
+    plain_src.flags = 0;
+    type_offset_t plain_dst = *dst_field;
+    plain_dst.flags = 0;
+    byte_struct_transcode_op_t to_plain, from_plain;
+    if (!byte_struct_transcode_find_transform(src, src_field, &plain, &plain_src, &to_plain)) return false;
+    if (!byte_struct_transcode_find_transform(&plain, &plain_dst, dst, dst_field, &from_plain)) return false;
+
+    op->op_type = BYTE_STRUCT_TRANSCODE_WIDEN;
+    op->size = src_field->size;
+    op->reverse = to_plain.reverse;
+    memcpy(op->mask, to_plain.mask, sizeof(op->mask));
+    op->dst_size = dst_field->size;
+    op->sign_extend = src_signed;
+    op->dst_reverse = from_plain.reverse;
+    memcpy(op->dst_mask, from_plain.mask, sizeof(op->dst_mask));
+    return true;
+}
+
+// Merges op into prev when both are contiguous runs of the same transform
+static bool byte_struct_transcode_merge_op(byte_struct_transcode_op_t *prev, byte_struct_transcode_op_t *op) {
+    if (prev->op_type != op->op_type) return false;
+    if (op->op_type == BYTE_STRUCT_TRANSCODE_COPY || op->op_type == BYTE_STRUCT_TRANSCODE_DEFAULT_VALUE) {
+        if (prev->src_offset + prev->size != op->src_offset || prev->dst_offset + prev->size != op->dst_offset) return false;
+        prev->size += op->size;
+        return true;
+    }
+    if (op->op_type == BYTE_STRUCT_TRANSCODE_TRANSFORM) {
+        if (prev->size != op->size || prev->reverse != op->reverse || memcmp(prev->mask, op->mask, sizeof(op->mask)) != 0) return false;
+        if (prev->src_offset + prev->size * prev->count != op->src_offset || prev->dst_offset + prev->size * prev->count != op->dst_offset) return false;
+        prev->count += op->count;
+        return true;
+    }
+    if (op->op_type == BYTE_STRUCT_TRANSCODE_WIDEN) {
+        if (prev->size != op->size || prev->dst_size != op->dst_size || prev->sign_extend != op->sign_extend) return false;
+        if (prev->reverse != op->reverse || memcmp(prev->mask, op->mask, sizeof(op->mask)) != 0) return false;
+        if (prev->dst_reverse != op->dst_reverse || memcmp(prev->dst_mask, op->dst_mask, sizeof(op->dst_mask)) != 0) return false;
+        if (prev->src_offset + prev->size * prev->count != op->src_offset || prev->dst_offset + prev->dst_size * prev->count != op->dst_offset) return false;
+        prev->count += op->count;
+        return true;
+    }
+    return false;
+}
+
+void byte_struct_transcoder_destroy(byte_struct_transcoder_t *t);
+
+// Encodes zero into every element of field, recursing into group members
+static void byte_struct_transcode_default_field(byte_struct_t *dst, type_offset_t *field, uint8_t *record, void *zeros) {
+    if (field->type == BYTE_STRUCT_TYPE_GROUP) {
+        for (size_t j = 0; j < field->count; j++) {
+            uint8_t *element = record + field->offset + j * field->size;
+            for (size_t c = 0; c < field->num_children; c++) {
+                byte_struct_transcode_default_field(dst, &dst->type_offsets[field->first_child + c], element, zeros);
+            }
+        }
+        return;
+    }
+    if (byte_struct_field_nullable(field)) {
+        byte_struct_pack_null(dst, field, record);
+        return;
+    }
+    size_t chunk_max = BYTE_STRUCT_CONVERT_SCRATCH_SIZE / field->native_size;
+    for (size_t j = 0; j < field->count; j += chunk_max) {
+        type_offset_t chunk = *field;
+        chunk.offset = field->offset + j * field->size;
+        chunk.count = field->count - j < chunk_max ? field->count - j : chunk_max;
+        byte_struct_pack_field(dst, &chunk, record, zeros);
+    }
+}
+
+/*
+field_map[i] is the src field index feeding dst field i, or
+BYTE_STRUCT_TRANSCODE_DEFAULT for fields added in dst. A NULL field_map maps
+fields by position. Array fields whose counts differ transcode the common
+prefix and zero the rest. Group fields always CONVERT and map their members by
+position, a group mapped to a differently shaped field fails, as does a mapping
+that moves an 'r' field.
+*/
+byte_struct_transcoder_t *byte_struct_transcoder_new(byte_struct_t *src, byte_struct_t *dst, size_t *field_map) {
+    if (src == NULL || dst == NULL || src->num_fields == 0 || dst->num_fields == 0) return NULL;
+    if (field_map == NULL && src->num_fields != dst->num_fields) return NULL;
+
+    byte_struct_transcoder_t *t = calloc(1, sizeof(byte_struct_transcoder_t));
+    if (t == NULL) return NULL;
+    t->src = src;
+    t->dst = dst;
+    t->ops = calloc(dst->num_fields * 2, sizeof(byte_struct_transcode_op_t));
+    t->default_record = calloc(1, dst->total_size > 0 ? dst->total_size : 1);
+    if (t->ops == NULL || t->default_record == NULL) {
+        byte_struct_transcoder_destroy(t);
+        return NULL;
+    }
+
+    uint64_t zeros[BYTE_STRUCT_CONVERT_SCRATCH_SIZE / sizeof(uint64_t)] = {0};
+    for (size_t i = 0; i < dst->num_fields; i++) {
+        byte_struct_transcode_default_field(dst, &dst->type_offsets[i], t->default_record, zeros);
+    }
+
+    for (size_t i = 0; i < dst->num_fields; i++) {
+        type_offset_t dst_field = dst->type_offsets[i];
+        size_t src_index = field_map == NULL ? i : field_map[i];
+        size_t dst_size = dst_field.size;
+
+        byte_struct_transcode_op_t ops[2];
+        size_t num_field_ops = 0;
+        size_t common = 0;
+
+        if (src_index != BYTE_STRUCT_TRANSCODE_DEFAULT) {
+            if (src_index >= src->num_fields) {
+                byte_struct_transcoder_destroy(t);
+                return NULL;
+            }
+            type_offset_t src_field = src->type_offsets[src_index];
+            if (!byte_struct_transcode_groups_compatible(src, &src_field, dst, &dst_field)) {
+                byte_struct_transcoder_destroy(t);
+                return NULL;
+            }
+            bool relptr = byte_struct_transcode_relptr_mapped(src, &src_field, dst, &dst_field);
+            if (relptr && (src->total_size != dst->total_size || !byte_struct_transcode_relptrs_fixed(src, &src_field, dst, &dst_field))) {
+                byte_struct_transcoder_destroy(t);
+                return NULL;
+            }
+            common = src_field.count < dst_field.count ? src_field.count : dst_field.count;
+
+            byte_struct_transcode_op_t op = {
+                .src_offset = src_field.offset,
+                .dst_offset = dst_field.offset,
+                .count = common,
+                .src_field = src_field,
+                .dst_field = dst_field
+            };
+            op.src_field.count = common;
+            op.dst_field.count = common;
+            if (byte_struct_transcode_find_transform(src, &src_field, dst, &dst_field, &op)) {
+                if (op.op_type == BYTE_STRUCT_TRANSCODE_COPY) {
+                    op.size = common * dst_size;
+                    op.count = 1;
+                }
+            } else if (!byte_struct_transcode_find_widen(src, &src_field, dst, &dst_field, &op)) {
+                op.op_type = BYTE_STRUCT_TRANSCODE_CONVERT;
+            }
+            ops[num_field_ops++] = op;
+        }
+
+        if (common < dst_field.count) {
+            size_t default_start = dst_field.offset + common * dst_size;
+            // a field with no source at all takes its null marker from the default record too
+            if (common == 0 && byte_struct_field_nullable(&dst_field)) default_start = dst_field.null_offset;
+            ops[num_field_ops++] = (byte_struct_transcode_op_t){
+                .op_type = BYTE_STRUCT_TRANSCODE_DEFAULT_VALUE,
+                .src_offset = default_start,
+                .dst_offset = default_start,
+                .size = dst_field.offset + dst_field.count * dst_size - default_start,
+                .count = 1
+            };
+        }
+
+        for (size_t k = 0; k < num_field_ops; k++) {
+            if (t->num_ops > 0 && byte_struct_transcode_merge_op(&t->ops[t->num_ops - 1], &ops[k])) continue;
+            t->ops[t->num_ops++] = ops[k];
+        }
+    }
+    return t;
+}
+
+static void byte_struct_transcode_block(byte_struct_transcoder_t *t, uint8_t *src, uint8_t *dst, size_t n) {
+    size_t src_stride = t->src->total_size;
+    size_t dst_stride = t->dst->total_size;
+    for (size_t k = 0; k < t->num_ops; k++) {
+        byte_struct_transcode_op_t *op = &t->ops[k];
+        uint8_t *src_field = src + op->src_offset;
+        uint8_t *dst_field = dst + op->dst_offset;
+        switch (op->op_type) {
+            case BYTE_STRUCT_TRANSCODE_COPY:
+                for (size_t r = 0; r < n; r++) {
+                    memcpy(dst_field + r * dst_stride, src_field + r * src_stride, op->size);
+                }
+                break;
+            case BYTE_STRUCT_TRANSCODE_DEFAULT_VALUE:
+                for (size_t r = 0; r < n; r++) {
+                    memcpy(dst_field + r * dst_stride, t->default_record + op->dst_offset, op->size);
+                }
+                break;
+            case BYTE_STRUCT_TRANSCODE_TRANSFORM:
+                for (size_t r = 0; r < n; r++) {
+                    byte_struct_transcode_apply_run(dst_field + r * dst_stride, src_field + r * src_stride, op->size, op->count, op->reverse, op->mask);
+                }
+                break;
+            case BYTE_STRUCT_TRANSCODE_WIDEN:
+                for (size_t r = 0; r < n; r++) {
+                    byte_struct_transcode_widen_run(dst_field + r * dst_stride, src_field + r * src_stride, op->count, op);
+                }
+                break;
+            case BYTE_STRUCT_TRANSCODE_CONVERT:
+                for (size_t r = 0; r < n; r++) {
+                    byte_struct_transcode_convert_elements(t->src, &op->src_field, src + r * src_stride, t->dst, &op->dst_field, dst + r * dst_stride, op->count);
+                }
+                break;
+        }
+    }
+}
+
+// Transcodes records [start, end), src and dst must not overlap
+static void byte_struct_transcode_range(byte_struct_transcoder_t *t, uint8_t *src, size_t start, size_t end, uint8_t *dst) {
+    for (size_t r = start; r < end; r += BYTE_STRUCT_TRANSCODE_BLOCK_RECORDS) {
+        size_t m = end - r < BYTE_STRUCT_TRANSCODE_BLOCK_RECORDS ? end - r : BYTE_STRUCT_TRANSCODE_BLOCK_RECORDS;
+        byte_struct_transcode_block(t, src + r * t->src->total_size, dst + r * t->dst->total_size, m);
+    }
+}
+
+bool byte_struct_transcode(byte_struct_transcoder_t *t, uint8_t *src, size_t n, uint8_t *dst) {
+    if (t == NULL || src == NULL || dst == NULL) return false;
+    byte_struct_transcode_range(t, src, 0, n, dst);
+    return true;
+}
+
+typedef struct byte_struct_parallel_transcode_arg {
+    byte_struct_transcoder_t *t;
+    uint8_t *src;
+    uint8_t *dst;
+} byte_struct_parallel_transcode_arg_t;
+
+static void byte_struct_parallel_transcode_fn(void *arg, size_t start, size_t end) {
+    byte_struct_parallel_transcode_arg_t *transcode = arg;
+    byte_struct_transcode_range(transcode->t, transcode->src, start, end, transcode->dst);
+}
+
+// Grains are sized and aligned for dst records, grain 0 for the default
+bool byte_struct_transcode_parallel(byte_struct_thread_pool_t *pool, byte_struct_transcoder_t *t, uint8_t *src, size_t n, uint8_t *dst, size_t grain) {
+    if (t == NULL || src == NULL || dst == NULL) return false;
+    byte_struct_parallel_transcode_arg_t arg = {.t = t, .src = src, .dst = dst};
+    return byte_struct_thread_pool_for(pool, n, byte_struct_parallel_grain(t->dst, grain), byte_struct_parallel_transcode_fn, &arg);
+}
+
+void byte_struct_transcoder_destroy(byte_struct_transcoder_t *t) {
+    if (t == NULL) return;
+    free(t->ops);
+    free(t->default_record);
+    free(t);
+}
+
+#endif
@@ -0,0 +1,325 @@
+#ifndef BYTE_STRUCT_ZONE_MAP_H
+#define BYTE_STRUCT_ZONE_MAP_H
+
+#include <stdint.h>
+#include <stdlib.h>
+#include <stdbool.h>
+#include <string.h>
+
+#include "byte_struct.h"
+
+/*
+Zone maps: a small summary per block of block_records consecutive records, so
+range scans can skip blocks that cannot match.
+
+- MIN_MAX: per field minimum and maximum, kept in the sortable encoding so any
+  field type compares with memcmp. Array fields compare lexicographically.
+- KEY_RANGE: first and last record of each block, for data already sorted in
+  BYTE_STRUCT_SORTABLE order. Much cheaper to maintain, and blocks can be
+  located by binary search on a key prefix.
+
+Maps are built incrementally with byte_struct_zone_map_update (or
+byte_struct_pack_batch_zone_map) as records are packed or written out, in
+the same order they're stored.
+*/
+
+typedef enum {
+    BYTE_STRUCT_ZONE_MAP_MIN_MAX,
+    BYTE_STRUCT_ZONE_MAP_KEY_RANGE
+} byte_struct_zone_map_mode_t;
+
+#define BYTE_STRUCT_ZONE_MAP_DEFAULT_BLOCK_RECORDS 1024
+#define BYTE_STRUCT_ZONE_MAP_MAGIC 0x4d5a5342u  // "BSZM" little-endian
+#define BYTE_STRUCT_ZONE_MAP_LAYOUT_VERSION 1
+// magic, version, mode, then block_records, num_records, record_size
+#define BYTE_STRUCT_ZONE_MAP_HEADER_SIZE (3 * sizeof(uint32_t) + 3 * sizeof(uint64_t))
+
+typedef struct byte_struct_zone_map {
+    byte_struct_t *s;
+    byte_struct_zone_map_mode_t mode;
+    size_t block_records;
+    size_t num_records;
+    size_t num_blocks;
+    size_t max_blocks;
+    // per block, a min record followed by a max record (total_size bytes each)
+    uint8_t *zones;
+    // one record in the sortable encoding
+    uint8_t *scratch;
+} byte_struct_zone_map_t;
+
+// Inclusive bounds on one field, lo/hi are packed records in the map's schema, NULL for unbounded
+typedef struct byte_struct_zone_predicate {
+    size_t field;
+    uint8_t *lo;
+    uint8_t *hi;
+} byte_struct_zone_predicate_t;
+
+/*
+Zone map over records of s in blocks of block_records (0 for the default).
+KEY_RANGE maps need a BYTE_STRUCT_SORTABLE schema.
+*/
+byte_struct_zone_map_t *byte_struct_zone_map_new(byte_struct_t *s, size_t block_records, byte_struct_zone_map_mode_t mode) {
+    if (s == NULL || s->total_size == 0) return NULL;
+    if (mode != BYTE_STRUCT_ZONE_MAP_MIN_MAX && mode != BYTE_STRUCT_ZONE_MAP_KEY_RANGE) return NULL;
+    if (mode == BYTE_STRUCT_ZONE_MAP_KEY_RANGE && s->byte_order != BYTE_STRUCT_SORTABLE) return NULL;
+    byte_struct_zone_map_t *zm = calloc(1, sizeof(byte_struct_zone_map_t));
+    if (zm == NULL) return NULL;
+    zm->scratch = malloc(s->total_size);
+    if (zm->scratch == NULL) {
+        free(zm);
+        return NULL;
+    }
+    zm->s = s;
+    zm->mode = mode;
+    zm->block_records = block_records > 0 ? block_records : BYTE_STRUCT_ZONE_MAP_DEFAULT_BLOCK_RECORDS;
+    return zm;
+}
+
+static inline uint8_t *byte_struct_zone_map_min(byte_struct_zone_map_t *zm, size_t block) {
+    return zm->zones + block * 2 * zm->s->total_size;
+}
+
+static inline uint8_t *byte_struct_zone_map_max(byte_struct_zone_map_t *zm, size_t block) {
+    return zm->zones + (block * 2 + 1) * zm->s->total_size;
+}
+
+static bool byte_struct_zone_map_reserve(byte_struct_zone_map_t *zm, size_t num_blocks) {
+    if (num_blocks <= zm->max_blocks) return true;
+    size_t max_blocks = zm->max_blocks > 0 ? zm->max_blocks * 2 : 16;
+    if (max_blocks < num_blocks) max_blocks = num_blocks;
+    if (max_blocks > SIZE_MAX / 2 / zm->s->total_size) return false;
+    uint8_t *zones = realloc(zm->zones, max_blocks * 2 * zm->s->total_size);
+    if (zones == NULL) return false;
+    zm->zones = zones;
+    zm->max_blocks = max_blocks;
+    return true;
+}
+
+// Re-encodes one field of record into the sortable encoding at the same offset of out
+static void byte_struct_zone_map_encode_field(byte_struct_zone_map_t *zm, type_offset_t *type_offset, uint8_t *record, uint8_t *out) {
+    byte_struct_t *s = zm->s;
+    if (s->byte_order == BYTE_STRUCT_SORTABLE) {
+        memcpy(out + type_offset->offset, record + type_offset->offset, type_offset->size * type_offset->count);
+        return;
+    }
+    byte_struct_t sortable = {.byte_order = BYTE_STRUCT_SORTABLE};
+    uint64_t scratch[BYTE_STRUCT_CONVERT_SCRATCH_SIZE / sizeof(uint64_t)];
+    byte_struct_convert_field(s, type_offset, record, &sortable, out, scratch);
+}
+
+/*
+Descending fields are stored complemented in the sortable encoding, so their
+value bounds map to swapped byte bounds.
+*/
+static inline bool byte_struct_zone_map_field_reversed(type_offset_t *type_offset) {
+    return (type_offset->flags & BYTE_STRUCT_FIELD_DESCENDING) != 0;
+}
+
+// Appends n records (e.g. a chunk just packed or written) to the map
+bool byte_struct_zone_map_update(byte_struct_zone_map_t *zm, uint8_t *data, size_t n) {
+    if (zm == NULL || (data == NULL && n > 0)) return false;
+    byte_struct_t *s = zm->s;
+    size_t record_size = s->total_size;
+    if (n > 0 && !byte_struct_zone_map_reserve(zm, (zm->num_records + n - 1) / zm->block_records + 1)) return false;
+
+    for (size_t r = 0; r < n; r++) {
+        uint8_t *record = data + r * record_size;
+        size_t block = zm->num_records / zm->block_records;
+        bool first = zm->num_records % zm->block_records == 0;
+        uint8_t *min = byte_struct_zone_map_min(zm, block);
+        uint8_t *max = byte_struct_zone_map_max(zm, block);
+        zm->num_records++;
+
+        if (zm->mode == BYTE_STRUCT_ZONE_MAP_KEY_RANGE) {
+            if (first) memcpy(min, record, record_size);
+            memcpy(max, record, record_size);
+            continue;
+        }
+
+        uint8_t *encoded = record;
+        if (s->byte_order != BYTE_STRUCT_SORTABLE) {
+            encoded = zm->scratch;
+            for (size_t i = 0; i < s->num_fields; i++) {
+                byte_struct_zone_map_encode_field(zm, &s->type_offsets[i], record, encoded);
+            }
+        }
+        if (first) {
+            memcpy(min, encoded, record_size);
+            memcpy(max, encoded, record_size);
+            continue;
+        }
+        for (size_t i = 0; i < s->num_fields; i++) {
+            type_offset_t *type_offset = &s->type_offsets[i];
+            size_t offset = type_offset->offset;
+            size_t size = type_offset->size * type_offset->count;
+            if (memcmp(encoded + offset, min + offset, size) < 0) {
+                memcpy(min + offset, encoded + offset, size);
+            } else if (memcmp(encoded + offset, max + offset, size) > 0) {
+                memcpy(max + offset, encoded + offset, size);
+            }
+        }
+    }
+    zm->num_blocks = (zm->num_records + zm->block_records - 1) / zm->block_records;
+    return true;
+}
+
+// byte_struct_pack_batch, summarizing the packed records as it goes
+bool byte_struct_pack_batch_zone_map(byte_struct_zone_map_t *zm, uint8_t *data, size_t n, void **columns) {
+    if (zm == NULL) return false;
+    if (!byte_struct_pack_batch(zm->s, data, n, columns)) return false;
+    return byte_struct_zone_map_update(zm, data, n);
+}
+
+// Records [start, end) covered by block
+void byte_struct_zone_map_block_range(byte_struct_zone_map_t *zm, size_t block, size_t *start, size_t *end) {
+    *start = block * zm->block_records;
+    *end = *start + zm->block_records;
+    if (*end > zm->num_records) *end = zm->num_records;
+    if (*start > *end) *start = *end;
+}
+
+/*
+Writes the indices of blocks that may contain records matching all predicates
+to blocks (room for num_blocks entries) and returns how many there are. In
+KEY_RANGE mode only predicates on field 0 can rule blocks out.
+*/
+size_t byte_struct_zone_map_select(byte_struct_zone_map_t *zm, byte_struct_zone_predicate_t *predicates, size_t num_predicates, size_t *blocks) {
+    if (zm == NULL || blocks == NULL || (predicates == NULL && num_predicates > 0)) return 0;
+    byte_struct_t *s = zm->s;
+    for (size_t p = 0; p < num_predicates; p++) {
+        if (predicates[p].field >= s->num_fields) return 0;
+    }
+
+    // Bounds encoded once up front, lo fields into bounds, hi fields into bounds + total_size
+    uint8_t *bounds = malloc(2 * s->total_size);
+    if (bounds == NULL) return 0;
+    for (size_t p = 0; p < num_predicates; p++) {
+        type_offset_t *type_offset = &s->type_offsets[predicates[p].field];
+        if (predicates[p].lo != NULL) byte_struct_zone_map_encode_field(zm, type_offset, predicates[p].lo, bounds);
+        if (predicates[p].hi != NULL) byte_struct_zone_map_encode_field(zm, type_offset, predicates[p].hi, bounds + s->total_size);
+    }
+
+    size_t num_selected = 0;
+    for (size_t b = 0; b < zm->num_blocks; b++) {
+        uint8_t *min = byte_struct_zone_map_min(zm, b);
+        uint8_t *max = byte_struct_zone_map_max(zm, b);
+        bool match = true;
+        for (size_t p = 0; p < num_predicates && match; p++) {
+            size_t field = predicates[p].field;
+            if (zm->mode == BYTE_STRUCT_ZONE_MAP_KEY_RANGE && field != 0) continue;
+            type_offset_t *type_offset = &s->type_offsets[field];
+            size_t offset = type_offset->offset;
+            size_t size = type_offset->size * type_offset->count;
+            uint8_t *lo = predicates[p].lo != NULL ? bounds + offset : NULL;
+            uint8_t *hi = predicates[p].hi != NULL ? bounds + s->total_size + offset : NULL;
+            if (byte_struct_zone_map_field_reversed(type_offset)) {
+                uint8_t *tmp = lo;
+                lo = hi;
+                hi = tmp;
+            }
+            if (lo != NULL && memcmp(max + offset, lo, size) < 0) match = false;
+            if (hi != NULL && memcmp(min + offset, hi, size) > 0) match = false;
+        }
+        if (match) blocks[num_selected++] = b;
+    }
+    free(bounds);
+    return num_selected;
+}
+
+/*
+KEY_RANGE maps: blocks [*first_block, *end_block) are the only ones that can
+hold keys whose first prefix_fields fields lie in [lo, hi] (packed records,
+NULL for unbounded). Found by binary search, so O(log num_blocks).
+*/
+bool byte_struct_zone_map_key_blocks(byte_struct_zone_map_t *zm, uint8_t *lo, uint8_t *hi, size_t prefix_fields, size_t *first_block, size_t *end_block) {
+    if (zm == NULL || zm->mode != BYTE_STRUCT_ZONE_MAP_KEY_RANGE || first_block == NULL || end_block == NULL) return false;
+    byte_struct_t *s = zm->s;
+    if (prefix_fields == 0 || prefix_fields > s->num_fields) return false;
+    size_t prefix_len = byte_struct_prefix_size(s, prefix_fields);
+
+    // First block whose last key is >= lo
+    size_t left = 0, right = zm->num_blocks;
+    if (lo != NULL) {
+        while (left < right) {
+            size_t mid = left + (right - left) / 2;
+            if (memcmp(byte_struct_zone_map_max(zm, mid), lo, prefix_len) < 0) {
+                left = mid + 1;
+            } else {
+                right = mid;
+            }
+        }
+    }
+    *first_block = left;
+
+    // First block whose first key is > hi
+    right = zm->num_blocks;
+    if (hi != NULL) {
+        while (left < right) {
+            size_t mid = left + (right - left) / 2;
+            if (memcmp(byte_struct_zone_map_min(zm, mid), hi, prefix_len) <= 0) {
+                left = mid + 1;
+            } else {
+                right = mid;
+            }
+        }
+    }
+    *end_block = right;
+    return true;
+}
+
+void byte_struct_zone_map_destroy(byte_struct_zone_map_t *zm);
+
+size_t byte_struct_zone_map_serialized_size(byte_struct_zone_map_t *zm) {
+    if (zm == NULL) return 0;
+    return BYTE_STRUCT_ZONE_MAP_HEADER_SIZE + zm->num_blocks * 2 * zm->s->total_size;
+}
+
+// Zones are stored as sortable (or already sortable) records, so the bytes are portable as is
+bool byte_struct_zone_map_serialize(byte_struct_zone_map_t *zm, uint8_t *out) {
+    if (zm == NULL || out == NULL) return false;
+    write_uint32_little_endian(out, BYTE_STRUCT_ZONE_MAP_MAGIC);
+    write_uint32_little_endian(out + 4, BYTE_STRUCT_ZONE_MAP_LAYOUT_VERSION);
+    write_uint32_little_endian(out + 8, (uint32_t)zm->mode);
+    write_uint64_little_endian(out + 12, (uint64_t)zm->block_records);
+    write_uint64_little_endian(out + 20, (uint64_t)zm->num_records);
+    write_uint64_little_endian(out + 28, (uint64_t)zm->s->total_size);
+    if (zm->num_blocks > 0) {
+        memcpy(out + BYTE_STRUCT_ZONE_MAP_HEADER_SIZE, zm->zones, zm->num_blocks * 2 * zm->s->total_size);
+    }
+    return true;
+}
+
+// s must be the schema the map was built with
+byte_struct_zone_map_t *byte_struct_zone_map_deserialize(byte_struct_t *s, uint8_t *data, size_t len) {
+    if (s == NULL || data == NULL || len < BYTE_STRUCT_ZONE_MAP_HEADER_SIZE) return NULL;
+    if (read_uint32_little_endian(data) != BYTE_STRUCT_ZONE_MAP_MAGIC) return NULL;
+    if (read_uint32_little_endian(data + 4) != BYTE_STRUCT_ZONE_MAP_LAYOUT_VERSION) return NULL;
+    uint32_t mode = read_uint32_little_endian(data + 8);
+    uint64_t block_records = read_uint64_little_endian(data + 12);
+    uint64_t num_records = read_uint64_little_endian(data + 20);
+    if (read_uint64_little_endian(data + 28) != s->total_size || block_records == 0 || block_records > SIZE_MAX || num_records > SIZE_MAX) return NULL;
+
+    byte_struct_zone_map_t *zm = byte_struct_zone_map_new(s, (size_t)block_records, (byte_struct_zone_map_mode_t)mode);
+    if (zm == NULL) return NULL;
+    size_t num_blocks = (size_t)(num_records / block_records + (num_records % block_records != 0));
+    if (num_blocks > (len - BYTE_STRUCT_ZONE_MAP_HEADER_SIZE) / 2 / s->total_size || !byte_struct_zone_map_reserve(zm, num_blocks)) {
+        byte_struct_zone_map_destroy(zm);
+        return NULL;
+    }
+    if (num_blocks > 0) {
+        memcpy(zm->zones, data + BYTE_STRUCT_ZONE_MAP_HEADER_SIZE, num_blocks * 2 * s->total_size);
+    }
+    zm->num_records = (size_t)num_records;
+    zm->num_blocks = num_blocks;
+    return zm;
+}
+
+// The schema stays owned by the caller
+void byte_struct_zone_map_destroy(byte_struct_zone_map_t *zm) {
+    if (zm == NULL) return;
+    free(zm->zones);
+    free(zm->scratch);
+    free(zm);
+}
+
+#endif
@@ -1,8 +1,23 @@
 #include <stdint.h>
 #include <float.h>
+#include <stddef.h>
 #include "greatest/greatest.h"
 
 #include "byte_struct.h"
+#include "byte_struct_bloom.h"
+#include "byte_struct_codec.h"
+#include "byte_struct_csv.h"
+#include "byte_struct_dict.h"
+#include "byte_struct_merge.h"
+#include "byte_struct_parallel.h"
+#include "byte_struct_partition.h"
+#include "byte_struct_relptr.h"
+#include "byte_struct_ring.h"
+#include "byte_struct_search.h"
+#include "byte_struct_sketch.h"
+#include "byte_struct_topk.h"
+#include "byte_struct_transcode.h"
+#include "byte_struct_zone_map.h"
 
 TEST test_byte_struct(void) {
     byte_struct_t *s = byte_struct_new("bI[4]f");
@@ -114,12 +129,2256 @@ TEST test_byte_struct(void) {
 
     free(p2_data);
 
+    // Pointer arrays unpack into void *[N] in every byte order
+    byte_order_t orders[] = {BYTE_STRUCT_BIG_ENDIAN, BYTE_STRUCT_LITTLE_ENDIAN, BYTE_STRUCT_NATIVE_ENDIAN, BYTE_STRUCT_SORTABLE};
+    for (size_t o = 0; o < 4; o++) {
+        byte_struct_t *ptrs = byte_struct_new_len_options("p[3]", 4, orders[o]);
+        ASSERT_NEQ(ptrs, NULL);
+        uint8_t ptr_data[3 * sizeof(void *)];
+        void *targets[3] = {&v, NULL, &orders[o]};
+        ASSERT(byte_struct_pack(ptrs, ptr_data, targets));
+        void *unpacked[3] = {NULL, &v, NULL};
+        ASSERT(byte_struct_unpack(ptrs, ptr_data, sizeof(ptr_data), unpacked));
+        ASSERT_MEM_EQ(targets, unpacked, sizeof(targets));
+        byte_struct_destroy(ptrs);
+    }
+
     byte_struct_destroy(s);
     byte_struct_destroy(f);
     byte_struct_destroy(p);
     PASS();
 }
 
+TEST test_byte_struct_batch(void) {
+    byte_struct_t *s = byte_struct_new_len_options("iH[2]d", strlen("iH[2]d"), BYTE_STRUCT_SORTABLE);
+    ASSERT_NEQ(s, NULL);
+
+    size_t n = 100;
+    int32_t ints[100];
+    uint16_t shorts[200];
+    double doubles[100];
+    for (size_t i = 0; i < n; i++) {
+        ints[i] = (int32_t)(n / 2) - (int32_t)(i % 50);
+        shorts[2 * i] = (uint16_t)i;
+        shorts[2 * i + 1] = (uint16_t)(i * 3);
+        doubles[i] = (double)i * -0.5;
+    }
+
+    uint8_t *data = malloc(n * s->total_size);
+    ASSERT_NEQ(data, NULL);
+    ASSERT(byte_struct_pack_batch(s, data, n, (void *[]){ints, shorts, doubles}));
+
+    int32_t b_int = 0;
+    uint16_t b_shorts[2] = {0};
+    double b_double = 0.0;
+    ASSERT(byte_struct_unpack(s, data + 7 * s->total_size, s->total_size, &b_int, &b_shorts, &b_double));
+    ASSERT_EQ(b_int, ints[7]);
+    ASSERT_EQ(b_shorts[0], 7);
+    ASSERT_EQ(b_shorts[1], 21);
+    ASSERT_IN_RANGE(b_double, -3.5, DBL_EPSILON);
+
+    int32_t out_ints[100];
+    uint16_t out_shorts[200];
+    double out_doubles[100];
+    ASSERT(byte_struct_unpack_batch(s, data, n, (void *[]){out_ints, out_shorts, out_doubles}));
+    ASSERT_MEM_EQ(ints, out_ints, sizeof(ints));
+    ASSERT_MEM_EQ(shorts, out_shorts, sizeof(shorts));
+    ASSERT_MEM_EQ(doubles, out_doubles, sizeof(doubles));
+
+    // Round trip through another byte order, converting in place
+    uint8_t *copy = malloc(n * s->total_size);
+    ASSERT_NEQ(copy, NULL);
+    ASSERT(byte_struct_convert(s, data, n, BYTE_STRUCT_LITTLE_ENDIAN, copy));
+    byte_struct_t *le = byte_struct_new_len_options("iH[2]d", strlen("iH[2]d"), BYTE_STRUCT_LITTLE_ENDIAN);
+    ASSERT_NEQ(le, NULL);
+    ASSERT(byte_struct_unpack(le, copy + 7 * le->total_size, le->total_size, &b_int, &b_shorts, &b_double));
+    ASSERT_EQ(b_int, ints[7]);
+    ASSERT_EQ(b_shorts[1], 21);
+    ASSERT(byte_struct_convert(le, copy, n, BYTE_STRUCT_SORTABLE, copy));
+    ASSERT_MEM_EQ(data, copy, n * s->total_size);
+
+    ASSERT(byte_struct_sort(s, data, n));
+    for (size_t i = 1; i < n; i++) {
+        ASSERT(memcmp(data + (i - 1) * s->total_size, data + i * s->total_size, s->total_size) <= 0);
+    }
+
+    free(copy);
+    free(data);
+    byte_struct_destroy(le);
+    byte_struct_destroy(s);
+    PASS();
+}
+
+typedef struct byte_struct_parallel_nested_arg {
+    byte_struct_thread_pool_t *pool;
+    // big-endian records in data, sortable ones in expected
+    byte_struct_t *s;
+    uint8_t *data;
+    uint8_t *expected;
+    volatile bool ok;
+} byte_struct_parallel_nested_arg_t;
+
+// Each task converts its own 1/8 of the records through the pool it runs on
+static void byte_struct_parallel_nested_fn(void *arg, size_t start, size_t end) {
+    byte_struct_parallel_nested_arg_t *nested = arg;
+    size_t size = nested->s->total_size;
+    size_t part = 10007 / 8;
+    for (size_t k = start; k < end; k++) {
+        size_t count = k == 7 ? 10007 - 7 * part : part;
+        uint8_t *records = nested->data + k * part * size;
+        if (!byte_struct_convert_parallel(nested->pool, nested->s, records, count, BYTE_STRUCT_SORTABLE, records, 16)) nested->ok = false;
+        if (memcmp(records, nested->expected + k * part * size, count * size) != 0) nested->ok = false;
+    }
+}
+
+TEST test_byte_struct_parallel(void) {
+    byte_struct_t *s = byte_struct_new_len_options("lI", strlen("lI"), BYTE_STRUCT_SORTABLE);
+    ASSERT_NEQ(s, NULL);
+
+    byte_struct_thread_pool_t *pool = byte_struct_thread_pool_new(4);
+    ASSERT_NEQ(pool, NULL);
+    ASSERT(byte_struct_thread_pool_size(pool) >= 1);
+
+    size_t n = 10007;
+    int64_t *longs = malloc(n * sizeof(int64_t));
+    uint32_t *uints = malloc(n * sizeof(uint32_t));
+    int64_t *out_longs = malloc(n * sizeof(int64_t));
+    uint32_t *out_uints = malloc(n * sizeof(uint32_t));
+    uint8_t *data = malloc(n * s->total_size);
+    uint8_t *expected = malloc(n * s->total_size);
+    ASSERT(longs != NULL && uints != NULL && out_longs != NULL && out_uints != NULL && data != NULL && expected != NULL);
+
+    for (size_t i = 0; i < n; i++) {
+        longs[i] = (int64_t)((i * 7919) % n) - (int64_t)(n / 2);
+        uints[i] = (uint32_t)i;
+    }
+
+    ASSERT(byte_struct_pack_batch_parallel(pool, s, data, n, (void *[]){longs, uints}, 100));
+    ASSERT(byte_struct_pack_batch(s, expected, n, (void *[]){longs, uints}));
+    ASSERT_MEM_EQ(expected, data, n * s->total_size);
+
+    ASSERT(byte_struct_unpack_batch_parallel(pool, s, data, n, (void *[]){out_longs, out_uints}, 0));
+    ASSERT_MEM_EQ(longs, out_longs, n * sizeof(int64_t));
+    ASSERT_MEM_EQ(uints, out_uints, n * sizeof(uint32_t));
+
+    ASSERT(byte_struct_convert_parallel(pool, s, data, n, BYTE_STRUCT_BIG_ENDIAN, data, 0));
+    ASSERT(byte_struct_convert(s, expected, n, BYTE_STRUCT_BIG_ENDIAN, expected));
+    ASSERT_MEM_EQ(expected, data, n * s->total_size);
+
+    ASSERT(byte_struct_pack_batch(s, data, n, (void *[]){longs, uints}));
+    memcpy(expected, data, n * s->total_size);
+    ASSERT(byte_struct_sort(s, expected, n));
+    ASSERT(byte_struct_sort_parallel(pool, s, data, n));
+    ASSERT_MEM_EQ(expected, data, n * s->total_size);
+
+    // Parallel calls from inside pool tasks run inline instead of deadlocking
+    byte_struct_t *big = byte_struct_new_len_options("lI", strlen("lI"), BYTE_STRUCT_BIG_ENDIAN);
+    ASSERT_NEQ(big, NULL);
+    ASSERT(byte_struct_convert(s, data, n, BYTE_STRUCT_BIG_ENDIAN, data));
+    byte_struct_parallel_nested_arg_t nested = {.pool = pool, .s = big, .data = data, .expected = expected, .ok = true};
+    ASSERT(byte_struct_thread_pool_for(pool, 8, 1, byte_struct_parallel_nested_fn, &nested));
+    ASSERT(nested.ok);
+    ASSERT_MEM_EQ(expected, data, n * s->total_size);
+    byte_struct_destroy(big);
+
+    free(longs);
+    free(uints);
+    free(out_longs);
+    free(out_uints);
+    free(data);
+    free(expected);
+    byte_struct_thread_pool_destroy(pool);
+    byte_struct_destroy(s);
+    PASS();
+}
+
+TEST test_byte_struct_transcode(void) {
+    byte_struct_t *src = byte_struct_new_len_options("iH[2]dc[3]", strlen("iH[2]dc[3]"), BYTE_STRUCT_NATIVE_ENDIAN);
+    byte_struct_t *dst = byte_struct_new_len_options("iH[2]dc[3]", strlen("iH[2]dc[3]"), BYTE_STRUCT_SORTABLE);
+    ASSERT(src != NULL && dst != NULL);
+
+    size_t n = 130;
+    uint8_t *src_data = malloc(n * src->total_size);
+    uint8_t *dst_data = malloc(n * dst->total_size);
+    uint8_t *expected = malloc(n * dst->total_size);
+    ASSERT(src_data != NULL && dst_data != NULL && expected != NULL);
+    for (size_t i = 0; i < n; i++) {
+        int32_t v = (int32_t)i * 1000 - 50000;
+        uint16_t u[2] = {(uint16_t)i, (uint16_t)(i * 511)};
+        double d = (double)v / 7.0;
+        ASSERT(byte_struct_pack(src, src_data + i * src->total_size, v, u, d, "abc"));
+        ASSERT(byte_struct_pack(dst, expected + i * dst->total_size, v, u, d, "abc"));
+    }
+
+    byte_struct_transcoder_t *t = byte_struct_transcoder_new(src, dst, NULL);
+    ASSERT_NEQ(t, NULL);
+    ASSERT(byte_struct_transcode(t, src_data, n, dst_data));
+    ASSERT_MEM_EQ(expected, dst_data, n * dst->total_size);
+    // Same bytes split across threads
+    byte_struct_thread_pool_t *pool = byte_struct_thread_pool_new(4);
+    ASSERT_NEQ(pool, NULL);
+    memset(dst_data, 0, n * dst->total_size);
+    ASSERT(byte_struct_transcode_parallel(pool, t, src_data, n, dst_data, 7));
+    ASSERT_MEM_EQ(expected, dst_data, n * dst->total_size);
+    byte_struct_thread_pool_destroy(pool);
+    byte_struct_transcoder_destroy(t);
+
+    // Same schema is a single merged copy
+    t = byte_struct_transcoder_new(dst, dst, NULL);
+    ASSERT_NEQ(t, NULL);
+    ASSERT_EQ(t->num_ops, 1);
+    ASSERT_EQ(t->ops[0].op_type, BYTE_STRUCT_TRANSCODE_COPY);
+    byte_struct_transcoder_destroy(t);
+
+    // Big to little endian ints are byte swaps
+    byte_struct_t *big = byte_struct_new_len_options("I[4]", strlen("I[4]"), BYTE_STRUCT_BIG_ENDIAN);
+    byte_struct_t *little = byte_struct_new_len_options("I[4]", strlen("I[4]"), BYTE_STRUCT_LITTLE_ENDIAN);
+    t = byte_struct_transcoder_new(big, little, NULL);
+    ASSERT_NEQ(t, NULL);
+    ASSERT_EQ(t->num_ops, 1);
+    ASSERT_EQ(t->ops[0].op_type, BYTE_STRUCT_TRANSCODE_TRANSFORM);
+    ASSERT(t->ops[0].reverse);
+    byte_struct_transcoder_destroy(t);
+    byte_struct_destroy(big);
+    byte_struct_destroy(little);
+
+    // Reorder, widen, drop a field and add one
+    byte_struct_t *v2 = byte_struct_new_len_options("dlH[3]f", strlen("dlH[3]f"), BYTE_STRUCT_BIG_ENDIAN);
+    ASSERT_NEQ(v2, NULL);
+    t = byte_struct_transcoder_new(src, v2, (size_t[]){2, 0, 1, BYTE_STRUCT_TRANSCODE_DEFAULT});
+    ASSERT_NEQ(t, NULL);
+    uint8_t *v2_data = malloc(n * v2->total_size);
+    ASSERT_NEQ(v2_data, NULL);
+    ASSERT(byte_struct_transcode(t, src_data, n, v2_data));
+    for (size_t i = 0; i < n; i += 13) {
+        double d = 0.0;
+        int64_t l = 0;
+        uint16_t u[3] = {1, 1, 1};
+        float f = 1.0f;
+        ASSERT(byte_struct_unpack(v2, v2_data + i * v2->total_size, v2->total_size, &d, &l, &u, &f));
+        ASSERT_EQ(l, (int64_t)i * 1000 - 50000);
+        ASSERT_IN_RANGE(d, (double)l / 7.0, DBL_EPSILON * 10000);
+        ASSERT_EQ(u[0], (uint16_t)i);
+        ASSERT_EQ(u[1], (uint16_t)(i * 511));
+        ASSERT_EQ(u[2], 0);
+        ASSERT_IN_RANGE(f, 0.0f, FLT_EPSILON);
+    }
+    // int32 -> int64 extends bytes in place of decoding
+    bool widened = false;
+    for (size_t k = 0; k < t->num_ops; k++) {
+        if (t->ops[k].dst_offset == v2->type_offsets[1].offset) widened = t->ops[k].op_type == BYTE_STRUCT_TRANSCODE_WIDEN;
+    }
+    ASSERT(widened);
+    byte_struct_transcoder_destroy(t);
+
+    ASSERT_EQ(byte_struct_transcoder_new(src, v2, (size_t[]){2, 0, 7, 1}), NULL);
+
+    // Widening across every pair of byte orders, with sign and zero extension and a flipped sort direction
+    int8_t narrow_i8[4] = {0, -1, 127, -128};
+    int16_t narrow_i16[4] = {1, -300, INT16_MAX, INT16_MIN};
+    uint8_t narrow_u8[4] = {0, 1, 0x80, 0xff};
+    uint16_t narrow_u16[4] = {0, 0x1234, 0x8000, 0xffff};
+    int32_t narrow_i32[4][2] = {{0, -1}, {INT32_MIN, INT32_MAX}, {-70000, 70000}, {5, -5}};
+    for (byte_order_t src_order = 0; src_order < BYTE_STRUCT_NUM_BYTE_ORDERS; src_order++) {
+        for (byte_order_t dst_order = 0; dst_order < BYTE_STRUCT_NUM_BYTE_ORDERS; dst_order++) {
+            byte_struct_t *narrow = byte_struct_new_len_options("bh-BHi[2]", strlen("bh-BHi[2]"), src_order);
+            byte_struct_t *wide = byte_struct_new_len_options("i-lhL-l[2]", strlen("i-lhL-l[2]"), dst_order);
+            ASSERT(narrow != NULL && wide != NULL);
+            ASSERT(narrow->total_size == 14 && wide->total_size == 38);
+            t = byte_struct_transcoder_new(narrow, wide, NULL);
+            ASSERT_NEQ(t, NULL);
+            for (size_t k = 0; k < t->num_ops; k++) {
+                ASSERT_EQ(t->ops[k].op_type, BYTE_STRUCT_TRANSCODE_WIDEN);
+            }
+            uint8_t narrow_data[4 * 14];
+            uint8_t wide_data[4 * 38];
+            uint8_t wide_expected[4 * 38];
+            for (size_t i = 0; i < 4; i++) {
+                int64_t wide_i32[2] = {narrow_i32[i][0], narrow_i32[i][1]};
+                ASSERT(byte_struct_pack(narrow, narrow_data + i * 14, narrow_i8[i], narrow_i16[i], narrow_u8[i], narrow_u16[i], narrow_i32[i]));
+                ASSERT(byte_struct_pack(wide, wide_expected + i * 38, (int32_t)narrow_i8[i], (int64_t)narrow_i16[i], (int16_t)narrow_u8[i], (uint64_t)narrow_u16[i], wide_i32));
+            }
+            ASSERT(byte_struct_transcode(t, narrow_data, 4, wide_data));
+            ASSERT_MEM_EQ(wide_expected, wide_data, sizeof(wide_data));
+            byte_struct_transcoder_destroy(t);
+            byte_struct_destroy(narrow);
+            byte_struct_destroy(wide);
+        }
+    }
+    // Signed to unsigned can't extend bytes and still decodes and re-encodes
+    byte_struct_t *signed_narrow = byte_struct_new("h");
+    byte_struct_t *unsigned_wide = byte_struct_new("I");
+    t = byte_struct_transcoder_new(signed_narrow, unsigned_wide, NULL);
+    ASSERT_NEQ(t, NULL);
+    ASSERT_EQ(t->ops[0].op_type, BYTE_STRUCT_TRANSCODE_CONVERT);
+    byte_struct_transcoder_destroy(t);
+    byte_struct_destroy(signed_narrow);
+    byte_struct_destroy(unsigned_wide);
+
+    free(v2_data);
+    free(src_data);
+    free(dst_data);
+    free(expected);
+    byte_struct_destroy(v2);
+    byte_struct_destroy(src);
+    byte_struct_destroy(dst);
+    PASS();
+}
+
+TEST test_byte_struct_descending(void) {
+    byte_struct_t *s = byte_struct_new_len_options("H-lc-c[2]", strlen("H-lc-c[2]"), BYTE_STRUCT_SORTABLE);
+    ASSERT_NEQ(s, NULL);
+    ASSERT_EQ(s->num_fields, 4);
+    ASSERT_EQ(s->type_offsets[0].flags, 0);
+    ASSERT_EQ(s->type_offsets[1].flags, BYTE_STRUCT_FIELD_DESCENDING);
+    ASSERT_EQ(s->type_offsets[2].flags, 0);
+    ASSERT_EQ(s->type_offsets[3].flags, BYTE_STRUCT_FIELD_DESCENDING);
+    ASSERT_EQ(s->type_offsets[3].count, 2);
+    ASSERT_EQ(s->total_size, sizeof(uint16_t) + sizeof(int64_t) + 3);
+
+    ASSERT_EQ(byte_struct_new("H-"), NULL);
+    ASSERT_EQ(byte_struct_new("H--l"), NULL);
+    ASSERT_EQ(byte_struct_new("H-[2]"), NULL);
+
+    // (tenant ASC, timestamp DESC)
+    uint8_t a[13], b[13], c[13];
+    ASSERT(byte_struct_pack(s, a, (uint16_t)1, (int64_t)-5, 'x', "ab"));
+    ASSERT(byte_struct_pack(s, b, (uint16_t)1, (int64_t)-7, 'x', "ab"));
+    ASSERT(byte_struct_pack(s, c, (uint16_t)2, (int64_t)100, 'x', "ab"));
+    ASSERT(memcmp(a, b, s->total_size) < 0);
+    ASSERT(memcmp(b, c, s->total_size) < 0);
+    ASSERT(byte_struct_pack(s, b, (uint16_t)1, (int64_t)-5, 'x', "ac"));
+    ASSERT(memcmp(b, a, s->total_size) < 0);
+
+    uint16_t tenant = 0;
+    int64_t timestamp = 0;
+    char ch = 0;
+    char str[2] = {0};
+    ASSERT(byte_struct_unpack(s, a, s->total_size, &tenant, &timestamp, &ch, &str));
+    ASSERT_EQ(tenant, 1);
+    ASSERT_EQ(timestamp, -5);
+    ASSERT_EQ(ch, 'x');
+    ASSERT_MEM_EQ(str, "ab", 2);
+
+    // Batch paths and conversion out of sortable order decode transparently
+    int64_t timestamps[3] = {0};
+    uint16_t tenants[3] = {0};
+    char chars[3] = {0};
+    char strs[6] = {0};
+    uint8_t records[39];
+    memcpy(records, a, 13);
+    memcpy(records + 13, b, 13);
+    memcpy(records + 26, c, 13);
+    ASSERT(byte_struct_unpack_batch(s, records, 3, (void *[]){tenants, timestamps, chars, strs}));
+    ASSERT_EQ(timestamps[2], 100);
+    ASSERT_MEM_EQ(strs, "abacab", 6);
+
+    byte_struct_t *big = byte_struct_new("H-lc-c[2]");
+    ASSERT_NEQ(big, NULL);
+    uint8_t converted[39];
+    ASSERT(byte_struct_convert(s, records, 3, BYTE_STRUCT_BIG_ENDIAN, converted));
+    ASSERT(byte_struct_unpack(big, converted + 26, big->total_size, &tenant, &timestamp, &ch, &str));
+    ASSERT_EQ(tenant, 2);
+    ASSERT_EQ(timestamp, 100);
+    ASSERT_MEM_EQ(str, "ab", 2);
+
+    byte_struct_transcoder_t *t = byte_struct_transcoder_new(big, s, NULL);
+    ASSERT_NEQ(t, NULL);
+    uint8_t round_trip[39];
+    ASSERT(byte_struct_transcode(t, converted, 3, round_trip));
+    ASSERT_MEM_EQ(records, round_trip, sizeof(records));
+    byte_struct_transcoder_destroy(t);
+
+    byte_struct_destroy(big);
+    byte_struct_destroy(s);
+    PASS();
+}
+
+TEST test_byte_struct_nullable(void) {
+    byte_struct_t *s = byte_struct_new("?i!d?c[3]l");
+    ASSERT_NEQ(s, NULL);
+    ASSERT_EQ(s->num_fields, 4);
+    ASSERT_EQ(s->type_offsets[0].flags, BYTE_STRUCT_FIELD_NULLABLE);
+    ASSERT_EQ(s->type_offsets[1].flags, BYTE_STRUCT_FIELD_NULLABLE | BYTE_STRUCT_FIELD_NULLS_LAST);
+    ASSERT_EQ(s->type_offsets[0].null_offset, 0);
+    ASSERT_EQ(s->type_offsets[0].offset, 1);
+    ASSERT_EQ(s->type_offsets[1].null_offset, 5);
+    ASSERT_EQ(s->type_offsets[2].null_offset, 14);
+    ASSERT_EQ(s->type_offsets[3].offset, 18);
+    ASSERT_EQ(s->total_size, 26);
+    // prefixes end before the next field's marker
+    ASSERT_EQ(byte_struct_prefix_size(s, 1), 5);
+
+    ASSERT_EQ(byte_struct_new("i?"), NULL);
+    ASSERT_EQ(byte_struct_new("??i"), NULL);
+    ASSERT_EQ(byte_struct_new("?!i"), NULL);
+    ASSERT_EQ(byte_struct_new("?(i)"), NULL);
+    ASSERT_EQ(byte_struct_new("(i?)"), NULL);
+    ASSERT_EQ(byte_struct_new("?-r"), NULL);
+    byte_struct_t *modifiers = byte_struct_new("-?l?-l?r(?H)[2]");
+    ASSERT_NEQ(modifiers, NULL);
+    ASSERT_EQ(modifiers->type_offsets[0].flags, modifiers->type_offsets[1].flags);
+    byte_struct_destroy(modifiers);
+
+    // Presence flags go before each nullable value, absent values aren't read
+    uint8_t data[26];
+    ASSERT(byte_struct_pack(s, data, true, (int32_t)-5, false, 1.5, false, NULL, (int64_t)7));
+    ASSERT(!byte_struct_is_null(s, data, &s->type_offsets[0]));
+    ASSERT(byte_struct_is_null(s, data, &s->type_offsets[1]));
+    ASSERT(byte_struct_is_null(s, data, &s->type_offsets[2]));
+    ASSERT(!byte_struct_is_null(s, data, &s->type_offsets[3]));
+
+    bool present[3] = {false, true, true};
+    int32_t i = 0;
+    double d = 2.0;
+    char str[3] = {'x', 'y', 'z'};
+    int64_t l = 0;
+    ASSERT(byte_struct_unpack(s, data, sizeof(data), &present[0], &i, &present[1], &d, &present[2], str, &l));
+    ASSERT(present[0] && !present[1] && !present[2]);
+    ASSERT_EQ(i, -5);
+    ASSERT_EQ(d, 0.0);
+    ASSERT_MEM_EQ(str, "\0\0\0", 3);
+    ASSERT_EQ(l, 7);
+
+    ASSERT(byte_struct_set_null(s, data, &s->type_offsets[0]));
+    ASSERT(!byte_struct_set_null(s, data, &s->type_offsets[3]));
+    ASSERT(byte_struct_unpack(s, data, sizeof(data), NULL, &i, NULL, &d, NULL, str, &l));
+    ASSERT_EQ(i, 0);
+    ASSERT(byte_struct_is_null(s, data, &s->type_offsets[0]));
+
+    // Nulls first for '?', last for '!', in both directions
+    byte_struct_t *sortable = byte_struct_new_len_options("?i!-lI", strlen("?i!-lI"), BYTE_STRUCT_SORTABLE);
+    ASSERT_NEQ(sortable, NULL);
+    size_t n = 200;
+    size_t size = sortable->total_size;
+    uint8_t *records = malloc(n * size);
+    ASSERT_NEQ(records, NULL);
+    uint32_t seed = 17;
+    for (size_t r = 0; r < n; r++) {
+        seed = seed * 1103515245 + 12345;
+        bool a_present = (seed >> 16) % 4 != 0;
+        bool b_present = (seed >> 18) % 3 != 0;
+        int32_t a = (int32_t)((seed >> 20) % 5) - 2;
+        int64_t b = (int64_t)((seed >> 23) % 5) - 2;
+        ASSERT(byte_struct_pack(sortable, records + r * size, a_present, a, b_present, b, (uint32_t)r));
+    }
+    ASSERT(byte_struct_sort(sortable, records, n));
+    for (size_t r = 1; r < n; r++) {
+        bool pa = false, pb = false, qa = false, qb = false;
+        int32_t a = 0, qa_value = 0;
+        int64_t b = 0, qb_value = 0;
+        uint32_t id = 0, qid = 0;
+        ASSERT(byte_struct_unpack(sortable, records + (r - 1) * size, size, &pa, &a, &pb, &b, &id));
+        ASSERT(byte_struct_unpack(sortable, records + r * size, size, &qa, &qa_value, &qb, &qb_value, &qid));
+        if (pa != qa) {
+            ASSERT(!pa);
+            continue;
+        }
+        if (a != qa_value) {
+            ASSERT(a < qa_value);
+            continue;
+        }
+        if (pb != qb) {
+            ASSERT(pb);
+            continue;
+        }
+        if (b != qb_value) {
+            ASSERT(b > qb_value);
+            continue;
+        }
+        ASSERT(id < qid);
+    }
+
+    uint8_t bitmap[25];
+    size_t nulls = byte_struct_null_bitmap(sortable, records, n, &sortable->type_offsets[0], bitmap);
+    ASSERT(nulls > 0 && nulls < n);
+    // nulls first, so the null records are exactly the first ones
+    for (size_t r = 0; r < n; r++) {
+        ASSERT_EQ((bitmap[r / 8] >> (r % 8)) & 1, r < nulls);
+    }
+    ASSERT_EQ(byte_struct_null_bitmap(sortable, records, n, &sortable->type_offsets[2], bitmap), 0);
+
+    // Markers carry over between byte orders and nulls convert back to the same bytes
+    uint8_t *converted = malloc(n * size);
+    uint8_t *round_trip = malloc(n * size);
+    ASSERT(converted != NULL && round_trip != NULL);
+    ASSERT(byte_struct_convert(sortable, records, n, BYTE_STRUCT_LITTLE_ENDIAN, converted));
+    byte_struct_t *little = byte_struct_new_len_options("?i!-lI", strlen("?i!-lI"), BYTE_STRUCT_LITTLE_ENDIAN);
+    ASSERT_NEQ(little, NULL);
+    ASSERT_EQ(byte_struct_null_bitmap(little, converted, n, &little->type_offsets[0], bitmap), nulls);
+    ASSERT(byte_struct_convert(little, converted, n, BYTE_STRUCT_SORTABLE, round_trip));
+    ASSERT_MEM_EQ(records, round_trip, n * size);
+
+    // Transcoding keeps nulls between nullable fields and defaults added ones to null
+    byte_struct_t *wide = byte_struct_new("?l!-lI?d");
+    ASSERT_NEQ(wide, NULL);
+    byte_struct_transcoder_t *t = byte_struct_transcoder_new(little, wide, (size_t[]){0, 1, 2, BYTE_STRUCT_TRANSCODE_DEFAULT});
+    ASSERT_NEQ(t, NULL);
+    uint8_t *transcoded = malloc(n * wide->total_size);
+    ASSERT_NEQ(transcoded, NULL);
+    ASSERT(byte_struct_transcode(t, converted, n, transcoded));
+    for (size_t r = 0; r < n; r++) {
+        uint8_t *src = converted + r * size;
+        uint8_t *dst = transcoded + r * wide->total_size;
+        bool pa = false, pb = false, pc = true;
+        int32_t a = 0;
+        int64_t b = 0, wide_a = 0, wide_b = 0;
+        uint32_t id = 0, wide_id = 0;
+        double c = 1.0;
+        ASSERT(byte_struct_unpack(little, src, size, &pa, &a, &pb, &b, &id));
+        ASSERT(byte_struct_unpack(wide, dst, wide->total_size, &pa, &wide_a, &pb, &wide_b, &wide_id, &pc, &c));
+        ASSERT_EQ(byte_struct_is_null(little, src, &little->type_offsets[0]), byte_struct_is_null(wide, dst, &wide->type_offsets[0]));
+        ASSERT_EQ(byte_struct_is_null(little, src, &little->type_offsets[1]), byte_struct_is_null(wide, dst, &wide->type_offsets[1]));
+        ASSERT_EQ(wide_a, a);
+        ASSERT_EQ(wide_b, b);
+        ASSERT_EQ(wide_id, id);
+        ASSERT(!pc);
+    }
+    byte_struct_transcoder_destroy(t);
+
+    // Empty unquoted columns load as null, "" as an empty string
+    byte_struct_t *csv = byte_struct_new("?i?c[4]?H[2]");
+    ASSERT_NEQ(csv, NULL);
+    const char *text = "1,ab,2,3\n,\"\", ,\n 7 ,,,\n";
+    ASSERT_EQ(csv->total_size, 15);
+    uint8_t csv_records[3 * 15];
+    size_t csv_n = 0;
+    byte_struct_csv_error_t error = {0};
+    ASSERT(byte_struct_csv_parse(NULL, csv, text, strlen(text), NULL, csv_records, 3, &csv_n, &error));
+    ASSERT_EQ(csv_n, 3);
+    ASSERT(!byte_struct_is_null(csv, csv_records, &csv->type_offsets[2]));
+    ASSERT(byte_struct_is_null(csv, csv_records + 15, &csv->type_offsets[0]));
+    ASSERT(!byte_struct_is_null(csv, csv_records + 15, &csv->type_offsets[1]));
+    ASSERT(byte_struct_is_null(csv, csv_records + 15, &csv->type_offsets[2]));
+    ASSERT(!byte_struct_is_null(csv, csv_records + 30, &csv->type_offsets[0]));
+    ASSERT(byte_struct_is_null(csv, csv_records + 30, &csv->type_offsets[1]));
+    char dumped[64];
+    size_t dumped_len = byte_struct_csv_dump(csv, csv_records, csv_n, NULL, dumped, sizeof(dumped));
+    ASSERT_EQ(dumped_len, strlen("1,ab,2,3\n,\"\",,\n7,,,\n"));
+    ASSERT_MEM_EQ(dumped, "1,ab,2,3\n,\"\",,\n7,,,\n", dumped_len);
+
+    byte_struct_destroy(csv);
+    free(transcoded);
+    byte_struct_destroy(wide);
+    byte_struct_destroy(little);
+    free(round_trip);
+    free(converted);
+    free(records);
+    byte_struct_destroy(sortable);
+    byte_struct_destroy(s);
+    PASS();
+}
+
+TEST test_byte_struct_groups(void) {
+    byte_struct_t *s = byte_struct_new("i(Hf)[3]c");
+    ASSERT_NEQ(s, NULL);
+    ASSERT_EQ(s->num_fields, 3);
+    ASSERT_EQ(s->num_type_offsets, 5);
+    ASSERT_EQ(s->total_size, 4 + 3 * 6 + 1);
+    ASSERT_EQ(s->type_offsets[1].type, BYTE_STRUCT_TYPE_GROUP);
+    ASSERT_EQ(s->type_offsets[1].offset, 4);
+    ASSERT_EQ(s->type_offsets[1].count, 3);
+    ASSERT_EQ(s->type_offsets[1].size, 6);
+    ASSERT_EQ(s->type_offsets[1].num_children, 2);
+    ASSERT_EQ(s->type_offsets[2].offset, 22);
+
+    typedef struct {
+        uint16_t id;
+        float weight;
+    } pair_t;
+    ASSERT_EQ(s->type_offsets[1].native_size, sizeof(pair_t));
+    ASSERT_EQ(s->type_offsets[s->type_offsets[1].first_child + 1].native_offset, offsetof(pair_t, weight));
+
+    pair_t pairs[3] = {{1, 0.5f}, {2, 1.5f}, {3, -2.0f}};
+    uint8_t data[23];
+    ASSERT(byte_struct_pack(s, data, (int32_t)-7, pairs, 'z'));
+    // The second pair's id sits right after the first pair
+    ASSERT_EQ(data[4 + 6], 0);
+    ASSERT_EQ(data[4 + 6 + 1], 2);
+
+    int32_t i = 0;
+    pair_t out[3] = {{0}};
+    char c = 0;
+    ASSERT(byte_struct_unpack(s, data, sizeof(data), &i, out, &c));
+    ASSERT_EQ(i, -7);
+    ASSERT_EQ(c, 'z');
+    for (size_t k = 0; k < 3; k++) {
+        ASSERT_EQ(out[k].id, pairs[k].id);
+        ASSERT_EQ(out[k].weight, pairs[k].weight);
+    }
+
+    type_offset_t field;
+    ASSERT(byte_struct_field_path(s, (size_t[]){1, 2, 0}, 3, &field));
+    ASSERT_EQ(field.type, BYTE_STRUCT_TYPE_UINT16);
+    ASSERT_EQ(field.offset, 4 + 2 * 6);
+    ASSERT(byte_struct_field_path(s, (size_t[]){1, 1}, 2, &field));
+    ASSERT_EQ(field.offset, 4 + 6);
+    ASSERT_EQ(field.count, 1);
+    ASSERT_FALSE(byte_struct_field_path(s, (size_t[]){1, 3, 0}, 3, &field));
+    ASSERT_FALSE(byte_struct_field_path(s, (size_t[]){0, 0, 0}, 3, &field));
+
+    // Batch and conversion walk the group members
+    uint8_t records[46];
+    memcpy(records, data, 23);
+    memcpy(records + 23, data, 23);
+    int32_t ints[2];
+    pair_t pair_column[6];
+    char chars[2];
+    ASSERT(byte_struct_unpack_batch(s, records, 2, (void *[]){ints, pair_column, chars}));
+    ASSERT_EQ(pair_column[5].id, 3);
+    ASSERT_EQ(pair_column[5].weight, -2.0f);
+
+    byte_struct_t *little = byte_struct_new_len_options("i(Hf)[3]c", 9, BYTE_STRUCT_LITTLE_ENDIAN);
+    uint8_t converted[46];
+    ASSERT(byte_struct_convert(s, records, 2, BYTE_STRUCT_LITTLE_ENDIAN, converted));
+    ASSERT_EQ(converted[23 + 4 + 6], 2);
+    ASSERT(byte_struct_unpack(little, converted + 23, 23, &i, out, &c));
+    ASSERT_EQ(out[2].weight, -2.0f);
+
+    byte_struct_transcoder_t *t = byte_struct_transcoder_new(little, s, NULL);
+    ASSERT_NEQ(t, NULL);
+    uint8_t round_trip[46];
+    ASSERT(byte_struct_transcode(t, converted, 2, round_trip));
+    ASSERT_MEM_EQ(records, round_trip, sizeof(records));
+    byte_struct_transcoder_destroy(t);
+
+    // Wider members get the common prefix and zeros, whatever dst held before
+    byte_struct_t *narrow_member = byte_struct_new("(H[2])");
+    byte_struct_t *wide_member = byte_struct_new("(H[4])");
+    ASSERT(narrow_member != NULL && wide_member != NULL);
+    t = byte_struct_transcoder_new(narrow_member, wide_member, NULL);
+    ASSERT_NEQ(t, NULL);
+    uint8_t narrow_data[4] = {0, 1, 0, 2};
+    uint8_t wide_data[8];
+    memset(wide_data, 0xab, sizeof(wide_data));
+    ASSERT(byte_struct_transcode(t, narrow_data, 1, wide_data));
+    ASSERT_MEM_EQ(wide_data, ((uint8_t[]){0, 1, 0, 2, 0, 0, 0, 0}), 8);
+    byte_struct_transcoder_destroy(t);
+    byte_struct_destroy(wide_member);
+    byte_struct_destroy(narrow_member);
+
+    // Nested groups and the natural struct layout of the values
+    byte_struct_t *nested = byte_struct_new("(b(hd)[2])[2]");
+    ASSERT_NEQ(nested, NULL);
+    ASSERT_EQ(nested->total_size, 2 * (1 + 2 * 10));
+    ASSERT(byte_struct_field_path(nested, (size_t[]){0, 1, 1, 1, 1}, 5, &field));
+    ASSERT_EQ(field.type, BYTE_STRUCT_TYPE_DOUBLE);
+    ASSERT_EQ(field.offset, 21 + 1 + 10 + 2);
+
+    ASSERT_EQ(byte_struct_new("i()"), NULL);
+    ASSERT_EQ(byte_struct_new("i(H"), NULL);
+    ASSERT_EQ(byte_struct_new("iH)"), NULL);
+    ASSERT_EQ(byte_struct_new("-(H)"), NULL);
+    ASSERT_EQ(byte_struct_new("(H)[0]"), NULL);
+    ASSERT_EQ(byte_struct_transcoder_new(nested, s, (size_t[]){0, 1, 2}), NULL);
+
+    byte_struct_destroy(nested);
+    byte_struct_destroy(little);
+    byte_struct_destroy(s);
+    PASS();
+}
+
+#define TEST_RING_RECORDS 20000
+#define TEST_RING_THREADS 2
+
+typedef struct {
+    byte_struct_ring_t *ring;
+    uint32_t producer;
+    uint64_t sum;
+    size_t consumed;
+} test_ring_arg_t;
+
+static BYTE_STRUCT_THREAD_RETURN test_ring_produce(void *arg) {
+    test_ring_arg_t *a = arg;
+    byte_struct_ring_reservation_t r;
+    for (uint32_t i = 0; i < TEST_RING_RECORDS;) {
+        if (!byte_struct_ring_reserve(a->ring, TEST_RING_RECORDS - i, &r)) {
+            byte_struct_cpu_relax();
+            continue;
+        }
+        for (size_t j = 0; j < r.count; j++, i++) {
+            byte_struct_pack(a->ring->schema, r.data + j * a->ring->schema->total_size, a->producer, i);
+        }
+        byte_struct_ring_commit(a->ring, &r);
+    }
+    return BYTE_STRUCT_THREAD_RETURN_VALUE;
+}
+
+static BYTE_STRUCT_THREAD_RETURN test_ring_consume(void *arg) {
+    test_ring_arg_t *a = arg;
+    byte_struct_ring_reservation_t r;
+    while (a->consumed < TEST_RING_RECORDS) {
+        size_t max = TEST_RING_RECORDS - a->consumed < 16 ? TEST_RING_RECORDS - a->consumed : 16;
+        if (!byte_struct_ring_acquire(a->ring, max, &r)) {
+            byte_struct_cpu_relax();
+            continue;
+        }
+        for (size_t j = 0; j < r.count; j++) {
+            uint32_t producer, i;
+            byte_struct_unpack(a->ring->schema, r.data + j * a->ring->schema->total_size, a->ring->schema->total_size, &producer, &i);
+            a->sum += i;
+        }
+        a->consumed += r.count;
+        byte_struct_ring_release(a->ring, &r);
+    }
+    return BYTE_STRUCT_THREAD_RETURN_VALUE;
+}
+
+TEST test_byte_struct_ring(void) {
+    ASSERT_EQ(byte_struct_ring_memory_size("II", 2, 6, BYTE_STRUCT_RING_SPSC), 0);
+    ASSERT_EQ(byte_struct_ring_new("II", 2, BYTE_STRUCT_BIG_ENDIAN, 0, BYTE_STRUCT_RING_SPSC), NULL);
+
+    // Runs stop at the end of the slot array
+    byte_struct_ring_t *ring = byte_struct_ring_new("II", 2, BYTE_STRUCT_BIG_ENDIAN, 8, BYTE_STRUCT_RING_SPSC);
+    ASSERT_NEQ(ring, NULL);
+    byte_struct_ring_reservation_t r;
+    ASSERT_FALSE(byte_struct_ring_acquire(ring, 4, &r));
+    ASSERT(byte_struct_ring_reserve(ring, 6, &r));
+    ASSERT_EQ(r.count, 6);
+    byte_struct_ring_commit(ring, &r);
+    ASSERT(byte_struct_ring_acquire(ring, 4, &r));
+    ASSERT_EQ(r.count, 4);
+    byte_struct_ring_release(ring, &r);
+    ASSERT(byte_struct_ring_reserve(ring, 6, &r));
+    ASSERT_EQ(r.count, 2);
+    byte_struct_ring_commit(ring, &r);
+    ASSERT(byte_struct_ring_reserve(ring, 6, &r));
+    ASSERT_EQ(r.count, 4);
+    byte_struct_ring_commit(ring, &r);
+    ASSERT_EQ(byte_struct_ring_size(ring), 8);
+    ASSERT_FALSE(byte_struct_ring_reserve(ring, 1, &r));
+    byte_struct_ring_destroy(ring);
+
+    // Caller-provided memory, attached through a second handle as another process would
+    size_t memory_size = byte_struct_ring_memory_size("HlI", 3, 64, BYTE_STRUCT_RING_MPMC);
+    ASSERT(memory_size > 0);
+    uint64_t *memory = malloc(memory_size);
+    ASSERT_EQ(byte_struct_ring_attach(memory, memory_size), NULL);
+    byte_struct_ring_t *producer = byte_struct_ring_init(memory, memory_size, "HlI", 3, BYTE_STRUCT_SORTABLE, 64, BYTE_STRUCT_RING_MPMC);
+    ASSERT_NEQ(producer, NULL);
+    ASSERT_EQ(byte_struct_ring_attach(memory, memory_size - 1), NULL);
+    byte_struct_ring_t *consumer = byte_struct_ring_attach(memory, memory_size);
+    ASSERT_NEQ(consumer, NULL);
+    ASSERT_EQ(consumer->schema->byte_order, BYTE_STRUCT_SORTABLE);
+    ASSERT_EQ(consumer->schema->total_size, 14);
+
+    ASSERT(byte_struct_ring_reserve(producer, 1, &r));
+    ASSERT(byte_struct_pack(producer->schema, r.data, (uint16_t)3, (int64_t)-9, (uint32_t)12));
+    byte_struct_ring_commit(producer, &r);
+    ASSERT(byte_struct_ring_acquire(consumer, 8, &r));
+    ASSERT_EQ(r.count, 1);
+    uint16_t h;
+    int64_t l;
+    uint32_t u;
+    ASSERT(byte_struct_unpack(consumer->schema, r.data, r.count * consumer->schema->total_size, &h, &l, &u));
+    ASSERT_EQ(l, -9);
+    byte_struct_ring_release(consumer, &r);
+    byte_struct_ring_destroy(producer);
+    byte_struct_ring_destroy(consumer);
+    free(memory);
+
+    // Concurrent producers and consumers, each record seen exactly once
+    byte_struct_ring_mode_t modes[] = {BYTE_STRUCT_RING_SPSC, BYTE_STRUCT_RING_MPMC};
+    for (size_t m = 0; m < 2; m++) {
+        size_t num_threads = modes[m] == BYTE_STRUCT_RING_SPSC ? 1 : TEST_RING_THREADS;
+        ring = byte_struct_ring_new("II", 2, BYTE_STRUCT_LITTLE_ENDIAN, 128, modes[m]);
+        ASSERT_NEQ(ring, NULL);
+        test_ring_arg_t producers[TEST_RING_THREADS], consumers[TEST_RING_THREADS];
+        byte_struct_thread_t threads[2 * TEST_RING_THREADS];
+        for (size_t k = 0; k < num_threads; k++) {
+            producers[k] = (test_ring_arg_t){.ring = ring, .producer = (uint32_t)k};
+            consumers[k] = (test_ring_arg_t){.ring = ring};
+            ASSERT(byte_struct_thread_create(&threads[2 * k], test_ring_produce, &producers[k]));
+            ASSERT(byte_struct_thread_create(&threads[2 * k + 1], test_ring_consume, &consumers[k]));
+        }
+        uint64_t sum = 0;
+        for (size_t k = 0; k < num_threads; k++) {
+            byte_struct_thread_join(threads[2 * k]);
+            byte_struct_thread_join(threads[2 * k + 1]);
+            sum += consumers[k].sum;
+        }
+        ASSERT_EQ(sum, (uint64_t)num_threads * TEST_RING_RECORDS * (TEST_RING_RECORDS - 1) / 2);
+        ASSERT_EQ(byte_struct_ring_size(ring), 0);
+        byte_struct_ring_destroy(ring);
+    }
+    PASS();
+}
+
+TEST test_byte_struct_bloom(void) {
+    byte_struct_t *s = byte_struct_new_len_options("IlH", 3, BYTE_STRUCT_SORTABLE);
+    ASSERT_NEQ(s, NULL);
+    ASSERT_EQ(byte_struct_bloom_new(s, 0, 100, 0), NULL);
+    ASSERT_EQ(byte_struct_bloom_new(s, 4, 100, 0), NULL);
+
+    size_t n = 2000;
+    uint32_t *tenants = malloc(n * sizeof(uint32_t));
+    int64_t *timestamps = malloc(n * sizeof(int64_t));
+    uint16_t *shards = malloc(n * sizeof(uint16_t));
+    uint8_t *data = malloc(n * s->total_size);
+    bool *results = malloc(n * sizeof(bool));
+    ASSERT(tenants != NULL && timestamps != NULL && shards != NULL && data != NULL && results != NULL);
+    for (size_t i = 0; i < n; i++) {
+        tenants[i] = (uint32_t)(i / 10);
+        timestamps[i] = (int64_t)i * 1000;
+        shards[i] = (uint16_t)(i % 7);
+    }
+    ASSERT(byte_struct_pack_batch(s, data, n, (void *[]){tenants, timestamps, shards}));
+
+    byte_struct_bloom_t *full = byte_struct_bloom_new(s, s->num_fields, n, 0);
+    byte_struct_bloom_t *prefix = byte_struct_bloom_new(s, 1, n / 10, 0);
+    ASSERT(full != NULL && prefix != NULL);
+    ASSERT_EQ(prefix->key_len, sizeof(uint32_t));
+    byte_struct_bloom_add_batch(full, data, n);
+    byte_struct_bloom_add_batch(prefix, data, n);
+
+    // No false negatives
+    ASSERT_EQ(byte_struct_bloom_may_contain_batch(full, data, n, results), n);
+    for (size_t i = 0; i < n; i++) {
+        ASSERT(byte_struct_bloom_may_contain(prefix, data + i * s->total_size));
+    }
+
+    // Misses are mostly rejected, for whole keys and for tenant prefixes
+    size_t false_positives = 0, prefix_false_positives = 0;
+    uint8_t key[14];
+    for (size_t i = 0; i < n; i++) {
+        ASSERT(byte_struct_pack(s, key, (uint32_t)(i / 10), (int64_t)i * 1000 + 1, (uint16_t)0));
+        false_positives += byte_struct_bloom_may_contain(full, key);
+        ASSERT(byte_struct_pack(s, key, (uint32_t)(n + i), (int64_t)0, (uint16_t)0));
+        prefix_false_positives += byte_struct_bloom_may_contain(prefix, key);
+    }
+    ASSERT(false_positives < n / 20);
+    ASSERT(prefix_false_positives < n / 20);
+
+    size_t size = byte_struct_bloom_serialized_size(full);
+    uint8_t *serialized = malloc(size);
+    ASSERT(byte_struct_bloom_serialize(full, serialized));
+    ASSERT_EQ(byte_struct_bloom_deserialize(serialized, size - 1), NULL);
+    byte_struct_bloom_t *loaded = byte_struct_bloom_deserialize(serialized, size);
+    ASSERT_NEQ(loaded, NULL);
+    ASSERT_EQ(loaded->num_blocks, full->num_blocks);
+    ASSERT_MEM_EQ(loaded->blocks, full->blocks, full->num_blocks * sizeof(byte_struct_bloom_block_t));
+    ASSERT(byte_struct_bloom_may_contain(loaded, data + 17 * s->total_size));
+
+    byte_struct_bloom_t *empty = byte_struct_bloom_new(s, s->num_fields, n, 0);
+    ASSERT(byte_struct_bloom_merge(empty, full));
+    ASSERT_MEM_EQ(empty->blocks, full->blocks, full->num_blocks * sizeof(byte_struct_bloom_block_t));
+    ASSERT_FALSE(byte_struct_bloom_merge(prefix, full));
+
+    byte_struct_bloom_destroy(empty);
+    byte_struct_bloom_destroy(loaded);
+    byte_struct_bloom_destroy(full);
+    byte_struct_bloom_destroy(prefix);
+    free(serialized);
+    free(tenants);
+    free(timestamps);
+    free(shards);
+    free(data);
+    free(results);
+    byte_struct_destroy(s);
+    PASS();
+}
+
+TEST test_byte_struct_zone_map(void) {
+    // Time-ordered telemetry: timestamp rises, sensor cycles, reading wanders
+    byte_struct_t *s = byte_struct_new("lHf");
+    ASSERT_NEQ(s, NULL);
+    ASSERT_EQ(byte_struct_zone_map_new(s, 100, BYTE_STRUCT_ZONE_MAP_KEY_RANGE), NULL);
+    byte_struct_zone_map_t *zm = byte_struct_zone_map_new(s, 100, BYTE_STRUCT_ZONE_MAP_MIN_MAX);
+    ASSERT_NEQ(zm, NULL);
+
+    size_t n = 1050;
+    int64_t *timestamps = malloc(n * sizeof(int64_t));
+    uint16_t *sensors = malloc(n * sizeof(uint16_t));
+    float *readings = malloc(n * sizeof(float));
+    uint8_t *data = malloc(n * s->total_size);
+    ASSERT(timestamps != NULL && sensors != NULL && readings != NULL && data != NULL);
+    for (size_t i = 0; i < n; i++) {
+        timestamps[i] = (int64_t)i * 10 - 5000;
+        sensors[i] = (uint16_t)(i % 13);
+        readings[i] = (float)((int)(i % 50) - 25);
+    }
+    // Packed in two chunks, blocks straddle the boundary
+    ASSERT(byte_struct_pack_batch_zone_map(zm, data, 150, (void *[]){timestamps, sensors, readings}));
+    ASSERT(byte_struct_pack_batch_zone_map(zm, data + 150 * s->total_size, n - 150, (void *[]){timestamps + 150, sensors + 150, readings + 150}));
+    ASSERT_EQ(zm->num_blocks, 11);
+
+    size_t start, end;
+    byte_struct_zone_map_block_range(zm, 10, &start, &end);
+    ASSERT_EQ(start, 1000);
+    ASSERT_EQ(end, n);
+
+    uint8_t lo[14], hi[14];
+    ASSERT(byte_struct_pack(s, lo, (int64_t)-10, (uint16_t)0, -30.0));
+    ASSERT(byte_struct_pack(s, hi, (int64_t)1990, (uint16_t)0, 30.0));
+    size_t blocks[11];
+    byte_struct_zone_predicate_t time_range = {.field = 0, .lo = lo, .hi = hi};
+    size_t num_blocks = byte_struct_zone_map_select(zm, &time_range, 1, blocks);
+    ASSERT_EQ(num_blocks, 3);
+    ASSERT_EQ(blocks[0], 4);
+    ASSERT_EQ(blocks[2], 6);
+
+    // Negative floats order correctly, no block has a reading above 24
+    uint8_t reading_lo[14], reading_hi[14];
+    ASSERT(byte_struct_pack(s, reading_lo, (int64_t)0, (uint16_t)0, 24.5));
+    byte_struct_zone_predicate_t high_reading = {.field = 2, .lo = reading_lo, .hi = NULL};
+    ASSERT_EQ(byte_struct_zone_map_select(zm, &high_reading, 1, blocks), 0);
+    ASSERT(byte_struct_pack(s, reading_hi, (int64_t)0, (uint16_t)0, -25.0));
+    byte_struct_zone_predicate_t low_reading = {.field = 2, .lo = NULL, .hi = reading_hi};
+    ASSERT_EQ(byte_struct_zone_map_select(zm, &low_reading, 1, blocks), 11);
+    ASSERT_EQ(byte_struct_zone_map_select(zm, (byte_struct_zone_predicate_t[]){time_range, high_reading}, 2, blocks), 0);
+
+    size_t size = byte_struct_zone_map_serialized_size(zm);
+    uint8_t *serialized = malloc(size);
+    ASSERT(byte_struct_zone_map_serialize(zm, serialized));
+    byte_struct_zone_map_t *loaded = byte_struct_zone_map_deserialize(s, serialized, size);
+    ASSERT_NEQ(loaded, NULL);
+    ASSERT_EQ(loaded->num_records, n);
+    ASSERT_EQ(byte_struct_zone_map_select(loaded, &time_range, 1, blocks), 3);
+    ASSERT_EQ(byte_struct_zone_map_deserialize(s, serialized, size - 1), NULL);
+    byte_struct_zone_map_destroy(loaded);
+    free(serialized);
+
+    // Sorted sortable keys: first/last key per block and binary search on a prefix
+    byte_struct_t *sorted = byte_struct_new_len_options("Hl", 2, BYTE_STRUCT_SORTABLE);
+    byte_struct_zone_map_t *key_map = byte_struct_zone_map_new(sorted, 64, BYTE_STRUCT_ZONE_MAP_KEY_RANGE);
+    ASSERT_NEQ(key_map, NULL);
+    uint16_t *tenants = malloc(n * sizeof(uint16_t));
+    for (size_t i = 0; i < n; i++) {
+        tenants[i] = (uint16_t)(i / 100);
+    }
+    ASSERT(byte_struct_pack_batch_zone_map(key_map, data, n, (void *[]){tenants, timestamps}));
+    uint8_t key_lo[10], key_hi[10];
+    ASSERT(byte_struct_pack(sorted, key_lo, (uint16_t)3, (int64_t)0));
+    ASSERT(byte_struct_pack(sorted, key_hi, (uint16_t)4, (int64_t)0));
+    size_t first_block, end_block;
+    ASSERT(byte_struct_zone_map_key_blocks(key_map, key_lo, key_hi, 1, &first_block, &end_block));
+    // Tenants 3 and 4 are records [300, 500), blocks 4 through 7
+    ASSERT_EQ(first_block, 4);
+    ASSERT_EQ(end_block, 8);
+    ASSERT(byte_struct_zone_map_key_blocks(key_map, NULL, key_lo, 1, &first_block, &end_block));
+    ASSERT_EQ(first_block, 0);
+    ASSERT_EQ(end_block, 7);
+
+    byte_struct_zone_map_destroy(key_map);
+    byte_struct_destroy(sorted);
+    free(tenants);
+    free(timestamps);
+    free(sensors);
+    free(readings);
+    free(data);
+    byte_struct_zone_map_destroy(zm);
+    byte_struct_destroy(s);
+    PASS();
+}
+
+TEST test_byte_struct_merge(void) {
+    byte_struct_t *s = byte_struct_new_len_options("IH", 2, BYTE_STRUCT_SORTABLE);
+    byte_struct_t *other = byte_struct_new_len_options("Id", 2, BYTE_STRUCT_SORTABLE);
+    ASSERT(s != NULL && other != NULL);
+
+    // Small/large pairs exercise both the linear and the galloping paths
+    size_t sizes[][2] = {{40, 50}, {7, 3000}, {3000, 5}};
+    for (size_t c = 0; c < sizeof(sizes) / sizeof(sizes[0]); c++) {
+        size_t na = sizes[c][0], nb = sizes[c][1];
+        uint32_t *a_keys = malloc(na * sizeof(uint32_t));
+        uint16_t *a_vals = malloc(na * sizeof(uint16_t));
+        uint32_t *b_keys = malloc(nb * sizeof(uint32_t));
+        double *b_vals = malloc(nb * sizeof(double));
+        uint16_t *b_shorts = calloc(nb, sizeof(uint16_t));
+        uint8_t *a = malloc(na * s->total_size);
+        uint8_t *b = malloc(nb * other->total_size);
+        uint8_t *b_same = malloc(nb * s->total_size);
+        size_t *indices = malloc((na + nb) * sizeof(size_t));
+        uint8_t *out = malloc((na + nb) * s->total_size);
+        ASSERT(a_keys && a_vals && b_keys && b_vals && b_shorts && a && b && b_same && indices && out);
+        // Sorted keys with duplicates on both sides
+        for (size_t i = 0; i < na; i++) {
+            a_keys[i] = (uint32_t)(i * 3 / 2);
+            a_vals[i] = (uint16_t)i;
+        }
+        for (size_t j = 0; j < nb; j++) {
+            b_keys[j] = (uint32_t)(j * 5 / 3 + 1);
+            b_vals[j] = (double)j;
+        }
+        ASSERT(byte_struct_pack_batch(s, a, na, (void *[]){a_keys, a_vals}));
+        ASSERT(byte_struct_pack_batch(other, b, nb, (void *[]){b_keys, b_vals}));
+        ASSERT(byte_struct_pack_batch(s, b_same, nb, (void *[]){b_keys, b_shorts}));
+
+        byte_struct_index_pairs_t pairs = {0};
+        ASSERT(byte_struct_merge_join(s, a, na, other, b, nb, 1, &pairs));
+        size_t expected_pairs = 0, expected_intersect = 0;
+        for (size_t i = 0; i < na; i++) {
+            bool found = false;
+            for (size_t j = 0; j < nb; j++) {
+                if (a_keys[i] == b_keys[j]) {
+                    ASSERT(expected_pairs < pairs.n);
+                    ASSERT_EQ(pairs.a[expected_pairs], i);
+                    ASSERT_EQ(pairs.b[expected_pairs], j);
+                    expected_pairs++;
+                    found = true;
+                }
+            }
+            expected_intersect += found;
+        }
+        ASSERT_EQ(pairs.n, expected_pairs);
+
+        uint8_t *joined = malloc((pairs.n > 0 ? pairs.n : 1) * 14);
+        ASSERT(byte_struct_merge_join_records(s, a, other, b, 1, &pairs, joined));
+        if (pairs.n > 0) {
+            byte_struct_t *joined_s = byte_struct_new_len_options("IHd", 3, BYTE_STRUCT_SORTABLE);
+            uint32_t key;
+            uint16_t a_val;
+            double b_val;
+            ASSERT(byte_struct_unpack(joined_s, joined + (pairs.n - 1) * 14, 14, &key, &a_val, &b_val));
+            ASSERT_EQ(key, a_keys[pairs.a[pairs.n - 1]]);
+            ASSERT_EQ(b_val, b_vals[pairs.b[pairs.n - 1]]);
+            byte_struct_destroy(joined_s);
+        }
+        free(joined);
+        byte_struct_index_pairs_destroy(&pairs);
+
+        size_t num_intersect = byte_struct_merge_intersect(s, a, na, b_same, nb, 1, indices, out);
+        ASSERT_EQ(num_intersect, expected_intersect);
+        size_t num_difference = byte_struct_merge_difference(s, a, na, b_same, nb, 1, NULL, out);
+        ASSERT_EQ(num_difference, na - expected_intersect);
+        for (size_t r = 0; r < num_difference; r++) {
+            uint32_t key;
+            uint16_t val;
+            ASSERT(byte_struct_unpack(s, out + r * s->total_size, s->total_size, &key, &val));
+            for (size_t j = 0; j < nb; j++) {
+                ASSERT_NEQ(key, b_keys[j]);
+            }
+        }
+
+        // Union keeps key order and drops b records whose key is in a
+        size_t num_union = byte_struct_merge_union(s, a, na, b_same, nb, 1, out);
+        size_t b_only = byte_struct_merge_difference(s, b_same, nb, a, na, 1, indices, NULL);
+        ASSERT_EQ(num_union, na + b_only);
+        for (size_t r = 1; r < num_union; r++) {
+            ASSERT(memcmp(out + (r - 1) * s->total_size, out + r * s->total_size, 4) <= 0);
+        }
+
+        free(a_keys);
+        free(a_vals);
+        free(b_keys);
+        free(b_vals);
+        free(b_shorts);
+        free(a);
+        free(b);
+        free(b_same);
+        free(indices);
+        free(out);
+    }
+
+    // Key fields must agree and the data must be sortable
+    byte_struct_index_pairs_t pairs = {0};
+    byte_struct_t *big = byte_struct_new("IH");
+    ASSERT_FALSE(byte_struct_merge_join(s, NULL, 0, other, NULL, 0, 2, &pairs));
+    ASSERT_FALSE(byte_struct_merge_join(big, NULL, 0, s, NULL, 0, 1, &pairs));
+    byte_struct_destroy(big);
+    byte_struct_destroy(other);
+    byte_struct_destroy(s);
+    PASS();
+}
+
+TEST test_byte_struct_half(void) {
+    // The new types don't renumber existing ones
+    ASSERT_EQ(BYTE_STRUCT_TYPE_PTR, 11);
+    ASSERT(BYTE_STRUCT_TYPE_HALF > BYTE_STRUCT_TYPE_PTR && BYTE_STRUCT_TYPE_BFLOAT16 > BYTE_STRUCT_TYPE_PTR);
+
+    // Exact values, rounding to nearest even, overflow, subnormals and NaN
+    ASSERT_EQ(byte_struct_float_to_half(1.0f), 0x3c00);
+    ASSERT_EQ(byte_struct_float_to_half(-2.0f), 0xc000);
+    ASSERT_EQ(byte_struct_float_to_half(65504.0f), 0x7bff);
+    ASSERT_EQ(byte_struct_float_to_half(65520.0f), 0x7c00);
+    ASSERT_EQ(byte_struct_float_to_half(1.0f + 1.0f / 2048.0f), 0x3c00);
+    ASSERT_EQ(byte_struct_float_to_half(1.0f + 3.0f / 2048.0f), 0x3c02);
+    ASSERT_EQ(byte_struct_float_to_half(5.9604645e-8f), 0x0001);
+    ASSERT_EQ(byte_struct_half_to_float(0x0001), 5.9604645e-8f);
+    ASSERT_EQ(byte_struct_half_to_float(0x7bff), 65504.0f);
+    ASSERT_EQ(byte_struct_float_to_bfloat16(1.0f), 0x3f80);
+    ASSERT_EQ(byte_struct_float_to_bfloat16(1.0f + 1.0f / 256.0f), 0x3f80);
+    ASSERT_EQ(byte_struct_float_to_bfloat16(1.0f + 3.0f / 256.0f), 0x3f82);
+    ASSERT_EQ(byte_struct_bfloat16_to_float(0xc040), -3.0f);
+    float nan = byte_struct_half_to_float(byte_struct_float_to_half(byte_struct_bits_float(0x7fc00000u)));
+    ASSERT(nan != nan);
+    // Signaling NaNs are quieted, keeping the payload
+    ASSERT_EQ(byte_struct_float_bits(byte_struct_half_to_float(0x7c01)), 0x7fc02000u);
+    ASSERT_EQ(byte_struct_float_bits(byte_struct_half_to_float(0xfd00)), 0xffe00000u);
+#ifdef __F16C__
+    // Scalar decoding gives the same bits as the hardware for every half
+    for (uint32_t h = 0; h < 65536; h += 8) {
+        uint16_t halves[8];
+        float hardware[8];
+        for (uint32_t k = 0; k < 8; k++) halves[k] = (uint16_t)(h + k);
+        _mm256_storeu_ps(hardware, _mm256_cvtph_ps(_mm_loadu_si128((const __m128i *)halves)));
+        for (uint32_t k = 0; k < 8; k++) {
+            ASSERT_EQ(byte_struct_float_bits(byte_struct_half_to_float(halves[k])), byte_struct_float_bits(hardware[k]));
+        }
+    }
+#endif
+
+    // Every half value survives a round trip through float, in every byte order
+    float *all = malloc(65536 * sizeof(float));
+    float *out = malloc(65536 * sizeof(float));
+    uint8_t *data = malloc(65536 * sizeof(uint16_t));
+    ASSERT(all != NULL && out != NULL && data != NULL);
+    for (uint32_t h = 0; h < 65536; h++) {
+        all[h] = byte_struct_half_to_float((uint16_t)h);
+    }
+    byte_order_t orders[] = {BYTE_STRUCT_BIG_ENDIAN, BYTE_STRUCT_LITTLE_ENDIAN, BYTE_STRUCT_NATIVE_ENDIAN, BYTE_STRUCT_SORTABLE};
+    for (size_t o = 0; o < 4; o++) {
+        byte_struct_t *s = byte_struct_new_len_options("e", 1, orders[o]);
+        ASSERT_NEQ(s, NULL);
+        ASSERT_EQ(s->total_size, 2);
+        ASSERT(byte_struct_pack_batch(s, data, 65536, (void *[]){all}));
+        ASSERT(byte_struct_unpack_batch(s, data, 65536, (void *[]){out}));
+        for (uint32_t h = 0; h < 65536; h++) {
+            if (all[h] == all[h]) {
+                ASSERT_MEM_EQ(&all[h], &out[h], sizeof(float));
+            } else {
+                ASSERT(out[h] != out[h]);
+            }
+        }
+        byte_struct_destroy(s);
+    }
+    byte_struct_t *big = byte_struct_new("e");
+    ASSERT(byte_struct_pack(big, data, 1.0));
+    ASSERT_EQ(data[0], 0x3c);
+    ASSERT_EQ(data[1], 0x00);
+    byte_struct_destroy(big);
+
+    // Sortable encodings order like the values
+    byte_struct_t *sortable = byte_struct_new_len_options("eE", 2, BYTE_STRUCT_SORTABLE);
+    float ordered[] = {-65504.0f, -2.5f, -1e-6f, 0.0f, 1e-6f, 0.75f, 3.0f, 60000.0f};
+    uint8_t prev[4], cur[4];
+    for (size_t i = 0; i < sizeof(ordered) / sizeof(ordered[0]); i++) {
+        ASSERT(byte_struct_pack(sortable, cur, (double)ordered[i], (double)ordered[i]));
+        if (i > 0) {
+            ASSERT(memcmp(prev, cur, 2) < 0);
+            ASSERT(memcmp(prev + 2, cur + 2, 2) < 0);
+        }
+        memcpy(prev, cur, 4);
+    }
+    float h = 0.0f, b = 0.0f;
+    ASSERT(byte_struct_unpack(sortable, cur, 4, &h, &b));
+    ASSERT_EQ(h, 60000.0f);
+    ASSERT_EQ(b, 59904.0f);
+
+    // Feature vectors: float arrays in, half the bytes out, conversion across orders
+    byte_struct_t *vector = byte_struct_new_len_options("Ie[19]", 6, BYTE_STRUCT_LITTLE_ENDIAN);
+    ASSERT_EQ(vector->total_size, 4 + 19 * 2);
+    float features[19], features_out[19];
+    for (size_t i = 0; i < 19; i++) {
+        features[i] = (float)i * 0.25f - 2.0f;
+    }
+    uint8_t record[42], converted[42];
+    ASSERT(byte_struct_pack(vector, record, (uint32_t)9, features));
+    ASSERT(byte_struct_convert(vector, record, 1, BYTE_STRUCT_SORTABLE, converted));
+    byte_struct_t *sortable_vector = byte_struct_new_len_options("Ie[19]", 6, BYTE_STRUCT_SORTABLE);
+    uint32_t id = 0;
+    ASSERT(byte_struct_unpack(sortable_vector, converted, 42, &id, features_out));
+    ASSERT_MEM_EQ(features, features_out, sizeof(features));
+
+    byte_struct_t *floats = byte_struct_new_len_options("If[19]", 6, BYTE_STRUCT_LITTLE_ENDIAN);
+    byte_struct_transcoder_t *t = byte_struct_transcoder_new(vector, floats, NULL);
+    ASSERT_NEQ(t, NULL);
+    uint8_t widened[80];
+    ASSERT(byte_struct_transcode(t, record, 1, widened));
+    ASSERT(byte_struct_unpack(floats, widened, 80, &id, features_out));
+    ASSERT_MEM_EQ(features, features_out, sizeof(features));
+    byte_struct_transcoder_destroy(t);
+
+    byte_struct_destroy(floats);
+    byte_struct_destroy(sortable_vector);
+    byte_struct_destroy(vector);
+    byte_struct_destroy(sortable);
+    free(all);
+    free(out);
+    free(data);
+    PASS();
+}
+
+TEST test_byte_struct_relptr(void) {
+    ASSERT_EQ(byte_struct_new("I-r"), NULL);
+
+    // Singly linked chain: id, next, and an array of two back references
+    byte_struct_t *s = byte_struct_new_len_options("Irr[2]", 6, BYTE_STRUCT_LITTLE_ENDIAN);
+    ASSERT_NEQ(s, NULL);
+    ASSERT_EQ(s->total_size, 4 + 3 * 8);
+    size_t n = 16;
+    size_t pool_size = n * s->total_size;
+    uint8_t *pool = malloc(pool_size);
+    uint8_t *copy = malloc(pool_size);
+    uint8_t *converted = malloc(pool_size);
+    ASSERT(pool != NULL && copy != NULL && converted != NULL);
+    for (size_t i = 0; i < n; i++) {
+        uint8_t *record = pool + i * s->total_size;
+        void *next = i + 1 < n ? record + s->total_size : NULL;
+        void *back[2] = {i > 0 ? record - s->total_size : NULL, pool};
+        ASSERT(byte_struct_pack(s, record, (uint32_t)i, next, back));
+    }
+    // NULL stores INT64_MIN, little-endian here
+    uint8_t null_offset[8] = {0, 0, 0, 0, 0, 0, 0, 0x80};
+    ASSERT_MEM_EQ(pool + (n - 1) * s->total_size + 4, null_offset, 8);
+
+    // Offset 0 is a pointer to the field itself, e.g. the sentinel of an empty circular list
+    byte_struct_t *sentinel = byte_struct_new_len_options("rI", 2, BYTE_STRUCT_BIG_ENDIAN);
+    ASSERT_NEQ(sentinel, NULL);
+    uint8_t head[12];
+    ASSERT(byte_struct_pack(sentinel, head, (void *)head, (uint32_t)0));
+    void *head_next = NULL;
+    uint32_t head_size = 1;
+    ASSERT(byte_struct_unpack(sentinel, head, sizeof(head), &head_next, &head_size));
+    ASSERT_EQ(head_next, head);
+    ASSERT_EQ(byte_struct_relptr_resolve(sentinel, head, &sentinel->type_offsets[0]), head);
+    ASSERT(byte_struct_pool_resolve(sentinel, head, sizeof(head), sentinel->total_size, head, &sentinel->type_offsets[0], &head_next));
+    ASSERT_EQ(head_next, head);
+    byte_struct_destroy(sentinel);
+
+    // A copy at another address links to itself without any fixup
+    memcpy(copy, pool, pool_size);
+    memset(pool, 0, pool_size);
+    size_t visited = 0;
+    for (uint8_t *record = copy; record != NULL; visited++) {
+        uint32_t id = 0;
+        void *next = NULL;
+        void *back[2] = {NULL, NULL};
+        ASSERT(byte_struct_unpack(s, record, s->total_size, &id, &next, back));
+        ASSERT_EQ(id, visited);
+        ASSERT_EQ(back[0], visited > 0 ? record - s->total_size : NULL);
+        ASSERT_EQ(back[1], copy);
+        ASSERT_EQ(byte_struct_relptr_resolve(s, record, &s->type_offsets[1]), next);
+        record = next;
+    }
+    ASSERT_EQ(visited, n);
+
+    // Batch unpack resolves against each record's address
+    uint32_t ids[16];
+    void *nexts[16];
+    void *backs[32];
+    ASSERT(byte_struct_unpack_batch(s, copy, n, (void *[]){ids, nexts, backs}));
+    ASSERT_EQ(nexts[3], copy + 4 * s->total_size);
+    ASSERT_EQ(backs[2 * 3], copy + 2 * s->total_size);
+
+    // In place assignment, then conversion to another byte order keeps the offsets
+    ASSERT(byte_struct_relptr_assign(s, copy, &s->type_offsets[1], copy + 5 * s->total_size));
+    ASSERT_EQ(byte_struct_relptr_resolve(s, copy, &s->type_offsets[1]), copy + 5 * s->total_size);
+    ASSERT(!byte_struct_relptr_assign(s, copy, &s->type_offsets[0], copy));
+    ASSERT(byte_struct_convert(s, copy, n, BYTE_STRUCT_BIG_ENDIAN, converted));
+    byte_struct_t *big = byte_struct_new_len_options("Irr[2]", 6, BYTE_STRUCT_BIG_ENDIAN);
+    ASSERT_EQ(byte_struct_relptr_resolve(big, converted, &big->type_offsets[1]), converted + 5 * s->total_size);
+    type_offset_t element;
+    ASSERT(byte_struct_field_path(big, (size_t[]){2, 1}, 2, &element));
+    ASSERT_EQ(byte_struct_relptr_resolve(big, converted + 7 * s->total_size, &element), converted);
+
+    // The transcoder carries the offsets over too, the output links within itself
+    byte_struct_transcoder_t *transcoder = byte_struct_transcoder_new(s, big, NULL);
+    ASSERT_NEQ(transcoder, NULL);
+    uint8_t *transcoded = malloc(pool_size);
+    ASSERT_NEQ(transcoded, NULL);
+    ASSERT(byte_struct_transcode(transcoder, copy, n, transcoded));
+    ASSERT_MEM_EQ(transcoded, converted, pool_size);
+    ASSERT_EQ(byte_struct_relptr_resolve(big, transcoded, &big->type_offsets[1]), transcoded + 5 * s->total_size);
+    byte_struct_transcoder_destroy(transcoder);
+    // Same within groups, which go element by element
+    byte_struct_t *grouped = byte_struct_new_len_options("I(r)[3]", 7, BYTE_STRUCT_LITTLE_ENDIAN);
+    byte_struct_t *grouped_big = byte_struct_new_len_options("I(r)[3]", 7, BYTE_STRUCT_BIG_ENDIAN);
+    ASSERT(grouped != NULL && grouped_big != NULL);
+    transcoder = byte_struct_transcoder_new(grouped, grouped_big, NULL);
+    ASSERT_NEQ(transcoder, NULL);
+    void *links[3] = {copy, copy + s->total_size, NULL};
+    ASSERT(byte_struct_pack(grouped, copy, (uint32_t)1, links));
+    ASSERT(byte_struct_transcode(transcoder, copy, 1, transcoded));
+    void *transcoded_links[3] = {NULL, NULL, copy};
+    uint32_t grouped_id = 0;
+    ASSERT(byte_struct_unpack(grouped_big, transcoded, grouped_big->total_size, &grouped_id, transcoded_links));
+    ASSERT_EQ(transcoded_links[0], transcoded);
+    ASSERT_EQ(transcoded_links[1], transcoded + s->total_size);
+    ASSERT_EQ(transcoded_links[2], NULL);
+    byte_struct_transcoder_destroy(transcoder);
+    // Moving an 'r' field or resizing the records would break the offsets
+    byte_struct_t *relptr_moved = byte_struct_new_len_options("rIr[2]", 6, BYTE_STRUCT_BIG_ENDIAN);
+    byte_struct_t *wider = byte_struct_new_len_options("Irr[2]c", 7, BYTE_STRUCT_BIG_ENDIAN);
+    ASSERT(relptr_moved != NULL && wider != NULL);
+    ASSERT_EQ(byte_struct_transcoder_new(s, relptr_moved, (size_t[]){1, 0, 2}), NULL);
+    ASSERT_EQ(byte_struct_transcoder_new(s, wider, (size_t[]){0, 1, 2, BYTE_STRUCT_TRANSCODE_DEFAULT}), NULL);
+    byte_struct_destroy(wider);
+    byte_struct_destroy(relptr_moved);
+    byte_struct_destroy(grouped_big);
+    byte_struct_destroy(grouped);
+    free(transcoded);
+
+    // Pool resolution checks targets against the mapping
+    void *target = NULL;
+    uint8_t *last = converted + (n - 1) * s->total_size;
+    ASSERT(byte_struct_pool_resolve(big, converted, pool_size, s->total_size, last, &big->type_offsets[1], &target));
+    ASSERT_EQ(target, NULL);
+    ASSERT(byte_struct_pool_resolve(big, converted, pool_size, s->total_size, last, &big->type_offsets[2], &target));
+    ASSERT_EQ(target, last - s->total_size);
+    ASSERT(byte_struct_pool_resolve(big, converted, pool_size, s->total_size, last, &element, &target));
+    ASSERT_EQ(target, converted);
+    ASSERT(!byte_struct_pool_resolve(big, converted + s->total_size, pool_size - s->total_size, s->total_size, last, &element, &target));
+    ASSERT(!byte_struct_pool_assign(big, converted, pool_size, s->total_size, last, &big->type_offsets[1], converted + pool_size));
+    int64_t hostile = (int64_t)pool_size;
+    type_offset_t raw_offset = big->type_offsets[1];
+    raw_offset.type = BYTE_STRUCT_TYPE_INT64;
+    byte_struct_pack_field(big, &raw_offset, last, &hostile);
+    ASSERT(!byte_struct_pool_resolve(big, converted, pool_size, s->total_size, last, &big->type_offsets[1], &target));
+    // Self-relative too: a target starting in the last record's tail runs past the pool
+    hostile = (int64_t)(pool_size - 1) - (int64_t)((last - converted) + big->type_offsets[1].offset);
+    byte_struct_pack_field(big, &raw_offset, last, &hostile);
+    ASSERT(!byte_struct_pool_resolve(big, converted, pool_size, s->total_size, last, &big->type_offsets[1], &target));
+    ASSERT(byte_struct_pool_resolve(big, converted, pool_size, 1, last, &big->type_offsets[1], &target));
+
+    // Offsets from the pool base in an ordinary uint64 field
+    byte_struct_t *indexed = byte_struct_new_len_options("IL", 2, BYTE_STRUCT_SORTABLE);
+    uint8_t nodes[4 * 12];
+    for (size_t i = 0; i < 4; i++) {
+        ASSERT(byte_struct_pack(indexed, nodes + i * 12, (uint32_t)i, (uint64_t)0));
+        ASSERT(byte_struct_pool_assign(indexed, nodes, sizeof(nodes), 12, nodes + i * 12, &indexed->type_offsets[1], i == 0 ? NULL : nodes + (i - 1) * 12));
+    }
+    uint8_t moved[4 * 12];
+    memcpy(moved, nodes, sizeof(nodes));
+    ASSERT(byte_struct_pool_resolve(indexed, moved, sizeof(moved), 12, moved + 3 * 12, &indexed->type_offsets[1], &target));
+    ASSERT_EQ(target, moved + 2 * 12);
+    ASSERT(byte_struct_pool_resolve(indexed, moved, sizeof(moved), 12, moved, &indexed->type_offsets[1], &target));
+    ASSERT_EQ(target, NULL);
+    ASSERT(!byte_struct_pool_resolve(indexed, moved, 2 * 12, 12, moved + 3 * 12, &indexed->type_offsets[1], &target));
+    ASSERT(!byte_struct_pool_resolve(indexed, moved, sizeof(moved), 12, moved, &indexed->type_offsets[0], &target));
+    // The whole target record has to fit, not just its first byte
+    uint64_t past_end = 2 * 12 - 1;
+    ASSERT(byte_struct_pack(indexed, moved, (uint32_t)0, past_end));
+    ASSERT(!byte_struct_pool_resolve(indexed, moved, 2 * 12, 12, moved, &indexed->type_offsets[1], &target));
+    ASSERT(!byte_struct_pool_assign(indexed, moved, 2 * 12, 12, moved, &indexed->type_offsets[1], moved + past_end));
+    uint64_t last_record = 12;
+    ASSERT(byte_struct_pack(indexed, moved, (uint32_t)0, last_record));
+    ASSERT(byte_struct_pool_resolve(indexed, moved, 2 * 12, 12, moved, &indexed->type_offsets[1], &target));
+    ASSERT_EQ(target, moved + 12);
+    ASSERT(!byte_struct_pool_resolve(indexed, moved, 2 * 12, 3 * 12, moved, &indexed->type_offsets[1], &target));
+
+    // Transcoding to raw pointers keeps the targets
+    byte_struct_t *raw = byte_struct_new_len_options("Ipp[2]", 6, BYTE_STRUCT_NATIVE_ENDIAN);
+    byte_struct_transcoder_t *t = byte_struct_transcoder_new(big, raw, NULL);
+    ASSERT_NEQ(t, NULL);
+    uint8_t raw_record[4 + 3 * sizeof(void *)];
+    ASSERT(byte_struct_transcode(t, converted + 2 * s->total_size, 1, raw_record));
+    uint32_t id = 0;
+    void *next = NULL;
+    void *back[2];
+    ASSERT(byte_struct_unpack(raw, raw_record, raw->total_size, &id, &next, back));
+    ASSERT_EQ(id, 2);
+    ASSERT_EQ(next, converted + 3 * s->total_size);
+    ASSERT_EQ(back[1], converted);
+    byte_struct_transcoder_destroy(t);
+
+    byte_struct_destroy(raw);
+    byte_struct_destroy(indexed);
+    byte_struct_destroy(big);
+    byte_struct_destroy(s);
+    free(pool);
+    free(copy);
+    free(converted);
+    PASS();
+}
+
+TEST test_byte_struct_search(void) {
+    byte_struct_t *s = byte_struct_new_len_options("IhL", 3, BYTE_STRUCT_SORTABLE);
+    ASSERT_NEQ(s, NULL);
+    ASSERT_EQ(byte_struct_search_new(s, (uint8_t[14]){0}, 1, 4, BYTE_STRUCT_SEARCH_EYTZINGER), NULL);
+    byte_struct_t *native = byte_struct_new_len_options("IhL", 3, BYTE_STRUCT_NATIVE_ENDIAN);
+    ASSERT_EQ(byte_struct_search_new(native, (uint8_t[14]){0}, 1, 1, BYTE_STRUCT_SEARCH_EYTZINGER), NULL);
+    byte_struct_destroy(native);
+
+    size_t sizes[] = {1, 2, 7, 8, 9, 100, 1000, 4097};
+    byte_struct_search_layout_t layouts[] = {BYTE_STRUCT_SEARCH_EYTZINGER, BYTE_STRUCT_SEARCH_STREE};
+    uint8_t *data = malloc(4097 * s->total_size);
+    ASSERT_NEQ(data, NULL);
+    for (size_t z = 0; z < sizeof(sizes) / sizeof(sizes[0]); z++) {
+        size_t n = sizes[z];
+        // Even ids with runs of duplicates, the payload is the input position
+        for (size_t i = 0; i < n; i++) {
+            ASSERT(byte_struct_pack(s, data + i * s->total_size, (uint32_t)(2 * (i / 3)), (int16_t)(i % 3) - 1, (uint64_t)i));
+        }
+        for (size_t l = 0; l < 2; l++) {
+            for (size_t prefix = 1; prefix <= 2; prefix++) {
+                byte_struct_search_t *search = byte_struct_search_new(s, data, n, prefix, layouts[l]);
+                ASSERT_NEQ(search, NULL);
+                size_t key_len = byte_struct_prefix_size(s, prefix);
+                uint8_t probe[14];
+                // Probes ascend, so the expected lower bound only moves forward
+                size_t expected = 0;
+                for (uint32_t id = 0; id <= 2 * (n / 3) + 2; id++) {
+                    for (int16_t sub = -2; sub <= 2; sub++) {
+                        ASSERT(byte_struct_pack(s, probe, id, sub, (uint64_t)0));
+                        while (expected < n && memcmp(data + expected * s->total_size, probe, key_len) < 0) expected++;
+                        ASSERT_EQ(byte_struct_search_lower_bound(search, probe), expected);
+                        bool present = expected < n && memcmp(data + expected * s->total_size, probe, key_len) == 0;
+                        size_t rank = SIZE_MAX;
+                        ASSERT_EQ(byte_struct_search_find(search, probe, &rank), present);
+                        if (present) ASSERT_EQ(rank, expected);
+                    }
+                }
+
+                // Batches give the same answers as one lookup at a time
+                size_t num_probes = (2 * (n / 3) + 3) * 5;
+                uint8_t *probes = malloc(num_probes * s->total_size);
+                size_t *ranks = malloc(num_probes * sizeof(size_t));
+                ASSERT(probes != NULL && ranks != NULL);
+                size_t p = 0;
+                for (uint32_t id = 0; id <= 2 * (n / 3) + 2; id++) {
+                    for (int16_t sub = -2; sub <= 2; sub++) {
+                        ASSERT(byte_struct_pack(s, probes + p++ * s->total_size, id, sub, (uint64_t)0));
+                    }
+                }
+                ASSERT(byte_struct_search_lower_bound_batch(search, probes, num_probes, ranks));
+                for (p = 0; p < num_probes; p++) {
+                    ASSERT_EQ(ranks[p], byte_struct_search_lower_bound(search, probes + p * s->total_size));
+                }
+                size_t num_found = 0;
+                for (p = 0; p < num_probes; p++) {
+                    size_t rank = 0;
+                    num_found += byte_struct_search_find(search, probes + p * s->total_size, &rank);
+                }
+                ASSERT_EQ(byte_struct_search_find_batch(search, probes, num_probes, ranks), num_found);
+                for (p = 0; p < num_probes; p++) {
+                    size_t rank = n;
+                    byte_struct_search_find(search, probes + p * s->total_size, &rank);
+                    ASSERT_EQ(ranks[p], rank);
+                }
+                free(ranks);
+                free(probes);
+                byte_struct_search_destroy(search);
+            }
+        }
+    }
+
+    // Ranks index the caller's payloads
+    size_t n = 1000;
+    byte_struct_search_t *search = byte_struct_search_new(s, data, n, 3, BYTE_STRUCT_SEARCH_STREE);
+    size_t rank = 0;
+    ASSERT(byte_struct_search_find(search, data + 500 * s->total_size, &rank));
+    uint32_t id = 0;
+    int16_t sub = 0;
+    uint64_t payload = 0;
+    ASSERT(byte_struct_unpack(s, data + rank * s->total_size, s->total_size, &id, &sub, &payload));
+    ASSERT_EQ(payload, 500);
+    byte_struct_search_destroy(search);
+
+    byte_struct_destroy(s);
+    free(data);
+    PASS();
+}
+
+TEST test_byte_struct_csv(void) {
+    byte_struct_t *s = byte_struct_new_len_options("Ibc[8]h[2]dfL", 13, BYTE_STRUCT_LITTLE_ENDIAN);
+    ASSERT_NEQ(s, NULL);
+    const char *text =
+        "id,small,name,a,b,d,f,big\n"
+        "1,-128,alpha,1,-2,0.5,1.25,18446744073709551615\n"
+        "\r\n"
+        "2, 127 ,\"a,\"\"q\"\"\",300,-300,-1e-3,3.4028235e38,0\r\n"
+        "3,0,,0,0,123456789012345678901234,-0.1,42\n";
+    byte_struct_csv_options_t options = {.header = true};
+    size_t n = 0;
+    byte_struct_csv_error_t error;
+    ASSERT(byte_struct_csv_parse(NULL, s, text, strlen(text), &options, NULL, 0, &n, &error));
+    ASSERT_EQ(n, 3);
+    uint8_t *records = calloc(n, s->total_size);
+    ASSERT(byte_struct_csv_parse(NULL, s, text, strlen(text), &options, records, n, &n, &error));
+
+    uint32_t id;
+    int8_t small;
+    char name[8];
+    int16_t pair[2];
+    double d;
+    float f;
+    uint64_t big;
+    ASSERT(byte_struct_unpack(s, records, s->total_size, &id, &small, name, pair, &d, &f, &big));
+    ASSERT_EQ(id, 1);
+    ASSERT_EQ(small, -128);
+    ASSERT_MEM_EQ(name, "alpha\0\0\0", 8);
+    ASSERT_EQ(pair[1], -2);
+    ASSERT_EQ(d, 0.5);
+    ASSERT_EQ(f, 1.25f);
+    ASSERT_EQ(big, UINT64_MAX);
+    ASSERT(byte_struct_unpack(s, records + s->total_size, s->total_size, &id, &small, name, pair, &d, &f, &big));
+    ASSERT_EQ(small, 127);
+    ASSERT_MEM_EQ(name, "a,\"q\"\0\0\0", 8);
+    ASSERT_EQ(pair[0], 300);
+    ASSERT_EQ(d, -1e-3);
+    ASSERT_EQ(f, 3.4028235e38f);
+    ASSERT(byte_struct_unpack(s, records + 2 * s->total_size, s->total_size, &id, &small, name, pair, &d, &f, &big));
+    ASSERT_EQ(name[0], '\0');
+    ASSERT_EQ(d, 123456789012345678901234.0);
+    ASSERT_EQ(f, -0.1f);
+
+    // Dump and parse back gives the same bytes
+    size_t text_len = byte_struct_csv_dump(s, records, n, NULL, NULL, 0);
+    ASSERT(text_len > 0);
+    char *dumped = malloc(text_len);
+    ASSERT_EQ(byte_struct_csv_dump(s, records, n, NULL, dumped, text_len), text_len);
+    ASSERT_MEM_EQ(dumped, "1,-128,alpha,1,-2,0.5,1.25,18446744073709551615\n", 48);
+    uint8_t *reparsed = calloc(n, s->total_size);
+    size_t m = 0;
+    ASSERT(byte_struct_csv_parse(NULL, s, dumped, text_len, NULL, reparsed, n, &m, &error));
+    ASSERT_EQ(m, n);
+    ASSERT_MEM_EQ(records, reparsed, n * s->total_size);
+
+    // Single chars that are delimiters or quotes get quoted too
+    byte_struct_t *chars = byte_struct_new("cc[4]i");
+    ASSERT_NEQ(chars, NULL);
+    uint8_t char_records[3 * 9];
+    ASSERT(byte_struct_pack(chars, char_records, ',', "a,b", (int32_t)5));
+    ASSERT(byte_struct_pack(chars, char_records + 9, '"', "x\0\0", (int32_t)6));
+    ASSERT(byte_struct_pack(chars, char_records + 18, '\0', "\0\0\0", (int32_t)7));
+    char char_text[64];
+    size_t char_len = byte_struct_csv_dump(chars, char_records, 3, NULL, char_text, sizeof(char_text));
+    ASSERT_EQ(char_len, strlen("\",\",\"a,b\",5\n\"\"\"\",x,6\n,,7\n"));
+    ASSERT_MEM_EQ(char_text, "\",\",\"a,b\",5\n\"\"\"\",x,6\n,,7\n", char_len);
+    uint8_t char_reparsed[3 * 9];
+    ASSERT(byte_struct_csv_parse(NULL, chars, char_text, char_len, NULL, char_reparsed, 3, &m, &error));
+    ASSERT_EQ(m, 3);
+    ASSERT_MEM_EQ(char_records, char_reparsed, sizeof(char_records));
+    byte_struct_destroy(chars);
+
+    // Errors carry line and column
+    const char *bad[] = {
+        "1,2,x,1,1,1,1,1\n2,200,x,1,1,1,1,1\n",
+        "1,2,x,1,1,1,1,1\n2,2,x,1,1,1,1\n",
+        "1,2,toolongname,1,1,1,1,1\n",
+        "1,2,x,1,1,1.5x,1,1\n",
+        "1,2,x,1,,1,1,1\n",
+        "1,2,\"x,1,1,1,1,1\n",
+        "1,2,x,1,1,1,1,-1\n"
+    };
+    size_t lines[] = {2, 2, 1, 1, 1, 1, 1};
+    size_t columns[] = {2, 8, 3, 6, 5, 3, 8};
+    for (size_t i = 0; i < sizeof(bad) / sizeof(bad[0]); i++) {
+        ASSERT(!byte_struct_csv_parse(NULL, s, bad[i], strlen(bad[i]), NULL, reparsed, n, &m, &error));
+        ASSERT_EQ(error.line, lines[i]);
+        ASSERT_EQ(error.column, columns[i]);
+        ASSERT_NEQ(error.message, NULL);
+    }
+    ASSERT(!byte_struct_csv_parse(NULL, s, text, strlen(text), &options, reparsed, 2, &m, &error));
+
+    // One number grammar whichever path parses it
+    byte_struct_t *doubles = byte_struct_new("d");
+    ASSERT_NEQ(doubles, NULL);
+    const char *numbers[] = {"1e00005", "-.5", "2.", "1e-400", "-INF", "nan", "1234567890123456789012345e-5", "0.000000000000000000000000000000000000000000000000000000000000000000000015"};
+    double expected_numbers[] = {1e5, -0.5, 2.0, 0.0, -1.0 / 0.0, 0.0, 12345678901234567890.12345, 1.5e-71};
+    for (size_t i = 0; i < sizeof(numbers) / sizeof(numbers[0]); i++) {
+        uint8_t packed_number[8];
+        double parsed = 0.0;
+        ASSERT(byte_struct_csv_parse(NULL, doubles, numbers[i], strlen(numbers[i]), NULL, packed_number, 1, &m, &error));
+        ASSERT(byte_struct_unpack(doubles, packed_number, sizeof(packed_number), &parsed));
+        if (i == 5) {
+            ASSERT(parsed != parsed);
+        } else {
+            ASSERT_EQ(parsed, expected_numbers[i]);
+        }
+    }
+    const char *not_numbers[] = {"0x10", "1e", "1e+", ".", "-", "e5", "nan(1)", "1.5.2", "infinit"};
+    for (size_t i = 0; i < sizeof(not_numbers) / sizeof(not_numbers[0]); i++) {
+        uint8_t packed_number[8];
+        ASSERT(!byte_struct_csv_parse(NULL, doubles, not_numbers[i], strlen(not_numbers[i]), NULL, packed_number, 1, &m, &error));
+        ASSERT_STR_EQ(error.message, "invalid number");
+    }
+    byte_struct_destroy(doubles);
+
+    // Tab separated with remapped columns, parsed in parallel across many chunks
+    byte_struct_t *pairs = byte_struct_new_len_options("Ld", 2, BYTE_STRUCT_SORTABLE);
+    size_t rows = 200000;
+    char *tsv = malloc(rows * 48);
+    size_t tsv_len = 0;
+    for (size_t i = 0; i < rows; i++) {
+        tsv_len += (size_t)sprintf(tsv + tsv_len, "ignored\t%zu.%02zu\t%zu\n", i, i % 100, i * 7);
+    }
+    size_t column_map[] = {2, 1};
+    byte_struct_csv_options_t tsv_options = {.delimiter = '\t', .column_map = column_map};
+    byte_struct_thread_pool_t *pool = byte_struct_thread_pool_new(4);
+    uint8_t *packed = malloc(rows * pairs->total_size);
+    ASSERT(byte_struct_csv_parse(pool, pairs, tsv, tsv_len, &tsv_options, packed, rows, &m, &error));
+    ASSERT_EQ(m, rows);
+    for (size_t i = 0; i < rows; i += 997) {
+        uint64_t key;
+        double value;
+        ASSERT(byte_struct_unpack(pairs, packed + i * pairs->total_size, pairs->total_size, &key, &value));
+        ASSERT_EQ(key, i * 7);
+        ASSERT_EQ(value, (double)i + (double)(i % 100) / 100.0);
+    }
+    tsv_len += (size_t)sprintf(tsv + tsv_len - 4, "zz\n") - 4;
+    ASSERT(!byte_struct_csv_parse(pool, pairs, tsv, tsv_len, &tsv_options, packed, rows, &m, &error));
+    ASSERT_EQ(error.line, rows);
+    ASSERT_EQ(error.column, 3);
+
+    byte_struct_thread_pool_destroy(pool);
+    byte_struct_destroy(pairs);
+    byte_struct_destroy(s);
+    free(packed);
+    free(tsv);
+    free(reparsed);
+    free(dumped);
+    free(records);
+    PASS();
+}
+
+TEST test_byte_struct_partition(void) {
+    byte_struct_thread_pool_t *pool = byte_struct_thread_pool_new(4);
+    const char *formats[] = {"LI", "LIc[300]"};
+    size_t n = 50000;
+    for (size_t f = 0; f < 2; f++) {
+        byte_struct_t *s = byte_struct_new_len_options(formats[f], strlen(formats[f]), BYTE_STRUCT_SORTABLE);
+        ASSERT_NEQ(s, NULL);
+        uint8_t *data = calloc(n, s->total_size);
+        uint8_t *out = malloc(n * s->total_size);
+        size_t *offsets = malloc(((1 << BYTE_STRUCT_PARTITION_MAX_BITS) + 1) * sizeof(size_t));
+        bool *seen = malloc(n * sizeof(bool));
+        ASSERT(data != NULL && out != NULL && offsets != NULL && seen != NULL);
+        char payload_in[300] = "payload";
+        uint64_t x = 88172645463325252ull;
+        for (size_t i = 0; i < n; i++) {
+            x ^= x << 13;
+            x ^= x >> 7;
+            x ^= x << 17;
+            ASSERT(byte_struct_pack(s, data + i * s->total_size, x, (uint32_t)i, payload_in));
+        }
+        size_t bits_list[] = {1, 6, 8, 11, 16};
+        for (size_t mode = 0; mode < 2; mode++) {
+            for (size_t b = 0; b < sizeof(bits_list) / sizeof(bits_list[0]); b++) {
+                size_t bits = bits_list[b];
+                ASSERT(byte_struct_partition(pool, s, data, n, 1, (byte_struct_partition_mode_t)mode, bits, out, offsets));
+                size_t num_partitions = (size_t)1 << bits;
+                ASSERT_EQ(offsets[0], 0);
+                ASSERT_EQ(offsets[num_partitions], n);
+                memset(seen, 0, n * sizeof(bool));
+                for (size_t p = 0; p < num_partitions; p++) {
+                    ASSERT(offsets[p] <= offsets[p + 1]);
+                    uint32_t prev = 0;
+                    for (size_t r = offsets[p]; r < offsets[p + 1]; r++) {
+                        uint8_t *record = out + r * s->total_size;
+                        ASSERT_EQ(byte_struct_partition_of(s, record, 1, (byte_struct_partition_mode_t)mode, bits), p);
+                        uint64_t key;
+                        uint32_t index;
+                        char payload[300];
+                        ASSERT(byte_struct_unpack(s, record, s->total_size, &key, &index, payload));
+                        // Input order within each partition
+                        ASSERT(r == offsets[p] || index > prev);
+                        prev = index;
+                        ASSERT(!seen[index]);
+                        seen[index] = true;
+                        ASSERT_MEM_EQ(record, data + index * s->total_size, s->total_size);
+                        // Radix partitions of sortable keys are in key order
+                        if (mode == BYTE_STRUCT_PARTITION_RADIX) {
+                            ASSERT_EQ(key >> (64 - bits), p);
+                        }
+                    }
+                }
+            }
+        }
+        // Serial and parallel runs agree
+        uint8_t *serial = malloc(n * s->total_size);
+        size_t serial_offsets[257];
+        ASSERT(byte_struct_partition(NULL, s, data, n, 1, BYTE_STRUCT_PARTITION_HASH, 8, serial, serial_offsets));
+        ASSERT(byte_struct_partition(pool, s, data, n, 1, BYTE_STRUCT_PARTITION_HASH, 8, out, offsets));
+        ASSERT_MEM_EQ(serial_offsets, offsets, sizeof(serial_offsets));
+        ASSERT_MEM_EQ(serial, out, n * s->total_size);
+        ASSERT(!byte_struct_partition(pool, s, data, n, 1, BYTE_STRUCT_PARTITION_HASH, 17, out, offsets));
+        ASSERT(byte_struct_partition(pool, s, data, 0, 1, BYTE_STRUCT_PARTITION_HASH, 12, out, offsets));
+        ASSERT_EQ(offsets[1 << 12], 0);
+
+        free(serial);
+        free(seen);
+        free(offsets);
+        free(out);
+        free(data);
+        byte_struct_destroy(s);
+    }
+    byte_struct_thread_pool_destroy(pool);
+    PASS();
+}
+
+TEST test_byte_struct_topk(void) {
+    byte_struct_t *s = byte_struct_new_len_options("-iI", strlen("-iI"), BYTE_STRUCT_SORTABLE);
+    ASSERT_NEQ(s, NULL);
+    size_t size = s->total_size;
+    size_t n = 20000;
+    uint8_t *data = malloc(n * size);
+    uint8_t *sorted = malloc(n * size);
+    uint8_t *work = malloc(n * size);
+    uint8_t *result = malloc(n * size);
+    bool *seen = malloc(n * sizeof(bool));
+    ASSERT(data != NULL && sorted != NULL && work != NULL && result != NULL && seen != NULL);
+    size_t ks[] = {1, 7, 100, 5000, 20000};
+    uint64_t x = 88172645463325252ull;
+    // random with duplicates, ascending, descending (adversarial for the pivots), all equal
+    for (size_t input = 0; input < 4; input++) {
+        for (size_t i = 0; i < n; i++) {
+            x ^= x << 13;
+            x ^= x >> 7;
+            x ^= x << 17;
+            int32_t key = input == 0 ? (int32_t)(x % 1000) - 500 : input == 1 ? (int32_t)i : input == 2 ? -(int32_t)i : 3;
+            ASSERT(byte_struct_pack(s, data + i * size, key, (uint32_t)i));
+        }
+        memcpy(sorted, data, n * size);
+        ASSERT(byte_struct_sort(s, sorted, n));
+        for (size_t t = 0; t < sizeof(ks) / sizeof(ks[0]); t++) {
+            size_t k = ks[t];
+            // Streaming, fed in uneven batches
+            byte_struct_topk_t *topk = byte_struct_topk_new(s, k, 1);
+            ASSERT_NEQ(topk, NULL);
+            for (size_t i = 0; i < n; i += 333) {
+                byte_struct_topk_push_batch(topk, data + i * size, i + 333 <= n ? 333 : n - i);
+            }
+            ASSERT_EQ(byte_struct_topk_size(topk), k);
+            ASSERT_EQ(byte_struct_topk_result(topk, result), k);
+            for (size_t i = 0; i < k; i++) {
+                ASSERT_MEM_EQ(result + i * size, sorted + i * size, 4);
+            }
+            // Whole records from the input, each at most once
+            memset(seen, 0, n * sizeof(bool));
+            for (size_t i = 0; i < k; i++) {
+                int32_t key;
+                uint32_t index;
+                ASSERT(byte_struct_unpack(s, result + i * size, size, &key, &index));
+                ASSERT(index < n && !seen[index]);
+                seen[index] = true;
+                ASSERT_MEM_EQ(result + i * size, data + index * size, size);
+            }
+            byte_struct_topk_destroy(topk);
+
+            size_t nth = k - 1;
+            memcpy(work, data, n * size);
+            ASSERT(byte_struct_select_nth(s, work, n, nth, 1));
+            ASSERT_MEM_EQ(work + nth * size, sorted + nth * size, 4);
+            for (size_t i = 0; i < n; i++) {
+                int cmp = memcmp(work + i * size, work + nth * size, 4);
+                ASSERT(i < nth ? cmp <= 0 : cmp >= 0);
+            }
+            // Still a permutation of the input
+            ASSERT(byte_struct_sort(s, work, n));
+            ASSERT_MEM_EQ(work, sorted, n * size);
+
+            memcpy(work, data, n * size);
+            ASSERT(byte_struct_partial_sort(s, work, n, k, 1));
+            for (size_t i = 0; i < k; i++) {
+                ASSERT_MEM_EQ(work + i * size, sorted + i * size, 4);
+            }
+        }
+    }
+
+    // Results so far, and continuing after a reset
+    byte_struct_topk_t *topk = byte_struct_topk_new(s, 3, 2);
+    ASSERT_EQ(byte_struct_topk_result(topk, result), 0);
+    ASSERT(byte_struct_topk_push(topk, data));
+    ASSERT_EQ(byte_struct_topk_result(topk, result), 1);
+    byte_struct_topk_reset(topk);
+    ASSERT_EQ(byte_struct_topk_size(topk), 0);
+    byte_struct_topk_destroy(topk);
+
+    ASSERT_EQ(byte_struct_topk_new(s, 0, 1), NULL);
+    ASSERT_EQ(byte_struct_topk_new(s, 3, 3), NULL);
+    ASSERT(!byte_struct_select_nth(s, data, n, n, 1));
+    ASSERT(byte_struct_select_nth(s, data, 0, 0, 1));
+    byte_struct_t *native = byte_struct_new("iI");
+    ASSERT_EQ(byte_struct_topk_new(native, 3, 1), NULL);
+    ASSERT(!byte_struct_select_nth(native, data, n, 0, 1));
+    byte_struct_destroy(native);
+
+    free(seen);
+    free(result);
+    free(work);
+    free(sorted);
+    free(data);
+    byte_struct_destroy(s);
+    PASS();
+}
+
+TEST test_byte_struct_codec(void) {
+    const char *formats[] = {"ILdc[8]", "i(Hf)[4]B", "-lbL", "lL"};
+    byte_order_t orders[] = {BYTE_STRUCT_BIG_ENDIAN, BYTE_STRUCT_NATIVE_ENDIAN, BYTE_STRUCT_SORTABLE, BYTE_STRUCT_LITTLE_ENDIAN};
+    size_t n = 30000;
+    uint64_t x = 88172645463325252ull;
+    for (size_t f = 0; f < sizeof(formats) / sizeof(formats[0]); f++) {
+        byte_struct_t *s = byte_struct_new_len_options(formats[f], strlen(formats[f]), orders[f]);
+        ASSERT_NEQ(s, NULL);
+        size_t size = s->total_size;
+        uint8_t *data = calloc(n, size);
+        uint8_t *decoded = malloc(n * size);
+        size_t bound = byte_struct_compress_bound(s, n);
+        uint8_t *encoded = malloc(bound);
+        ASSERT(data != NULL && decoded != NULL && encoded != NULL && bound > n * size);
+        for (size_t i = 0; i < n; i++) {
+            x ^= x << 13;
+            x ^= x >> 7;
+            x ^= x << 17;
+            uint8_t *record = data + i * size;
+            if (f == 0) {
+                // counter, timestamps with jitter, a narrow range of doubles, a few labels
+                char label[8] = "sensor";
+                if (x % 4 == 0) label[0] = 'S';
+                ASSERT(byte_struct_pack(s, record, (uint32_t)i, (int64_t)1700000000000ll + (int64_t)(i * 1000) - (int64_t)(x % 7), 20.0 + (double)(x % 100) / 4, label));
+            } else if (f == 1) {
+                typedef struct {
+                    uint16_t id;
+                    float weight;
+                } pair_t;
+                pair_t pairs[4] = {{(uint16_t)i, 1.5f}, {7, -2.0f}, {(uint16_t)(x % 3), (float)(x % 10)}, {65535, 0.0f}};
+                ASSERT(byte_struct_pack(s, record, -(int32_t)(x % 50), pairs, (uint8_t)(i & 1)));
+            } else if (f == 2) {
+                // descending keys in sortable order, random payload
+                ASSERT(byte_struct_pack(s, record, (int64_t)(n - i) * 3, (int8_t)(x % 256 - 128), x));
+            } else {
+                // incompressible: stored
+                ASSERT(byte_struct_pack(s, record, (int64_t)x, x * 0x9e3779b97f4a7c15ull));
+            }
+        }
+        size_t len = byte_struct_compress(s, data, n, encoded, bound);
+        ASSERT(len > 0 && len <= bound);
+        // the random payload of the third schema is half its size
+        if (f < 2) ASSERT(len < n * size / 4);
+        if (f == 2) ASSERT(len < n * size * 2 / 3);
+        size_t num_records = 0;
+        ASSERT(byte_struct_compressed_records(encoded, len, &num_records));
+        ASSERT_EQ(num_records, n);
+        memset(decoded, 0xa5, n * size);
+        ASSERT(byte_struct_decompress(s, encoded, len, decoded, n, &num_records));
+        ASSERT_EQ(num_records, n);
+        ASSERT_MEM_EQ(data, decoded, n * size);
+
+        // Too little room either way
+        ASSERT(!byte_struct_decompress(s, encoded, len, decoded, n - 1, &num_records));
+        ASSERT_EQ(byte_struct_compress(s, data, n, encoded, BYTE_STRUCT_CODEC_HEADER_SIZE), 0);
+        // Another schema
+        byte_struct_t *other = byte_struct_new("ILdc[7]");
+        ASSERT(!byte_struct_decompress(other, encoded, len, decoded, n, &num_records));
+        byte_struct_destroy(other);
+
+        // Corrupt or truncated blocks fail or decode garbage, without going out of bounds
+        size_t small = 500;
+        size_t small_len = byte_struct_compress(s, data, small, encoded, bound);
+        ASSERT(small_len > 0);
+        for (size_t cut = 0; cut < small_len; cut += 1 + cut / 16) {
+            ASSERT(!byte_struct_decompress(s, encoded, cut, decoded, n, &num_records));
+        }
+        for (size_t i = 0; i < 2000; i++) {
+            x ^= x << 13;
+            x ^= x >> 7;
+            x ^= x << 17;
+            size_t position = (size_t)(x % small_len);
+            uint8_t saved = encoded[position];
+            encoded[position] ^= (uint8_t)(1 + (x >> 32) % 255);
+            byte_struct_decompress(s, encoded, small_len, decoded, n, &num_records);
+            encoded[position] = saved;
+        }
+        ASSERT(byte_struct_decompress(s, encoded, small_len, decoded, n, &num_records));
+        ASSERT_EQ(num_records, small);
+        ASSERT_MEM_EQ(data, decoded, small * size);
+
+        // Empty block
+        len = byte_struct_compress(s, data, 0, encoded, bound);
+        ASSERT(len > 0);
+        ASSERT(byte_struct_decompress(s, encoded, len, NULL, 0, &num_records));
+        ASSERT_EQ(num_records, 0);
+
+        free(encoded);
+        free(decoded);
+        free(data);
+        byte_struct_destroy(s);
+    }
+    PASS();
+}
+
+TEST test_byte_struct_sort_abbreviated(void) {
+    byte_struct_t *s = byte_struct_new_len_options("c[8]Lc[100]", strlen("c[8]Lc[100]"), BYTE_STRUCT_SORTABLE);
+    ASSERT_NEQ(s, NULL);
+    size_t size = s->total_size;
+    ASSERT(size >= BYTE_STRUCT_SORT_ABBREVIATED_MIN_SIZE);
+    size_t n = 5000;
+    uint8_t *data = malloc(n * size);
+    uint8_t *expected = malloc(n * size);
+    uint8_t *sorted = malloc(n * size);
+    uint8_t *tmp = malloc(n * size);
+    size_t *permutation = malloc(n * sizeof(size_t));
+    ASSERT(data != NULL && expected != NULL && sorted != NULL && tmp != NULL && permutation != NULL);
+    uint64_t x = 88172645463325252ull;
+    for (size_t i = 0; i < n; i++) {
+        x ^= x << 13;
+        x ^= x >> 7;
+        x ^= x << 17;
+        // Mostly one prefix so the first abbreviated key ties, few distinct middles, tails that differ late
+        char prefix[8] = "tenant01";
+        if (x % 10 == 0) prefix[7] = '0' + (char)(x % 7);
+        char tail[100];
+        memset(tail, 'a', sizeof(tail));
+        tail[90 + x % 10] = (char)('a' + (x >> 8) % 3);
+        ASSERT(byte_struct_pack(s, data + i * size, prefix, (uint64_t)((x >> 16) % 50), tail));
+    }
+
+    // Against the merge sort on whole records
+    memcpy(expected, data, n * size);
+    byte_struct_sort_records(expected, n, size, tmp);
+    memcpy(sorted, data, n * size);
+    ASSERT(byte_struct_sort(s, sorted, n));
+    ASSERT_MEM_EQ(expected, sorted, n * size);
+
+    // On the first two fields, stable
+    ASSERT(byte_struct_sort_permutation(s, data, n, 2, permutation));
+    size_t key_len = byte_struct_prefix_size(s, 2);
+    for (size_t i = 1; i < n; i++) {
+        int cmp = memcmp(data + permutation[i - 1] * size, data + permutation[i] * size, key_len);
+        ASSERT(cmp < 0 || (cmp == 0 && permutation[i - 1] < permutation[i]));
+    }
+    ASSERT(byte_struct_permute(s, data, n, permutation, sorted));
+    memcpy(tmp, data, n * size);
+    ASSERT(byte_struct_permute(s, tmp, n, permutation, NULL));
+    ASSERT_MEM_EQ(sorted, tmp, n * size);
+    for (size_t i = 0; i < n; i++) {
+        ASSERT_MEM_EQ(sorted + i * size, data + permutation[i] * size, size);
+    }
+
+    // Not a permutation: nothing moves
+    permutation[1] = permutation[0];
+    memcpy(tmp, data, n * size);
+    ASSERT(!byte_struct_permute(s, tmp, n, permutation, NULL));
+    ASSERT_MEM_EQ(tmp, data, n * size);
+    permutation[1] = n;
+    ASSERT(!byte_struct_permute(s, tmp, n, permutation, sorted));
+    ASSERT(!byte_struct_sort_permutation(s, data, n, 0, permutation));
+    ASSERT(byte_struct_sort_permutation(s, data, 0, 1, permutation));
+
+    // Keys shorter than an abbreviated key, all in the abbreviation
+    byte_struct_t *narrow = byte_struct_new_len_options("-hc[70]", strlen("-hc[70]"), BYTE_STRUCT_SORTABLE);
+    ASSERT_NEQ(narrow, NULL);
+    for (size_t i = 0; i < n; i++) {
+        char filler[70] = {0};
+        ASSERT(byte_struct_pack(narrow, data + i * narrow->total_size, (int16_t)(i % 300) - 150, filler));
+    }
+    ASSERT(byte_struct_sort_permutation(narrow, data, n, 1, permutation));
+    for (size_t i = 1; i < n; i++) {
+        int16_t a, b;
+        char filler[70];
+        ASSERT(byte_struct_unpack(narrow, data + permutation[i - 1] * narrow->total_size, narrow->total_size, &a, filler));
+        ASSERT(byte_struct_unpack(narrow, data + permutation[i] * narrow->total_size, narrow->total_size, &b, filler));
+        ASSERT(a > b || (a == b && permutation[i - 1] < permutation[i]));
+    }
+    byte_struct_destroy(narrow);
+
+    free(permutation);
+    free(tmp);
+    free(sorted);
+    free(expected);
+    free(data);
+    byte_struct_destroy(s);
+    PASS();
+}
+
+TEST test_byte_struct_dict(void) {
+    byte_struct_t *s = byte_struct_new_len_options("BI", strlen("BI"), BYTE_STRUCT_SORTABLE);
+    ASSERT_NEQ(s, NULL);
+    byte_struct_dict_t *dict = byte_struct_dict_new(4, 1);
+    ASSERT_NEQ(dict, NULL);
+    ASSERT_EQ(byte_struct_dict_new(0, 1), NULL);
+    ASSERT_EQ(byte_struct_dict_new(4, 3), NULL);
+
+    // width-byte zero padded slots, like a c[4] column
+    const char strings[6][4] = {"us", "de", "fr", "us", "de", "br"};
+    size_t n = 6;
+    uint8_t records[6 * 5];
+    for (size_t r = 0; r < n; r++) {
+        ASSERT(byte_struct_pack(s, records + r * s->total_size, (uint8_t)0, (uint32_t)r));
+    }
+    ASSERT(byte_struct_dict_pack(dict, s, records, n, &s->type_offsets[0], &strings[0][0], true));
+    ASSERT_EQ(byte_struct_dict_size(dict), 4);
+    ASSERT(!byte_struct_dict_ordered(dict));
+    // codes in first-seen order
+    uint8_t record_codes[6];
+    uint32_t id = 0;
+    for (size_t r = 0; r < n; r++) {
+        ASSERT(byte_struct_unpack(s, records + r * s->total_size, s->total_size, &record_codes[r], &id));
+    }
+    ASSERT_MEM_EQ(record_codes, ((uint8_t[]){0, 1, 2, 0, 1, 3}), 6);
+
+    char decoded[6][4];
+    ASSERT(byte_struct_dict_unpack(dict, s, records, n, &s->type_offsets[0], &decoded[0][0]));
+    ASSERT_MEM_EQ(decoded, strings, sizeof(strings));
+
+    uint32_t code = 0;
+    ASSERT(byte_struct_dict_find(dict, "fr", &code));
+    ASSERT_EQ(code, 2);
+    ASSERT(!byte_struct_dict_find(dict, "it", &code));
+    ASSERT(!byte_struct_dict_find(dict, "toolong", &code));
+    ASSERT(!byte_struct_dict_lower_bound(dict, "de", &code));
+    uint32_t codes[2];
+    ASSERT(!byte_struct_dict_encode(dict, "it\0\0de\0\0", 2, codes, false));
+    ASSERT_EQ(byte_struct_dict_size(dict), 4);
+
+    // Renumbering in string order makes codes sort like the strings
+    uint32_t remap[4];
+    ASSERT(byte_struct_dict_sort(dict, remap));
+    ASSERT(byte_struct_dict_ordered(dict));
+    ASSERT_EQ(remap[0], 3);
+    ASSERT_EQ(remap[3], 0);
+    ASSERT(byte_struct_dict_remap(dict, s, records, n, &s->type_offsets[0], remap));
+    ASSERT(byte_struct_dict_unpack(dict, s, records, n, &s->type_offsets[0], &decoded[0][0]));
+    ASSERT_MEM_EQ(decoded, strings, sizeof(strings));
+    ASSERT(byte_struct_sort(s, records, n));
+    ASSERT(byte_struct_dict_unpack(dict, s, records, n, &s->type_offsets[0], &decoded[0][0]));
+    const char sorted[6][4] = {"br", "de", "de", "fr", "us", "us"};
+    ASSERT_MEM_EQ(decoded, sorted, sizeof(sorted));
+    ASSERT(byte_struct_dict_find(dict, "de", &code));
+    ASSERT_EQ(code, 1);
+
+    ASSERT(byte_struct_dict_lower_bound(dict, "de", &code));
+    ASSERT_EQ(code, 1);
+    ASSERT(byte_struct_dict_lower_bound(dict, "e", &code));
+    ASSERT_EQ(code, 2);
+    ASSERT(byte_struct_dict_lower_bound(dict, "frxxxx", &code));
+    ASSERT_EQ(code, 3);
+    ASSERT(byte_struct_dict_lower_bound(dict, "zz", &code));
+    ASSERT_EQ(code, 4);
+
+    // Appending past the largest string keeps the order, anything else breaks it
+    ASSERT(byte_struct_dict_encode(dict, "zz\0\0", 1, codes, true));
+    ASSERT(byte_struct_dict_ordered(dict));
+    ASSERT(byte_struct_dict_encode(dict, "aa\0\0", 1, codes, true));
+    ASSERT(!byte_struct_dict_ordered(dict));
+    ASSERT_EQ(codes[0], 5);
+
+    // Codes must fit the field
+    byte_struct_t *narrow = byte_struct_new("Bi");
+    ASSERT_NEQ(narrow, NULL);
+    byte_struct_dict_t *wide = byte_struct_dict_new(8, 2);
+    ASSERT_NEQ(wide, NULL);
+    ASSERT(!byte_struct_dict_pack(wide, narrow, records, 1, &narrow->type_offsets[0], "abcdefgh", true));
+    ASSERT(!byte_struct_dict_pack(dict, narrow, records, 1, &narrow->type_offsets[1], "us\0\0", true));
+
+    // One byte codes run out after 256 strings
+    byte_struct_dict_t *small = byte_struct_dict_new(4, 1);
+    ASSERT_NEQ(small, NULL);
+    for (uint32_t i = 0; i < 256; i++) {
+        ASSERT(byte_struct_dict_encode(small, (const char *)&i, 1, codes, true));
+        ASSERT_EQ(codes[0], i);
+    }
+    uint32_t overflow = 256;
+    ASSERT(!byte_struct_dict_encode(small, (const char *)&overflow, 1, codes, true));
+    ASSERT(byte_struct_dict_encode(small, (const char *)&(uint32_t){17}, 1, codes, false));
+    ASSERT_EQ(codes[0], 17);
+
+    // Arrays of codes in a wider schema, through growth and rehashing
+    byte_struct_t *multi = byte_struct_new("lH[2]");
+    ASSERT_NEQ(multi, NULL);
+    size_t m = 3000;
+    char *names = malloc(m * 2 * 8);
+    char *names_out = malloc(m * 2 * 8);
+    uint8_t *rows = malloc(m * multi->total_size);
+    ASSERT(names != NULL && names_out != NULL && rows != NULL);
+    for (size_t i = 0; i < 2 * m; i++) {
+        snprintf(names + i * 8, 8, "k%zu", (i * 7919) % 1500);
+        memset(names + i * 8 + strlen(names + i * 8), 0, 8 - strlen(names + i * 8));
+    }
+    ASSERT(byte_struct_dict_pack(wide, multi, rows, m, &multi->type_offsets[1], names, true));
+    ASSERT_EQ(byte_struct_dict_size(wide), 1500);
+    ASSERT(byte_struct_dict_unpack(wide, multi, rows, m, &multi->type_offsets[1], names_out));
+    ASSERT_MEM_EQ(names, names_out, m * 2 * 8);
+
+    free(rows);
+    free(names_out);
+    free(names);
+    byte_struct_destroy(multi);
+    byte_struct_dict_destroy(small);
+    byte_struct_dict_destroy(wide);
+    byte_struct_destroy(narrow);
+    byte_struct_dict_destroy(dict);
+    byte_struct_destroy(s);
+    PASS();
+}
+
+TEST test_byte_struct_sketch(void) {
+    byte_struct_t *s = byte_struct_new("I?d-iH[2]");
+    ASSERT_NEQ(s, NULL);
+    ASSERT_EQ(s->total_size, 21);
+    size_t n = 100000;
+    uint8_t *records = malloc(n * s->total_size);
+    ASSERT_NEQ(records, NULL);
+    for (size_t i = 0; i < n; i++) {
+        // 50000 distinct ids, each twice; every tenth value null
+        ASSERT(byte_struct_pack(s, records + i * s->total_size, (uint32_t)(i % 50000), i % 10 != 0, (double)i, (int32_t)i - 50000, (uint16_t[]){(uint16_t)(i % 1000), (uint16_t)(1000 + i % 1000)}));
+    }
+
+    byte_struct_hll_t *hll = byte_struct_hll_new(s, 1, 0);
+    ASSERT_NEQ(hll, NULL);
+    ASSERT_EQ(hll->precision, BYTE_STRUCT_HLL_DEFAULT_PRECISION);
+    ASSERT_EQ(hll->key_len, 4);
+    ASSERT_EQ(byte_struct_hll_new(s, 1, 3), NULL);
+    ASSERT_EQ(byte_struct_hll_new(s, 5, 0), NULL);
+    ASSERT_EQ(byte_struct_hll_estimate(hll), 0.0);
+    byte_struct_hll_add_batch(hll, records, n);
+    double estimate = byte_struct_hll_estimate(hll);
+    ASSERT(estimate > 50000 * 0.97 && estimate < 50000 * 1.03);
+
+    // One sketch per half merges to the sketch of the whole
+    byte_struct_hll_t *first = byte_struct_hll_new(s, 1, 0);
+    byte_struct_hll_t *second = byte_struct_hll_new(s, 1, 0);
+    ASSERT(first != NULL && second != NULL);
+    byte_struct_hll_add_batch(first, records, n / 2);
+    for (size_t i = n / 2; i < n; i++) {
+        byte_struct_hll_add(second, records + i * s->total_size);
+    }
+    ASSERT(byte_struct_hll_merge(first, second));
+    ASSERT_MEM_EQ(first->registers, hll->registers, byte_struct_hll_num_registers(hll));
+    byte_struct_hll_t *coarse = byte_struct_hll_new(s, 1, 10);
+    ASSERT_NEQ(coarse, NULL);
+    ASSERT_FALSE(byte_struct_hll_merge(first, coarse));
+
+    // Small counts go through linear counting
+    byte_struct_hll_add_batch(coarse, records, 100);
+    estimate = byte_struct_hll_estimate(coarse);
+    ASSERT(estimate > 95 && estimate < 105);
+    byte_struct_hll_reset(coarse);
+    ASSERT_EQ(byte_struct_hll_estimate(coarse), 0.0);
+
+    size_t hll_size = byte_struct_hll_serialized_size(hll);
+    uint8_t *hll_bytes = malloc(hll_size);
+    ASSERT_NEQ(hll_bytes, NULL);
+    ASSERT(byte_struct_hll_serialize(hll, hll_bytes));
+    byte_struct_hll_t *loaded = byte_struct_hll_deserialize(hll_bytes, hll_size);
+    ASSERT_NEQ(loaded, NULL);
+    ASSERT_EQ(byte_struct_hll_estimate(loaded), byte_struct_hll_estimate(hll));
+    ASSERT_EQ(byte_struct_hll_deserialize(hll_bytes, hll_size - 1), NULL);
+    hll_bytes[BYTE_STRUCT_HLL_HEADER_SIZE] = 64;
+    ASSERT_EQ(byte_struct_hll_deserialize(hll_bytes, hll_size), NULL);
+    hll_bytes[0] ^= 1;
+    ASSERT_EQ(byte_struct_hll_deserialize(hll_bytes, hll_size), NULL);
+
+    // Nullable double, nulls skipped
+    byte_struct_kll_t *kll = byte_struct_kll_new(s, &s->type_offsets[1], 0);
+    ASSERT_NEQ(kll, NULL);
+    double value = 0.0;
+    ASSERT_FALSE(byte_struct_kll_quantile(kll, 0.5, &value));
+    ASSERT(byte_struct_kll_add_batch(kll, records, n));
+    ASSERT_EQ(byte_struct_kll_count(kll), 90000);
+    double qs[5] = {0.0, 0.25, 0.5, 0.9, 1.0};
+    double values[5];
+    ASSERT(byte_struct_kll_quantiles(kll, qs, 5, values));
+    ASSERT_EQ(values[0], 1.0);
+    ASSERT_EQ(values[4], 99999.0);
+    for (size_t q = 1; q < 4; q++) {
+        ASSERT(values[q] > (qs[q] - 0.02) * n && values[q] < (qs[q] + 0.02) * n);
+    }
+    double rank = byte_struct_kll_rank(kll, 25000.0);
+    ASSERT(rank > 0.23 && rank < 0.27);
+    ASSERT(kll->size < 4 * kll->k);
+
+    // Descending int32
+    byte_struct_kll_t *descending = byte_struct_kll_new(s, &s->type_offsets[2], 100);
+    ASSERT_NEQ(descending, NULL);
+    ASSERT(byte_struct_kll_add_batch(descending, records, n));
+    ASSERT(byte_struct_kll_quantile(descending, 0.0, &value));
+    ASSERT_EQ(value, -50000.0);
+    ASSERT(byte_struct_kll_quantile(descending, 1.0, &value));
+    ASSERT_EQ(value, 49999.0);
+    ASSERT(byte_struct_kll_quantile(descending, 0.5, &value));
+    ASSERT(value > -4000.0 && value < 4000.0);
+
+    // Every element of an array, merged from one sketch per half
+    byte_struct_kll_t *array = byte_struct_kll_new(s, &s->type_offsets[3], 0);
+    byte_struct_kll_t *array_second = byte_struct_kll_new(s, &s->type_offsets[3], 0);
+    ASSERT(array != NULL && array_second != NULL);
+    ASSERT(byte_struct_kll_add_batch(array, records, n / 2));
+    ASSERT(byte_struct_kll_add_batch(array_second, records + n / 2 * s->total_size, n - n / 2));
+    ASSERT(byte_struct_kll_merge(array, array_second));
+    ASSERT_EQ(byte_struct_kll_count(array), 2 * n);
+    ASSERT(byte_struct_kll_quantile(array, 0.75, &value));
+    ASSERT(value > 1460.0 && value < 1540.0);
+
+    size_t kll_size = byte_struct_kll_serialized_size(array);
+    uint8_t *kll_bytes = malloc(kll_size);
+    ASSERT_NEQ(kll_bytes, NULL);
+    ASSERT(byte_struct_kll_serialize(array, kll_bytes));
+    byte_struct_kll_t *kll_loaded = byte_struct_kll_deserialize(s, &s->type_offsets[3], kll_bytes, kll_size);
+    ASSERT_NEQ(kll_loaded, NULL);
+    ASSERT_EQ(byte_struct_kll_count(kll_loaded), 2 * n);
+    double loaded_value = 0.0;
+    ASSERT(byte_struct_kll_quantile(kll_loaded, 0.75, &loaded_value));
+    ASSERT_EQ(loaded_value, value);
+    ASSERT_EQ(byte_struct_kll_deserialize(s, &s->type_offsets[1], kll_bytes, kll_size), NULL);
+    ASSERT_EQ(byte_struct_kll_deserialize(s, &s->type_offsets[3], kll_bytes, kll_size - 1), NULL);
+    kll_bytes[0] ^= 1;
+    ASSERT_EQ(byte_struct_kll_deserialize(s, &s->type_offsets[3], kll_bytes, kll_size), NULL);
+
+    byte_struct_t *text = byte_struct_new("c[4]");
+    ASSERT_NEQ(text, NULL);
+    ASSERT_EQ(byte_struct_kll_new(text, &text->type_offsets[0], 0), NULL);
+    ASSERT_EQ(byte_struct_kll_new(s, &s->type_offsets[1], 4), NULL);
+
+    byte_struct_destroy(text);
+    free(kll_bytes);
+    byte_struct_kll_destroy(kll_loaded);
+    byte_struct_kll_destroy(array_second);
+    byte_struct_kll_destroy(array);
+    byte_struct_kll_destroy(descending);
+    byte_struct_kll_destroy(kll);
+    free(hll_bytes);
+    byte_struct_hll_destroy(loaded);
+    byte_struct_hll_destroy(coarse);
+    byte_struct_hll_destroy(second);
+    byte_struct_hll_destroy(first);
+    byte_struct_hll_destroy(hll);
+    free(records);
+    byte_struct_destroy(s);
+    PASS();
+}
+
+#ifdef BYTE_STRUCT_STATS
+TEST test_byte_struct_stats(void) {
+    byte_struct_stats_reset();
+
+    byte_struct_t *s = byte_struct_new_len_options("Id", strlen("Id"), BYTE_STRUCT_SORTABLE);
+    ASSERT_NEQ(s, NULL);
+    ASSERT_EQ(byte_struct_new("I[x]"), NULL);
+
+    uint8_t data[12];
+    for (size_t i = 0; i < 1000; i++) {
+        ASSERT(byte_struct_pack(s, data, (uint32_t)i, 1.0));
+    }
+    uint32_t u = 0;
+    double d = 0.0;
+    ASSERT(byte_struct_unpack(s, data, sizeof(data), &u, &d));
+    ASSERT_FALSE(byte_struct_unpack(s, data, sizeof(data) - 1, &u, &d));
+    ASSERT_FALSE(byte_struct_pack(NULL, data, 1, 1.0));
+
+    byte_struct_stats_t stats;
+    byte_struct_stats_snapshot(&stats);
+    ASSERT_EQ(stats.parse_calls, 2);
+    ASSERT_EQ(stats.parse_failures, 1);
+    ASSERT_EQ(stats.pack_calls, 1001);
+    ASSERT_EQ(stats.pack_records, 1000);
+    ASSERT_EQ(stats.pack_bytes, 12000);
+    ASSERT_EQ(stats.pack_bytes_by_order[BYTE_STRUCT_SORTABLE], 12000);
+    ASSERT_EQ(stats.pack_fields_by_type[BYTE_STRUCT_TYPE_DOUBLE], 1000);
+    ASSERT_EQ(stats.unpack_calls, 2);
+    ASSERT_EQ(stats.unpack_records, 1);
+    ASSERT_EQ(stats.short_data_failures, 1);
+    ASSERT_EQ(stats.null_schema_failures, 1);
+
+    byte_struct_latency_histogram_t histogram;
+    ASSERT(byte_struct_latency_snapshot(s, &histogram));
+    uint64_t samples = 0;
+    for (size_t i = 0; i < BYTE_STRUCT_LATENCY_BUCKETS; i++) {
+        samples += histogram.pack[i];
+    }
+    ASSERT(samples > 0 && samples <= 1000);
+
+    byte_struct_stats_reset();
+    byte_struct_stats_snapshot(&stats);
+    ASSERT_EQ(stats.pack_calls, 0);
+
+    byte_struct_destroy(s);
+    PASS();
+}
+#endif
+
 /* Add definitions that need to be in the test runner's main file. */
 GREATEST_MAIN_DEFS();
 
@@ -127,6 +2386,29 @@ int32_t main(int32_t argc, char **argv) {
     GREATEST_MAIN_BEGIN();      /* command-line options, initialization. */
 
     RUN_TEST(test_byte_struct);
+    RUN_TEST(test_byte_struct_batch);
+    RUN_TEST(test_byte_struct_parallel);
+    RUN_TEST(test_byte_struct_transcode);
+    RUN_TEST(test_byte_struct_descending);
+    RUN_TEST(test_byte_struct_nullable);
+    RUN_TEST(test_byte_struct_groups);
+    RUN_TEST(test_byte_struct_ring);
+    RUN_TEST(test_byte_struct_bloom);
+    RUN_TEST(test_byte_struct_zone_map);
+    RUN_TEST(test_byte_struct_merge);
+    RUN_TEST(test_byte_struct_half);
+    RUN_TEST(test_byte_struct_relptr);
+    RUN_TEST(test_byte_struct_search);
+    RUN_TEST(test_byte_struct_csv);
+    RUN_TEST(test_byte_struct_partition);
+    RUN_TEST(test_byte_struct_topk);
+    RUN_TEST(test_byte_struct_codec);
+    RUN_TEST(test_byte_struct_sort_abbreviated);
+    RUN_TEST(test_byte_struct_dict);
+    RUN_TEST(test_byte_struct_sketch);
+#ifdef BYTE_STRUCT_STATS
+    RUN_TEST(test_byte_struct_stats);
+#endif
 
     GREATEST_MAIN_END();        /* display results */
 }